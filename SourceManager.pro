@@ -1,4 +1,4 @@
-QT       += core gui sql
+QT       += core gui sql concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,15 +9,49 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    backgroundio.cpp \
+    backupchain.cpp \
+    conflictaudit.cpp \
+    courseanalytics.cpp \
     course.cpp \
+    coursehistory.cpp \
+    coursejournal.cpp \
     coursemanager.cpp \
+    coursesnapshot.cpp \
+    csvexporter.cpp \
+    databasebackup.cpp \
+    dateintervalindex.cpp \
+    examscheduler.cpp \
+    icsparser.cpp \
+    jsonlines.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    occupancyindex.cpp \
+    refreshscratch.cpp \
+    snapshotsource.cpp \
+    timetablesolver.cpp
 
 HEADERS += \
+    backgroundio.h \
+    backupchain.h \
+    conflictaudit.h \
+    courseanalytics.h \
     course.h \
+    coursehistory.h \
+    coursejournal.h \
     coursemanager.h \
-    mainwindow.h
+    coursesnapshot.h \
+    csvexporter.h \
+    databasebackup.h \
+    dateintervalindex.h \
+    examscheduler.h \
+    icsparser.h \
+    jsonlines.h \
+    mainwindow.h \
+    occupancyindex.h \
+    refreshscratch.h \
+    snapshotsource.h \
+    timetablesolver.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,66 @@
+#include "backgroundio.h"
+#include <QSqlError>
+#include <QThread>
+
+bool BackgroundIo::withConnection(const QString &databasePath, const QString &name,
+                                  const Job &job, QString *error)
+{
+    const QString connection = QString("%1-%2").arg(name).arg(quintptr(QThread::currentThreadId()));
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection);
+        db.setDatabaseName(databasePath);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000"); // 界面线程正在写时等待而不是立即失败
+        if (db.open()) {
+            job(db);
+            db.close();
+            ok = true;
+        } else if (error) {
+            *error = db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(connection);
+    return ok;
+}
+
+QString BackgroundIo::inFilter(const QString &column, const QStringList &values)
+{
+    if (values.isEmpty()) return QString();
+    QStringList placeholders;
+    for (int i = 0; i < values.size(); ++i) placeholders << "?";
+    return QString(" WHERE %1 IN (%2)").arg(column, placeholders.join(", "));
+}
+
+BackgroundIo::Writer::Writer(const QString &filePath)
+    : m_file(filePath), m_bytes(0)
+{
+    m_buffer.reserve(BufferSize + 4096);
+}
+
+bool BackgroundIo::Writer::open()
+{
+    return m_file.open(QIODevice::WriteOnly);
+}
+
+bool BackgroundIo::Writer::flushIfFull()
+{
+    return m_buffer.size() < BufferSize || flush();
+}
+
+bool BackgroundIo::Writer::flush()
+{
+    if (m_file.write(m_buffer) != m_buffer.size()) return false;
+    m_bytes += m_buffer.size();
+    m_buffer.resize(0);
+    return true;
+}
+
+bool BackgroundIo::Writer::finish(bool ok, bool canceled, QString *error)
+{
+    if (ok && flush() && m_file.commit()) return true;
+
+    // 取消不算错误；调用方已经给出原因时不覆盖
+    if (!canceled && error && error->isEmpty()) *error = m_file.errorString();
+    m_file.cancelWriting();
+    return false;
+}
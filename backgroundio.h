@@ -0,0 +1,49 @@
+#ifndef BACKGROUNDIO_H
+#define BACKGROUNDIO_H
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <functional>
+
+// CsvExporter、JsonLines、DatabaseBackup 共用的后台读写工具。
+// withConnection 在工作线程上打开独立连接执行任务；Writer 经 1 MB 缓冲区写入 QSaveFile，
+// 只有 finish 成功时才替换目标文件，取消或出错时目标文件保持原样。
+class BackgroundIo
+{
+public:
+    static constexpr int BufferSize = 1 << 20;
+
+    using Job = std::function<void(const QSqlDatabase &db)>;
+
+    // 连接不能跨线程使用，每次调用都为当前线程单独打开一个，结束后移除。
+    // name 用于区分连接名；打开失败时不执行 job，返回 false 并写入 error
+    static bool withConnection(const QString &databasePath, const QString &name,
+                               const Job &job, QString *error = nullptr);
+
+    // " WHERE column IN (?, ?, ...)"，values 为空时返回空串；调用方按顺序绑定 values
+    static QString inFilter(const QString &column, const QStringList &values);
+
+    class Writer
+    {
+    public:
+        explicit Writer(const QString &filePath);
+
+        bool open();
+        QByteArray &buffer() { return m_buffer; }
+        bool flushIfFull();                   // 缓冲区写满时写出
+        bool finish(bool ok, bool canceled, QString *error); // ok 为 false 时丢弃已写的内容
+        qint64 bytes() const { return m_bytes; }
+        QString errorString() const { return m_file.errorString(); }
+
+    private:
+        bool flush();
+
+        QSaveFile m_file;
+        QByteArray m_buffer;
+        qint64 m_bytes;
+    };
+};
+
+#endif // BACKGROUNDIO_H
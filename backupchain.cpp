@@ -0,0 +1,283 @@
+#include "backupchain.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryFile>
+#include <QTextStream>
+
+namespace {
+
+const char ManifestHeader[] = "SMBACKUP 1";
+const char ManifestSuffix[] = ".manifest";
+
+} // namespace
+
+BackupChain::BackupChain(const QString &directory)
+    : m_dir(directory)
+{
+}
+
+QString BackupChain::directory() const
+{
+    return m_dir;
+}
+
+QString BackupChain::manifestPath(const QString &id) const
+{
+    return m_dir + "/" + id + ManifestSuffix;
+}
+
+QString BackupChain::objectPath(const QString &hash) const
+{
+    return m_dir + "/objects/" + hash.left(2) + "/" + hash;
+}
+
+bool BackupChain::backup(const QSqlDatabase &db, Snapshot *created, QString *error)
+{
+    auto fail = [error](const QString &message) {
+        if (error) *error = message;
+        qDebug() << "Failed to create incremental backup:" << message;
+        return false;
+    };
+
+    if (!QDir().mkpath(m_dir + "/objects")) {
+        return fail("无法创建备份目录 " + m_dir);
+    }
+
+    Snapshot snapshot;
+    snapshot.created = QDateTime::currentDateTime();
+    snapshot.id = snapshot.created.toString("yyyyMMdd_hhmmss_zzz");
+
+    // 开启读事务并读一次，持有共享锁直到 COMMIT；顺便快速检查一下数据库本身是否完好。
+    // 锁内只把数据库文件原样复制到临时文件，分块、哈希、压缩都在释放锁之后进行，尽量少阻塞写入
+    QSqlQuery lock(db);
+    if (!lock.exec("BEGIN")) {
+        return fail(lock.lastError().text());
+    }
+    if (!lock.exec("PRAGMA quick_check") || !lock.next() || lock.value(0).toString() != "ok") {
+        lock.exec("ROLLBACK");
+        return fail("数据库完整性检查未通过，已停止备份");
+    }
+    lock.finish();
+
+    QFile file(db.databaseName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        lock.exec("ROLLBACK");
+        return fail(file.errorString());
+    }
+    QTemporaryFile copy(m_dir + "/copy_XXXXXX.tmp");
+    if (!copy.open()) {
+        lock.exec("ROLLBACK");
+        return fail(copy.errorString());
+    }
+    while (!file.atEnd()) {
+        const QByteArray block = file.read(ChunkSize * 16);
+        if (block.isEmpty()) break;
+        if (copy.write(block) != block.size()) {
+            lock.exec("ROLLBACK");
+            return fail(copy.errorString());
+        }
+    }
+    const QString readError = file.error() == QFileDevice::NoError ? QString() : file.errorString();
+    file.close();
+    lock.exec("COMMIT");
+
+    if (!readError.isEmpty()) {
+        return fail(readError);
+    }
+    if (!copy.flush() || !copy.seek(0)) {
+        return fail(copy.errorString());
+    }
+
+    QStringList hashes;
+    bool ok = true;
+    QString message;
+    while (ok && !copy.atEnd()) {
+        const QByteArray chunk = copy.read(ChunkSize);
+        if (chunk.isEmpty()) break;
+        const QString hash = QString::fromLatin1(QCryptographicHash::hash(chunk, QCryptographicHash::Sha256).toHex());
+        hashes << hash;
+        snapshot.size += chunk.size();
+
+        const QString path = objectPath(hash);
+        if (QFile::exists(path)) continue;
+
+        QDir().mkpath(path.left(path.lastIndexOf('/')));
+        const QByteArray stored = qCompress(chunk);
+        QSaveFile object(path);
+        if (!object.open(QIODevice::WriteOnly) || object.write(stored) != stored.size() || !object.commit()) {
+            ok = false;
+            message = object.errorString();
+            break;
+        }
+        ++snapshot.newChunks;
+        snapshot.storedBytes += stored.size();
+    }
+    copy.close();
+
+    if (!ok) {
+        return fail(message);
+    }
+    snapshot.chunkCount = hashes.size();
+
+    // 清单最后写入：写到一半失败时不会留下引用缺失块的备份
+    QSaveFile manifest(manifestPath(snapshot.id));
+    if (!manifest.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return fail(manifest.errorString());
+    }
+    QTextStream out(&manifest);
+    out << ManifestHeader << "\n"
+        << "created " << snapshot.created.toString(Qt::ISODateWithMs) << "\n"
+        << "size " << snapshot.size << "\n"
+        << "new " << snapshot.newChunks << " " << snapshot.storedBytes << "\n";
+    for (const QString &hash : hashes) {
+        out << hash << "\n";
+    }
+    out.flush();
+    if (!manifest.commit()) {
+        return fail(manifest.errorString());
+    }
+
+    if (created) *created = snapshot;
+    return true;
+}
+
+bool BackupChain::readManifest(const QString &path, Snapshot *snapshot, QStringList *hashes) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream in(&file);
+    if (in.readLine() != ManifestHeader) {
+        return false;
+    }
+
+    const QString name = path.mid(path.lastIndexOf('/') + 1);
+    snapshot->id = name.left(name.size() - int(sizeof(ManifestSuffix)) + 1);
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        if (line.startsWith("created ")) {
+            snapshot->created = QDateTime::fromString(line.mid(8), Qt::ISODateWithMs);
+        } else if (line.startsWith("size ")) {
+            snapshot->size = line.mid(5).toLongLong();
+        } else if (line.startsWith("new ")) {
+            const QStringList parts = line.split(' ');
+            snapshot->newChunks = parts.value(1).toInt();
+            snapshot->storedBytes = parts.value(2).toLongLong();
+        } else if (line.size() == 64) {
+            ++snapshot->chunkCount;
+            if (hashes) hashes->append(line);
+        }
+    }
+    return snapshot->created.isValid();
+}
+
+QList<BackupChain::Snapshot> BackupChain::snapshots() const
+{
+    QList<Snapshot> result;
+    const QStringList names = QDir(m_dir).entryList({QString("*") + ManifestSuffix}, QDir::Files, QDir::Name | QDir::Reversed);
+    for (const QString &name : names) {
+        Snapshot snapshot;
+        if (readManifest(m_dir + "/" + name, &snapshot, nullptr)) {
+            result.append(snapshot);
+        }
+    }
+    return result;
+}
+
+bool BackupChain::restore(const QString &snapshotId, const QString &targetPath, QString *error) const
+{
+    auto fail = [error](const QString &message) {
+        if (error) *error = message;
+        qDebug() << "Failed to restore backup:" << message;
+        return false;
+    };
+
+    Snapshot snapshot;
+    QStringList hashes;
+    if (!readManifest(manifestPath(snapshotId), &snapshot, &hashes)) {
+        return fail("找不到备份 " + snapshotId);
+    }
+
+    QSaveFile target(targetPath);
+    if (!target.open(QIODevice::WriteOnly)) {
+        return fail(target.errorString());
+    }
+
+    qint64 written = 0;
+    for (const QString &hash : hashes) {
+        QFile object(objectPath(hash));
+        if (!object.open(QIODevice::ReadOnly)) {
+            target.cancelWriting();
+            return fail("备份数据块缺失: " + hash);
+        }
+        const QByteArray chunk = qUncompress(object.readAll());
+        if (QString::fromLatin1(QCryptographicHash::hash(chunk, QCryptographicHash::Sha256).toHex()) != hash) {
+            target.cancelWriting();
+            return fail("备份数据块已损坏: " + hash);
+        }
+        if (target.write(chunk) != chunk.size()) {
+            target.cancelWriting();
+            return fail(target.errorString());
+        }
+        written += chunk.size();
+    }
+
+    if (written != snapshot.size) {
+        target.cancelWriting();
+        return fail("备份大小与清单不符");
+    }
+    if (!target.commit()) {
+        return fail(target.errorString());
+    }
+    return true;
+}
+
+int BackupChain::prune(const Policy &policy)
+{
+    const QList<Snapshot> all = snapshots();
+    const QDate today = QDate::currentDate();
+
+    QSet<QDate> keptDays;
+    QStringList removed;
+    for (int i = 0; i < all.size(); ++i) {
+        const Snapshot &snapshot = all.at(i);
+        const QDate day = snapshot.created.date();
+        bool keep = i < policy.keepLatest;
+        if (day.daysTo(today) < policy.keepDays && !keptDays.contains(day)) {
+            keptDays.insert(day); // 按时间倒序遍历，每天第一个遇到的就是当天最后一份
+            keep = true;
+        }
+        if (!keep && QFile::remove(manifestPath(snapshot.id))) {
+            removed << snapshot.id;
+        }
+    }
+    if (removed.isEmpty()) {
+        return 0;
+    }
+
+    // 清理不再被任何清单引用的块
+    QSet<QString> referenced;
+    for (const Snapshot &snapshot : snapshots()) {
+        Snapshot parsed;
+        QStringList hashes;
+        if (readManifest(manifestPath(snapshot.id), &parsed, &hashes)) {
+            for (const QString &hash : hashes) referenced.insert(hash);
+        }
+    }
+    QDirIterator it(m_dir + "/objects", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        if (!referenced.contains(it.fileName())) QFile::remove(path);
+    }
+
+    return removed.size();
+}
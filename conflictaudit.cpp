@@ -0,0 +1,202 @@
+#include "conflictaudit.h"
+#include "occupancyindex.h"
+#include <QHash>
+#include <QRandomGenerator>
+#include <QtConcurrent>
+
+ConflictAudit::ConflictAudit(QObject *parent)
+    : QObject(parent), m_conflictCount(0)
+{
+    connect(&m_watcher, &QFutureWatcherBase::resultsReadyAt, this, [this](int begin, int end) {
+        QVector<Conflict> batch;
+        for (int i = begin; i < end; ++i) {
+            batch += m_watcher.resultAt(i);
+        }
+        m_conflictCount += batch.size();
+        if (!batch.isEmpty()) {
+            emit conflictsFound(batch);
+        }
+    });
+    connect(&m_watcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        emit progressChanged(value, m_watcher.progressMaximum());
+    });
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, [this]() {
+        m_plan.reset();
+        emit finished(m_conflictCount, m_timer.elapsed(), m_watcher.isCanceled());
+    });
+}
+
+ConflictAudit::~ConflictAudit()
+{
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+}
+
+void ConflictAudit::start(const QList<CourseData> &courses, const QDate &semesterStart, int weekCount)
+{
+    if (isRunning()) {
+        cancel();
+        m_watcher.waitForFinished();
+    }
+
+    m_timer.start();
+    m_conflictCount = 0;
+    m_plan = prepare(courses, semesterStart, weekCount);
+
+    std::shared_ptr<const Plan> plan = m_plan;
+    m_watcher.setFuture(QtConcurrent::mapped(plan->activeBuckets, [plan](int bucket) {
+        return auditBucket(*plan, bucket);
+    }));
+}
+
+void ConflictAudit::cancel()
+{
+    m_watcher.cancel();
+}
+
+bool ConflictAudit::isRunning() const
+{
+    return m_watcher.isRunning();
+}
+
+QVector<ConflictAudit::Conflict> ConflictAudit::run(const QList<CourseData> &courses,
+                                                     const QDate &semesterStart, int weekCount)
+{
+    std::shared_ptr<const Plan> plan = prepare(courses, semesterStart, weekCount);
+    const QList<QVector<Conflict>> perBucket = QtConcurrent::blockingMapped(plan->activeBuckets, [plan](int bucket) {
+        return auditBucket(*plan, bucket);
+    });
+
+    QVector<Conflict> conflicts;
+    for (const QVector<Conflict> &bucket : perBucket) {
+        conflicts += bucket;
+    }
+    return conflicts;
+}
+
+QStringList ConflictAudit::benchmark(const QVector<int> &sizes)
+{
+    QStringList lines;
+    const QDate semesterStart(2025, 9, 1);
+    const int weekCount = 20;
+    QRandomGenerator random(20250901); // 固定种子，便于前后对比
+
+    for (int size : sizes) {
+        // 教室和教师数量随规模增长，使每个教室每周的课时与真实学期接近
+        const int rooms = qMax(1, size / 20);
+        const int teachers = qMax(1, size / 15);
+
+        QList<CourseData> courses;
+        courses.reserve(size);
+        for (int i = 0; i < size; ++i) {
+            CourseData course;
+            course.id = i + 1;
+            course.name = QString("课程%1").arg(i + 1);
+            course.dayOfWeek = random.bounded(1, 6);
+            course.startSlot = random.bounded(1, OccupancyIndex::SlotsPerDay);
+            course.endSlot = qMin(int(OccupancyIndex::SlotsPerDay), course.startSlot + random.bounded(0, 2));
+            course.location = QString("教室%1").arg(random.bounded(rooms));
+            course.teacher = QString("教师%1").arg(random.bounded(teachers));
+            course.startDate = semesterStart;
+            course.endDate = semesterStart.addDays(weekCount * 7 - 1);
+            courses.append(course);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        const int found = run(courses, semesterStart, weekCount).size();
+        lines << QString("%1 门课程: %2 ms，%3 处冲突").arg(size).arg(timer.elapsed()).arg(found);
+    }
+    return lines;
+}
+
+std::shared_ptr<const ConflictAudit::Plan> ConflictAudit::prepare(const QList<CourseData> &courses,
+                                                                   const QDate &semesterStart, int weekCount)
+{
+    // 借用占用索引计算每门课实际上课的周次，与实时冲突检测保持同一套规则
+    OccupancyIndex weeksOf;
+    weeksOf.reset(semesterStart, weekCount);
+
+    auto plan = std::make_shared<Plan>();
+    plan->items.reserve(courses.size());
+    plan->buckets.resize(OccupancyIndex::DaysPerWeek * OccupancyIndex::SlotsPerDay);
+
+    for (const CourseData &course : courses) {
+        Item item;
+        item.id = course.id;
+        item.slotMask = OccupancyIndex::slotRangeMask(course.startSlot, course.endSlot);
+        item.weeks = weeksOf.activeWeeks(course);
+        item.room = course.location.trimmed();
+        item.teacher = course.teacher.trimmed();
+        if (!item.slotMask || !item.weeks || (item.room.isEmpty() && item.teacher.isEmpty())) continue;
+
+        const int index = plan->items.size();
+        plan->items.append(item);
+
+        const int dayBase = (course.dayOfWeek - 1) * OccupancyIndex::SlotsPerDay;
+        for (int slot = 0; slot < OccupancyIndex::SlotsPerDay; ++slot) {
+            if (item.slotMask & (1u << slot)) {
+                plan->buckets[dayBase + slot].append(index);
+            }
+        }
+    }
+
+    for (int bucket = 0; bucket < plan->buckets.size(); ++bucket) {
+        if (plan->buckets.at(bucket).size() > 1) {
+            plan->activeBuckets.append(bucket);
+        }
+    }
+    return plan;
+}
+
+QVector<ConflictAudit::Conflict> ConflictAudit::auditBucket(const Plan &plan, int bucket)
+{
+    QVector<Conflict> conflicts;
+    const quint16 bit = quint16(1u << (bucket % OccupancyIndex::SlotsPerDay));
+
+    QHash<QString, QVector<int>> byRoom;
+    QHash<QString, QVector<int>> byTeacher;
+    for (int index : plan.buckets.at(bucket)) {
+        const Item &item = plan.items.at(index);
+        if (!item.room.isEmpty()) byRoom[item.room].append(index);
+        if (!item.teacher.isEmpty()) byTeacher[item.teacher].append(index);
+    }
+
+    auto check = [&](const Item &a, const Item &b, bool sameRoom, bool sameTeacher) {
+        const quint16 common = a.slotMask & b.slotMask;
+        if (common & (bit - 1)) return; // 更早的节次已经重叠，由那个桶负责报告
+        const quint64 weeks = a.weeks & b.weeks;
+        if (!weeks) return;
+
+        Conflict conflict;
+        conflict.firstId = qMin(a.id, b.id);
+        conflict.secondId = qMax(a.id, b.id);
+        conflict.sameRoom = sameRoom;
+        conflict.sameTeacher = sameTeacher;
+        conflict.slotMask = common;
+        conflict.weeks = weeks;
+        conflicts.append(conflict);
+    };
+
+    for (const QVector<int> &group : byRoom) {
+        for (int i = 0; i < group.size(); ++i) {
+            const Item &a = plan.items.at(group.at(i));
+            for (int j = i + 1; j < group.size(); ++j) {
+                const Item &b = plan.items.at(group.at(j));
+                check(a, b, true, !a.teacher.isEmpty() && a.teacher == b.teacher);
+            }
+        }
+    }
+
+    for (const QVector<int> &group : byTeacher) {
+        for (int i = 0; i < group.size(); ++i) {
+            const Item &a = plan.items.at(group.at(i));
+            for (int j = i + 1; j < group.size(); ++j) {
+                const Item &b = plan.items.at(group.at(j));
+                if (!a.room.isEmpty() && a.room == b.room) continue; // 已在教室分组中报告
+                check(a, b, false, true);
+            }
+        }
+    }
+    return conflicts;
+}
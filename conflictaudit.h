@@ -0,0 +1,73 @@
+#ifndef CONFLICTAUDIT_H
+#define CONFLICTAUDIT_H
+
+#include <QObject>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include "coursemanager.h"
+
+// 整学期冲突审计。
+// 课程按 (星期, 节次) 分桶，桶内只比较同教室或同教师的课程，避免全量两两比较；
+// 各桶通过 QtConcurrent 在线程池中并行检查，每个桶的结果检查完就送回界面线程。
+// 同一对课程只在它们共同占用的第一节所在的桶中报告一次。
+class ConflictAudit : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Conflict {
+        int firstId;
+        int secondId;
+        bool sameRoom;
+        bool sameTeacher;
+        quint16 slotMask;  // 冲突的节次位
+        quint64 weeks;     // 冲突的周次位
+    };
+
+    explicit ConflictAudit(QObject *parent = nullptr);
+    ~ConflictAudit();
+
+    void start(const QList<CourseData> &courses, const QDate &semesterStart, int weekCount);
+    void cancel();
+    bool isRunning() const;
+
+    // 同步执行，供基准测试等非界面场景使用
+    static QVector<Conflict> run(const QList<CourseData> &courses, const QDate &semesterStart, int weekCount);
+    // 用随机生成的课程计时，每个规模输出一行结果
+    static QStringList benchmark(const QVector<int> &sizes = {10000, 50000, 200000});
+
+signals:
+    void conflictsFound(const QVector<ConflictAudit::Conflict> &conflicts);
+    void progressChanged(int done, int total);
+    void finished(int conflictCount, qint64 elapsedMs, bool canceled);
+
+private:
+    struct Item {
+        int id;
+        quint16 slotMask;
+        quint64 weeks;
+        QString room;
+        QString teacher;
+    };
+
+    struct Plan {
+        QVector<Item> items;
+        QVector<QVector<int>> buckets;  // 下标 = (星期-1) * 每天节数 + (节次-1)，内容为 items 下标
+        QVector<int> activeBuckets;     // 至少有两门课的桶
+    };
+
+    static std::shared_ptr<const Plan> prepare(const QList<CourseData> &courses,
+                                               const QDate &semesterStart, int weekCount);
+    static QVector<Conflict> auditBucket(const Plan &plan, int bucket);
+
+    QFutureWatcher<QVector<Conflict>> m_watcher;
+    std::shared_ptr<const Plan> m_plan;
+    QElapsedTimer m_timer;
+    int m_conflictCount;
+};
+
+#endif // CONFLICTAUDIT_H
@@ -0,0 +1,195 @@
+#include "courseanalytics.h"
+#include "coursemanager.h"
+#include "csvexporter.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+#include <algorithm>
+
+namespace {
+
+int bitCount(quint64 value)
+{
+    int count = 0;
+    for (; value; value &= value - 1) ++count;
+    return count;
+}
+
+} // namespace
+
+CourseAnalytics::CourseAnalytics(CourseManager *manager, QObject *parent)
+    : QObject(parent), m_manager(manager), m_valid(false), m_weekCount(0), m_computeMs(0)
+{
+    connect(m_manager, &CourseManager::dataChanged, this, &CourseAnalytics::invalidate);
+}
+
+const QList<CourseAnalytics::TeacherWorkload> &CourseAnalytics::teacherWorkloads()
+{
+    ensureComputed();
+    return m_teachers;
+}
+
+const QList<CourseAnalytics::RoomUtilisation> &CourseAnalytics::roomUtilisation()
+{
+    ensureComputed();
+    return m_rooms;
+}
+
+int CourseAnalytics::weekCount()
+{
+    ensureComputed();
+    return m_weekCount;
+}
+
+qint64 CourseAnalytics::lastComputeMs() const
+{
+    return m_computeMs;
+}
+
+void CourseAnalytics::invalidate()
+{
+    m_valid = false;
+}
+
+bool CourseAnalytics::isValid() const
+{
+    return m_valid && m_semester == m_manager->getCurrentSemester();
+}
+
+void CourseAnalytics::ensureComputed()
+{
+    if (!isValid()) compute();
+}
+
+void CourseAnalytics::compute()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QList<CourseData> courses = m_manager->getAllCourses();
+    const OccupancyIndex &occupancy = m_manager->occupancyIndex();
+    m_weekCount = occupancy.weekCount();
+    const int days = OccupancyIndex::DaysPerWeek;
+
+    // 一次遍历：教师按周累计节数，教室按 (周, 天) 叠加占用位，重叠部分另记一份
+    QHash<QString, TeacherWorkload> teachers;
+    QHash<QString, QVector<quint16>> roomMasks;
+    QHash<QString, QVector<quint16>> roomOverlaps;
+    for (const CourseData &course : courses) {
+        const quint16 range = OccupancyIndex::slotRangeMask(course.startSlot, course.endSlot);
+        const quint64 weeks = occupancy.activeWeeks(course);
+        if (!range || !weeks || course.dayOfWeek < 1 || course.dayOfWeek > days) continue;
+        const int span = bitCount(range);
+
+        const QString teacher = course.teacher.trimmed();
+        if (!teacher.isEmpty()) {
+            TeacherWorkload &load = teachers[teacher];
+            if (load.slotsPerWeek.isEmpty()) {
+                load.teacher = teacher;
+                load.slotsPerWeek.fill(0, m_weekCount);
+            }
+            ++load.courseCount;
+            load.credits += course.credits;
+            for (int week = 0; week < m_weekCount; ++week) {
+                if (weeks & (quint64(1) << week)) load.slotsPerWeek[week] += span;
+            }
+        }
+
+        const QString room = course.location.trimmed();
+        if (!room.isEmpty()) {
+            QVector<quint16> &masks = roomMasks[room];
+            QVector<quint16> &overlaps = roomOverlaps[room];
+            if (masks.isEmpty()) {
+                masks.fill(0, m_weekCount * days);
+                overlaps.fill(0, m_weekCount * days);
+            }
+            for (int week = 0; week < m_weekCount; ++week) {
+                if (!(weeks & (quint64(1) << week))) continue;
+                const int cell = week * days + course.dayOfWeek - 1;
+                overlaps[cell] |= masks.at(cell) & range;
+                masks[cell] |= range;
+            }
+        }
+    }
+
+    m_teachers.clear();
+    for (TeacherWorkload &load : teachers) {
+        for (int slotCount : load.slotsPerWeek) {
+            load.totalSlots += slotCount;
+            load.peakWeekSlots = qMax(load.peakWeekSlots, slotCount);
+            if (slotCount > 0) ++load.teachingWeeks;
+        }
+        m_teachers.append(load);
+    }
+    std::sort(m_teachers.begin(), m_teachers.end(), [](const TeacherWorkload &a, const TeacherWorkload &b) {
+        return a.totalSlots != b.totalSlots ? a.totalSlots > b.totalSlots : a.teacher < b.teacher;
+    });
+
+    // 教室库中登记但本学期没有课的教室也列出，利用率为 0
+    QHash<QString, int> capacities;
+    for (const RoomData &room : m_manager->getRooms()) {
+        capacities.insert(room.name, room.capacity);
+        if (!roomMasks.contains(room.name)) roomMasks.insert(room.name, QVector<quint16>());
+    }
+
+    m_rooms.clear();
+    for (auto it = roomMasks.constBegin(); it != roomMasks.constEnd(); ++it) {
+        RoomUtilisation usage;
+        usage.room = it.key();
+        usage.capacity = capacities.value(it.key(), 0);
+        usage.availableSlots = m_weekCount * TeachingDays * OccupancyIndex::SlotsPerDay;
+        // 分母只含周一至周五，周末的课不计入利用率，避免超过 100%
+        const QVector<quint16> &masks = it.value();
+        const QVector<quint16> overlaps = roomOverlaps.value(it.key());
+        for (int cell = 0; cell < masks.size(); ++cell) {
+            if (cell % days >= TeachingDays) continue;
+            usage.usedSlots += bitCount(masks.at(cell));
+            usage.doubleBooked += bitCount(overlaps.at(cell));
+        }
+        m_rooms.append(usage);
+    }
+    std::sort(m_rooms.begin(), m_rooms.end(), [](const RoomUtilisation &a, const RoomUtilisation &b) {
+        return a.usedSlots != b.usedSlots ? a.usedSlots > b.usedSlots : a.room < b.room;
+    });
+
+    m_semester = m_manager->getCurrentSemester();
+    m_valid = true;
+    m_computeMs = timer.elapsed();
+}
+
+bool CourseAnalytics::exportToCsv(const QString &filePath)
+{
+    ensureComputed();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+
+    out << "教师,课程数,学分,总节数,周均节数,最忙一周节数,授课周数\n";
+    for (const TeacherWorkload &load : m_teachers) {
+        out << CsvExporter::quote(load.teacher) << ","
+            << load.courseCount << ","
+            << load.credits << ","
+            << load.totalSlots << ","
+            << QString::number(load.averageWeeklySlots(), 'f', 1) << ","
+            << load.peakWeekSlots << ","
+            << load.teachingWeeks << "\n";
+    }
+
+    out << "\n教室,容量,占用节数,可用节数,利用率(%),重复占用节数\n";
+    for (const RoomUtilisation &usage : m_rooms) {
+        out << CsvExporter::quote(usage.room) << ","
+            << usage.capacity << ","
+            << usage.usedSlots << ","
+            << usage.availableSlots << ","
+            << QString::number(usage.percent(), 'f', 1) << ","
+            << usage.doubleBooked << "\n";
+    }
+
+    file.close();
+    return true;
+}
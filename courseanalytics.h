@@ -0,0 +1,67 @@
+#ifndef COURSEANALYTICS_H
+#define COURSEANALYTICS_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class CourseManager;
+
+// 教师工作量与教室利用率统计。
+// 对当前学期的课程只遍历一次，同时累计教师课时和教室占用位图；
+// 结果缓存到 CourseManager 发出 dataChanged 或切换学期为止。
+class CourseAnalytics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct TeacherWorkload {
+        QString teacher;
+        int courseCount = 0;
+        double credits = 0;
+        int totalSlots = 0;          // 整个学期的总节数
+        int peakWeekSlots = 0;       // 最忙一周的节数
+        int teachingWeeks = 0;       // 有课的周数
+        QVector<int> slotsPerWeek;   // 第 i 项 = 第 i+1 周的节数
+
+        double averageWeeklySlots() const { return teachingWeeks ? double(totalSlots) / teachingWeeks : 0; }
+    };
+
+    struct RoomUtilisation {
+        QString room;
+        int capacity = 0;            // 教室库中未登记时为 0
+        int usedSlots = 0;           // 被占用的 (周, 天, 节) 格数，重复排课只计一次
+        int availableSlots = 0;      // 学期内工作日的全部格数
+        int doubleBooked = 0;        // 被两门及以上课程同时占用的格数
+
+        double percent() const { return availableSlots ? 100.0 * usedSlots / availableSlots : 0; }
+    };
+
+    static constexpr int TeachingDays = 5; // 利用率按周一至周五计算
+
+    explicit CourseAnalytics(CourseManager *manager, QObject *parent = nullptr);
+
+    const QList<TeacherWorkload> &teacherWorkloads();   // 按总节数从多到少
+    const QList<RoomUtilisation> &roomUtilisation();    // 按利用率从高到低
+    int weekCount();
+    qint64 lastComputeMs() const;
+
+    void invalidate();
+    bool isValid() const;
+    bool exportToCsv(const QString &filePath);
+
+private:
+    void ensureComputed();
+    void compute();
+
+    CourseManager *m_manager;
+    bool m_valid;
+    QString m_semester;
+    int m_weekCount;
+    qint64 m_computeMs;
+    QList<TeacherWorkload> m_teachers;
+    QList<RoomUtilisation> m_rooms;
+};
+
+#endif // COURSEANALYTICS_H
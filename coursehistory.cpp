@@ -0,0 +1,77 @@
+#include "coursehistory.h"
+
+CourseHistory::CourseHistory()
+    : m_index(0)
+{
+}
+
+void CourseHistory::push(const QString &text, const QList<Change> &changes)
+{
+    if (changes.isEmpty()) return;
+
+    // 新命令之后的重做记录失效
+    while (m_commands.size() > m_index) {
+        m_commands.removeLast();
+    }
+    m_commands.append({text, changes});
+    if (m_commands.size() > UndoLimit) {
+        m_commands.removeFirst();
+    }
+    m_index = m_commands.size();
+}
+
+void CourseHistory::clear()
+{
+    m_commands.clear();
+    m_index = 0;
+}
+
+bool CourseHistory::canUndo() const
+{
+    return m_index > 0;
+}
+
+bool CourseHistory::canRedo() const
+{
+    return m_index < m_commands.size();
+}
+
+QString CourseHistory::undoText() const
+{
+    return canUndo() ? m_commands.at(m_index - 1).text : QString();
+}
+
+QString CourseHistory::redoText() const
+{
+    return canRedo() ? m_commands.at(m_index).text : QString();
+}
+
+const CourseHistory::Command &CourseHistory::undoCommand() const
+{
+    return m_commands.at(m_index - 1);
+}
+
+const CourseHistory::Command &CourseHistory::redoCommand() const
+{
+    return m_commands.at(m_index);
+}
+
+void CourseHistory::undone()
+{
+    if (canUndo()) --m_index;
+}
+
+void CourseHistory::redone()
+{
+    if (canRedo()) ++m_index;
+}
+
+int CourseHistory::count() const
+{
+    return m_commands.size();
+}
+
+int CourseHistory::index() const
+{
+    return m_index;
+}
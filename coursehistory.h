@@ -0,0 +1,54 @@
+#ifndef COURSEHISTORY_H
+#define COURSEHISTORY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+// 内存中的撤销/重做栈，用法与 QUndoStack 类似：index 之前的命令可撤销，之后的可重做，
+// 撤销后再做新的修改会丢弃可重做的部分。
+// 每条命令是一次用户操作（添加、修改、删除、批量修改、导入……）涉及的全部课程，
+// 课程的修改前后内容用 CourseJournal 的紧凑编码保存；命令本身不执行任何数据库操作，
+// 撤销和重做由 CourseManager 在一个事务中完成。只在本次运行期间有效，持久的历史见 CourseJournal。
+class CourseHistory
+{
+public:
+    struct Change {
+        QString semester;
+        int courseId = -1;
+        QByteArray before;      // 为空表示这次操作新增了该课程
+        QByteArray after;       // 为空表示这次操作删除了该课程
+        QVector<int> students;  // 被删除课程原有的选课学生，撤销删除时一并恢复
+    };
+
+    struct Command {
+        QString text;
+        QList<Change> changes;
+    };
+
+    static constexpr int UndoLimit = 100; // 最多保留的命令数，超出时丢弃最早的
+
+    CourseHistory();
+
+    void push(const QString &text, const QList<Change> &changes);
+    void clear();
+
+    bool canUndo() const;
+    bool canRedo() const;
+    QString undoText() const;
+    QString redoText() const;
+    const Command &undoCommand() const; // 下一条要撤销的命令，调用前先检查 canUndo
+    const Command &redoCommand() const;
+    void undone();  // 撤销成功后调用，命令移到可重做的一侧
+    void redone();
+
+    int count() const;
+    int index() const;
+
+private:
+    QList<Command> m_commands;
+    int m_index;
+};
+
+#endif // COURSEHISTORY_H
@@ -0,0 +1,417 @@
+#include "coursejournal.h"
+#include "coursemanager.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariantList>
+
+namespace {
+
+enum Field {
+    Name, DayOfWeek, StartSlot, EndSlot, Location, StartDate, EndDate,
+    Teacher, ExamDate, CourseType, Credits, WeekMask, FieldCount
+};
+
+enum Kind : quint8 { Full = 0, Diff = 1 };
+
+bool sameField(const CourseData &a, const CourseData &b, int field)
+{
+    switch (field) {
+    case Name: return a.name == b.name;
+    case DayOfWeek: return a.dayOfWeek == b.dayOfWeek;
+    case StartSlot: return a.startSlot == b.startSlot;
+    case EndSlot: return a.endSlot == b.endSlot;
+    case Location: return a.location == b.location;
+    case StartDate: return a.startDate == b.startDate;
+    case EndDate: return a.endDate == b.endDate;
+    case Teacher: return a.teacher == b.teacher;
+    case ExamDate: return a.examDate == b.examDate;
+    case CourseType: return a.courseType == b.courseType;
+    case Credits: return a.credits == b.credits;
+    case WeekMask: return a.weekMask == b.weekMask;
+    default: return true;
+    }
+}
+
+void writeField(QDataStream &out, const CourseData &course, int field)
+{
+    switch (field) {
+    case Name: out << course.name.toUtf8(); break;
+    case DayOfWeek: out << qint8(course.dayOfWeek); break;
+    case StartSlot: out << qint8(course.startSlot); break;
+    case EndSlot: out << qint8(course.endSlot); break;
+    case Location: out << course.location.toUtf8(); break;
+    case StartDate: out << course.startDate; break;
+    case EndDate: out << course.endDate; break;
+    case Teacher: out << course.teacher.toUtf8(); break;
+    case ExamDate: out << course.examDate; break;
+    case CourseType: out << course.courseType.toUtf8(); break;
+    case Credits: out << course.credits; break;
+    case WeekMask: out << course.weekMask; break;
+    default: break;
+    }
+}
+
+void readField(QDataStream &in, CourseData *course, int field)
+{
+    QByteArray text;
+    qint8 small = 0;
+    switch (field) {
+    case Name: in >> text; course->name = QString::fromUtf8(text); break;
+    case DayOfWeek: in >> small; course->dayOfWeek = small; break;
+    case StartSlot: in >> small; course->startSlot = small; break;
+    case EndSlot: in >> small; course->endSlot = small; break;
+    case Location: in >> text; course->location = QString::fromUtf8(text); break;
+    case StartDate: in >> course->startDate; break;
+    case EndDate: in >> course->endDate; break;
+    case Teacher: in >> text; course->teacher = QString::fromUtf8(text); break;
+    case ExamDate: in >> course->examDate; break;
+    case CourseType: in >> text; course->courseType = QString::fromUtf8(text); break;
+    case Credits: in >> course->credits; break;
+    case WeekMask: in >> course->weekMask; break;
+    default: break;
+    }
+}
+
+} // namespace
+
+CourseJournal::CourseJournal(const QString &connection)
+    : m_connection(connection), m_batch(0), m_nextBatch(0), m_sinceCompaction(0)
+{
+}
+
+QSqlDatabase CourseJournal::database() const
+{
+    return QSqlDatabase::database(m_connection);
+}
+
+bool CourseJournal::createTables()
+{
+    QSqlQuery query;
+    return query.exec(
+               "CREATE TABLE IF NOT EXISTS change_journal ("
+               "seq INTEGER PRIMARY KEY,"
+               "batch INTEGER NOT NULL,"
+               "op INTEGER NOT NULL,"
+               "course_id INTEGER NOT NULL,"
+               "semester TEXT NOT NULL,"
+               "data BLOB NOT NULL"
+               ")")
+        && query.exec("CREATE INDEX IF NOT EXISTS idx_change_journal_batch ON change_journal(batch)")
+        && query.exec(
+               "CREATE TABLE IF NOT EXISTS change_batches ("
+               "batch INTEGER PRIMARY KEY,"
+               "ts INTEGER NOT NULL,"
+               "summary TEXT"
+               ")");
+}
+
+void CourseJournal::recordInsert(const QString &semester, const CourseData &after)
+{
+    m_pending.append({0, Insert, after.id, semester, encode(after)});
+}
+
+void CourseJournal::recordUpdate(const QString &semester, const CourseData &before, const CourseData &after)
+{
+    const QByteArray data = diff(before, after);
+    if (!data.isEmpty()) m_pending.append({0, Update, after.id, semester, data});
+}
+
+void CourseJournal::recordDelete(const QString &semester, const CourseData &before, const QVector<int> &students)
+{
+    // 选课学生接在完整字段之后，撤回删除时一并恢复；没有学生时与新增记录格式相同
+    QByteArray data = encode(before);
+    if (!students.isEmpty()) {
+        QDataStream out(&data, QIODevice::WriteOnly | QIODevice::Append);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << students;
+    }
+    m_pending.append({0, Delete, before.id, semester, data});
+}
+
+bool CourseJournal::hasPending() const
+{
+    return !m_pending.isEmpty();
+}
+
+void CourseJournal::discard()
+{
+    m_pending.clear();
+    m_batch = 0;
+}
+
+void CourseJournal::reset()
+{
+    m_pending.clear();
+    m_batch = 0;
+    m_nextBatch = 0;
+    m_sinceCompaction = 0;
+}
+
+qint64 CourseJournal::nextBatch()
+{
+    if (!m_nextBatch) m_nextBatch = lastBatch() + 1;
+    return m_nextBatch++;
+}
+
+bool CourseJournal::flush(const QString &summary)
+{
+    const bool ok = flushPart(summary);
+    endBatch();
+    return ok;
+}
+
+bool CourseJournal::flushPart(const QString &summary)
+{
+    if (m_pending.isEmpty()) return true;
+
+    if (!m_batch) {
+        m_batch = nextBatch();
+        QSqlQuery header(database());
+        header.prepare("INSERT INTO change_batches (batch, ts, summary) VALUES (?, ?, ?)");
+        header.addBindValue(m_batch);
+        header.addBindValue(QDateTime::currentMSecsSinceEpoch());
+        header.addBindValue(summary);
+        if (!header.exec()) {
+            qDebug() << "Failed to write journal batch:" << header.lastError().text();
+            m_pending.clear();
+            m_batch = 0;
+            m_nextBatch = 0;
+            return false;
+        }
+    }
+
+    // 一条预编译语句按列绑定整批记录
+    QVariantList batches, ops, ids, semesters, data;
+    for (const Entry &entry : m_pending) {
+        batches << m_batch;
+        ops << int(entry.op);
+        ids << entry.courseId;
+        semesters << entry.semester;
+        data << entry.data;
+    }
+
+    QSqlQuery query(database());
+    query.prepare("INSERT INTO change_journal (batch, op, course_id, semester, data) VALUES (?, ?, ?, ?, ?)");
+    query.addBindValue(batches);
+    query.addBindValue(ops);
+    query.addBindValue(ids);
+    query.addBindValue(semesters);
+    query.addBindValue(data);
+    const bool ok = query.execBatch();
+    if (!ok) {
+        qDebug() << "Failed to write journal entries:" << query.lastError().text();
+        m_batch = 0;
+        m_nextBatch = 0;
+    } else {
+        m_sinceCompaction += m_pending.size();
+    }
+    m_pending.clear();
+    return ok;
+}
+
+void CourseJournal::endBatch()
+{
+    m_batch = 0;
+}
+
+int CourseJournal::pendingCount() const
+{
+    return m_pending.size();
+}
+
+QList<CourseJournal::Operation> CourseJournal::operations(int limit) const
+{
+    QList<Operation> result;
+    QSqlQuery query(database());
+    query.prepare("SELECT b.batch, b.ts, b.summary, "
+                  "(SELECT COUNT(*) FROM change_journal j WHERE j.batch = b.batch) "
+                  "FROM change_batches b ORDER BY b.batch DESC LIMIT ?");
+    query.addBindValue(limit);
+    if (query.exec()) {
+        while (query.next()) {
+            Operation operation;
+            operation.batch = query.value(0).toLongLong();
+            operation.time = QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong());
+            operation.summary = query.value(2).toString();
+            operation.changes = query.value(3).toInt();
+            result.append(operation);
+        }
+    }
+    return result;
+}
+
+QDateTime CourseJournal::earliestTime() const
+{
+    QSqlQuery query("SELECT MIN(ts) FROM change_batches", database());
+    if (query.next() && !query.value(0).isNull()) {
+        return QDateTime::fromMSecsSinceEpoch(query.value(0).toLongLong());
+    }
+    return QDateTime();
+}
+
+qint64 CourseJournal::firstBatchAfter(const QDateTime &time) const
+{
+    QSqlQuery query(database());
+    query.prepare("SELECT MIN(batch) FROM change_batches WHERE ts > ?");
+    query.addBindValue(time.toMSecsSinceEpoch());
+    if (query.exec() && query.next() && !query.value(0).isNull()) {
+        return query.value(0).toLongLong();
+    }
+    return 0;
+}
+
+qint64 CourseJournal::lastBatch() const
+{
+    QSqlQuery query("SELECT MAX(batch) FROM change_batches", database());
+    return query.next() ? query.value(0).toLongLong() : 0;
+}
+
+QList<CourseJournal::Entry> CourseJournal::entriesFrom(qint64 batch) const
+{
+    QList<Entry> result;
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT batch, op, course_id, semester, data FROM change_journal WHERE batch >= ? ORDER BY seq DESC");
+    query.addBindValue(batch);
+    if (query.exec()) {
+        while (query.next()) {
+            Entry entry;
+            entry.batch = query.value(0).toLongLong();
+            entry.op = Op(query.value(1).toInt());
+            entry.courseId = query.value(2).toInt();
+            entry.semester = query.value(3).toString();
+            entry.data = query.value(4).toByteArray();
+            result.append(entry);
+        }
+    }
+    return result;
+}
+
+bool CourseJournal::truncateFrom(qint64 batch)
+{
+    QSqlQuery query(database());
+    query.prepare("DELETE FROM change_journal WHERE batch >= ?");
+    query.addBindValue(batch);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM change_batches WHERE batch >= ?");
+        query.addBindValue(batch);
+        ok = query.exec();
+    }
+    m_nextBatch = 0;
+    return ok;
+}
+
+bool CourseJournal::compactIfNeeded()
+{
+    if (m_sinceCompaction < CompactInterval) return false;
+    m_sinceCompaction = 0;
+    return compact() > 0;
+}
+
+int CourseJournal::compact()
+{
+    // 找出需要删除的最大批次：超过保留天数的，以及超出条数上限的最旧部分
+    qint64 cutoff = 0;
+    QSqlQuery query(database());
+    query.prepare("SELECT MAX(batch) FROM change_batches WHERE ts < ?");
+    query.addBindValue(QDateTime::currentDateTime().addDays(-KeepDays).toMSecsSinceEpoch());
+    if (query.exec() && query.next()) cutoff = query.value(0).toLongLong();
+
+    query.prepare("SELECT batch FROM change_journal ORDER BY seq DESC LIMIT 1 OFFSET ?");
+    query.addBindValue(MaxEntries);
+    if (query.exec() && query.next()) cutoff = qMax(cutoff, query.value(0).toLongLong());
+    query.finish();
+
+    if (cutoff <= 0) return 0;
+
+    database().transaction();
+    query.prepare("SELECT COUNT(*) FROM change_batches WHERE batch <= ?");
+    query.addBindValue(cutoff);
+    const int removed = query.exec() && query.next() ? query.value(0).toInt() : 0;
+
+    query.prepare("DELETE FROM change_journal WHERE batch <= ?");
+    query.addBindValue(cutoff);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM change_batches WHERE batch <= ?");
+        query.addBindValue(cutoff);
+        ok = query.exec();
+    }
+    if (!ok) {
+        qDebug() << "Failed to compact journal:" << query.lastError().text();
+        database().rollback();
+        return 0;
+    }
+    database().commit();
+    return removed;
+}
+
+QByteArray CourseJournal::encode(const CourseData &course)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(Full);
+    for (int field = 0; field < FieldCount; ++field) {
+        writeField(out, course, field);
+    }
+    return data;
+}
+
+QByteArray CourseJournal::diff(const CourseData &before, const CourseData &after)
+{
+    quint16 mask = 0;
+    for (int field = 0; field < FieldCount; ++field) {
+        if (!sameField(before, after, field)) mask |= quint16(1) << field;
+    }
+    if (!mask) return QByteArray();
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(Diff) << mask;
+    for (int field = 0; field < FieldCount; ++field) {
+        if (!(mask & (quint16(1) << field))) continue;
+        writeField(out, before, field);
+        writeField(out, after, field);
+    }
+    return data;
+}
+
+bool CourseJournal::decode(const QByteArray &data, CourseData *course, QVector<int> *students)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint8 kind = 0;
+    in >> kind;
+    if (kind != Full) return false;
+    for (int field = 0; field < FieldCount; ++field) {
+        readField(in, course, field);
+    }
+    if (students && !in.atEnd()) {
+        in >> *students;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool CourseJournal::revertDiff(const QByteArray &data, CourseData *course)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint8 kind = 0;
+    quint16 mask = 0;
+    in >> kind >> mask;
+    if (kind != Diff) return false;
+
+    CourseData newer;
+    for (int field = 0; field < FieldCount; ++field) {
+        if (!(mask & (quint16(1) << field))) continue;
+        readField(in, course, field);
+        readField(in, &newer, field);
+    }
+    return in.status() == QDataStream::Ok;
+}
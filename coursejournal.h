@@ -0,0 +1,93 @@
+#ifndef COURSEJOURNAL_H
+#define COURSEJOURNAL_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+
+class CourseData;
+
+// 课程修改日志：只追加的 change_journal 表，每条记录一门课程的一次增、删或改。
+// 一次用户操作（添加、批量修改、导入、提交方案……）的所有记录属于同一个批次，
+// 批次的时间和说明记在 change_batches 表中，撤销和按时间点恢复都以批次为单位。
+//
+// 记录内容为紧凑的二进制：新增、删除存完整字段，删除另存当时的选课学生；修改只存变化字段的旧值和新值。
+// 调用方在自己的事务里先 record*，再 flush 一次性写入（预编译语句 + execBatch），
+// 事务回滚时调用 discard 丢弃未写入的记录，因此日志与课程数据始终一致。
+// 记录很多时（如 JSON 导入）用 flushPart 分段写入同一批次，最后 endBatch，内存中只留一段记录。
+// 默认使用界面线程的默认连接；工作线程传入自己的连接名。
+//
+// 日志只覆盖 courses 表：选课的增删（setEnrollments、enrollStudents、删除学生）和学期起止日期的修改
+// 不写日志，撤销或恢复到某个时间点时不会回退它们；撤回课程删除时只恢复仍然存在的学生的选课。
+class CourseJournal
+{
+public:
+    enum Op : quint8 { Insert = 1, Update = 2, Delete = 3 };
+
+    struct Entry {
+        qint64 batch = 0;
+        Op op = Insert;
+        int courseId = -1;
+        QString semester;
+        QByteArray data;
+    };
+
+    struct Operation {
+        qint64 batch = 0;
+        QDateTime time;
+        QString summary;
+        int changes = 0;
+    };
+
+    static constexpr int KeepDays = 30;           // 超过这个天数的批次在压缩时删除
+    static constexpr int MaxEntries = 50000;      // 日志最多保留的记录数
+    static constexpr int CompactInterval = 1000;  // 每写入这么多条记录检查一次是否需要压缩
+
+    explicit CourseJournal(const QString &connection = QLatin1String(QSqlDatabase::defaultConnection));
+
+    static bool createTables();
+
+    void recordInsert(const QString &semester, const CourseData &after);
+    void recordUpdate(const QString &semester, const CourseData &before, const CourseData &after);
+    void recordDelete(const QString &semester, const CourseData &before,
+                      const QVector<int> &students = QVector<int>());
+    bool flush(const QString &summary); // 必须在调用方的事务内
+    bool flushPart(const QString &summary); // 写出已记录的部分，之后的记录仍属于同一批次
+    void endBatch();
+    int pendingCount() const;
+    void discard();
+    void reset(); // 数据库在别处被整体改写（恢复备份、导入）后调用，重新读取批次号
+    bool hasPending() const;
+
+    QList<Operation> operations(int limit = 200) const; // 新的在前
+    QDateTime earliestTime() const;
+    qint64 firstBatchAfter(const QDateTime &time) const; // 没有则返回 0
+    qint64 lastBatch() const;
+    QList<Entry> entriesFrom(qint64 batch) const;       // 按写入顺序倒序，便于逐条撤销
+    bool truncateFrom(qint64 batch);                    // 删除该批次及之后的记录，必须在调用方的事务内
+
+    bool compactIfNeeded();
+    int compact(); // 返回删除的批次数
+
+    // 二进制编码：Insert/Delete 为完整课程，Update 为变化字段的旧值和新值
+    static QByteArray encode(const CourseData &course);
+    static QByteArray diff(const CourseData &before, const CourseData &after);
+    static bool decode(const QByteArray &data, CourseData *course,
+                       QVector<int> *students = nullptr); // students 只有删除记录才有
+    static bool revertDiff(const QByteArray &data, CourseData *course); // 把 course 中的新值换回旧值
+
+private:
+    QSqlDatabase database() const;
+    qint64 nextBatch();
+
+    QString m_connection;
+    QList<Entry> m_pending;
+    qint64 m_batch;      // flushPart 正在写入的批次，0 表示尚未开始
+    qint64 m_nextBatch;
+    int m_sinceCompaction;
+};
+
+#endif // COURSEJOURNAL_H
@@ -1,12 +1,90 @@
 #include "coursemanager.h"
+#include "backupchain.h"
+#include "coursehistory.h"
+#include "coursejournal.h"
+#include "coursesnapshot.h"
+#include "csvexporter.h"
+#include "databasebackup.h"
+#include "jsonlines.h"
+#include "icsparser.h"
 #include <QDebug>
 #include <QDir>
 #include <QStandardPaths>
 #include <QFile>
+#include <QSaveFile>
+#include <QTimeZone>
 #include <QTextStream>
+#include <algorithm>
+
+namespace {
+// 旧数据库新增 week_mask 列之前的记录为 NULL，视为每周都上课
+quint32 weekMaskFromValue(const QVariant &value)
+{
+    return value.isNull() ? CourseData::AllWeeks : quint32(value.toLongLong());
+}
+}
+
+quint32 CourseData::makeWeekMask(int startWeek, int endWeek, WeekParity parity)
+{
+    startWeek = qMax(1, startWeek);
+    endWeek = qMin(int(MaxMaskWeeks), endWeek);
+
+    quint32 mask = 0;
+    for (int week = startWeek; week <= endWeek; ++week) {
+        if (parity == OddWeeks && week % 2 == 0) continue;
+        if (parity == EvenWeeks && week % 2 == 1) continue;
+        mask |= 1u << (week - 1);
+    }
+    return mask;
+}
+
+void CourseData::decodeWeekMask(quint32 mask, int *startWeek, int *endWeek, WeekParity *parity)
+{
+    *startWeek = 1;
+    *endWeek = MaxMaskWeeks;
+    *parity = EveryWeek;
+    if (mask == 0 || mask == AllWeeks) return;
+
+    while (!(mask & (1u << (*startWeek - 1)))) ++*startWeek;
+    while (!(mask & (1u << (*endWeek - 1)))) --*endWeek;
+
+    if (mask == makeWeekMask(*startWeek, *endWeek, OddWeeks)) {
+        *parity = OddWeeks;
+    } else if (mask == makeWeekMask(*startWeek, *endWeek, EvenWeeks)) {
+        *parity = EvenWeeks;
+    }
+}
+
+QString CourseData::weekPatternText() const
+{
+    if (weekMask == AllWeeks) return "每周";
+    if (weekMask == 0) return "不上课";
+
+    int startWeek, endWeek;
+    WeekParity parity;
+    decodeWeekMask(weekMask, &startWeek, &endWeek, &parity);
+
+    if (weekMask == makeWeekMask(startWeek, endWeek, parity)) {
+        QString text = QString("第%1-%2周").arg(startWeek).arg(endWeek);
+        if (parity == OddWeeks) text += "(单)";
+        else if (parity == EvenWeeks) text += "(双)";
+        return text;
+    }
+
+    // 不规则的周次，逐段列出，例如 "第1-4,6,9-12周"
+    QStringList parts;
+    for (int week = 1; week <= MaxMaskWeeks; ++week) {
+        if (!occursInWeek(week)) continue;
+        int last = week;
+        while (last < MaxMaskWeeks && occursInWeek(last + 1)) ++last;
+        parts << (last == week ? QString::number(week) : QString("%1-%2").arg(week).arg(last));
+        week = last;
+    }
+    return QString("第%1周").arg(parts.join(","));
+}
 
 CourseManager::CourseManager(QObject *parent)
-    : QObject(parent), m_currentSemester("2025-2026-1")
+    : QObject(parent), m_currentSemester("2025-2026-1"), m_memoryBudget(64 * 1024 * 1024)
 {
     initDatabase();
 }
@@ -41,7 +119,6 @@ bool CourseManager::initDatabase()
     }
 
     QString dbPath = dataPath + "/coursemanager.db";
-    bool dbExists = QFile::exists(dbPath);
 
     m_db = QSqlDatabase::addDatabase("QSQLITE");
     m_db.setDatabaseName(dbPath);
@@ -55,8 +132,9 @@ bool CourseManager::initDatabase()
         return false;
     }
 
-    if (!dbExists) {
-        upgradeDatabase();
+    // 旧版本创建的数据库缺少后来新增的列，每次启动都检查一遍
+    if (!upgradeDatabase()) {
+        return false;
     }
 
     return true;
@@ -81,6 +159,8 @@ bool CourseManager::createTables()
         "exam_date TEXT,"
         "course_type TEXT,"
         "credits REAL DEFAULT 0,"
+        "week_mask INTEGER DEFAULT 4294967295,"
+        "room_id INTEGER REFERENCES rooms(id),"
         "semester TEXT NOT NULL"
         ")";
 
@@ -104,6 +184,55 @@ bool CourseManager::createTables()
         return false;
     }
 
+    QString roomTable =
+        "CREATE TABLE IF NOT EXISTS rooms ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT UNIQUE NOT NULL,"
+        "building TEXT,"
+        "capacity INTEGER DEFAULT 0,"
+        "features TEXT"
+        ")";
+
+    if (!query.exec(roomTable)) {
+
+        m_db.rollback();
+        return false;
+    }
+
+    QString studentTable =
+        "CREATE TABLE IF NOT EXISTS students ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "student_no TEXT UNIQUE NOT NULL,"
+        "name TEXT NOT NULL,"
+        "class_name TEXT"
+        ")";
+
+    if (!query.exec(studentTable)) {
+
+        m_db.rollback();
+        return false;
+    }
+
+    // 主键 (student_id, course_id) 即按学生查课程的索引，另建按课程查学生的索引
+    QString enrollmentTable =
+        "CREATE TABLE IF NOT EXISTS enrollments ("
+        "student_id INTEGER NOT NULL REFERENCES students(id) ON DELETE CASCADE,"
+        "course_id INTEGER NOT NULL REFERENCES courses(id) ON DELETE CASCADE,"
+        "PRIMARY KEY (student_id, course_id)"
+        ") WITHOUT ROWID";
+
+    if (!query.exec(enrollmentTable)
+        || !query.exec("CREATE INDEX IF NOT EXISTS idx_enrollments_course ON enrollments(course_id, student_id)")) {
+
+        m_db.rollback();
+        return false;
+    }
+
+    if (!CourseJournal::createTables()) {
+        m_db.rollback();
+        return false;
+    }
+
     QString checkSemester = "SELECT COUNT(*) FROM semesters WHERE name = '2025-2026-1'";
     if (query.exec(checkSemester) && query.next() && query.value(0).toInt() == 0) {
         QString insertSemester =
@@ -143,7 +272,7 @@ bool CourseManager::upgradeDatabase()
 
     // 检查并添加缺失的字段
     QStringList columnsToAdd = {
-        "exam_date", "course_type", "credits"
+        "exam_date", "course_type", "credits", "week_mask", "room_id"
     };
 
     for (const QString &column : columnsToAdd) {
@@ -163,6 +292,10 @@ bool CourseManager::upgradeDatabase()
             QString addColumn = QString("ALTER TABLE courses ADD COLUMN %1 TEXT").arg(column);
             if (column == "credits") {
                 addColumn = QString("ALTER TABLE courses ADD COLUMN %1 REAL DEFAULT 0").arg(column);
+            } else if (column == "week_mask") {
+                addColumn = QString("ALTER TABLE courses ADD COLUMN %1 INTEGER DEFAULT 4294967295").arg(column);
+            } else if (column == "room_id") {
+                addColumn = QString("ALTER TABLE courses ADD COLUMN %1 INTEGER REFERENCES rooms(id)").arg(column);
             }
 
             if (!query.exec(addColumn)) {
@@ -172,152 +305,268 @@ bool CourseManager::upgradeDatabase()
         }
     }
 
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_courses_room ON courses(room_id)")) {
+        qDebug() << "Failed to create room index:" << query.lastError().text();
+        return false;
+    }
+
+    // 把还没有关联教室的地点登记到教室库，楼栋取地点中第一个空格之前的部分
+    m_db.transaction();
+    bool migrated = query.exec(
+        "INSERT OR IGNORE INTO rooms (name, building) "
+        "SELECT DISTINCT TRIM(location), "
+        "CASE WHEN instr(TRIM(location), ' ') > 0 "
+        "THEN substr(TRIM(location), 1, instr(TRIM(location), ' ') - 1) ELSE '' END "
+        "FROM courses WHERE room_id IS NULL AND TRIM(location) <> ''")
+        && query.exec(
+            "UPDATE courses SET room_id = (SELECT id FROM rooms WHERE rooms.name = TRIM(courses.location)) "
+            "WHERE room_id IS NULL AND TRIM(location) <> ''");
+    if (!migrated) {
+        qDebug() << "Failed to migrate rooms:" << query.lastError().text();
+        m_db.rollback();
+        return false;
+    }
+    m_db.commit();
+
     return true;
 }
 
 bool CourseManager::addCourse(const CourseData &course)
 {
+    if (m_scenario) {
+        CourseData staged = course;
+        staged.id = m_scenario->nextTempId--;
+        return stageCourse(staged);
+    }
+
     QSqlDatabase::database().transaction();
 
     QSqlQuery query;
     query.prepare(
         "INSERT INTO courses (name, day_of_week, start_slot, end_slot, location, "
-        "start_date, end_date, teacher, exam_date, course_type, credits, semester) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+        "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
         );
 
-    query.addBindValue(course.name);
-    query.addBindValue(course.dayOfWeek);
-    query.addBindValue(course.startSlot);
-    query.addBindValue(course.endSlot);
-    query.addBindValue(course.location);
-    query.addBindValue(course.startDate.toString(Qt::ISODate));
-    query.addBindValue(course.endDate.toString(Qt::ISODate));
-    query.addBindValue(course.teacher);
-    query.addBindValue(course.examDate.isValid() ? course.examDate.toString(Qt::ISODate) : "");
-    query.addBindValue(course.courseType);
-    query.addBindValue(course.credits);
+    const int roomId = roomIdFor(course.location);
+    bindCourseFields(query, course, roomId);
     query.addBindValue(m_currentSemester);
 
     if (!query.exec()) {
 
-        QSqlDatabase::database().rollback();
+        rollbackChanges();
+        return false;
+    }
+
+    CourseData stored = course;
+    stored.id = query.lastInsertId().toInt();
+    stored.roomId = roomId > 0 ? roomId : -1;
+
+    recordChange(m_currentSemester, CourseData(), stored);
+    if (!flushChanges(QString("添加课程「%1」").arg(course.name))) {
+        rollbackChanges();
         return false;
     }
 
     QSqlDatabase::database().commit();
+
+    indexCourse(m_currentSemester, stored);
+    finishChanges();
+    emit dataChanged();
     return true;
 }
 
 bool CourseManager::updateCourse(const CourseData &course)
 {
+    if (m_scenario) return stageCourse(course);
+
+    QString courseSemester;
+    const CourseData before = loadCourseById(course.id, &courseSemester);
+
     QSqlDatabase::database().transaction();
 
+    CourseData stored = course;
+    const int roomId = roomIdFor(course.location);
+    stored.roomId = roomId > 0 ? roomId : -1;
+
     QSqlQuery query;
     query.prepare(
         "UPDATE courses SET name=?, day_of_week=?, start_slot=?, end_slot=?, "
-        "location=?, start_date=?, end_date=?, teacher=?, exam_date=?, course_type=?, credits=? WHERE id=?"
+        "location=?, start_date=?, end_date=?, teacher=?, exam_date=?, course_type=?, credits=?, week_mask=?, room_id=? WHERE id=?"
         );
 
-    query.addBindValue(course.name);
-    query.addBindValue(course.dayOfWeek);
-    query.addBindValue(course.startSlot);
-    query.addBindValue(course.endSlot);
-    query.addBindValue(course.location);
-    query.addBindValue(course.startDate.toString(Qt::ISODate));
-    query.addBindValue(course.endDate.toString(Qt::ISODate));
-    query.addBindValue(course.teacher);
-    query.addBindValue(course.examDate.isValid() ? course.examDate.toString(Qt::ISODate) : "");
-    query.addBindValue(course.courseType);
-    query.addBindValue(course.credits);
+    bindCourseFields(query, course, roomId);
     query.addBindValue(course.id);
 
     if (!query.exec()) {
         qDebug() << "Failed to update course:" << query.lastError().text();
-        QSqlDatabase::database().rollback();
+        rollbackChanges();
+        return false;
+    }
+
+    recordChange(courseSemester, before, stored);
+    if (!flushChanges(QString("修改课程「%1」").arg(course.name))) {
+        rollbackChanges();
         return false;
     }
 
     QSqlDatabase::database().commit();
+
+    QString semester = unindexCourse(course.id);
+    if (!semester.isEmpty()) {
+        indexCourse(semester, stored);
+    }
+    finishChanges();
+    emit dataChanged();
     return true;
 }
 
-bool CourseManager::deleteCourse(int id)
+bool CourseManager::updateCourses(const QList<CourseData> &courses)
 {
+    if (courses.isEmpty()) return true;
+    if (m_scenario) {
+        for (const CourseData &course : courses) {
+            if (!stageCourse(course)) return false;
+        }
+        return true;
+    }
+
     QSqlDatabase::database().transaction();
 
     QSqlQuery query;
-    query.prepare("DELETE FROM courses WHERE id=?");
-    query.addBindValue(id);
+    query.prepare(
+        "UPDATE courses SET name=?, day_of_week=?, start_slot=?, end_slot=?, "
+        "location=?, start_date=?, end_date=?, teacher=?, exam_date=?, course_type=?, credits=?, week_mask=?, room_id=? WHERE id=?"
+        );
 
-    if (!query.exec()) {
-        qDebug() << "Failed to delete course:" << query.lastError().text();
-        QSqlDatabase::database().rollback();
+    QList<CourseData> stored = courses;
+    for (CourseData &course : stored) {
+        QString courseSemester;
+        const CourseData before = loadCourseById(course.id, &courseSemester);
+        const int roomId = roomIdFor(course.location);
+        course.roomId = roomId > 0 ? roomId : -1;
+
+        bindCourseFields(query, course, roomId);
+        query.addBindValue(course.id);
+
+        if (!query.exec()) {
+            qDebug() << "Failed to update course" << course.id << ":" << query.lastError().text();
+            rollbackChanges();
+            return false;
+        }
+        recordChange(courseSemester, before, course);
+    }
+
+    if (!flushChanges(QString("批量修改 %1 门课程").arg(stored.size()))) {
+        rollbackChanges();
         return false;
     }
 
-    QSqlDatabase::database().commit();
+    if (!QSqlDatabase::database().commit()) {
+        qDebug() << "Failed to commit course batch:" << QSqlDatabase::database().lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    for (const CourseData &course : stored) {
+        QString semester = unindexCourse(course.id);
+        if (!semester.isEmpty()) {
+            indexCourse(semester, course);
+        }
+    }
+    finishChanges();
+    emit dataChanged();
     return true;
 }
 
-QList<CourseData> CourseManager::getCoursesByWeek(const QDate &date)
+bool CourseManager::deleteCourse(int id)
 {
-    QList<CourseData> courses;
-    QSqlQuery query;
-
-    query.prepare(
-        "SELECT id, name, day_of_week, start_slot, end_slot, location, "
-        "start_date, end_date, teacher, exam_date, course_type, credits FROM courses "
-        "WHERE semester = ? AND start_date <= ? AND end_date >= ? "
-        "ORDER BY day_of_week, start_slot"
-        );
+    if (m_scenario) return stageDeletion(id);
 
-    query.addBindValue(m_currentSemester);
-    query.addBindValue(date.toString(Qt::ISODate));
-    query.addBindValue(date.toString(Qt::ISODate));
+    QString semester;
+    const CourseData before = loadCourseById(id, &semester);
+    const QVector<int> students = enrolledStudentIds(id);
 
-    if (query.exec()) {
-        while (query.next()) {
-            CourseData course;
-            course.id = query.value(0).toInt();
-            course.name = query.value(1).toString();
-            course.dayOfWeek = query.value(2).toInt();
-            course.startSlot = query.value(3).toInt();
-            course.endSlot = query.value(4).toInt();
-            course.location = query.value(5).toString();
-            course.startDate = QDate::fromString(query.value(6).toString(), Qt::ISODate);
-            course.endDate = QDate::fromString(query.value(7).toString(), Qt::ISODate);
-            course.teacher = query.value(8).toString();
+    QSqlDatabase::database().transaction();
 
-            QString examDateStr = query.value(9).toString();
-            if (!examDateStr.isEmpty()) {
-                course.examDate = QDate::fromString(examDateStr, Qt::ISODate);
-            }
+    QSqlQuery query;
+    query.prepare("DELETE FROM enrollments WHERE course_id=?");
+    query.addBindValue(id);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM courses WHERE id=?");
+        query.addBindValue(id);
+        ok = query.exec();
+    }
 
-            course.courseType = query.value(10).toString();
-            course.credits = query.value(11).toDouble();
+    if (ok && before.id >= 0) {
+        recordChange(semester, before, CourseData(), students);
+        ok = flushChanges(QString("删除课程「%1」").arg(before.name));
+    }
 
-            courses.append(course);
-        }
-    } else {
-        qDebug() << "Failed to get courses:" << query.lastError().text();
+    if (!ok) {
+        qDebug() << "Failed to delete course:" << query.lastError().text();
+        rollbackChanges();
+        return false;
     }
 
+    QSqlDatabase::database().commit();
+    unindexCourse(id);
+    m_enrollments.clear();
+    finishChanges();
+    emit dataChanged();
+    return true;
+}
+
+QList<CourseData> CourseManager::getCoursesByWeek(const QDate &date)
+{
+    // 与原来的 SQL 条件一致：start_date <= date AND end_date >= date，再按周次位过滤
+    SemesterCache &cache = cacheFor(m_currentSemester);
+    QList<CourseData> courses = sortedCourses(cache, cache.dates.stab(date));
+
+    int week = getWeekNumber(date);
+    courses.erase(std::remove_if(courses.begin(), courses.end(), [week](const CourseData &course) {
+        return !course.occursInWeek(week);
+    }), courses.end());
+    return courses;
+}
+
+QList<CourseData> CourseManager::getCoursesInRange(const QDate &from, const QDate &to)
+{
+    SemesterCache &cache = cacheFor(m_currentSemester);
+    return sortedCourses(cache, cache.dates.overlapping(from, to));
+}
+
+QList<CourseData> CourseManager::getCoursesOnDate(const QDate &date)
+{
+    QList<CourseData> courses = getCoursesByWeek(date);
+    courses.erase(std::remove_if(courses.begin(), courses.end(), [&date](const CourseData &course) {
+        return course.dayOfWeek != date.dayOfWeek();
+    }), courses.end());
     return courses;
 }
 
 QList<CourseData> CourseManager::getAllCourses()
+{
+    if (m_scenario && m_scenario->semester == m_currentSemester) {
+        const SemesterCache &cache = m_scenario->cache;
+        return sortedCourses(cache, QVector<int>(cache.courses.keyBegin(), cache.courses.keyEnd()));
+    }
+    return loadCourses(m_currentSemester);
+}
+
+QList<CourseData> CourseManager::loadCourses(const QString &semester)
 {
     QList<CourseData> courses;
     QSqlQuery query;
 
     query.prepare(
         "SELECT id, name, day_of_week, start_slot, end_slot, location, "
-        "start_date, end_date, teacher, exam_date, course_type, credits FROM courses "
+        "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id FROM courses "
         "WHERE semester = ? ORDER BY day_of_week, start_slot"
         );
 
-    query.addBindValue(m_currentSemester);
+    query.addBindValue(semester);
 
     if (query.exec()) {
         while (query.next()) {
@@ -339,6 +588,8 @@ QList<CourseData> CourseManager::getAllCourses()
 
             course.courseType = query.value(10).toString();
             course.credits = query.value(11).toDouble();
+            course.weekMask = weekMaskFromValue(query.value(12));
+            course.roomId = query.value(13).isNull() ? -1 : query.value(13).toInt();
 
             courses.append(course);
         }
@@ -349,12 +600,22 @@ QList<CourseData> CourseManager::getAllCourses()
 
 QList<CourseData> CourseManager::searchCourses(const QString &keyword)
 {
+    if (m_scenario && m_scenario->semester == m_currentSemester) {
+        QList<CourseData> courses = getAllCourses();
+        courses.erase(std::remove_if(courses.begin(), courses.end(), [&keyword](const CourseData &course) {
+            return !course.name.contains(keyword, Qt::CaseInsensitive)
+                && !course.teacher.contains(keyword, Qt::CaseInsensitive)
+                && !course.location.contains(keyword, Qt::CaseInsensitive);
+        }), courses.end());
+        return courses;
+    }
+
     QList<CourseData> courses;
     QSqlQuery query;
 
     query.prepare(
         "SELECT id, name, day_of_week, start_slot, end_slot, location, "
-        "start_date, end_date, teacher, exam_date, course_type, credits FROM courses "
+        "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id FROM courses "
         "WHERE semester = ? AND (name LIKE ? OR teacher LIKE ? OR location LIKE ?) "
         "ORDER BY day_of_week, start_slot"
         );
@@ -385,6 +646,8 @@ QList<CourseData> CourseManager::searchCourses(const QString &keyword)
 
             course.courseType = query.value(10).toString();
             course.credits = query.value(11).toDouble();
+            course.weekMask = weekMaskFromValue(query.value(12));
+            course.roomId = query.value(13).isNull() ? -1 : query.value(13).toInt();
 
             courses.append(course);
         }
@@ -394,13 +657,24 @@ QList<CourseData> CourseManager::searchCourses(const QString &keyword)
 }
 
 CourseData CourseManager::getCourseById(int id)
+{
+    if (m_scenario) {
+        auto it = m_scenario->cache.courses.constFind(id);
+        if (it != m_scenario->cache.courses.constEnd()) return it.value();
+        if (id < 0 || m_scenario->deleted.contains(id)) return CourseData();
+    }
+
+    return loadCourseById(id);
+}
+
+CourseData CourseManager::loadCourseById(int id, QString *semester)
 {
     CourseData course;
     QSqlQuery query;
 
     query.prepare(
         "SELECT id, name, day_of_week, start_slot, end_slot, location, "
-        "start_date, end_date, teacher, exam_date, course_type, credits FROM courses WHERE id=?"
+        "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester FROM courses WHERE id=?"
         );
 
     query.addBindValue(id);
@@ -423,6 +697,9 @@ CourseData CourseManager::getCourseById(int id)
 
         course.courseType = query.value(10).toString();
         course.credits = query.value(11).toDouble();
+        course.weekMask = weekMaskFromValue(query.value(12));
+        course.roomId = query.value(13).isNull() ? -1 : query.value(13).toInt();
+        if (semester) *semester = query.value(14).toString();
     }
 
     return course;
@@ -431,6 +708,7 @@ CourseData CourseManager::getCourseById(int id)
 bool CourseManager::setCurrentSemester(const QString &semester)
 {
     m_currentSemester = semester;
+    emit dataChanged();
     return true;
 }
 
@@ -439,6 +717,21 @@ QString CourseManager::getCurrentSemester() const
     return m_currentSemester;
 }
 
+bool CourseManager::semesterRange(const QString &semester, QDate *start, QDate *end) const
+{
+    QSqlQuery query;
+    query.prepare("SELECT start_date, end_date FROM semesters WHERE name=?");
+    query.addBindValue(semester);
+
+    if (!query.exec() || !query.next()) {
+        return false;
+    }
+
+    *start = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+    *end = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+    return start->isValid() && end->isValid() && *start < *end;
+}
+
 QDate CourseManager::getSemesterStartDate() const
 {
     QSqlQuery query;
@@ -465,6 +758,14 @@ QDate CourseManager::getSemesterEndDate() const
     return QDate(2026, 1, 31);
 }
 
+int CourseManager::getWeekNumber(const QDate &date) const
+{
+    QDate start = getSemesterStartDate();
+    QDate firstMonday = start.addDays(1 - start.dayOfWeek());
+    qint64 days = firstMonday.daysTo(date);
+    return days < 0 ? 0 : int(days / 7) + 1;
+}
+
 bool CourseManager::setSemester(const QString &name, const QDate &start, const QDate &end)
 {
     if (!start.isValid() || !end.isValid() || start >= end) {
@@ -473,6 +774,21 @@ bool CourseManager::setSemester(const QString &name, const QDate &start, const Q
 
     QSqlDatabase::database().transaction();
 
+    if (!writeSemester(name, start, end)) {
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+    m_caches.remove(name); // 起止日期可能变化，下次查询时重建
+    m_cacheOrder.removeOne(name);
+    m_currentSemester = name;
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::writeSemester(const QString &name, const QDate &start, const QDate &end)
+{
     QSqlQuery query;
     query.prepare("SELECT COUNT(*) FROM semesters WHERE name=?");
     query.addBindValue(name);
@@ -500,58 +816,2113 @@ bool CourseManager::setSemester(const QString &name, const QDate &start, const Q
     }
 
     if (!ok) {
-        QSqlDatabase::database().rollback();
-        return false;
+        qDebug() << "Failed to save semester:" << name;
     }
+    return ok;
+}
 
-    QSqlDatabase::database().commit();
-    m_currentSemester = name;
-    return true;
+QStringList CourseManager::getSemesters()
+{
+    QStringList semesters;
+    QSqlQuery query("SELECT name FROM semesters ORDER BY start_date");
+    while (query.next()) {
+        semesters << query.value(0).toString();
+    }
+    return semesters;
+}
+
+QString CourseManager::databasePath() const
+{
+    return m_db.databaseName();
 }
 
 bool CourseManager::exportToCsv(const QString &filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    CsvExporter::Options options;
+    options.filePath = filePath;
+    options.semesters << m_currentSemester;
+
+    const CsvExporter::Result result = CsvExporter::exportTo(m_db, options);
+    if (!result.ok) {
+        qDebug() << "Failed to export courses:" << result.error;
+    }
+    return result.ok;
+}
+
+bool CourseManager::exportToJsonLines(const QString &filePath, const QStringList &semesters)
+{
+    JsonLines::ExportOptions options;
+    options.filePath = filePath;
+    options.semesters = semesters;
+
+    const JsonLines::Result result = JsonLines::exportTo(m_db, options);
+    if (!result.ok) {
+        qDebug() << "Failed to export JSON Lines:" << result.error;
+    }
+    return result.ok;
+}
+
+bool CourseManager::importFromJsonLines(const QString &filePath, bool replaceSemesters, JsonLines::Result *report)
+{
+    if (m_scenario) {
+        qDebug() << "Cannot import JSON Lines while a scenario is active";
         return false;
     }
 
-    QTextStream out(&file);
+    JsonLines::ImportOptions options;
+    options.filePath = filePath;
+    options.defaultSemester = m_currentSemester;
+    options.replaceSemesters = replaceSemesters;
+
+    const JsonLines::Result result = JsonLines::importFrom(m_db, options);
+    if (report) *report = result;
+    if (result.ok) {
+        reloadFromDatabase();
+    }
+    return result.ok;
+}
 
+bool CourseManager::exportToIcs(const QString &filePath, bool includeExams)
+{
+    static const char *const dayCodes[] = {"MO", "TU", "WE", "TH", "FR", "SA", "SU"};
+    const QTimeZone zone(8 * 3600); // 作息时间按北京时间
+    const QString tzid = "Asia/Shanghai";
+    const QString stamp = QDateTime::currentDateTimeUtc().toString("yyyyMMdd'T'HHmmss'Z'");
+
+    // RFC 5545：转义文本中的特殊字符，每行不超过 75 字节，续行以空格开头
+    auto escape = [](QString text) {
+        text.replace("\\", "\\\\");
+        text.replace(";", "\\;");
+        text.replace(",", "\\,");
+        text.replace("\n", "\\n");
+        return text;
+    };
+    QByteArray out;
+    auto line = [&out](const QString &text) {
+        const QByteArray bytes = text.toUtf8();
+        int start = 0;
+        int limit = 75;
+        while (bytes.size() - start > limit) {
+            int cut = start + limit;
+            while (cut > start && (uchar(bytes.at(cut)) & 0xC0) == 0x80) --cut; // 不拆开多字节字符
+            out.append(bytes.mid(start, cut - start));
+            out.append("\r\n ");
+            start = cut;
+            limit = 74;
+        }
+        out.append(bytes.mid(start));
+        out.append("\r\n");
+    };
+    auto localTime = [&tzid](const QDate &date, const QTime &time) {
+        return QString(";TZID=%1:%2T%3").arg(tzid, date.toString("yyyyMMdd"), time.toString("HHmmss"));
+    };
 
-    // 写入表头
-    out << "课程名称,星期,开始节次,结束节次,地点,开始日期,结束日期,教师,考试日期,课程类型,学分\n";
+    const QList<CourseData> courses = getAllCourses();
+    out.reserve(courses.size() * 400 + 1024);
+
+    line("BEGIN:VCALENDAR");
+    line("VERSION:2.0");
+    line("PRODID:-//SourceManager//课程管理系统//ZH");
+    line("CALSCALE:GREGORIAN");
+    line("X-WR-CALNAME:" + escape(m_currentSemester + " 课程表"));
+    line("X-WR-TIMEZONE:" + tzid);
+    line("BEGIN:VTIMEZONE");
+    line("TZID:" + tzid);
+    line("BEGIN:STANDARD");
+    line("DTSTART:19700101T000000");
+    line("TZOFFSETFROM:+0800");
+    line("TZOFFSETTO:+0800");
+    line("TZNAME:CST");
+    line("END:STANDARD");
+    line("END:VTIMEZONE");
 
-    QList<CourseData> courses = getAllCourses();
     for (const CourseData &course : courses) {
-        out << course.name << ","
-            << course.dayOfWeek << ","
-            << course.startSlot << ","
-            << course.endSlot << ","
-            << course.location << ","
-            << course.startDate.toString("yyyy-MM-dd") << ","
-            << course.endDate.toString("yyyy-MM-dd") << ","
-            << course.teacher << ","
-            << (course.examDate.isValid() ? course.examDate.toString("yyyy-MM-dd") : "") << ","
-            << course.courseType << ","
-            << course.credits << "\n";
-    }
-
-    file.close();
+        if (course.dayOfWeek < 1 || course.dayOfWeek > 7) continue;
+        const QTime begin = slotStartTime(course.startSlot);
+        const QTime end = slotEndTime(course.endSlot);
+        if (!begin.isValid() || !end.isValid() || !course.startDate.isValid() || !course.endDate.isValid()) continue;
+
+        // 起止日期内第一次和最后一次上课，再按周次位收缩到实际上课的周
+        QDate first = course.startDate.addDays((course.dayOfWeek - course.startDate.dayOfWeek() + 7) % 7);
+        QDate last = course.endDate.addDays(-((course.endDate.dayOfWeek() - course.dayOfWeek + 7) % 7));
+        while (first <= last && !course.occursInWeek(getWeekNumber(first))) first = first.addDays(7);
+        while (last >= first && !course.occursInWeek(getWeekNumber(last))) last = last.addDays(-7);
+
+        if (first <= last) {
+            // 上课周间隔一致（每周或单双周）时用 INTERVAL 表示，否则逐个列出停课日期
+            QVector<QDate> skipped;
+            int interval = 0;
+            int previous = 0;
+            bool regular = true;
+            for (QDate date = first; date <= last; date = date.addDays(7)) {
+                const int week = getWeekNumber(date);
+                if (!course.occursInWeek(week)) {
+                    skipped.append(date);
+                    continue;
+                }
+                if (previous) {
+                    if (!interval) interval = week - previous;
+                    else if (week - previous != interval) regular = false;
+                }
+                previous = week;
+            }
+            if (!interval) interval = 1;
+            if (regular && interval <= 2) {
+                skipped.clear();
+            } else {
+                interval = 1;
+            }
+
+            QString rule = QString("RRULE:FREQ=WEEKLY;BYDAY=%1;UNTIL=%2")
+                               .arg(dayCodes[course.dayOfWeek - 1],
+                                    QDateTime(last, end, zone).toUTC().toString("yyyyMMdd'T'HHmmss'Z'"));
+            if (interval > 1) rule += QString(";INTERVAL=%1").arg(interval);
+
+            QStringList details;
+            if (!course.teacher.isEmpty()) details << "教师：" + course.teacher;
+            if (!course.courseType.isEmpty()) details << "类型：" + course.courseType;
+            details << QString("第%1-%2节，%3").arg(course.startSlot).arg(course.endSlot).arg(course.weekPatternText());
+
+            line("BEGIN:VEVENT");
+            line(QString("UID:course-%1-%2@sourcemanager").arg(m_currentSemester).arg(course.id));
+            line("DTSTAMP:" + stamp);
+            line("DTSTART" + localTime(first, begin));
+            line("DTEND" + localTime(first, end));
+            line(rule);
+            for (const QDate &date : skipped) {
+                line("EXDATE" + localTime(date, begin));
+            }
+            line("SUMMARY:" + escape(course.name));
+            if (!course.location.isEmpty()) line("LOCATION:" + escape(course.location));
+            line("DESCRIPTION:" + escape(details.join("\n")));
+            line("END:VEVENT");
+        }
+
+        if (includeExams && course.examDate.isValid()) {
+            line("BEGIN:VEVENT");
+            line(QString("UID:exam-%1-%2@sourcemanager").arg(m_currentSemester).arg(course.id));
+            line("DTSTAMP:" + stamp);
+            line("DTSTART;VALUE=DATE:" + course.examDate.toString("yyyyMMdd"));
+            line("DTEND;VALUE=DATE:" + course.examDate.addDays(1).toString("yyyyMMdd"));
+            line("SUMMARY:" + escape("考试：" + course.name));
+            line("CATEGORIES:考试");
+            line("END:VEVENT");
+        }
+    }
+    line("END:VCALENDAR");
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit()) {
+        qDebug() << "Failed to export calendar:" << file.errorString();
+        return false;
+    }
     return true;
 }
 
+QTime CourseManager::slotStartTime(int slot)
+{
+    static const QTime starts[] = {
+        QTime(8, 0), QTime(8, 55), QTime(9, 50), QTime(10, 45),
+        QTime(14, 0), QTime(14, 55), QTime(15, 50), QTime(16, 45),
+        QTime(19, 0), QTime(19, 55)
+    };
+    return slot >= 1 && slot <= OccupancyIndex::SlotsPerDay ? starts[slot - 1] : QTime();
+}
+
+QTime CourseManager::slotEndTime(int slot)
+{
+    const QTime start = slotStartTime(slot);
+    return start.isValid() ? start.addSecs(45 * 60) : QTime(); // 每节 45 分钟
+}
+
 bool CourseManager::importFromCsv(const QString &filePath)
 {
     // 实现CSV导入逻辑
     return true;
 }
 
-bool CourseManager::createBackup()
+bool CourseManager::importFromIcs(const QString &filePath, IcsImportReport *report)
 {
-    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QString backupPath = dataPath + "/backup_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".db";
+    IcsImportReport local;
+    IcsImportReport &result = report ? *report : local;
+    result = IcsImportReport();
+
+    const QTimeZone zone(8 * 3600); // 与导出一致，按北京时间对齐作息时间表
+    QDate rangeEnd = getSemesterEndDate();
+    if (!rangeEnd.isValid()) rangeEnd = QDate::currentDate().addYears(1);
+
+    IcsParser parser(zone);
+    const bool parsed = parser.parseFile(filePath, rangeEnd);
+    result.skipped << parser.warnings();
+    if (!parsed) {
+        qDebug() << "Failed to parse calendar:" << parser.warnings();
+        return false;
+    }
+
+    // 时间映射到节次：开始于某节结束之前即从该节算起，结束于某节开始之后即算到该节
+    auto startSlotFor = [](const QTime &time) {
+        for (int slot = 1; slot <= OccupancyIndex::SlotsPerDay; ++slot) {
+            if (slotEndTime(slot) > time) return slot;
+        }
+        return 0;
+    };
+    auto endSlotFor = [](const QTime &time) {
+        for (int slot = OccupancyIndex::SlotsPerDay; slot >= 1; --slot) {
+            if (slotStartTime(slot) < time) return slot;
+        }
+        return 0;
+    };
+    auto field = [](const QString &description, const QString &label) {
+        for (const QString &text : description.split('\n')) {
+            if (text.startsWith(label)) return text.mid(label.size()).trimmed();
+        }
+        return QString();
+    };
+    auto courseKey = [](const CourseData &course) {
+        return QStringList{course.name, course.location, course.teacher, QString::number(course.dayOfWeek),
+                           QString::number(course.startSlot), QString::number(course.endSlot)}.join('\x1f');
+    };
+
+    // 同一课程、地点、教师、星期、节次的所有上课日期合并为一行课程
+    struct Group {
+        CourseData course;
+        QList<QDate> dates;
+    };
+    QHash<QString, Group> groups;
+    QStringList order;
+    QHash<QString, QDate> exams; // 课程名 -> 考试日期
+
+    for (const IcsParser::Event &event : parser.events()) {
+        ++result.events;
+        if (event.summary.isEmpty()) {
+            result.skipped << QString("%1 的事件没有标题").arg(event.start.date().toString("yyyy-MM-dd"));
+            continue;
+        }
+
+        if (event.allDay) {
+            QString name = event.summary;
+            if (name.startsWith("考试：") || name.startsWith("考试:")) name = name.mid(3).trimmed();
+            else if (!event.categories.contains("考试")) name.clear();
+            if (name.isEmpty()) {
+                result.skipped << QString("「%1」是全天事件，不是课程").arg(event.summary);
+            } else {
+                exams.insert(name, event.occurrences.first());
+            }
+            continue;
+        }
+
+        CourseData course;
+        course.name = event.summary;
+        course.location = event.location;
+        course.teacher = field(event.description, "教师：");
+        const QString type = field(event.description, "类型：");
+        if (!type.isEmpty()) course.courseType = type;
+        course.dayOfWeek = event.start.date().dayOfWeek();
+        course.startSlot = startSlotFor(event.start.time());
+        course.endSlot = endSlotFor(event.end.time());
+        if (event.start.date() != event.end.date() || !course.startSlot || course.endSlot < course.startSlot) {
+            result.skipped << QString("「%1」%2-%3 不在作息时间表内")
+                                  .arg(event.summary, event.start.time().toString("HH:mm"),
+                                       event.end.time().toString("HH:mm"));
+            continue;
+        }
+
+        // 重复规则可能覆盖多个星期几，按实际日期分到各自的星期
+        for (const QDate &date : event.occurrences) {
+            course.dayOfWeek = date.dayOfWeek();
+            const QString key = courseKey(course);
+            auto it = groups.find(key);
+            if (it == groups.end()) {
+                it = groups.insert(key, Group{course, {}});
+                order << key;
+            }
+            it->dates.append(date);
+        }
+    }
+
+    // 已有课程不重复导入；考试日期可以写到已有课程上
+    QSet<QString> existing;
+    QHash<QString, QList<CourseData>> existingByName; // 同名课程可能分成多个组（不同星期、教室）
+    for (const CourseData &course : getAllCourses()) {
+        existing.insert(courseKey(course));
+        existingByName[course.name].append(course);
+    }
+
+    QList<CourseData> pending;
+    QSet<QString> examsUsed; // 已写到新导入课程上的考试
+    pending.reserve(order.size());
+    for (const QString &key : order) {
+        Group &group = groups[key];
+        if (existing.contains(key)) {
+            ++result.duplicates;
+            continue;
+        }
+        std::sort(group.dates.begin(), group.dates.end());
+        CourseData course = group.course;
+        course.startDate = group.dates.first();
+        course.endDate = group.dates.last();
+
+        // 上课周连续时不需要周次位；有间断（单双周、停课）时只标出上课的周
+        quint32 mask = 0;
+        bool contiguous = true;
+        bool fitsMask = true;
+        int previous = 0;
+        for (const QDate &date : group.dates) {
+            const int week = getWeekNumber(date);
+            if (week < 1 || week > CourseData::MaxMaskWeeks) fitsMask = false;
+            else mask |= 1u << (week - 1);
+            if (previous && week > previous + 1) contiguous = false;
+            previous = week;
+        }
+        if (!contiguous && fitsMask) course.weekMask = mask;
+        else if (!contiguous) result.skipped << QString("「%1」超出学期周数，按每周上课导入").arg(course.name);
+
+        // 同名课程的每个组（包括已有课程）都写上考试日期
+        if (exams.contains(course.name)) {
+            course.examDate = exams.value(course.name);
+            examsUsed.insert(course.name);
+            ++result.exams;
+        }
+        pending.append(course);
+    }
+
+    QList<CourseData> examUpdates;
+    QList<CourseData> examBefore;
+    for (auto it = exams.constBegin(); it != exams.constEnd(); ++it) {
+        if (!existingByName.contains(it.key())) {
+            if (!examsUsed.contains(it.key())) {
+                result.skipped << QString("找不到考试「%1」对应的课程").arg(it.key());
+            }
+            continue;
+        }
+        for (const CourseData &before : existingByName.value(it.key())) {
+            if (before.examDate == it.value()) continue;
+            CourseData course = before;
+            course.examDate = it.value();
+            examUpdates.append(course);
+            examBefore.append(before);
+            ++result.exams;
+        }
+    }
+
+    if (m_scenario) {
+        // 先校验再暂存，保证要么全部进入方案，要么一门都不进
+        if (m_scenario->semester != m_currentSemester) {
+            qDebug() << "Scenario" << m_scenario->name << "only covers semester" << m_scenario->semester;
+            return false;
+        }
+        for (const CourseData &course : examUpdates) {
+            if (course.id >= 0 && !m_scenario->cache.courses.contains(course.id)) {
+                qDebug() << "Course" << course.id << "is not part of the scenario";
+                return false;
+            }
+        }
+        for (const CourseData &course : pending) addCourse(course);
+        for (const CourseData &course : examUpdates) updateCourse(course);
+        result.courses = pending.size();
+        return true;
+    }
+
+    if (pending.isEmpty() && examUpdates.isEmpty()) return true;
+
+    // 一个事务、一条预编译语句写入全部课程，插入成功后再统一更新缓存
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    query.prepare(
+        "INSERT INTO courses (name, day_of_week, start_slot, end_slot, location, "
+        "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+        );
+    for (CourseData &course : pending) {
+        const int roomId = roomIdFor(course.location);
+        bindCourseFields(query, course, roomId);
+        query.addBindValue(m_currentSemester);
+        if (!query.exec()) {
+            qDebug() << "Failed to import course:" << course.name << query.lastError().text();
+            rollbackChanges();
+            return false;
+        }
+        course.id = query.lastInsertId().toInt();
+        course.roomId = roomId > 0 ? roomId : -1;
+        recordChange(m_currentSemester, CourseData(), course);
+    }
+
+    QSqlQuery exam;
+    exam.prepare("UPDATE courses SET exam_date = ? WHERE id = ?");
+    for (int i = 0; i < examUpdates.size(); ++i) {
+        const CourseData &course = examUpdates.at(i);
+        exam.addBindValue(course.examDate.toString(Qt::ISODate));
+        exam.addBindValue(course.id);
+        if (!exam.exec()) {
+            qDebug() << "Failed to import exam date:" << course.name << exam.lastError().text();
+            rollbackChanges();
+            return false;
+        }
+        recordChange(m_currentSemester, examBefore.at(i), course);
+    }
+
+    if (!flushChanges(QString("导入日历：%1 门课程，%2 个考试日期").arg(pending.size()).arg(examUpdates.size()))) {
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+
+    for (const CourseData &course : pending) {
+        indexCourse(m_currentSemester, course);
+    }
+    for (const CourseData &course : examUpdates) {
+        const QString semester = unindexCourse(course.id);
+        if (!semester.isEmpty()) indexCourse(semester, course);
+    }
+    result.courses = pending.size();
+    finishChanges();
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::exportSnapshot(const QString &filePath, bool compress)
+{
+    return CourseSnapshot::write(filePath, m_currentSemester, getSemesterStartDate(), getSemesterEndDate(),
+                                 getAllCourses(), compress);
+}
+
+bool CourseManager::importSnapshot(const QString &filePath, int *imported)
+{
+    if (m_scenario) {
+        qDebug() << "Cannot import snapshot while a scenario is active";
+        return false;
+    }
+
+    CourseSnapshot snapshot;
+    if (!snapshot.open(filePath)) {
+        return false;
+    }
+    // 先校验，学期的写入和课程替换放在同一个事务中，提交后才切换当前学期
+    const QString semester = snapshot.semesterName();
+    const QDate start = snapshot.semesterStart();
+    const QDate end = snapshot.semesterEnd();
+    if (semester.isEmpty() || !start.isValid() || !end.isValid() || start >= end) {
+        qDebug() << "Snapshot has no valid semester:" << semester;
+        return false;
+    }
+    const QList<CourseData> courses = snapshot.courses();
+    const QList<CourseData> replaced = loadCourses(semester);
+
+    QSqlDatabase::database().transaction();
+
+    if (!writeSemester(semester, start, end)) {
+        rollbackChanges();
+        return false;
+    }
+
+    // 被替换的课程连同选课学生记入日志，必须在删除选课记录之前读取
+    for (const CourseData &course : replaced) {
+        recordChange(semester, course, CourseData(), enrolledStudentIds(course.id));
+    }
+
+    // 整体替换：先删除该学期原有课程及其选课记录
+    QSqlQuery clear;
+    clear.prepare("DELETE FROM enrollments WHERE course_id IN (SELECT id FROM courses WHERE semester=?)");
+    clear.addBindValue(semester);
+    bool ok = clear.exec();
+    if (ok) {
+        clear.prepare("DELETE FROM courses WHERE semester=?");
+        clear.addBindValue(semester);
+        ok = clear.exec();
+    }
+    if (!ok) {
+        qDebug() << "Failed to clear semester for snapshot:" << clear.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlQuery query;
+    query.prepare(
+        "INSERT INTO courses (name, day_of_week, start_slot, end_slot, location, "
+        "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+        );
+    for (const CourseData &course : courses) {
+        bindCourseFields(query, course, roomIdFor(course.location));
+        query.addBindValue(semester);
+        if (!query.exec()) {
+            qDebug() << "Failed to import snapshot course:" << course.name << query.lastError().text();
+            rollbackChanges();
+            return false;
+        }
+        CourseData stored = course;
+        stored.id = query.lastInsertId().toInt();
+        recordChange(semester, CourseData(), stored);
+    }
+
+    if (!flushChanges(QString("导入快照：学期 %1，%2 门课程").arg(semester).arg(courses.size()))) {
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+
+    // 课程 id 已重新分配，该学期的缓存和选课缓存下次查询时重建
+    m_caches.remove(semester);
+    m_cacheOrder.removeOne(semester);
+    m_enrollments.clear();
+    m_currentSemester = semester;
+    finishChanges();
+    if (imported) *imported = courses.size();
+    emit dataChanged();
+    return true;
+}
+
+QString CourseManager::nextBackupPath() const
+{
+    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return dataPath + "/backup_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".db";
+}
+
+QString CourseManager::backupChainDirectory() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/backups";
+}
+
+bool CourseManager::restoreBackup(const QString &snapshotId, QString *error)
+{
+    if (m_scenario) {
+        if (error) *error = "请先提交或放弃当前的假设方案";
+        return false;
+    }
+
+    const QString dbPath = m_db.databaseName();
+    const QString restoredPath = dbPath + ".restore";
+    const QString previousPath = dbPath + ".before-restore";
+
+    BackupChain chain(backupChainDirectory());
+    if (!chain.restore(snapshotId, restoredPath, error) || !DatabaseBackup::verify(restoredPath, error)) {
+        QFile::remove(restoredPath);
+        return false;
+    }
+
+    // 原数据库保留为 .before-restore，替换失败时换回去
+    m_db.close();
+    QFile::remove(previousPath);
+    if (!QFile::rename(dbPath, previousPath)) {
+        QFile::remove(restoredPath);
+        // 文件没有改动，重新打开原连接即可
+        if (error) *error = m_db.open() ? QString("无法替换数据库文件") : m_db.lastError().text();
+        return false;
+    }
+
+    QString failure;
+    if (!QFile::rename(restoredPath, dbPath)) {
+        failure = "无法替换数据库文件";
+        QFile::remove(restoredPath);
+    } else if (!m_db.open() || !upgradeDatabase()) {
+        failure = m_db.lastError().text();
+        m_db.close();
+        QFile::remove(dbPath);
+    }
+    if (!failure.isEmpty() && (!QFile::rename(previousPath, dbPath) || !m_db.open())) {
+        failure += QString("；原数据库也无法重新打开，已保留为 %1").arg(previousPath);
+    }
+
+    // 数据库文件换过一次，不论结果如何内存中的缓存、教室 id 和撤销记录都不再可信
+    reloadFromDatabase();
+    if (!failure.isEmpty()) {
+        if (error) *error = failure;
+        return false;
+    }
+    return true;
+}
+
+bool CourseManager::createBackup()
+{
+    // 同步备份；界面上的备份按钮走 DatabaseBackup 的后台线程
+    const DatabaseBackup::Result result = DatabaseBackup::backupTo(m_db, nextBackupPath());
+    if (!result.ok) {
+        qDebug() << "Failed to create backup:" << result.error;
+    }
+    return result.ok;
+}
+
+const OccupancyIndex &CourseManager::occupancyIndex()
+{
+    return cacheFor(m_currentSemester).occupancy;
+}
+
+bool CourseManager::isSlotFree(const QDate &date, int slot)
+{
+    const OccupancyIndex &index = cacheFor(m_currentSemester).occupancy;
+    int week = index.weekIndexOf(date);
+    return week < 0 || index.isSlotFree(week, date.dayOfWeek(), slot);
+}
+
+bool CourseManager::isRoomFree(const QString &room, const QDate &date, int slot)
+{
+    const OccupancyIndex &index = cacheFor(m_currentSemester).occupancy;
+    int week = index.weekIndexOf(date);
+    if (week < 0) return true; // 学期之外没有课程
+    if (slot < 1 || slot > OccupancyIndex::SlotsPerDay) return false;
+    return !(index.roomBusyMask(room, week, date.dayOfWeek()) & (1u << (slot - 1)));
+}
+
+bool CourseManager::isTeacherFree(const QString &teacher, const QDate &date, int slot)
+{
+    const OccupancyIndex &index = cacheFor(m_currentSemester).occupancy;
+    int week = index.weekIndexOf(date);
+    if (week < 0) return true; // 学期之外没有课程
+    if (slot < 1 || slot > OccupancyIndex::SlotsPerDay) return false;
+    return !(index.teacherBusyMask(teacher, week, date.dayOfWeek()) & (1u << (slot - 1)));
+}
+
+CourseManager::SemesterCache &CourseManager::cacheFor(const QString &semester)
+{
+    if (m_scenario && m_scenario->semester == semester) {
+        return m_scenario->cache;
+    }
+
+    auto it = m_caches.find(semester);
+    if (it != m_caches.end()) {
+        if (m_cacheOrder.last() != semester) {
+            m_cacheOrder.removeOne(semester);
+            m_cacheOrder.append(semester);
+        }
+        return it.value();
+    }
+
+    SemesterCache &cache = m_caches[semester];
+    m_cacheOrder.removeOne(semester);
+    m_cacheOrder.append(semester);
+    QDate start, end;
+    if (!semesterRange(semester, &start, &end)) {
+        start = getSemesterStartDate();
+        end = getSemesterEndDate();
+    }
+    cache.occupancy.reset(start, start.addDays(1 - start.dayOfWeek()).daysTo(end) / 7 + 1);
+
+    QList<CourseData> courses = loadCourses(semester);
+    cache.courses.reserve(courses.size());
+    for (CourseData &course : courses) {
+        internStrings(cache, course);
+        addToBuckets(cache, course);
+        cache.courses.insert(course.id, course);
+        cache.occupancy.addCourse(course);
+        cache.dates.insert(course.id, course.startDate, course.endDate);
+        cache.totals.apply(course, 1);
+    }
+
+    // 加载之后再按预算淘汰其他学期，刚加载的这个保留；淘汰会移动哈希表中的元素，需重新查找
+    enforceMemoryBudget(semester);
+    return m_caches[semester];
+}
+
+QList<CourseData> CourseManager::sortedCourses(const SemesterCache &cache, const QVector<int> &ids)
+{
+    QList<CourseData> courses;
+    courses.reserve(ids.size());
+    for (int id : ids) {
+        auto it = cache.courses.constFind(id);
+        if (it != cache.courses.constEnd()) {
+            courses.append(it.value());
+        }
+    }
+
+    std::sort(courses.begin(), courses.end(), [](const CourseData &a, const CourseData &b) {
+        if (a.dayOfWeek != b.dayOfWeek) return a.dayOfWeek < b.dayOfWeek;
+        return a.startSlot < b.startSlot;
+    });
+    return courses;
+}
+
+void CourseManager::indexCourse(const QString &semester, const CourseData &course)
+{
+    // 只维护已经加载过的学期，未加载的在首次查询时整体构建
+    SemesterCache *found = nullptr;
+    if (m_scenario) {
+        if (m_scenario->semester == semester) found = &m_scenario->cache;
+    } else {
+        auto it = m_caches.find(semester);
+        if (it != m_caches.end()) found = &it.value();
+    }
+    if (!found) return;
+
+    SemesterCache &cache = *found;
+    CourseData stored = course;
+    internStrings(cache, stored);
+    addToBuckets(cache, stored);
+    cache.courses.insert(stored.id, stored);
+    cache.occupancy.addCourse(course);
+    cache.dates.insert(course.id, course.startDate, course.endDate);
+    cache.totals.apply(stored, 1);
+}
+
+QString CourseManager::unindexCourse(int courseId)
+{
+    // 方案进行中只修改方案自己的缓存，正式数据的缓存保持原样
+    if (m_scenario) {
+        return removeFromCache(m_scenario->cache, courseId) ? m_scenario->semester : QString();
+    }
+
+    for (auto it = m_caches.begin(); it != m_caches.end(); ++it) {
+        if (removeFromCache(it.value(), courseId)) {
+            return it.key();
+        }
+    }
+    return QString();
+}
+
+bool CourseManager::removeFromCache(SemesterCache &cache, int courseId)
+{
+    auto found = cache.courses.find(courseId);
+    if (found == cache.courses.end()) return false;
+
+    removeFromBuckets(cache, found.value());
+    cache.totals.apply(found.value(), -1);
+    cache.courses.erase(found);
+    cache.occupancy.removeCourse(courseId);
+    cache.dates.remove(courseId);
+    return true;
+}
+
+void CourseManager::bindCourseFields(QSqlQuery &query, const CourseData &course, int roomId)
+{
+    query.addBindValue(course.name);
+    query.addBindValue(course.dayOfWeek);
+    query.addBindValue(course.startSlot);
+    query.addBindValue(course.endSlot);
+    query.addBindValue(course.location);
+    query.addBindValue(course.startDate.toString(Qt::ISODate));
+    query.addBindValue(course.endDate.toString(Qt::ISODate));
+    query.addBindValue(course.teacher);
+    query.addBindValue(course.examDate.isValid() ? course.examDate.toString(Qt::ISODate) : "");
+    query.addBindValue(course.courseType);
+    query.addBindValue(course.credits);
+    query.addBindValue(qint64(course.weekMask));
+    query.addBindValue(roomId > 0 ? QVariant(roomId) : QVariant());
+}
+
+void CourseManager::addToBuckets(SemesterCache &cache, const CourseData &course)
+{
+    const QString room = course.location.trimmed();
+    const QString teacher = course.teacher.trimmed();
+    if (!room.isEmpty()) cache.roomCourses[room].append(course.id);
+    if (!teacher.isEmpty()) cache.teacherCourses[teacher].append(course.id);
+}
+
+void CourseManager::removeFromBuckets(SemesterCache &cache, const CourseData &course)
+{
+    auto removeFrom = [&course](QHash<QString, QVector<int>> &buckets, const QString &key) {
+        auto it = buckets.find(key);
+        if (it == buckets.end()) return;
+        it.value().removeOne(course.id);
+        if (it.value().isEmpty()) buckets.erase(it);
+    };
+    removeFrom(cache.roomCourses, course.location.trimmed());
+    removeFrom(cache.teacherCourses, course.teacher.trimmed());
+}
+
+void CourseManager::internStrings(SemesterCache &cache, CourseData &course)
+{
+    for (QString *value : {&course.location, &course.teacher, &course.courseType}) {
+        auto it = cache.strings.constFind(*value);
+        if (it != cache.strings.constEnd()) {
+            *value = *it;
+        } else {
+            cache.strings.insert(*value);
+        }
+    }
+}
+
+qint64 CourseManager::cacheBytes(const SemesterCache &cache, MemoryUsage *usage)
+{
+    const qint64 charSize = sizeof(QChar);
+    const qint64 nodeOverhead = sizeof(int) + sizeof(void *);
+
+    qint64 courseBytes = qint64(cache.courses.size()) * (qint64(sizeof(CourseData)) + nodeOverhead);
+    for (const CourseData &course : cache.courses) {
+        courseBytes += course.name.capacity() * charSize;
+    }
+
+    qint64 stringBytes = 0;
+    for (const QString &value : cache.strings) {
+        stringBytes += qint64(sizeof(QString)) + nodeOverhead + value.capacity() * charSize;
+    }
+
+    qint64 indexBytes = cache.occupancy.memoryBytes() + cache.dates.memoryBytes();
+    for (const QHash<QString, QVector<int>> *buckets : {&cache.roomCourses, &cache.teacherCourses}) {
+        for (const QVector<int> &ids : *buckets) {
+            indexBytes += qint64(sizeof(QString)) + nodeOverhead + qint64(ids.capacity()) * qint64(sizeof(int));
+        }
+    }
+
+    if (usage) {
+        usage->courseBytes += courseBytes;
+        usage->stringBytes += stringBytes;
+        usage->indexBytes += indexBytes;
+        usage->cachedSemesters += 1;
+        usage->cachedCourses += cache.courses.size();
+        usage->pooledStrings += cache.strings.size();
+    }
+    return courseBytes + stringBytes + indexBytes;
+}
+
+MemoryUsage CourseManager::memoryUsage() const
+{
+    MemoryUsage usage;
+    for (const SemesterCache &cache : m_caches) {
+        cacheBytes(cache, &usage);
+    }
+    return usage;
+}
+
+void CourseManager::setMemoryBudget(qint64 bytes)
+{
+    m_memoryBudget = qMax<qint64>(0, bytes);
+    enforceMemoryBudget();
+}
+
+qint64 CourseManager::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+void CourseManager::clearCaches()
+{
+    m_caches.clear();
+    m_cacheOrder.clear();
+}
+
+void CourseManager::reloadFromDatabase()
+{
+    clearCaches();
+    m_roomIds.clear();
+    m_enrollments.clear();
+    m_history.clear();
+    m_journal.reset();
+    emit dataChanged();
+}
+
+void CourseManager::enforceMemoryBudget(const QString &keep)
+{
+    if (m_memoryBudget <= 0) return;
+
+    qint64 total = memoryUsage().total();
+
+    // 从最久未使用的学期开始淘汰，当前学期最后才考虑；被淘汰的缓存在下次查询时重新加载
+    QStringList order = m_cacheOrder;
+    order.removeOne(m_currentSemester);
+    order.append(m_currentSemester);
+
+    for (const QString &semester : order) {
+        if (total <= m_memoryBudget) break;
+        if (semester == keep) continue;
+
+        auto it = m_caches.find(semester);
+        if (it == m_caches.end()) continue;
+
+        total -= cacheBytes(it.value(), nullptr);
+        m_caches.erase(it);
+        m_cacheOrder.removeOne(semester);
+    }
+}
+
+int CourseConflict::firstWeek() const
+{
+    for (int week = 0; week < OccupancyIndex::MaxWeeks; ++week) {
+        if (weeks & (quint64(1) << week)) return week + 1;
+    }
+    return 0;
+}
+
+void CreditSummary::apply(const CourseData &course, int delta)
+{
+    const qint64 cents = qRound64(course.credits * 100) * delta;
+    const int span = course.endSlot >= course.startSlot ? (course.endSlot - course.startSlot + 1) * delta : 0;
+
+    auto update = [&](Bucket &bucket) {
+        bucket.courseCount += delta;
+        bucket.creditCents += cents;
+        bucket.slotCount += span;
+    };
+    auto updateKeyed = [&](QHash<QString, Bucket> &buckets, const QString &key) {
+        Bucket &bucket = buckets[key];
+        update(bucket);
+        if (bucket.courseCount <= 0) buckets.remove(key);
+    };
+
+    update(total);
+    updateKeyed(byType, course.courseType.trimmed());
+    updateKeyed(byTeacher, course.teacher.trimmed());
+    if (course.dayOfWeek >= 1 && course.dayOfWeek <= 7) {
+        update(byWeekday[course.dayOfWeek - 1]);
+    }
+}
+
+void CreditSummary::clear()
+{
+    *this = CreditSummary();
+}
+
+const CreditSummary &CourseManager::creditSummary()
+{
+    return cacheFor(m_currentSemester).totals;
+}
+
+QString CourseConflict::description() const
+{
+    QStringList kinds;
+    if (sameRoom) kinds << QString("教室 %1").arg(other.location);
+    if (sameTeacher) kinds << QString("教师 %1").arg(other.teacher);
+
+    int firstSlot = 0;
+    int lastSlot = 0;
+    for (int slot = 1; slot <= OccupancyIndex::SlotsPerDay; ++slot) {
+        if (!(slotMask & (1u << (slot - 1)))) continue;
+        if (!firstSlot) firstSlot = slot;
+        lastSlot = slot;
+    }
+
+    int weekCount = 0;
+    for (quint64 rest = weeks; rest; rest &= rest - 1) ++weekCount;
+
+    return QString("与「%1」%2冲突：周%3 第%4-%5节，自第%6周起共%7周")
+        .arg(other.name)
+        .arg(kinds.join("、"))
+        .arg(other.dayOfWeek)
+        .arg(firstSlot)
+        .arg(lastSlot)
+        .arg(firstWeek())
+        .arg(weekCount);
+}
+
+QList<CourseJournal::Operation> CourseManager::journalOperations(int limit) const
+{
+    return m_journal.operations(limit);
+}
+
+QDateTime CourseManager::journalEarliestTime() const
+{
+    return m_journal.earliestTime();
+}
+
+bool CourseManager::undoLastOperation(QString *summary)
+{
+    const QList<CourseJournal::Operation> last = m_journal.operations(1);
+    if (last.isEmpty()) return false;
+    if (summary) *summary = last.first().summary;
+    return revertJournal(last.first().batch);
+}
+
+bool CourseManager::revertToOperation(qint64 batch)
+{
+    return batch > 0 && revertJournal(batch);
+}
+
+bool CourseManager::restoreToTime(const QDateTime &time)
+{
+    const qint64 batch = m_journal.firstBatchAfter(time);
+    return batch == 0 || revertJournal(batch); // 该时间之后没有操作时无需恢复
+}
+
+int CourseManager::compactJournal()
+{
+    return m_journal.compact();
+}
+
+bool CourseManager::revertJournal(qint64 batch)
+{
+    if (m_scenario) {
+        qDebug() << "Cannot revert journal while a scenario is active";
+        return false;
+    }
+
+    // 从最新的记录往回逐条做反向操作，全部在一个事务中完成
+    const QList<CourseJournal::Entry> entries = m_journal.entriesFrom(batch);
+
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    bool ok = true;
+    for (const CourseJournal::Entry &entry : entries) {
+        if (entry.op == CourseJournal::Insert) {
+            query.prepare("DELETE FROM enrollments WHERE course_id=?");
+            query.addBindValue(entry.courseId);
+            ok = query.exec();
+            if (ok) {
+                query.prepare("DELETE FROM courses WHERE id=?");
+                query.addBindValue(entry.courseId);
+                ok = query.exec();
+            }
+        } else if (entry.op == CourseJournal::Delete) {
+            CourseData course;
+            QVector<int> students;
+            ok = CourseJournal::decode(entry.data, &course, &students);
+            if (ok) {
+                query.prepare(
+                    "INSERT INTO courses (id, name, day_of_week, start_slot, end_slot, location, "
+                    "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+                    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+                    );
+                query.addBindValue(entry.courseId);
+                bindCourseFields(query, course, roomIdFor(course.location));
+                query.addBindValue(entry.semester);
+                ok = query.exec();
+            }
+            if (ok && !students.isEmpty()) {
+                // 与撤销相同：已被删除的学生不再恢复选课
+                query.prepare("INSERT OR IGNORE INTO enrollments (student_id, course_id) "
+                              "SELECT id, ? FROM students WHERE id=?");
+                for (int i = 0; ok && i < students.size(); ++i) {
+                    query.addBindValue(entry.courseId);
+                    query.addBindValue(students.at(i));
+                    ok = query.exec();
+                }
+            }
+        } else {
+            CourseData course = loadCourseById(entry.courseId);
+            ok = course.id >= 0 && CourseJournal::revertDiff(entry.data, &course);
+            if (ok) {
+                query.prepare(
+                    "UPDATE courses SET name=?, day_of_week=?, start_slot=?, end_slot=?, "
+                    "location=?, start_date=?, end_date=?, teacher=?, exam_date=?, course_type=?, credits=?, week_mask=?, room_id=? WHERE id=?"
+                    );
+                bindCourseFields(query, course, roomIdFor(course.location));
+                query.addBindValue(course.id);
+                ok = query.exec();
+            }
+        }
+        if (!ok) {
+            qDebug() << "Failed to revert journal entry for course" << entry.courseId << ":" << query.lastError().text();
+            break;
+        }
+    }
+
+    if (!ok || !m_journal.truncateFrom(batch) || !QSqlDatabase::database().commit()) {
+        rollbackChanges();
+        return false;
+    }
+
+    // 日志撤回绕过了撤销栈，栈中记录的修改前后内容已与数据库对不上
+    m_history.clear();
+    clearCaches();
+    m_enrollments.clear();
+    emit dataChanged();
+    return true;
+}
+
+void CourseManager::recordChange(const QString &semester, const CourseData &before, const CourseData &after,
+                                 const QVector<int> &students)
+{
+    CourseHistory::Change change;
+    change.semester = semester;
+    if (before.id < 0) {
+        m_journal.recordInsert(semester, after);
+        change.courseId = after.id;
+    } else if (after.id < 0) {
+        m_journal.recordDelete(semester, before, students);
+        change.courseId = before.id;
+        change.students = students;
+    } else {
+        m_journal.recordUpdate(semester, before, after);
+        change.courseId = after.id;
+    }
+    if (before.id >= 0) change.before = CourseJournal::encode(before);
+    if (after.id >= 0) change.after = CourseJournal::encode(after);
+    m_pendingChanges.append(change);
+}
+
+bool CourseManager::flushChanges(const QString &summary)
+{
+    m_pendingSummary = summary;
+    if (!m_journal.flush(summary)) {
+        m_pendingChanges.clear();
+        return false;
+    }
+    return true;
+}
+
+void CourseManager::discardChanges()
+{
+    m_journal.discard();
+    m_pendingChanges.clear();
+}
+
+void CourseManager::rollbackChanges()
+{
+    QSqlDatabase::database().rollback();
+    discardChanges();
+    // roomIdFor 可能在本事务中登记了新教室，回滚后这些 id 已失效并会被重新分配
+    m_roomIds.clear();
+}
+
+void CourseManager::finishChanges()
+{
+    // 事务已提交：本次操作成为撤销栈上的一条命令
+    m_history.push(m_pendingSummary, m_pendingChanges);
+    m_pendingChanges.clear();
+    m_journal.compactIfNeeded();
+    enforceMemoryBudget(m_currentSemester); // 新增和修改会让已加载的缓存变大；正在使用的学期保留
+}
+
+QVector<int> CourseManager::enrolledStudentIds(int courseId)
+{
+    QVector<int> students;
+    QSqlQuery query;
+    query.prepare("SELECT student_id FROM enrollments WHERE course_id=?");
+    query.addBindValue(courseId);
+    if (query.exec()) {
+        while (query.next()) {
+            students.append(query.value(0).toInt());
+        }
+    }
+    return students;
+}
+
+bool CourseManager::canUndo() const
+{
+    return !m_scenario && m_history.canUndo();
+}
+
+bool CourseManager::canRedo() const
+{
+    return !m_scenario && m_history.canRedo();
+}
+
+QString CourseManager::undoText() const
+{
+    return m_history.undoText();
+}
+
+QString CourseManager::redoText() const
+{
+    return m_history.redoText();
+}
+
+bool CourseManager::undo(QList<CourseData> *touched)
+{
+    if (!canUndo()) return false;
+    if (!applyHistory(m_history.undoCommand(), true, touched)) return false;
+    m_history.undone();
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::redo(QList<CourseData> *touched)
+{
+    if (!canRedo()) return false;
+    if (!applyHistory(m_history.redoCommand(), false, touched)) return false;
+    m_history.redone();
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::applyHistory(const CourseHistory::Command &command, bool undo, QList<CourseData> *touched)
+{
+    // 撤销时从后往前把每门课换回修改前的内容，重做时从前往后换成修改后的内容；
+    // 课程保持原来的 id，删除后恢复的课程仍能对上日志和选课记录
+    struct Step {
+        const CourseHistory::Change *change;
+        CourseData from;
+        CourseData to;
+    };
+    QList<Step> steps;
+    for (int i = 0; i < command.changes.size(); ++i) {
+        const CourseHistory::Change &change = command.changes.at(undo ? command.changes.size() - 1 - i : i);
+        Step step{&change, CourseData(), CourseData()};
+        const QByteArray &from = undo ? change.after : change.before;
+        const QByteArray &to = undo ? change.before : change.after;
+        if ((!from.isEmpty() && !CourseJournal::decode(from, &step.from))
+            || (!to.isEmpty() && !CourseJournal::decode(to, &step.to))) {
+            qDebug() << "Corrupt undo record for course" << change.courseId;
+            return false;
+        }
+        if (!from.isEmpty()) step.from.id = change.courseId;
+        if (!to.isEmpty()) step.to.id = change.courseId;
+        steps.append(step);
+    }
+
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    bool ok = true;
+    bool enrollmentsChanged = false;
+    for (Step &step : steps) {
+        const CourseHistory::Change &change = *step.change;
+        if (step.to.id < 0) {
+            query.prepare("DELETE FROM enrollments WHERE course_id=?");
+            query.addBindValue(change.courseId);
+            ok = query.exec();
+            if (ok) {
+                query.prepare("DELETE FROM courses WHERE id=?");
+                query.addBindValue(change.courseId);
+                ok = query.exec() && query.numRowsAffected() == 1;
+            }
+            enrollmentsChanged = true;
+        } else {
+            const int roomId = roomIdFor(step.to.location);
+            step.to.roomId = roomId > 0 ? roomId : -1;
+            if (step.from.id < 0) {
+                query.prepare(
+                    "INSERT INTO courses (id, name, day_of_week, start_slot, end_slot, location, "
+                    "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+                    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+                    );
+                query.addBindValue(change.courseId);
+                bindCourseFields(query, step.to, roomId);
+                query.addBindValue(change.semester);
+                ok = query.exec();
+                if (ok && !change.students.isEmpty()) {
+                    // 已被删除的学生不再恢复选课
+                    query.prepare("INSERT OR IGNORE INTO enrollments (student_id, course_id) "
+                                  "SELECT id, ? FROM students WHERE id=?");
+                    for (int i = 0; ok && i < change.students.size(); ++i) {
+                        query.addBindValue(change.courseId);
+                        query.addBindValue(change.students.at(i));
+                        ok = query.exec();
+                    }
+                    enrollmentsChanged = true;
+                }
+            } else {
+                query.prepare(
+                    "UPDATE courses SET name=?, day_of_week=?, start_slot=?, end_slot=?, "
+                    "location=?, start_date=?, end_date=?, teacher=?, exam_date=?, course_type=?, credits=?, week_mask=?, room_id=? WHERE id=?"
+                    );
+                bindCourseFields(query, step.to, roomId);
+                query.addBindValue(change.courseId);
+                ok = query.exec() && query.numRowsAffected() == 1;
+            }
+        }
+        if (!ok) {
+            qDebug() << "Failed to apply undo record for course" << change.courseId << ":" << query.lastError().text();
+            break;
+        }
+        recordChange(change.semester, step.from, step.to);
+    }
+
+    const QString summary = (undo ? "撤销：" : "重做：") + command.text;
+    if (!ok || !flushChanges(summary) || !QSqlDatabase::database().commit()) {
+        rollbackChanges();
+        return false;
+    }
+
+    // 撤销/重做本身写入日志，但不再压入撤销栈
+    m_pendingChanges.clear();
+    m_journal.compactIfNeeded();
+
+    // 只更新涉及的课程，已加载的学期缓存增量维护
+    for (const Step &step : steps) {
+        if (step.from.id >= 0) unindexCourse(step.from.id);
+        if (step.to.id >= 0) indexCourse(step.change->semester, step.to);
+        if (touched) {
+            if (step.from.id >= 0) touched->append(step.from);
+            if (step.to.id >= 0) touched->append(step.to);
+        }
+    }
+    if (enrollmentsChanged) m_enrollments.clear();
+    enforceMemoryBudget(m_currentSemester);
+    return true;
+}
+
+QList<CourseConflict> CourseManager::findConflicts(const CourseData &candidate)
+{
+    QList<CourseConflict> conflicts;
+    const SemesterCache &cache = cacheFor(m_currentSemester);
+    const OccupancyIndex &occupancy = cache.occupancy;
+
+    const quint16 slotMask = OccupancyIndex::slotRangeMask(candidate.startSlot, candidate.endSlot);
+    const quint64 weeks = occupancy.activeWeeks(candidate);
+    if (!slotMask || !weeks) return conflicts;
+
+    const QString room = candidate.location.trimmed();
+    const QString teacher = candidate.teacher.trimmed();
+
+    // 位图预判：候选课程上课的所有周里，该教室/教师在这些节次都空闲就不可能冲突
+    auto mayClash = [&](const QString &key, bool isRoom) {
+        if (key.isEmpty()) return false;
+        for (int week = 0; week < occupancy.weekCount(); ++week) {
+            if (!(weeks & (quint64(1) << week))) continue;
+            quint16 busy = isRoom ? occupancy.roomBusyMask(key, week, candidate.dayOfWeek)
+                                  : occupancy.teacherBusyMask(key, week, candidate.dayOfWeek);
+            if (busy & slotMask) return true;
+        }
+        return false;
+    };
+
+    QHash<int, int> conflictIndex; // 课程 id -> conflicts 中的位置，同一门课只报告一次
+    auto collect = [&](const QHash<QString, QVector<int>> &buckets, const QString &key, bool isRoom) {
+        const QVector<int> ids = buckets.value(key);
+        for (int id : ids) {
+            if (id == candidate.id) continue;
+
+            // 只读查找：不让方案共享的课程表分离，也不为失效的桶 id 插入空课程
+            auto found = cache.courses.constFind(id);
+            if (found == cache.courses.constEnd()) continue;
+            const CourseData &other = found.value();
+            if (other.dayOfWeek != candidate.dayOfWeek) continue;
+
+            quint16 commonSlots = slotMask & OccupancyIndex::slotRangeMask(other.startSlot, other.endSlot);
+            if (!commonSlots) continue;
+
+            quint64 commonWeeks = weeks & occupancy.activeWeeks(id);
+            if (!commonWeeks) continue;
+
+            auto existing = conflictIndex.constFind(id);
+            if (existing == conflictIndex.constEnd()) {
+                CourseConflict conflict;
+                conflict.other = other;
+                conflict.slotMask = commonSlots;
+                conflict.weeks = commonWeeks;
+                conflictIndex.insert(id, conflicts.size());
+                conflicts.append(conflict);
+                existing = conflictIndex.constFind(id);
+            }
+
+            CourseConflict &conflict = conflicts[existing.value()];
+            if (isRoom) conflict.sameRoom = true;
+            else conflict.sameTeacher = true;
+        }
+    };
+
+    if (mayClash(room, true)) collect(cache.roomCourses, room, true);
+    if (mayClash(teacher, false)) collect(cache.teacherCourses, teacher, false);
+
+    return conflicts;
+}
+
+QList<FreeSlot> CourseManager::findFreeSlots(const FreeSlotQuery &query)
+{
+    QList<FreeSlot> candidates;
+    const OccupancyIndex &index = cacheFor(m_currentSemester).occupancy;
+    if (query.duration < 1 || index.weekCount() == 0) return candidates;
+
+    const QDate from = query.from.isValid() ? query.from : getSemesterStartDate();
+    const QDate to = query.to.isValid() ? query.to : getSemesterEndDate();
+    if (from > to) return candidates;
+
+    const QString room = query.room.trimmed();
+    const QString teacher = query.teacher.trimmed();
+    const int firstDay = query.dayOfWeek >= 1 && query.dayOfWeek <= OccupancyIndex::DaysPerWeek ? query.dayOfWeek : 1;
+    const int lastDay = query.dayOfWeek >= 1 && query.dayOfWeek <= OccupancyIndex::DaysPerWeek ? query.dayOfWeek
+                                                                                               : OccupancyIndex::DaysPerWeek;
+    const int earliest = qMax(1, query.earliestSlot);
+    const int latest = qMin(int(OccupancyIndex::SlotsPerDay), query.latestSlot);
+
+    for (int day = firstDay; day <= lastDay; ++day) {
+        // 先把每周当天的占用合并成一个位图，后面每个候选时段只需一次与运算
+        QVector<quint16> busy;
+        QVector<int> weeks;
+        for (int week = 0; week < index.weekCount(); ++week) {
+            const QDate date = index.firstMonday().addDays(week * 7 + day - 1);
+            if (date < from || date > to) continue;
+
+            quint16 mask = 0;
+            if (!room.isEmpty()) mask |= index.roomBusyMask(room, week, day);
+            if (!teacher.isEmpty()) mask |= index.teacherBusyMask(teacher, week, day);
+            busy.append(mask);
+            weeks.append(week);
+        }
+        if (weeks.isEmpty()) continue;
+
+        for (int start = earliest; start + query.duration - 1 <= latest; ++start) {
+            const int end = start + query.duration - 1;
+            const quint16 range = OccupancyIndex::slotRangeMask(start, end);
+
+            FreeSlot slot;
+            slot.dayOfWeek = day;
+            slot.startSlot = start;
+            slot.endSlot = end;
+            slot.totalWeeks = weeks.size();
+            for (int i = 0; i < weeks.size(); ++i) {
+                if (busy.at(i) & range) continue;
+                ++slot.freeWeeks;
+                slot.weeks |= quint64(1) << weeks.at(i);
+                for (int s = start; s <= end; ++s) {
+                    slot.load += index.slotLoad(weeks.at(i), day, s);
+                }
+            }
+            if (slot.freeWeeks > 0) {
+                candidates.append(slot);
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const FreeSlot &a, const FreeSlot &b) {
+        if (a.freeWeeks != b.freeWeeks) return a.freeWeeks > b.freeWeeks;
+        if (a.load != b.load) return a.load < b.load;
+        if (a.dayOfWeek != b.dayOfWeek) return a.dayOfWeek < b.dayOfWeek;
+        return a.startSlot < b.startSlot;
+    });
+
+    if (query.maxResults > 0 && candidates.size() > query.maxResults) {
+        candidates.erase(candidates.begin() + query.maxResults, candidates.end());
+    }
+    return candidates;
+}
+
+int CourseManager::roomIdFor(const QString &location)
+{
+    const QString name = location.trimmed();
+    if (name.isEmpty()) return -1;
+
+    if (m_roomIds.isEmpty()) {
+        QSqlQuery query("SELECT id, name FROM rooms");
+        while (query.next()) {
+            m_roomIds.insert(query.value(1).toString(), query.value(0).toInt());
+        }
+    }
+
+    auto it = m_roomIds.constFind(name);
+    if (it != m_roomIds.constEnd()) return it.value();
+
+    // 新出现的地点自动登记到教室库，容量留待补充
+    const int space = name.indexOf(' ');
+    QSqlQuery query;
+    query.prepare("INSERT INTO rooms (name, building) VALUES (?, ?)");
+    query.addBindValue(name);
+    query.addBindValue(space > 0 ? name.left(space) : QString());
+    if (!query.exec()) {
+        qDebug() << "Failed to register room:" << query.lastError().text();
+        return -1;
+    }
+
+    const int id = query.lastInsertId().toInt();
+    m_roomIds.insert(name, id);
+    return id;
+}
+
+QList<RoomData> CourseManager::getRooms()
+{
+    QList<RoomData> rooms;
+    QSqlQuery query("SELECT id, name, building, capacity, features FROM rooms ORDER BY building, name");
+    while (query.next()) {
+        RoomData room;
+        room.id = query.value(0).toInt();
+        room.name = query.value(1).toString();
+        room.building = query.value(2).toString();
+        room.capacity = query.value(3).toInt();
+        room.features = query.value(4).toString().split(',', Qt::SkipEmptyParts);
+        for (QString &feature : room.features) {
+            feature = feature.trimmed();
+        }
+        rooms.append(room);
+    }
+    return rooms;
+}
+
+bool CourseManager::saveRoom(RoomData &room)
+{
+    room.name = room.name.trimmed();
+    if (room.name.isEmpty()) return false;
+
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    if (room.id < 0) {
+        query.prepare("INSERT INTO rooms (name, building, capacity, features) VALUES (?, ?, ?, ?)");
+    } else {
+        query.prepare("UPDATE rooms SET name=?, building=?, capacity=?, features=? WHERE id=?");
+    }
+    query.addBindValue(room.name);
+    query.addBindValue(room.building.trimmed());
+    query.addBindValue(room.capacity);
+    query.addBindValue(room.features.join(","));
+    if (room.id >= 0) {
+        query.addBindValue(room.id);
+    }
+
+    if (!query.exec()) {
+        qDebug() << "Failed to save room:" << query.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    bool renamed = false;
+    if (room.id < 0) {
+        room.id = query.lastInsertId().toInt();
+    } else {
+        // 教室改名时同步关联课程的地点文本，每门课的地点变化写入修改日志
+        QSqlQuery affected;
+        affected.prepare("SELECT id FROM courses WHERE room_id=? AND location<>?");
+        affected.addBindValue(room.id);
+        affected.addBindValue(room.name);
+        QVector<int> courseIds;
+        if (affected.exec()) {
+            while (affected.next()) courseIds.append(affected.value(0).toInt());
+        }
+        for (int courseId : courseIds) {
+            QString semester;
+            const CourseData before = loadCourseById(courseId, &semester);
+            CourseData after = before;
+            after.location = room.name;
+            m_journal.recordUpdate(semester, before, after);
+        }
+
+        QSqlQuery rename;
+        rename.prepare("UPDATE courses SET location=? WHERE room_id=? AND location<>?");
+        rename.addBindValue(room.name);
+        rename.addBindValue(room.id);
+        rename.addBindValue(room.name);
+        if (!rename.exec() || !m_journal.flush(QString("教室改名：%1").arg(room.name))) {
+            qDebug() << "Failed to rename room in courses:" << rename.lastError().text();
+            rollbackChanges();
+            return false;
+        }
+        renamed = rename.numRowsAffected() > 0;
+    }
+
+    QSqlDatabase::database().commit();
+
+    m_roomIds.clear();
+    if (renamed) {
+        // 撤销栈中保存的是旧地点，撤销会把课程改回旧名并重新登记旧教室，因此清空
+        m_history.clear();
+        m_journal.compactIfNeeded();
+        clearCaches();
+    }
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::deleteRoom(int id)
+{
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    query.prepare("UPDATE courses SET room_id=NULL WHERE room_id=?");
+    query.addBindValue(id);
+    bool ok = query.exec();
+    const bool unlinked = ok && query.numRowsAffected() > 0;
+    if (ok) {
+        query.prepare("DELETE FROM rooms WHERE id=?");
+        query.addBindValue(id);
+        ok = query.exec();
+    }
+
+    if (!ok) {
+        qDebug() << "Failed to delete room:" << query.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+
+    m_roomIds.clear();
+    // room_id 由地点文本推导，日志中只记录地点，不需要为解除关联写日志；
+    // 但撤销记录会按地点重新登记教室，已删除的教室会被悄悄恢复，因此清空撤销栈
+    if (unlinked) m_history.clear();
+    for (SemesterCache &cache : m_caches) {
+        for (CourseData &course : cache.courses) {
+            if (course.roomId == id) course.roomId = -1;
+        }
+    }
+    emit dataChanged();
+    return true;
+}
+
+QList<CourseData> CourseManager::assignRooms(const QList<CourseData> &courses, const QHash<int, int> &courseSize,
+                                             const QHash<int, QStringList> &requiredFeatures, QStringList *unassigned)
+{
+    QList<CourseData> assigned;
+    QList<RoomData> rooms = getRooms();
+    std::sort(rooms.begin(), rooms.end(), [](const RoomData &a, const RoomData &b) {
+        return a.capacity != b.capacity ? a.capacity < b.capacity : a.name < b.name;
+    });
+
+    const OccupancyIndex &occupancy = cacheFor(m_currentSemester).occupancy;
+    const int days = OccupancyIndex::DaysPerWeek;
+    const int cells = occupancy.weekCount() * days;
+
+    // 每间教室整学期的占用位图复制一份，本次分配的课程直接叠加上去
+    QVector<QVector<quint16>> busy(rooms.size());
+    for (int room = 0; room < rooms.size(); ++room) {
+        busy[room].resize(cells);
+        for (int week = 0; week < occupancy.weekCount(); ++week) {
+            for (int day = 1; day <= days; ++day) {
+                busy[room][week * days + day - 1] = occupancy.roomBusyMask(rooms.at(room).name, week, day);
+            }
+        }
+    }
+
+    QList<CourseData> pending;
+    for (const CourseData &course : courses) {
+        if (course.location.trimmed().isEmpty()) pending.append(course);
+    }
+    std::stable_sort(pending.begin(), pending.end(), [&courseSize](const CourseData &a, const CourseData &b) {
+        const int sizeA = courseSize.value(a.id, 0);
+        const int sizeB = courseSize.value(b.id, 0);
+        if (sizeA != sizeB) return sizeA > sizeB;
+        return a.endSlot - a.startSlot > b.endSlot - b.startSlot;
+    });
+
+    for (CourseData course : pending) {
+        if (course.dayOfWeek < 1 || course.dayOfWeek > days) {
+            if (unassigned) unassigned->append(course.name);
+            continue;
+        }
+
+        const quint16 range = OccupancyIndex::slotRangeMask(course.startSlot, course.endSlot);
+        const quint64 weeks = occupancy.activeWeeks(course);
+        const int size = courseSize.value(course.id, 0);
+        const QStringList features = requiredFeatures.value(course.id);
+
+        int chosen = -1;
+        for (int room = 0; room < rooms.size() && chosen < 0; ++room) {
+            if (size > 0 && rooms.at(room).capacity < size) continue;
+            if (!rooms.at(room).hasFeatures(features)) continue;
+
+            bool free = true;
+            for (int week = 0; week < occupancy.weekCount() && free; ++week) {
+                if (weeks & (quint64(1) << week)) {
+                    free = !(busy.at(room).at(week * days + course.dayOfWeek - 1) & range);
+                }
+            }
+            if (free) chosen = room;
+        }
+
+        if (chosen < 0) {
+            if (unassigned) unassigned->append(course.name);
+            continue;
+        }
+
+        for (int week = 0; week < occupancy.weekCount(); ++week) {
+            if (weeks & (quint64(1) << week)) {
+                busy[chosen][week * days + course.dayOfWeek - 1] |= range;
+            }
+        }
+        course.location = rooms.at(chosen).name;
+        course.roomId = rooms.at(chosen).id;
+        assigned.append(course);
+    }
+    return assigned;
+}
+
+QList<StudentData> CourseManager::getStudents(const QString &keyword)
+{
+    QList<StudentData> students;
+    QSqlQuery query;
+    if (keyword.trimmed().isEmpty()) {
+        query.prepare("SELECT id, student_no, name, class_name FROM students ORDER BY student_no");
+    } else {
+        query.prepare("SELECT id, student_no, name, class_name FROM students "
+                      "WHERE student_no LIKE ? OR name LIKE ? OR class_name LIKE ? ORDER BY student_no");
+        const QString pattern = "%" + keyword.trimmed() + "%";
+        query.addBindValue(pattern);
+        query.addBindValue(pattern);
+        query.addBindValue(pattern);
+    }
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load students:" << query.lastError().text();
+        return students;
+    }
+    while (query.next()) {
+        StudentData student;
+        student.id = query.value(0).toInt();
+        student.studentNo = query.value(1).toString();
+        student.name = query.value(2).toString();
+        student.className = query.value(3).toString();
+        students.append(student);
+    }
+    return students;
+}
+
+bool CourseManager::saveStudent(StudentData &student)
+{
+    student.studentNo = student.studentNo.trimmed();
+    student.name = student.name.trimmed();
+    if (student.studentNo.isEmpty() || student.name.isEmpty()) return false;
+
+    QSqlQuery query;
+    if (student.id < 0) {
+        query.prepare("INSERT INTO students (student_no, name, class_name) VALUES (?, ?, ?)");
+    } else {
+        query.prepare("UPDATE students SET student_no=?, name=?, class_name=? WHERE id=?");
+    }
+    query.addBindValue(student.studentNo);
+    query.addBindValue(student.name);
+    query.addBindValue(student.className.trimmed());
+    if (student.id >= 0) {
+        query.addBindValue(student.id);
+    }
+
+    if (!query.exec()) {
+        qDebug() << "Failed to save student:" << query.lastError().text();
+        return false;
+    }
+    if (student.id < 0) {
+        student.id = query.lastInsertId().toInt();
+    }
+    return true;
+}
+
+bool CourseManager::deleteStudent(int id)
+{
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    query.prepare("DELETE FROM enrollments WHERE student_id=?");
+    query.addBindValue(id);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM students WHERE id=?");
+        query.addBindValue(id);
+        ok = query.exec();
+    }
+
+    if (!ok) {
+        qDebug() << "Failed to delete student:" << query.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+    m_enrollments.remove(id);
+    return true;
+}
+
+QVector<int> CourseManager::enrolledCourseIds(int studentId)
+{
+    auto it = m_enrollments.constFind(studentId);
+    if (it != m_enrollments.constEnd()) return it.value();
+
+    // 只走主键索引，不回表
+    QVector<int> ids;
+    QSqlQuery query;
+    query.prepare("SELECT course_id FROM enrollments WHERE student_id=?");
+    query.addBindValue(studentId);
+    if (!query.exec()) {
+        qDebug() << "Failed to load enrollments:" << query.lastError().text();
+        return ids;
+    }
+    while (query.next()) {
+        ids.append(query.value(0).toInt());
+    }
+
+    m_enrollments.insert(studentId, ids);
+    return ids;
+}
+
+bool CourseManager::setEnrollments(int studentId, const QVector<int> &courseIds)
+{
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    query.prepare("DELETE FROM enrollments WHERE student_id=?");
+    query.addBindValue(studentId);
+    bool ok = query.exec();
+
+    query.prepare("INSERT OR IGNORE INTO enrollments (student_id, course_id) VALUES (?, ?)");
+    for (int i = 0; ok && i < courseIds.size(); ++i) {
+        query.addBindValue(studentId);
+        query.addBindValue(courseIds.at(i));
+        ok = query.exec();
+    }
+
+    if (!ok) {
+        qDebug() << "Failed to save enrollments:" << query.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+    m_enrollments.remove(studentId);
+    return true;
+}
+
+bool CourseManager::enrollStudents(int courseId, const QVector<int> &studentIds)
+{
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    query.prepare("INSERT OR IGNORE INTO enrollments (student_id, course_id) VALUES (?, ?)");
+    bool ok = true;
+    for (int i = 0; ok && i < studentIds.size(); ++i) {
+        query.addBindValue(studentIds.at(i));
+        query.addBindValue(courseId);
+        ok = query.exec();
+    }
+
+    if (!ok) {
+        qDebug() << "Failed to enroll students:" << query.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    QSqlDatabase::database().commit();
+    for (int id : studentIds) {
+        m_enrollments.remove(id);
+    }
+    return true;
+}
+
+QList<CourseData> CourseManager::getStudentCoursesByWeek(int studentId, const QDate &date)
+{
+    // 学生只选了几门课，直接从学期缓存中取出再按日期和周次过滤，不必扫描全部课程
+    SemesterCache &cache = cacheFor(m_currentSemester);
+    QList<CourseData> courses = sortedCourses(cache, enrolledCourseIds(studentId));
+
+    int week = getWeekNumber(date);
+    courses.erase(std::remove_if(courses.begin(), courses.end(), [week, &date](const CourseData &course) {
+        return course.startDate > date || course.endDate < date || !course.occursInWeek(week);
+    }), courses.end());
+    return courses;
+}
+
+QList<StudentClash> CourseManager::findStudentClashes(int studentId)
+{
+    SemesterCache &cache = cacheFor(m_currentSemester);
+    const QList<CourseData> courses = sortedCourses(cache, enrolledCourseIds(studentId));
+
+    QList<StudentClash> clashes;
+    for (int i = 0; i < courses.size(); ++i) {
+        const CourseData &a = courses.at(i);
+        const quint16 maskA = OccupancyIndex::slotRangeMask(a.startSlot, a.endSlot);
+        for (int j = i + 1; j < courses.size(); ++j) {
+            const CourseData &b = courses.at(j);
+            if (a.dayOfWeek != b.dayOfWeek) continue;
+
+            const quint16 common = maskA & OccupancyIndex::slotRangeMask(b.startSlot, b.endSlot);
+            if (!common) continue;
+            const quint64 weeks = cache.occupancy.activeWeeks(a) & cache.occupancy.activeWeeks(b);
+            if (!weeks) continue;
+
+            StudentClash clash;
+            clash.first = a;
+            clash.second = b;
+            clash.slotMask = common;
+            clash.weeks = weeks;
+            clashes.append(clash);
+        }
+    }
+    return clashes;
+}
+
+QHash<int, int> CourseManager::enrollmentCounts()
+{
+    QHash<int, int> counts;
+    QSqlQuery query;
+    query.prepare("SELECT e.course_id, COUNT(*) FROM enrollments e "
+                  "JOIN courses c ON c.id = e.course_id "
+                  "WHERE c.semester = ? GROUP BY e.course_id");
+    query.addBindValue(m_currentSemester);
+    if (!query.exec()) {
+        qDebug() << "Failed to count enrollments:" << query.lastError().text();
+        return counts;
+    }
+    while (query.next()) {
+        counts.insert(query.value(0).toInt(), query.value(1).toInt());
+    }
+    return counts;
+}
+
+QList<QVector<int>> CourseManager::sharedStudentGroups()
+{
+    QList<QVector<int>> groups;
+    QSqlQuery query;
+    query.prepare("SELECT e.student_id, e.course_id FROM enrollments e "
+                  "JOIN courses c ON c.id = e.course_id "
+                  "WHERE c.semester = ? ORDER BY e.student_id, e.course_id");
+    query.addBindValue(m_currentSemester);
+    if (!query.exec()) {
+        qDebug() << "Failed to load enrollment groups:" << query.lastError().text();
+        return groups;
+    }
+
+    // 同班学生的选课往往完全相同，相同的组合只保留一份
+    QSet<QVector<int>> seen;
+    QVector<int> current;
+    int currentStudent = -1;
+    auto flush = [&]() {
+        if (current.size() > 1 && !seen.contains(current)) {
+            seen.insert(current);
+            groups.append(current);
+        }
+        current.clear();
+    };
+    while (query.next()) {
+        const int student = query.value(0).toInt();
+        if (student != currentStudent) {
+            flush();
+            currentStudent = student;
+        }
+        current.append(query.value(1).toInt());
+    }
+    flush();
+    return groups;
+}
+
+bool CourseManager::beginScenario(const QString &name)
+{
+    if (m_scenario) return false;
+
+    // 复制的是隐式共享的容器，此时不复制任何课程数据
+    SemesterCache &live = cacheFor(m_currentSemester);
+    m_scenario.reset(new Scenario);
+    m_scenario->name = name.trimmed().isEmpty() ? QString("未命名方案") : name.trimmed();
+    m_scenario->semester = m_currentSemester;
+    m_scenario->cache = live;
+
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::isScenarioActive() const
+{
+    return m_scenario != nullptr;
+}
+
+QString CourseManager::scenarioName() const
+{
+    return m_scenario ? m_scenario->name : QString();
+}
+
+int CourseManager::scenarioChangeCount() const
+{
+    if (!m_scenario) return 0;
+    return m_scenario->added.size() + m_scenario->updated.size() + m_scenario->deleted.size();
+}
+
+QStringList CourseManager::scenarioChanges() const
+{
+    QStringList changes;
+    if (!m_scenario) return changes;
+
+    static const QStringList dayNames = {"周一", "周二", "周三", "周四", "周五", "周六", "周日"};
+    auto when = [](const CourseData &course) {
+        return QString("%1 第%2-%3节 %4").arg(dayNames.value(course.dayOfWeek - 1))
+            .arg(course.startSlot).arg(course.endSlot).arg(course.location);
+    };
+
+    for (const CourseData &course : m_scenario->added) {
+        changes << QString("➕ 新增「%1」：%2").arg(course.name, when(course));
+    }
+    for (const CourseData &course : m_scenario->updated) {
+        changes << QString("✏️ 修改「%1」：%2").arg(course.name, when(course));
+    }
+    for (const CourseData &course : m_scenario->deleted) {
+        changes << QString("🗑️ 删除「%1」").arg(course.name);
+    }
+    return changes;
+}
+
+bool CourseManager::stageCourse(const CourseData &course)
+{
+    if (m_scenario->semester != m_currentSemester) {
+        qDebug() << "Scenario" << m_scenario->name << "only covers semester" << m_scenario->semester;
+        return false;
+    }
+    if (course.id >= 0 && !m_scenario->cache.courses.contains(course.id)) {
+        qDebug() << "Course" << course.id << "is not part of the scenario";
+        return false;
+    }
+
+    CourseData staged = course;
+    staged.roomId = -1; // 提交时再关联教室
+    if (staged.id < 0) {
+        m_scenario->added.insert(staged.id, staged);
+    } else {
+        m_scenario->updated.insert(staged.id, staged);
+    }
+
+    unindexCourse(staged.id);
+    indexCourse(m_scenario->semester, staged);
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::stageDeletion(int courseId)
+{
+    auto it = m_scenario->cache.courses.constFind(courseId);
+    if (it == m_scenario->cache.courses.constEnd()) return false;
+
+    if (courseId < 0) {
+        m_scenario->added.remove(courseId);
+    } else {
+        m_scenario->updated.remove(courseId);
+        m_scenario->deleted.insert(courseId, it.value());
+    }
+
+    unindexCourse(courseId);
+    emit dataChanged();
+    return true;
+}
+
+bool CourseManager::commitScenario()
+{
+    if (!m_scenario) return false;
+
+    QSqlDatabase::database().transaction();
+
+    QSqlQuery query;
+    bool ok = true;
+    const QString semester = m_scenario->semester;
+    for (auto it = m_scenario->deleted.constBegin(); ok && it != m_scenario->deleted.constEnd(); ++it) {
+        // 删除前的状态以数据库为准，方案中保存的副本可能已被方案内的修改改动过
+        const CourseData before = loadCourseById(it.key());
+        const QVector<int> students = enrolledStudentIds(it.key());
+        query.prepare("DELETE FROM enrollments WHERE course_id=?");
+        query.addBindValue(it.key());
+        ok = query.exec();
+        if (ok) {
+            query.prepare("DELETE FROM courses WHERE id=?");
+            query.addBindValue(it.key());
+            ok = query.exec();
+        }
+        if (ok) recordChange(semester, before, CourseData(), students);
+    }
+
+    for (auto it = m_scenario->updated.constBegin(); ok && it != m_scenario->updated.constEnd(); ++it) {
+        const CourseData &course = it.value();
+        recordChange(semester, loadCourseById(course.id), course);
+        const int roomId = roomIdFor(course.location);
+        query.prepare(
+            "UPDATE courses SET name=?, day_of_week=?, start_slot=?, end_slot=?, "
+            "location=?, start_date=?, end_date=?, teacher=?, exam_date=?, course_type=?, credits=?, week_mask=?, room_id=? WHERE id=?"
+            );
+        bindCourseFields(query, course, roomId);
+        query.addBindValue(course.id);
+        ok = query.exec();
+    }
+
+    for (auto it = m_scenario->added.constBegin(); ok && it != m_scenario->added.constEnd(); ++it) {
+        const CourseData &course = it.value();
+        const int roomId = roomIdFor(course.location);
+        query.prepare(
+            "INSERT INTO courses (name, day_of_week, start_slot, end_slot, location, "
+            "start_date, end_date, teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+            );
+        bindCourseFields(query, course, roomId);
+        query.addBindValue(m_scenario->semester);
+        ok = query.exec();
+        if (ok) {
+            CourseData stored = course;
+            stored.id = query.lastInsertId().toInt();
+            recordChange(semester, CourseData(), stored);
+        }
+    }
+
+    if (ok) ok = flushChanges(QString("提交方案「%1」").arg(m_scenario->name));
+    if (!ok || !QSqlDatabase::database().commit()) {
+        qDebug() << "Failed to commit scenario:" << query.lastError().text();
+        rollbackChanges();
+        return false;
+    }
+
+    // 新课程的正式 id 由数据库分配，直接丢弃该学期的缓存，下次查询时重建
+    m_scenario.reset();
+    m_caches.remove(semester);
+    m_cacheOrder.removeOne(semester);
+    m_enrollments.clear();
+    finishChanges();
+    emit dataChanged();
+    return true;
+}
+
+void CourseManager::discardScenario()
+{
+    if (!m_scenario) return;
 
-    QFile::copy(dataPath + "/coursemanager.db", backupPath);
-    return QFile::exists(backupPath);
+    m_scenario.reset();
+    emit dataChanged();
 }
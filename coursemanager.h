@@ -7,7 +7,17 @@
 #include <QSqlError>
 #include <QList>
 #include <QDate>
+#include <QTime>
 #include <QColor>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <memory>
+#include "occupancyindex.h"
+#include "dateintervalindex.h"
+#include "coursehistory.h"
+#include "coursejournal.h"
+#include "jsonlines.h"
 
 class CourseData
 {
@@ -24,49 +34,368 @@ public:
     QDate examDate;
     QString courseType;
     double credits;
+    quint32 weekMask; // 第 i 位表示第 i+1 个教学周是否上课，支持 1-32 周
+    int roomId;       // rooms 表中的教室，-1 表示地点不在教室库中
 
-    CourseData() : id(-1), dayOfWeek(1), startSlot(1), endSlot(1), credits(0) {}
+    static constexpr quint32 AllWeeks = 0xFFFFFFFFu;
+    static constexpr int MaxMaskWeeks = 32;
+    enum WeekParity { EveryWeek, OddWeeks, EvenWeeks };
+
+    CourseData() : id(-1), dayOfWeek(1), startSlot(1), endSlot(1), credits(0), weekMask(AllWeeks), roomId(-1) {}
     CourseData(const QString& name, int day, int start, int end, const QString& loc,
                const QDate& startDate, const QDate& endDate, const QString& teacher = "",
                const QDate& examDate = QDate(), const QString& courseType = "必修", double credits = 0)
         : id(-1), name(name), dayOfWeek(day), startSlot(start), endSlot(end),
         location(loc), startDate(startDate), endDate(endDate), teacher(teacher),
-        examDate(examDate), courseType(courseType), credits(credits) {}
+        examDate(examDate), courseType(courseType), credits(credits), weekMask(AllWeeks), roomId(-1) {}
+
+    bool occursInWeek(int week) const
+    {
+        if (week < 1 || week > MaxMaskWeeks) return weekMask == AllWeeks;
+        return (weekMask >> (week - 1)) & 1u;
+    }
+
+    static quint32 makeWeekMask(int startWeek, int endWeek, WeekParity parity = EveryWeek);
+    static void decodeWeekMask(quint32 mask, int *startWeek, int *endWeek, WeekParity *parity);
+    QString weekPatternText() const;
+};
+
+// 教室库中的一间教室
+struct RoomData
+{
+    int id = -1;
+    QString name;           // 与课程的 location 一致，例如 "厚德楼 B601"
+    QString building;
+    int capacity = 0;       // 0 表示未登记容量
+    QStringList features;   // 设备，例如 投影、机房
+
+    bool hasFeatures(const QStringList &required) const
+    {
+        for (const QString &feature : required) {
+            if (!features.contains(feature)) return false;
+        }
+        return true;
+    }
+};
+
+// 学生信息，选课关系保存在 enrollments 表中
+struct StudentData
+{
+    int id = -1;
+    QString studentNo;      // 学号，唯一
+    QString name;
+    QString className;
+};
+
+// 同一学生所选的两门课程在同一时间上课
+struct StudentClash
+{
+    CourseData first;
+    CourseData second;
+    quint16 slotMask = 0;  // 重叠的节次位
+    quint64 weeks = 0;     // 重叠的周次位
+};
+
+// 候选课程与已有课程之间的冲突：同一时间占用同一教室或同一教师
+struct CourseConflict
+{
+    CourseData other;
+    bool sameRoom = false;
+    bool sameTeacher = false;
+    quint16 slotMask = 0;  // 冲突的节次位（第 i 位 = 第 i+1 节）
+    quint64 weeks = 0;     // 冲突的周次位（第 i 位 = 第 i+1 周）
+
+    int firstWeek() const;
+    QString description() const;
+};
+
+// 空闲时段查询条件；教室和教师为空表示不限制，星期为 0 表示任意一天
+struct FreeSlotQuery
+{
+    QString room;
+    QString teacher;
+    int duration = 2;       // 连续节数
+    int dayOfWeek = 0;
+    int earliestSlot = 1;
+    int latestSlot = 10;    // 时段必须在这一节之前结束
+    QDate from;             // 为空时取学期开始/结束日期
+    QDate to;
+    int maxResults = 20;
 };
 
-class CourseManager : public QObject
+// 一个候选时段：在查询范围内的 totalWeeks 周中有 freeWeeks 周空闲
+struct FreeSlot
+{
+    int dayOfWeek = 1;
+    int startSlot = 1;
+    int endSlot = 1;
+    int freeWeeks = 0;
+    int totalWeeks = 0;
+    quint64 weeks = 0;      // 空闲的周次位（第 i 位 = 第 i+1 周）
+    int load = 0;           // 该时段全校已排课程的节次总数，越小越清静
+
+    bool isFullyFree() const { return freeWeeks == totalWeeks; }
+};
+
+// 学分与课时汇总，随课程增删改增量维护。
+// 学分以百分之一为单位累计为整数，反复增减不会产生浮点误差
+struct CreditSummary
+{
+    struct Bucket {
+        int courseCount = 0;
+        qint64 creditCents = 0;
+        int slotCount = 0;   // 每周节数
+
+        double credits() const { return creditCents / 100.0; }
+    };
+
+    Bucket total;
+    QHash<QString, Bucket> byType;
+    QHash<QString, Bucket> byTeacher;
+    Bucket byWeekday[7];     // 下标 0 = 周一
+
+    void apply(const CourseData &course, int delta); // delta 为 +1 添加，-1 移除
+    void clear();
+};
+
+// 日历导入结果：events 为展开重复规则前的事件数，skipped 为未导入的原因
+struct IcsImportReport
+{
+    int events = 0;
+    int courses = 0;      // 新增课程数
+    int exams = 0;        // 写入的考试日期
+    int duplicates = 0;   // 与本学期已有课程相同而跳过的
+    QStringList skipped;
+};
+
+// 课程数据在内存中的占用情况（估算值，单位字节）
+struct MemoryUsage
+{
+    qint64 courseBytes = 0;   // 缓存的课程记录
+    qint64 stringBytes = 0;   // 字符串池中的去重字符串
+    qint64 indexBytes = 0;    // 占用位图与日期区间索引
+    int cachedSemesters = 0;
+    int cachedCourses = 0;
+    int pooledStrings = 0;
+
+    qint64 total() const { return courseBytes + stringBytes + indexBytes; }
+};
+
+// 课程表界面读取课程的接口：平时由 CourseManager 基于数据库提供，
+// 只读浏览模式下由内存映射的学期快照提供，界面不关心数据来自哪里
+class CourseSource
+{
+public:
+    virtual ~CourseSource() = default;
+
+    virtual bool isReadOnly() const = 0;
+    virtual QString getCurrentSemester() const = 0;
+    virtual QDate getSemesterStartDate() const = 0;
+    virtual QDate getSemesterEndDate() const = 0;
+    virtual int getSemesterWeeks() const = 0;
+    virtual int getWeekNumber(const QDate &date) const = 0;
+    virtual QList<CourseData> getCoursesByWeek(const QDate &date) = 0;
+    virtual QList<CourseData> getAllCourses() = 0;
+    virtual QList<CourseData> searchCourses(const QString &keyword) = 0;
+    virtual CourseData getCourseById(int id) = 0;
+};
+
+class CourseManager : public QObject, public CourseSource
 {
     Q_OBJECT
 
 public:
     explicit CourseManager(QObject *parent = nullptr);
     ~CourseManager();
-    int getSemesterWeeks() const;
+    bool isReadOnly() const override { return false; }
+    int getSemesterWeeks() const override;
     bool initDatabase();
     bool addCourse(const CourseData &course);
     bool updateCourse(const CourseData &course);
+    bool updateCourses(const QList<CourseData> &courses); // 单个事务批量更新，任一失败则全部回滚
     bool deleteCourse(int id);
-    QList<CourseData> getCoursesByWeek(const QDate &date);
-    QList<CourseData> getAllCourses();
-    QList<CourseData> searchCourses(const QString &keyword);
-    CourseData getCourseById(int id);
+    QList<CourseData> getCoursesByWeek(const QDate &date) override;
+    QList<CourseData> getCoursesInRange(const QDate &from, const QDate &to);
+    QList<CourseData> getCoursesOnDate(const QDate &date);
+    QList<CourseData> getAllCourses() override;
+    QList<CourseData> searchCourses(const QString &keyword) override;
+    CourseData getCourseById(int id) override;
 
     bool setCurrentSemester(const QString &semester);
     bool setSemester(const QString &name, const QDate &start, const QDate &end);
-    QString getCurrentSemester() const;
-    QDate getSemesterStartDate() const;
-    QDate getSemesterEndDate() const;
+    QString getCurrentSemester() const override;
+    QDate getSemesterStartDate() const override;
+    QDate getSemesterEndDate() const override;
+    int getWeekNumber(const QDate &date) const override; // 学期第几周，从 1 开始；学期开始前返回 0
+
+    // 作息时间表，slot 取 1-10
+    static QTime slotStartTime(int slot);
+    static QTime slotEndTime(int slot);
 
-    bool exportToCsv(const QString &filePath);
+    QStringList getSemesters();
+    QString databasePath() const;
+
+    bool exportToCsv(const QString &filePath); // 当前学期，同步导出；后台导出见 CsvExporter
+    // 导出当前学期为 iCalendar：每门课一个带 RRULE 的每周重复事件，考试为全天事件
+    bool exportToIcs(const QString &filePath, bool includeExams = true);
     bool importFromCsv(const QString &filePath);
-    bool createBackup();
+    // JSON Lines：同步版本，后台导入导出见 JsonLines。导入记为修改日志的一个批次，撤销栈被清空
+    bool exportToJsonLines(const QString &filePath, const QStringList &semesters = QStringList());
+    bool importFromJsonLines(const QString &filePath, bool replaceSemesters = false, JsonLines::Result *report = nullptr);
+    // 导入 iCalendar：展开 RRULE/EXDATE，按作息时间表映射到节次，
+    // 同一课程的各次上课合并为一行课程，全部在一个事务中写入
+    bool importFromIcs(const QString &filePath, IcsImportReport *report = nullptr);
+    bool createBackup(); // 在线备份并校验完整性，见 DatabaseBackup
+    QString nextBackupPath() const;
+    QString backupChainDirectory() const;
+    // 从备份链还原整个数据库：先还原到临时文件并校验，再替换当前数据库并重新打开
+    bool restoreBackup(const QString &snapshotId, QString *error = nullptr);
+    // 学期快照：当前学期（含未提交的假设方案）写成二进制快照；
+    // 导入时按快照中的学期名建立或更新学期，并在一个事务中整体替换该学期的课程
+    bool exportSnapshot(const QString &filePath, bool compress = false);
+    bool importSnapshot(const QString &filePath, int *imported = nullptr);
+
+    // 占用位图查询：按学期惰性构建，增删改课程时增量维护
+    const OccupancyIndex &occupancyIndex();
+    bool isSlotFree(const QDate &date, int slot);
+    bool isRoomFree(const QString &room, const QDate &date, int slot);
+    bool isTeacherFree(const QString &teacher, const QDate &date, int slot);
+
+    // 教室库：课程通过 room_id 关联教室，地点文本仍保留用于显示和搜索
+    QList<RoomData> getRooms();
+    bool saveRoom(RoomData &room);   // id 为 -1 时新增
+    bool deleteRoom(int id);         // 关联课程的 room_id 置空，地点文本保留
+    // 为没有地点的课程分配教室：人数多的先排，每门课取容量足够、设备齐全且全程空闲的最小教室
+    QList<CourseData> assignRooms(const QList<CourseData> &courses, const QHash<int, int> &courseSize,
+                                  const QHash<int, QStringList> &requiredFeatures, QStringList *unassigned);
+
+    // 学生与选课：选课关系按学生惰性缓存，切换周次时只在内存中过滤
+    QList<StudentData> getStudents(const QString &keyword = QString());
+    bool saveStudent(StudentData &student);  // id 为 -1 时新增
+    bool deleteStudent(int id);              // 同时删除其选课记录
+    QVector<int> enrolledCourseIds(int studentId);
+    bool setEnrollments(int studentId, const QVector<int> &courseIds); // 整体替换该学生的选课
+    bool enrollStudents(int courseId, const QVector<int> &studentIds);
+    QList<CourseData> getStudentCoursesByWeek(int studentId, const QDate &date);
+    QList<StudentClash> findStudentClashes(int studentId);
+    QHash<int, int> enrollmentCounts();         // 本学期课程 id -> 选课人数
+    QList<QVector<int>> sharedStudentGroups();  // 本学期每位学生所选课程的 id，已去重
+
+    // 当前学期的学分与课时汇总，随学期缓存一起增量维护
+    const CreditSummary &creditSummary();
+
+    // 假设方案：在当前学期之上叠加一层只存在于内存中的修改。
+    // 开始后课程的增删改只写入方案，周课表、冲突检测等查询都读取叠加后的结果；
+    // 提交时在一个事务中写回数据库，放弃则直接丢弃，数据库始终不受影响
+    bool beginScenario(const QString &name);
+    bool isScenarioActive() const;
+    QString scenarioName() const;
+    int scenarioChangeCount() const;
+    QStringList scenarioChanges() const;
+    bool commitScenario();
+    void discardScenario();
+
+    // 修改日志：每次课程增删改都在同一事务中追加日志，可撤销最近的操作或恢复到某个时间点。
+    // 撤销/恢复会删除被撤回的日志记录；选课记录和教室、学生资料不在日志范围内
+    QList<CourseJournal::Operation> journalOperations(int limit = 200) const;
+    QDateTime journalEarliestTime() const;
+    bool undoLastOperation(QString *summary = nullptr);
+    bool revertToOperation(qint64 batch);       // 撤回该操作及之后的全部操作
+    bool restoreToTime(const QDateTime &time);  // 撤回 time 之后的全部操作
+    int compactJournal();
+
+    // 撤销/重做：本次运行中的修改按操作压栈，撤销和重做各在一个事务中完成并写入修改日志。
+    // touched 返回受影响课程修改前后的内容，界面据此只刷新相关的格子。假设方案进行中不可用
+    bool canUndo() const;
+    bool canRedo() const;
+    QString undoText() const;
+    QString redoText() const;
+    bool undo(QList<CourseData> *touched = nullptr);
+    bool redo(QList<CourseData> *touched = nullptr);
+
+    // 冲突检测：基于占用位图快速排除，再只在同教室/同教师的课程中逐一比较
+    QList<CourseConflict> findConflicts(const CourseData &candidate);
+
+    // 空闲时段：直接读取占用位图，按空闲周数、全校负载、时间先后排序
+    QList<FreeSlot> findFreeSlots(const FreeSlotQuery &query);
+
+    // 内存统计与预算：超出预算时按最久未使用的顺序淘汰学期缓存
+    MemoryUsage memoryUsage() const;
+    void setMemoryBudget(qint64 bytes); // 0 表示不限制
+    qint64 memoryBudget() const;
+    void clearCaches();
+    // 数据库被其他连接整批修改后（如后台导入）调用：丢弃全部缓存和撤销记录
+    void reloadFromDatabase();
+
+signals:
+    void dataChanged(); // 课程、学期或教室被修改，依赖课程数据的统计应失效
 
 private:
     QSqlDatabase m_db;
     QString m_currentSemester;
 
+    // 已加载学期的内存缓存：课程数据 + 占用位图 + 日期区间索引
+    struct SemesterCache {
+        QHash<int, CourseData> courses;
+        QSet<QString> strings; // 地点、教师、类型等重复字符串的去重池
+        QHash<QString, QVector<int>> roomCourses;    // 教室 -> 课程 id
+        QHash<QString, QVector<int>> teacherCourses; // 教师 -> 课程 id
+        OccupancyIndex occupancy;
+        DateIntervalIndex dates;
+        CreditSummary totals;
+    };
+    QHash<QString, SemesterCache> m_caches;
+
+    // 方案复制学期缓存时只共享数据（Qt 容器写时复制），修改到哪部分才复制哪部分
+    struct Scenario {
+        QString name;
+        QString semester;
+        SemesterCache cache;
+        QHash<int, CourseData> added;    // 临时 id（-2 起递减）-> 新课程
+        QHash<int, CourseData> updated;  // 已有课程 id -> 修改后的课程
+        QHash<int, CourseData> deleted;  // 已有课程 id -> 删除前的课程
+        int nextTempId = -2;             // -1 是“无课程”的标记，临时 id 从 -2 开始
+    };
+    std::unique_ptr<Scenario> m_scenario;
+    QStringList m_cacheOrder; // 最近使用的学期排在最后
+    qint64 m_memoryBudget;
+    QHash<QString, int> m_roomIds; // 教室名 -> id，惰性加载
+    QHash<int, QVector<int>> m_enrollments; // 学生 id -> 所选课程 id，惰性加载
+    CourseJournal m_journal;
+    CourseHistory m_history;
+    QList<CourseHistory::Change> m_pendingChanges; // 当前事务中尚未提交的修改
+    QString m_pendingSummary;
+
     bool createTables();
     bool upgradeDatabase();
+    int roomIdFor(const QString &location);
+    bool semesterRange(const QString &semester, QDate *start, QDate *end) const;
+    bool writeSemester(const QString &name, const QDate &start, const QDate &end); // 在事务内调用
+    QList<CourseData> loadCourses(const QString &semester);
+    SemesterCache &cacheFor(const QString &semester);
+    static QList<CourseData> sortedCourses(const SemesterCache &cache, const QVector<int> &ids);
+    static void internStrings(SemesterCache &cache, CourseData &course);
+    static void addToBuckets(SemesterCache &cache, const CourseData &course);
+    static void removeFromBuckets(SemesterCache &cache, const CourseData &course);
+    static qint64 cacheBytes(const SemesterCache &cache, MemoryUsage *usage);
+    void enforceMemoryBudget(const QString &keep = QString()); // keep 指定的学期不淘汰
+    void indexCourse(const QString &semester, const CourseData &course);
+    QString unindexCourse(int courseId);
+    static bool removeFromCache(SemesterCache &cache, int courseId);
+    static void bindCourseFields(QSqlQuery &query, const CourseData &course, int roomId);
+    CourseData loadCourseById(int id, QString *semester = nullptr); // 直接读数据库，不经过假设方案
+    bool revertJournal(qint64 batch);
+    // 修改的统一入口：同时写入日志和撤销栈。before/after 的 id 为 -1 分别表示新增/删除
+    void recordChange(const QString &semester, const CourseData &before, const CourseData &after,
+                      const QVector<int> &students = QVector<int>());
+    bool flushChanges(const QString &summary); // 在事务内调用
+    void discardChanges();
+    void rollbackChanges();                    // 回滚当前事务，并丢弃日志记录和教室 id 缓存
+    void finishChanges();                      // 事务提交后调用
+    QVector<int> enrolledStudentIds(int courseId);
+    bool applyHistory(const CourseHistory::Command &command, bool undo, QList<CourseData> *touched);
+    bool stageCourse(const CourseData &course);
+    bool stageDeletion(int courseId);
 };
 
 #endif // COURSEMANAGER_H
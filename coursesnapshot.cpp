@@ -0,0 +1,293 @@
+#include "coursesnapshot.h"
+#include "coursemanager.h"
+#include <QDebug>
+#include <QHash>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <cstring>
+
+namespace {
+
+const char Magic[8] = {'S', 'M', 'S', 'N', 'A', 'P', '\x1a', '\n'};
+
+static_assert(sizeof(CourseSnapshot::Header) == 64, "snapshot header layout changed");
+static_assert(sizeof(CourseSnapshot::Record) == 44, "snapshot record layout changed");
+
+qint32 toJulian(const QDate &date)
+{
+    return date.isValid() ? qint32(date.toJulianDay()) : 0;
+}
+
+QDate fromJulian(qint64 day)
+{
+    return day ? QDate::fromJulianDay(day) : QDate();
+}
+
+} // namespace
+
+CourseSnapshot::CourseSnapshot()
+    : m_map(nullptr), m_records(nullptr), m_offsets(nullptr), m_strings(nullptr)
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+CourseSnapshot::~CourseSnapshot()
+{
+    close();
+}
+
+bool CourseSnapshot::write(const QString &filePath, const QString &semester, const QDate &start, const QDate &end,
+                           const QList<CourseData> &courses, bool compress, QString *error)
+{
+    // 字符串表：下标 0 为空串，其余按首次出现的顺序编号
+    QHash<QString, quint32> ids;
+    QByteArray strings;
+    QVector<quint32> offsets;
+    offsets.reserve(courses.size() / 4 + 16);
+    offsets.append(0);
+    ids.insert(QString(), 0);
+    offsets.append(0);
+    auto intern = [&](const QString &text) {
+        auto it = ids.constFind(text);
+        if (it != ids.constEnd()) return it.value();
+        const quint32 id = quint32(offsets.size() - 1);
+        strings.append(text.toUtf8());
+        offsets.append(quint32(strings.size()));
+        ids.insert(text, id);
+        return id;
+    };
+
+    QVector<Record> records;
+    records.reserve(courses.size());
+    for (const CourseData &course : courses) {
+        Record record;
+        std::memset(&record, 0, sizeof(record));
+        record.id = course.id;
+        record.name = intern(course.name);
+        record.location = intern(course.location);
+        record.teacher = intern(course.teacher);
+        record.courseType = intern(course.courseType);
+        record.startDate = toJulian(course.startDate);
+        record.endDate = toJulian(course.endDate);
+        record.examDate = toJulian(course.examDate);
+        record.weekMask = course.weekMask;
+        record.creditCents = qRound(course.credits * 100);
+        record.dayOfWeek = quint8(course.dayOfWeek);
+        record.startSlot = quint8(course.startSlot);
+        record.endSlot = quint8(course.endSlot);
+        records.append(record);
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.headerSize = sizeof(Header);
+    header.courseCount = quint32(records.size());
+    header.semesterName = intern(semester);
+    header.stringCount = quint32(offsets.size() - 1);
+    header.stringBytes = quint32(strings.size());
+    header.semesterStart = toJulian(start);
+    header.semesterEnd = toJulian(end);
+
+    QByteArray payload;
+    payload.reserve(records.size() * int(sizeof(Record)) + offsets.size() * 4 + strings.size());
+    payload.append(reinterpret_cast<const char *>(records.constData()), records.size() * int(sizeof(Record)));
+    payload.append(reinterpret_cast<const char *>(offsets.constData()), offsets.size() * 4);
+    payload.append(strings);
+    header.payloadSize = quint64(payload.size());
+
+    if (compress) {
+        payload = qCompress(payload);
+        header.flags |= Compressed;
+    }
+    header.storedSize = quint64(payload.size());
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || file.write(payload) != payload.size()
+        || !file.commit()) {
+        if (error) *error = file.errorString();
+        qDebug() << "Failed to write snapshot:" << file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool CourseSnapshot::open(const QString &filePath)
+{
+    close();
+
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian) {
+        return fail("快照按小端序存储，当前平台不支持");
+    }
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return fail(m_file.errorString());
+    }
+    if (m_file.read(reinterpret_cast<char *>(&m_header), sizeof(m_header)) != qint64(sizeof(m_header))
+        || std::memcmp(m_header.magic, Magic, sizeof(Magic)) != 0) {
+        return fail("不是课程快照文件");
+    }
+    if (m_header.version > Version || m_header.headerSize < sizeof(Header)) {
+        return fail(QString("不支持的快照版本 %1").arg(m_header.version));
+    }
+
+    // 只做 O(1) 的大小校验，保证之后按下标访问不会越界
+    const quint64 expected = quint64(m_header.courseCount) * sizeof(Record)
+                             + (quint64(m_header.stringCount) + 1) * 4 + m_header.stringBytes;
+    if (m_header.payloadSize != expected
+        || quint64(m_file.size()) < m_header.headerSize + m_header.storedSize) {
+        return fail("快照文件已损坏");
+    }
+
+    const uchar *payload = nullptr;
+    if (m_header.flags & Compressed) {
+        m_file.seek(m_header.headerSize);
+        m_payload = qUncompress(m_file.read(qint64(m_header.storedSize)));
+        if (quint64(m_payload.size()) != m_header.payloadSize) {
+            return fail("快照解压失败");
+        }
+        payload = reinterpret_cast<const uchar *>(m_payload.constData());
+    } else if (m_header.payloadSize > 0) {
+        m_map = m_file.map(m_header.headerSize, qint64(m_header.payloadSize));
+        if (!m_map) {
+            // 某些文件系统不支持映射，退回一次性读入
+            m_file.seek(m_header.headerSize);
+            m_payload = m_file.read(qint64(m_header.payloadSize));
+            if (quint64(m_payload.size()) != m_header.payloadSize) {
+                return fail(m_file.errorString());
+            }
+            payload = reinterpret_cast<const uchar *>(m_payload.constData());
+        } else {
+            payload = m_map;
+        }
+    }
+
+    m_records = reinterpret_cast<const Record *>(payload);
+    m_offsets = reinterpret_cast<const quint32 *>(payload + quint64(m_header.courseCount) * sizeof(Record));
+    m_strings = reinterpret_cast<const char *>(m_offsets + m_header.stringCount + 1);
+    if (m_offsets[m_header.stringCount] != m_header.stringBytes) {
+        return fail("快照文件已损坏");
+    }
+    return true;
+}
+
+void CourseSnapshot::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_payload.clear();
+    m_records = nullptr;
+    m_offsets = nullptr;
+    m_strings = nullptr;
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+bool CourseSnapshot::isOpen() const
+{
+    return m_offsets != nullptr;
+}
+
+bool CourseSnapshot::isMapped() const
+{
+    return m_map != nullptr;
+}
+
+QString CourseSnapshot::errorString() const
+{
+    return m_error;
+}
+
+bool CourseSnapshot::fail(const QString &message)
+{
+    close();
+    m_error = message;
+    qDebug() << "Failed to open snapshot:" << message;
+    return false;
+}
+
+QString CourseSnapshot::semesterName() const
+{
+    return string(m_header.semesterName);
+}
+
+QDate CourseSnapshot::semesterStart() const
+{
+    return fromJulian(m_header.semesterStart);
+}
+
+QDate CourseSnapshot::semesterEnd() const
+{
+    return fromJulian(m_header.semesterEnd);
+}
+
+int CourseSnapshot::courseCount() const
+{
+    return int(m_header.courseCount);
+}
+
+const CourseSnapshot::Record &CourseSnapshot::record(int index) const
+{
+    Q_ASSERT(index >= 0 && index < courseCount());
+    return m_records[index];
+}
+
+QString CourseSnapshot::string(quint32 index) const
+{
+    if (!isOpen() || index >= m_header.stringCount) return QString();
+    const quint32 begin = m_offsets[index];
+    const quint32 end = m_offsets[index + 1];
+    if (begin > end || end > m_header.stringBytes) return QString();
+    return QString::fromUtf8(m_strings + begin, int(end - begin));
+}
+
+CourseData CourseSnapshot::course(int index) const
+{
+    return toCourse(record(index), nullptr);
+}
+
+QList<CourseData> CourseSnapshot::courses() const
+{
+    QVector<QString> strings(int(m_header.stringCount));
+    for (quint32 i = 0; i < m_header.stringCount; ++i) {
+        strings[int(i)] = string(i);
+    }
+
+    QList<CourseData> result;
+    result.reserve(courseCount());
+    for (int i = 0; i < courseCount(); ++i) {
+        result.append(toCourse(m_records[i], &strings));
+    }
+    return result;
+}
+
+CourseData CourseSnapshot::toCourse(const Record &record, const QVector<QString> *strings) const
+{
+    auto text = [&](quint32 index) {
+        if (!strings) return string(index);
+        return index < quint32(strings->size()) ? strings->at(int(index)) : QString();
+    };
+
+    CourseData course;
+    course.id = record.id;
+    course.name = text(record.name);
+    course.location = text(record.location);
+    course.teacher = text(record.teacher);
+    course.courseType = text(record.courseType);
+    course.startDate = fromJulian(record.startDate);
+    course.endDate = fromJulian(record.endDate);
+    course.examDate = fromJulian(record.examDate);
+    course.weekMask = record.weekMask;
+    course.credits = record.creditCents / 100.0;
+    course.dayOfWeek = record.dayOfWeek;
+    course.startSlot = record.startSlot;
+    course.endSlot = record.endSlot;
+    return course;
+}
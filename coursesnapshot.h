@@ -0,0 +1,100 @@
+#ifndef COURSESNAPSHOT_H
+#define COURSESNAPSHOT_H
+
+#include <QByteArray>
+#include <QDate>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class CourseData;
+
+// 学期快照：一个学期的课程打包成单个二进制文件，用于在机器之间搬运或只读浏览。
+//
+// 文件布局（小端序）：
+//   Header（64 字节）
+//   负载：课程记录[courseCount]（每条 44 字节定长）
+//         字符串偏移[stringCount + 1]（quint32，相对字符串区开头）
+//         字符串区（UTF-8，不带结尾 0）
+// 课程名、地点、教师、类型都存字符串表下标，重复的字符串只存一次；下标 0 固定是空串。
+// 未压缩的快照直接映射到内存，打开时只校验文件头，读取时按下标取记录，不做任何解析；
+// 带 Compressed 标志的快照负载经 qCompress 压缩，打开时解压到内存后再同样访问。
+class CourseSnapshot
+{
+public:
+    static constexpr quint16 Version = 1;
+    enum Flag : quint16 { Compressed = 0x1 };
+
+    struct Header {
+        char magic[8];
+        quint16 version;
+        quint16 flags;
+        quint32 headerSize;
+        quint32 courseCount;
+        quint32 stringCount;
+        quint32 stringBytes;
+        quint32 semesterName;   // 字符串表下标
+        qint64 semesterStart;   // 儒略日
+        qint64 semesterEnd;
+        quint64 payloadSize;    // 未压缩的负载大小
+        quint64 storedSize;     // 文件中负载实际占用的大小
+    };
+
+    // 日期存儒略日，0 表示无效日期；学分以百分之一为单位
+    struct Record {
+        qint32 id;
+        quint32 name;
+        quint32 location;
+        quint32 teacher;
+        quint32 courseType;
+        qint32 startDate;
+        qint32 endDate;
+        qint32 examDate;
+        quint32 weekMask;
+        qint32 creditCents;
+        quint8 dayOfWeek;
+        quint8 startSlot;
+        quint8 endSlot;
+        quint8 reserved;
+    };
+
+    CourseSnapshot();
+    ~CourseSnapshot();
+
+    static bool write(const QString &filePath, const QString &semester, const QDate &start, const QDate &end,
+                      const QList<CourseData> &courses, bool compress, QString *error = nullptr);
+
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const;
+    bool isMapped() const; // 未压缩且直接映射文件，没有复制数据
+    QString errorString() const;
+
+    QString semesterName() const;
+    QDate semesterStart() const;
+    QDate semesterEnd() const;
+
+    int courseCount() const;
+    const Record &record(int index) const;
+    QString string(quint32 index) const;
+    CourseData course(int index) const;
+    QList<CourseData> courses() const; // 字符串表只解码一次，同名字符串共享数据
+
+private:
+    Q_DISABLE_COPY(CourseSnapshot)
+
+    bool fail(const QString &message);
+    CourseData toCourse(const Record &record, const QVector<QString> *strings) const;
+
+    QFile m_file;
+    uchar *m_map;
+    QByteArray m_payload;  // 压缩快照解压后的负载
+    Header m_header;
+    const Record *m_records;
+    const quint32 *m_offsets;
+    const char *m_strings;
+    QString m_error;
+};
+
+#endif // COURSESNAPSHOT_H
@@ -0,0 +1,148 @@
+#include "csvexporter.h"
+#include "backgroundio.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtConcurrent>
+
+namespace {
+
+const int ProgressStep = 2000; // 每写出这么多行报告一次进度
+
+} // namespace
+
+CsvExporter::CsvExporter(QObject *parent)
+    : QObject(parent), m_canceled(false)
+{
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, [this]() {
+        emit finished(m_watcher.result());
+    });
+}
+
+CsvExporter::~CsvExporter()
+{
+    cancel();
+    m_watcher.waitForFinished();
+}
+
+void CsvExporter::start(const QString &databasePath, const Options &options)
+{
+    if (isRunning()) {
+        cancel();
+        m_watcher.waitForFinished();
+    }
+
+    m_canceled = false;
+    m_watcher.setFuture(QtConcurrent::run([this, databasePath, options]() {
+        Result result;
+        BackgroundIo::withConnection(databasePath, "csv-export", [&](const QSqlDatabase &db) {
+            result = exportTo(db, options, [this](int done, int total) {
+                emit progressChanged(done, total);
+                return !m_canceled;
+            });
+        }, &result.error);
+        return result;
+    }));
+}
+
+void CsvExporter::cancel()
+{
+    m_canceled = true;
+}
+
+bool CsvExporter::isRunning() const
+{
+    return m_watcher.isRunning();
+}
+
+CsvExporter::Result CsvExporter::exportTo(const QSqlDatabase &db, const Options &options,
+                                          const ProgressCallback &progress)
+{
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString filter = BackgroundIo::inFilter("semester", options.semesters);
+    int total = 0;
+    QSqlQuery count(db);
+    count.prepare("SELECT COUNT(*) FROM courses" + filter);
+    for (const QString &semester : options.semesters) count.addBindValue(semester);
+    if (count.exec() && count.next()) total = count.value(0).toInt();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT name, day_of_week, start_slot, end_slot, location, start_date, end_date, "
+                  "teacher, exam_date, course_type, credits, semester FROM courses" + filter +
+                  " ORDER BY semester, day_of_week, start_slot");
+    for (const QString &semester : options.semesters) query.addBindValue(semester);
+    if (!query.exec()) {
+        result.error = query.lastError().text();
+        qDebug() << "Failed to query courses for export:" << result.error;
+        return result;
+    }
+
+    BackgroundIo::Writer file(options.filePath);
+    if (!file.open()) {
+        result.error = file.errorString();
+        return result;
+    }
+
+    QByteArray &buffer = file.buffer();
+    if (options.writeBom) buffer.append("\xEF\xBB\xBF");
+    buffer.append(QString("课程名称,星期,开始节次,结束节次,地点,开始日期,结束日期,教师,考试日期,课程类型,学分,学期\r\n").toUtf8());
+
+    bool ok = true;
+    QStringList fields;
+    fields.reserve(12);
+    while (ok && query.next()) {
+        fields.clear();
+        fields << quote(query.value(0).toString())
+               << query.value(1).toString()
+               << query.value(2).toString()
+               << query.value(3).toString()
+               << quote(query.value(4).toString())
+               << quote(query.value(5).toString())
+               << quote(query.value(6).toString())
+               << quote(query.value(7).toString())
+               << quote(query.value(8).toString())
+               << quote(query.value(9).toString())
+               << QString::number(query.value(10).toDouble())
+               << quote(query.value(11).toString());
+        buffer.append(fields.join(',').toUtf8());
+        buffer.append("\r\n");
+        ++result.rows;
+
+        ok = file.flushIfFull();
+        if (ok && progress && result.rows % ProgressStep == 0 && !progress(result.rows, total)) {
+            result.canceled = true;
+            ok = false;
+        }
+    }
+
+    if (ok && progress && !progress(result.rows, total)) {
+        result.canceled = true;
+        ok = false;
+    }
+
+    result.ok = file.finish(ok, result.canceled, &result.error);
+    result.bytes = file.bytes();
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+QString CsvExporter::quote(const QString &field)
+{
+    bool needsQuotes = false;
+    for (QChar ch : field) {
+        if (ch == ',' || ch == '"' || ch == '\n' || ch == '\r') {
+            needsQuotes = true;
+            break;
+        }
+    }
+    if (!needsQuotes) return field;
+
+    QString quoted = field;
+    quoted.replace("\"", "\"\"");
+    return "\"" + quoted + "\"";
+}
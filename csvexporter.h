@@ -0,0 +1,60 @@
+#ifndef CSVEXPORTER_H
+#define CSVEXPORTER_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+
+// 课程 CSV 导出。
+// 按 RFC 4180 写出：字段含逗号、引号或换行时加引号并把引号加倍，行尾为 CRLF。
+// 查询以只进游标逐行读取，经 1 MB 缓冲区写入 QSaveFile，不在内存中保留课程列表；
+// 取消或出错时临时文件被丢弃，目标文件保持原样。
+// 后台导出在线程池中使用独立的数据库连接，不占用界面线程。
+class CsvExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString filePath;
+        QStringList semesters;   // 为空表示全部学期
+        bool writeBom = false;   // 写入 UTF-8 BOM，便于 Excel 识别中文
+    };
+
+    struct Result {
+        bool ok = false;
+        bool canceled = false;
+        int rows = 0;
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+        QString error;
+    };
+
+    // 返回 false 表示取消导出
+    using ProgressCallback = std::function<bool(int done, int total)>;
+
+    explicit CsvExporter(QObject *parent = nullptr);
+    ~CsvExporter();
+
+    void start(const QString &databasePath, const Options &options);
+    void cancel();
+    bool isRunning() const;
+
+    // 同步导出，使用调用线程上已打开的连接
+    static Result exportTo(const QSqlDatabase &db, const Options &options,
+                           const ProgressCallback &progress = ProgressCallback());
+    static QString quote(const QString &field);
+
+signals:
+    void progressChanged(int done, int total);
+    void finished(const CsvExporter::Result &result);
+
+private:
+    QFutureWatcher<Result> m_watcher;
+    std::atomic<bool> m_canceled;
+};
+
+#endif // CSVEXPORTER_H
@@ -0,0 +1,147 @@
+#include "databasebackup.h"
+#include "backgroundio.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QtConcurrent>
+
+DatabaseBackup::DatabaseBackup(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, [this]() {
+        const Result result = m_watcher.result();
+        if (!result.ok) {
+            qDebug() << "Database backup failed:" << result.filePath << result.error;
+        }
+        emit finished(result);
+    });
+}
+
+DatabaseBackup::~DatabaseBackup()
+{
+    m_watcher.waitForFinished();
+}
+
+void DatabaseBackup::start(const QString &databasePath, const QString &backupPath)
+{
+    run(databasePath, [backupPath](const QSqlDatabase &db) {
+        return backupTo(db, backupPath);
+    });
+}
+
+void DatabaseBackup::startIncremental(const QString &databasePath, const QString &chainDirectory,
+                                      const BackupChain::Policy &policy)
+{
+    run(databasePath, [chainDirectory, policy](const QSqlDatabase &db) {
+        QElapsedTimer timer;
+        timer.start();
+
+        Result result;
+        BackupChain chain(chainDirectory);
+        BackupChain::Snapshot snapshot;
+        result.ok = chain.backup(db, &snapshot, &result.error);
+        if (result.ok) {
+            result.filePath = snapshot.id;
+            result.bytes = snapshot.size;
+            result.storedBytes = snapshot.storedBytes;
+            result.pruned = chain.prune(policy);
+        }
+        result.elapsedMs = timer.elapsed();
+        return result;
+    });
+}
+
+void DatabaseBackup::run(const QString &databasePath, const Job &job)
+{
+    if (isRunning()) {
+        return;
+    }
+
+    m_watcher.setFuture(QtConcurrent::run([databasePath, job]() {
+        Result result;
+        BackgroundIo::withConnection(databasePath, "backup", [&](const QSqlDatabase &db) {
+            result = job(db);
+        }, &result.error);
+        return result;
+    }));
+}
+
+bool DatabaseBackup::isRunning() const
+{
+    return m_watcher.isRunning();
+}
+
+DatabaseBackup::Result DatabaseBackup::backupTo(const QSqlDatabase &db, const QString &backupPath)
+{
+    Result result;
+    result.filePath = backupPath;
+    QElapsedTimer timer;
+    timer.start();
+
+    // VACUUM INTO 要求目标文件不存在
+    const QString partPath = backupPath + ".part";
+    QFile::remove(partPath);
+
+    QSqlQuery query(db);
+    query.prepare("VACUUM INTO ?");
+    query.addBindValue(partPath);
+    if (!query.exec()) {
+        result.error = query.lastError().text();
+        QFile::remove(partPath);
+        return result;
+    }
+
+    if (!verify(partPath, &result.error)) {
+        QFile::remove(partPath);
+        return result;
+    }
+
+    QFile::remove(backupPath);
+    if (!QFile::rename(partPath, backupPath)) {
+        result.error = "无法重命名备份文件";
+        QFile::remove(partPath);
+        return result;
+    }
+
+    result.ok = true;
+    result.bytes = QFileInfo(backupPath).size();
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+bool DatabaseBackup::verify(const QString &filePath, QString *error)
+{
+    const QString connection = QString("backup-verify-%1").arg(quintptr(QThread::currentThreadId()));
+    bool ok = false;
+    QString message;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection);
+        db.setDatabaseName(filePath);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        if (db.open()) {
+            {
+                // 完整性正常时只返回一行 "ok"，否则逐行列出问题
+                QSqlQuery query(db);
+                QStringList problems;
+                if (query.exec("PRAGMA integrity_check")) {
+                    while (query.next()) problems << query.value(0).toString();
+                    ok = problems == QStringList{"ok"};
+                    if (!ok) message = "备份完整性检查未通过: " + problems.join("; ");
+                } else {
+                    message = query.lastError().text();
+                }
+            }
+            db.close();
+        } else {
+            message = db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(connection);
+
+    if (error && !ok) *error = message;
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QSqlDatabase>
+#include <functional>
+#include "backupchain.h"
+
+// 数据库在线备份。
+// 用 VACUUM INTO 在一个读事务内把数据库写成新文件：拿到的是一致的快照，
+// 备份期间界面线程照常读写，不会像复制文件那样拷到写了一半的页。
+// 先写到 .part 临时文件，PRAGMA integrity_check 通过后才改成正式文件名，
+// 因此备份目录里只会出现校验过的完整备份。
+// startIncremental 走同样的后台线程，但写入去重的备份链，见 BackupChain。
+class DatabaseBackup : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        bool ok = false;
+        QString filePath;
+        qint64 bytes = 0;
+        qint64 storedBytes = 0;   // 增量备份实际新写入的字节数
+        int pruned = 0;           // 按保留策略删除的旧备份数
+        qint64 elapsedMs = 0;
+        QString error;
+    };
+
+    explicit DatabaseBackup(QObject *parent = nullptr);
+    ~DatabaseBackup();
+
+    // 在线程池中使用独立连接备份 databasePath，完成后发出 finished
+    void start(const QString &databasePath, const QString &backupPath);
+    // 写入备份链（只存新增的数据块），完成后按保留策略清理；filePath 为备份 id
+    void startIncremental(const QString &databasePath, const QString &chainDirectory,
+                          const BackupChain::Policy &policy = BackupChain::Policy());
+    bool isRunning() const;
+
+    // 同步备份，使用调用线程上已打开的连接
+    static Result backupTo(const QSqlDatabase &db, const QString &backupPath);
+    static bool verify(const QString &filePath, QString *error = nullptr);
+
+signals:
+    void finished(const DatabaseBackup::Result &result);
+
+private:
+    using Job = std::function<Result(const QSqlDatabase &db)>;
+    void run(const QString &databasePath, const Job &job);
+
+    QFutureWatcher<Result> m_watcher;
+};
+
+#endif // DATABASEBACKUP_H
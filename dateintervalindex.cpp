@@ -0,0 +1,162 @@
+#include "dateintervalindex.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+// 待合并/已删除的条目超过这个数量（或排序数组的 1/8）时重建
+const int kMinRebuildThreshold = 64;
+}
+
+DateIntervalIndex::DateIntervalIndex()
+{
+}
+
+void DateIntervalIndex::clear()
+{
+    m_sorted.clear();
+    m_maxEnd.clear();
+    m_pending.clear();
+    m_pendingSlot.clear();
+    m_removed.clear();
+    m_ids.clear();
+    m_invalid.clear();
+}
+
+void DateIntervalIndex::insert(int courseId, const QDate &start, const QDate &end)
+{
+    remove(courseId);
+    m_ids.insert(courseId);
+
+    if (!start.isValid() || !end.isValid()) {
+        m_invalid.insert(courseId);
+        return;
+    }
+
+    Entry entry;
+    entry.start = start.toJulianDay();
+    entry.end = end.toJulianDay();
+    entry.id = courseId;
+
+    m_pendingSlot.insert(courseId, m_pending.size());
+    m_pending.append(entry);
+}
+
+bool DateIntervalIndex::remove(int courseId)
+{
+    if (!m_ids.remove(courseId)) return false;
+    if (m_invalid.remove(courseId)) return true;
+
+    // 待合并列表无序：用最后一项填补空位，O(1) 删除
+    auto it = m_pendingSlot.find(courseId);
+    if (it != m_pendingSlot.end()) {
+        const int slot = it.value();
+        m_pendingSlot.erase(it);
+        const Entry last = m_pending.takeLast();
+        if (slot < m_pending.size()) {
+            m_pending[slot] = last;
+            m_pendingSlot[last.id] = slot;
+        }
+        return true;
+    }
+
+    m_removed.insert(courseId);
+    return true;
+}
+
+int DateIntervalIndex::size() const
+{
+    return m_ids.size();
+}
+
+qint64 DateIntervalIndex::memoryBytes() const
+{
+    const qint64 setNode = qint64(sizeof(int) + sizeof(void *));
+    return qint64(m_sorted.capacity() + m_pending.capacity()) * qint64(sizeof(Entry))
+           + qint64(m_maxEnd.capacity()) * qint64(sizeof(qint64))
+           + qint64(m_removed.size() + m_ids.size() + m_invalid.size()) * setNode
+           + qint64(m_pendingSlot.size()) * qint64(2 * sizeof(int) + sizeof(void *));
+}
+
+QVector<int> DateIntervalIndex::stab(const QDate &date) const
+{
+    return overlapping(date, date);
+}
+
+QVector<int> DateIntervalIndex::overlapping(const QDate &from, const QDate &to) const
+{
+    QVector<int> result;
+    if (!from.isValid() || !to.isValid() || from > to) return result;
+
+    rebuildIfNeeded();
+
+    const qint64 lo = from.toJulianDay();
+    const qint64 hi = to.toJulianDay();
+
+    collect(0, m_sorted.size(), lo, hi, result);
+
+    for (const Entry &entry : m_pending) {
+        if (entry.start <= hi && entry.end >= lo) {
+            result.append(entry.id);
+        }
+    }
+    return result;
+}
+
+void DateIntervalIndex::rebuildIfNeeded() const
+{
+    const int churn = m_pending.size() + m_removed.size();
+    if (churn == 0) return;
+    if (churn < kMinRebuildThreshold && churn * 8 < m_sorted.size()) return;
+
+    QVector<Entry> entries;
+    entries.reserve(m_sorted.size() - m_removed.size() + m_pending.size());
+    for (const Entry &entry : m_sorted) {
+        if (!m_removed.contains(entry.id)) {
+            entries.append(entry);
+        }
+    }
+    entries += m_pending;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.start < b.start;
+    });
+
+    m_sorted = entries;
+    m_pending.clear();
+    m_pendingSlot.clear();
+    m_removed.clear();
+
+    // 自底向上计算每个隐式子树 [lo, hi) 的最大结束日期，结果存放在 mid 位置
+    m_maxEnd.fill(0, m_sorted.size());
+    struct Builder {
+        const QVector<Entry> &sorted;
+        QVector<qint64> &maxEnd;
+        qint64 build(int lo, int hi) {
+            if (lo >= hi) return std::numeric_limits<qint64>::min();
+            int mid = lo + (hi - lo) / 2;
+            qint64 value = std::max({sorted.at(mid).end, build(lo, mid), build(mid + 1, hi)});
+            maxEnd[mid] = value;
+            return value;
+        }
+    };
+    Builder builder{m_sorted, m_maxEnd};
+    builder.build(0, m_sorted.size());
+}
+
+void DateIntervalIndex::collect(int lo, int hi, qint64 from, qint64 to, QVector<int> &out) const
+{
+    if (lo >= hi) return;
+
+    int mid = lo + (hi - lo) / 2;
+    if (m_maxEnd.at(mid) < from) return; // 整棵子树都在查询范围之前结束
+
+    collect(lo, mid, from, to, out);
+
+    const Entry &entry = m_sorted.at(mid);
+    if (entry.start > to) return; // 右侧的开始日期只会更晚
+
+    if (entry.end >= from && !m_removed.contains(entry.id)) {
+        out.append(entry.id);
+    }
+    collect(mid + 1, hi, from, to, out);
+}
@@ -0,0 +1,47 @@
+#ifndef DATEINTERVALINDEX_H
+#define DATEINTERVALINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+// 课程起止日期的区间索引。
+// 按开始日期排序后的数组隐式构成一棵平衡二叉树，每个子树记录最大结束日期，
+// 因此“某天有哪些课程在上”和“某个日期范围内有哪些课程”都能在 O(log n + k) 内回答。
+// 增删只记录到待合并列表/删除标记中，积累到一定数量后在下一次查询时惰性重建。
+// 起止日期无效的课程只登记 id，不参与任何查询，与原先按日期比较的 SQL 一致。
+class DateIntervalIndex
+{
+public:
+    DateIntervalIndex();
+
+    void clear();
+    void insert(int courseId, const QDate &start, const QDate &end);
+    bool remove(int courseId);
+    int size() const;
+    qint64 memoryBytes() const; // 估算占用的堆内存
+
+    QVector<int> stab(const QDate &date) const;
+    QVector<int> overlapping(const QDate &from, const QDate &to) const;
+
+private:
+    struct Entry {
+        qint64 start;
+        qint64 end;
+        int id;
+    };
+
+    void rebuildIfNeeded() const;
+    void collect(int lo, int hi, qint64 from, qint64 to, QVector<int> &out) const;
+
+    mutable QVector<Entry> m_sorted;   // 按 start 排序
+    mutable QVector<qint64> m_maxEnd;  // 以 mid 为根的子树中的最大 end
+    mutable QVector<Entry> m_pending;  // 尚未合并进排序数组的新区间
+    mutable QHash<int, int> m_pendingSlot; // 课程 id -> 在 m_pending 中的下标
+    mutable QSet<int> m_removed;       // 排序数组中已删除的课程
+    QSet<int> m_ids;
+    QSet<int> m_invalid;               // 日期无效、不进入索引的课程
+};
+
+#endif // DATEINTERVALINDEX_H
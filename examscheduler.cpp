@@ -0,0 +1,292 @@
+#include "examscheduler.h"
+#include <QDebug>
+#include <QPair>
+#include <algorithm>
+
+ExamScheduler::ExamScheduler()
+    : m_sessionsPerDay(1)
+{
+}
+
+void ExamScheduler::setCourses(const QList<CourseData> &courses)
+{
+    m_courses = QVector<CourseData>(courses.begin(), courses.end());
+    m_vertexOf.clear();
+    m_adjacent.clear();
+    m_adjacent.resize(m_courses.size());
+
+    QHash<QString, QVector<int>> byTeacher;
+    for (int vertex = 0; vertex < m_courses.size(); ++vertex) {
+        m_vertexOf.insert(m_courses.at(vertex).id, vertex);
+        const QString teacher = m_courses.at(vertex).teacher.trimmed();
+        if (!teacher.isEmpty()) byTeacher[teacher].append(m_courses.at(vertex).id);
+    }
+    for (const QVector<int> &group : byTeacher) {
+        addConflictGroup(group);
+    }
+
+    m_slot.fill(-1, m_courses.size());
+    m_room.fill(-1, m_courses.size());
+    m_neighbourSlots.fill(QVector<int>(slotCount(), 0), m_courses.size());
+    m_saturation.fill(0, m_courses.size());
+}
+
+void ExamScheduler::addConflictGroup(const QVector<int> &courseIds)
+{
+    QVector<int> vertices;
+    for (int id : courseIds) {
+        int vertex = m_vertexOf.value(id, -1);
+        if (vertex >= 0) vertices.append(vertex);
+    }
+    for (int i = 0; i < vertices.size(); ++i) {
+        for (int j = i + 1; j < vertices.size(); ++j) {
+            if (vertices.at(i) == vertices.at(j)) continue;
+            m_adjacent[vertices.at(i)].insert(vertices.at(j));
+            m_adjacent[vertices.at(j)].insert(vertices.at(i));
+        }
+    }
+}
+
+bool ExamScheduler::schedule(const Options &options)
+{
+    m_days.clear();
+    for (QDate day = options.firstDay; day.isValid() && day <= options.lastDay; day = day.addDays(1)) {
+        if (options.skipWeekends && day.dayOfWeek() > 5) continue;
+        m_days.append(day);
+    }
+    m_sessionsPerDay = qMax(1, options.sessionsPerDay);
+
+    // 考场按容量从小到大排列，分配时取第一间放得下的
+    QList<QPair<int, QString>> rooms;
+    for (auto it = options.roomCapacity.constBegin(); it != options.roomCapacity.constEnd(); ++it) {
+        if (it.value() > 0) rooms.append(qMakePair(it.value(), it.key()));
+    }
+    std::sort(rooms.begin(), rooms.end());
+    m_roomNames.clear();
+    m_roomCapacity.clear();
+    for (const auto &room : rooms) {
+        m_roomCapacity.append(room.first);
+        m_roomNames.append(room.second);
+    }
+
+    m_size.fill(0, m_courses.size());
+    for (int vertex = 0; vertex < m_courses.size(); ++vertex) {
+        m_size[vertex] = options.examSize.value(m_courses.at(vertex).id, 0);
+    }
+
+    m_slot.fill(-1, m_courses.size());
+    m_room.fill(-1, m_courses.size());
+    m_neighbourSlots.fill(QVector<int>(slotCount(), 0), m_courses.size());
+    m_saturation.fill(0, m_courses.size());
+    m_slotLoad.fill(0, slotCount());
+    m_usedRooms.clear();
+    m_usedRooms.resize(slotCount());
+
+    QVector<int> all(m_courses.size());
+    for (int vertex = 0; vertex < all.size(); ++vertex) all[vertex] = vertex;
+    return colour(all);
+}
+
+bool ExamScheduler::moveExam(int courseId, int slot)
+{
+    const int vertex = m_vertexOf.value(courseId, -1);
+    if (vertex < 0 || slot < 0 || slot >= slotCount()) return false;
+
+    release(vertex);
+    occupy(vertex, slot);
+    const int room = pickRoom(slot, m_size.at(vertex));
+    if (room >= 0) {
+        m_room[vertex] = room;
+        m_usedRooms[slot].insert(room);
+    }
+
+    // 只有和它同场的邻居需要挪开，其余考试保持原来的场次
+    QVector<int> displaced;
+    for (int neighbour : m_adjacent.at(vertex)) {
+        if (m_slot.at(neighbour) == slot) {
+            release(neighbour);
+            displaced.append(neighbour);
+        }
+    }
+    if (room == -2) {
+        // 固定的考试没有考场时，让出一间给它：挪走该场次中占用最小可用考场的一门考试
+        for (int other = 0; other < m_courses.size(); ++other) {
+            if (other == vertex || m_slot.at(other) != slot || m_room.at(other) < 0) continue;
+            if (m_roomCapacity.at(m_room.at(other)) < m_size.at(vertex)) continue;
+
+            const int freed = m_room.at(other);
+            release(other);
+            displaced.append(other);
+            m_room[vertex] = freed;
+            m_usedRooms[slot].insert(freed);
+            break;
+        }
+    }
+
+    const bool ok = colour(displaced);
+    return ok && problems().isEmpty();
+}
+
+int ExamScheduler::slotCount() const
+{
+    return m_days.size() * m_sessionsPerDay;
+}
+
+int ExamScheduler::slotOf(int courseId) const
+{
+    const int vertex = m_vertexOf.value(courseId, -1);
+    return vertex < 0 ? -1 : m_slot.value(vertex, -1);
+}
+
+QDate ExamScheduler::dateOfSlot(int slot) const
+{
+    if (slot < 0 || slot >= slotCount()) return QDate();
+    return m_days.at(slot / m_sessionsPerDay);
+}
+
+int ExamScheduler::sessionOfSlot(int slot) const
+{
+    return slot < 0 ? -1 : slot % m_sessionsPerDay;
+}
+
+QString ExamScheduler::roomOf(int courseId) const
+{
+    const int vertex = m_vertexOf.value(courseId, -1);
+    const int room = vertex < 0 ? -1 : m_room.value(vertex, -1);
+    return room < 0 ? QString() : m_roomNames.at(room);
+}
+
+QHash<int, QDate> ExamScheduler::examDates() const
+{
+    QHash<int, QDate> dates;
+    for (int vertex = 0; vertex < m_courses.size(); ++vertex) {
+        if (m_slot.at(vertex) >= 0) {
+            dates.insert(m_courses.at(vertex).id, dateOfSlot(m_slot.at(vertex)));
+        }
+    }
+    return dates;
+}
+
+QStringList ExamScheduler::problems() const
+{
+    QStringList problems;
+    for (int vertex = 0; vertex < m_courses.size(); ++vertex) {
+        const QString &name = m_courses.at(vertex).name;
+        if (m_slot.at(vertex) < 0) {
+            problems << QString("%1：没有可用的考试场次").arg(name);
+            continue;
+        }
+        for (int neighbour : m_adjacent.at(vertex)) {
+            if (neighbour > vertex && m_slot.at(neighbour) == m_slot.at(vertex)) {
+                problems << QString("%1 与 %2 安排在同一场").arg(name, m_courses.at(neighbour).name);
+            }
+        }
+        if (!m_roomNames.isEmpty() && m_room.at(vertex) < 0) {
+            problems << QString("%1：没有容量不少于 %2 人的空闲考场").arg(name).arg(m_size.at(vertex));
+        }
+    }
+    return problems;
+}
+
+bool ExamScheduler::colour(const QVector<int> &pending)
+{
+    QVector<int> left = pending;
+    bool ok = true;
+    while (!left.isEmpty()) {
+        // DSatur：先安排邻居已占用场次最多的考试，相同时先安排冲突最多的
+        int pick = 0;
+        int bestSaturation = -1;
+        for (int i = 0; i < left.size(); ++i) {
+            const int vertex = left.at(i);
+            const int value = saturation(vertex);
+            if (value > bestSaturation
+                || (value == bestSaturation && m_adjacent.at(vertex).size() > m_adjacent.at(left.at(pick)).size())) {
+                pick = i;
+                bestSaturation = value;
+            }
+        }
+
+        const int vertex = left.at(pick);
+        left[pick] = left.last();
+        left.removeLast();
+        ok = assign(vertex) && ok;
+    }
+    return ok;
+}
+
+bool ExamScheduler::assign(int vertex)
+{
+    const int slotTotal = slotCount();
+    if (slotTotal == 0) return false;
+
+    // 每个场次中已安排的邻居数随 occupy/release 增量维护
+    const QVector<int> &clashes = m_neighbourSlots.at(vertex);
+
+    // 在不冲突且有考场的场次中选已安排考试最少的，使考试尽量分散
+    int best = -1;
+    int bestRoom = -1;
+    for (int slot = 0; slot < slotTotal; ++slot) {
+        if (clashes.at(slot) > 0) continue;
+        const int room = pickRoom(slot, m_size.at(vertex));
+        if (room == -2) continue;
+        if (best < 0 || m_slotLoad.at(slot) < m_slotLoad.at(best)) {
+            best = slot;
+            bestRoom = room;
+        }
+    }
+
+    bool ok = best >= 0;
+    if (!ok) {
+        // 无论如何都会冲突：退而求其次，选同场冲突最少的场次，留待手动调整
+        best = int(std::min_element(clashes.begin(), clashes.end()) - clashes.begin());
+        bestRoom = pickRoom(best, m_size.at(vertex));
+    }
+
+    occupy(vertex, best);
+    if (bestRoom >= 0) {
+        m_room[vertex] = bestRoom;
+        m_usedRooms[best].insert(bestRoom);
+    }
+    return ok;
+}
+
+int ExamScheduler::saturation(int vertex) const
+{
+    return m_saturation.at(vertex);
+}
+
+int ExamScheduler::pickRoom(int slot, int size) const
+{
+    if (m_roomNames.isEmpty()) return -1;
+    for (int room = 0; room < m_roomNames.size(); ++room) {
+        if (m_roomCapacity.at(room) >= size && !m_usedRooms.at(slot).contains(room)) {
+            return room;
+        }
+    }
+    return -2;
+}
+
+void ExamScheduler::occupy(int vertex, int slot)
+{
+    m_slot[vertex] = slot;
+    ++m_slotLoad[slot];
+    for (int neighbour : m_adjacent.at(vertex)) {
+        if (m_neighbourSlots[neighbour][slot]++ == 0) ++m_saturation[neighbour];
+    }
+}
+
+void ExamScheduler::release(int vertex)
+{
+    const int slot = m_slot.at(vertex);
+    if (slot < 0) return;
+
+    --m_slotLoad[slot];
+    for (int neighbour : m_adjacent.at(vertex)) {
+        if (--m_neighbourSlots[neighbour][slot] == 0) --m_saturation[neighbour];
+    }
+    if (m_room.at(vertex) >= 0) {
+        m_usedRooms[slot].remove(m_room.at(vertex));
+    }
+    m_slot[vertex] = -1;
+    m_room[vertex] = -1;
+}
@@ -0,0 +1,70 @@
+#ifndef EXAMSCHEDULER_H
+#define EXAMSCHEDULER_H
+
+#include <QDate>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include "coursemanager.h"
+
+// 考试安排。
+// 以课程为顶点、以“不能同场考试”为边建冲突图（同一教师，或有共同学生的课程组），
+// 再用 DSatur 启发式把图着色到考试场次上：每个场次是 (日期, 第几场)，颜色相同即同场。
+// 配置了考场容量时，每场考试还要在该场次中分到一间容量足够且空闲的最小考场。
+// 单门考试被手动移动后，只把与它同场冲突的邻居重新着色，其余安排保持不动。
+class ExamScheduler
+{
+public:
+    struct Options {
+        QDate firstDay;
+        QDate lastDay;
+        int sessionsPerDay = 2;
+        bool skipWeekends = true;
+        QHash<QString, int> roomCapacity;  // 考场 -> 容量，为空表示不分配考场
+        QHash<int, int> examSize;          // 课程 id -> 考试人数，未列出视为 0
+    };
+
+    ExamScheduler();
+
+    void setCourses(const QList<CourseData> &courses);      // 同一教师的课程互相连边
+    void addConflictGroup(const QVector<int> &courseIds);   // 有共同学生的课程互相连边
+
+    bool schedule(const Options &options);                  // 全部重新着色，全部满足时返回 true
+    bool moveExam(int courseId, int slot);                  // 固定一门考试的场次并局部修复
+
+    int slotCount() const;
+    int slotOf(int courseId) const;                         // 未安排时返回 -1
+    QDate dateOfSlot(int slot) const;
+    int sessionOfSlot(int slot) const;                      // 当天第几场，从 0 开始
+    QString roomOf(int courseId) const;
+    QHash<int, QDate> examDates() const;
+    QStringList problems() const;                           // 同场冲突与缺少考场的说明
+
+private:
+    bool colour(const QVector<int> &pending);
+    bool assign(int vertex);
+    int saturation(int vertex) const;
+    int pickRoom(int slot, int size) const;                 // -1 表示不需要考场，-2 表示没有合适考场
+    void occupy(int vertex, int slot);                      // 安排到场次并更新邻居的饱和度
+    void release(int vertex);
+
+    QVector<CourseData> m_courses;                          // 下标即顶点编号
+    QHash<int, int> m_vertexOf;                             // 课程 id -> 顶点
+    QVector<QSet<int>> m_adjacent;
+
+    QVector<QDate> m_days;
+    int m_sessionsPerDay;
+    QStringList m_roomNames;                                // 按容量从小到大
+    QVector<int> m_roomCapacity;
+    QVector<int> m_size;                                    // 顶点 -> 考试人数
+
+    QVector<int> m_slot;                                    // 顶点 -> 场次
+    QVector<int> m_room;                                    // 顶点 -> 考场下标
+    QVector<int> m_slotLoad;                                // 场次 -> 已安排的考试数
+    QVector<QSet<int>> m_usedRooms;                         // 场次 -> 已占用的考场
+    QVector<QVector<int>> m_neighbourSlots;                 // 顶点 -> 各场次中已安排的邻居数
+    QVector<int> m_saturation;                              // 顶点 -> 邻居占用的不同场次数
+};
+
+#endif // EXAMSCHEDULER_H
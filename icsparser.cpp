@@ -0,0 +1,314 @@
+#include "icsparser.h"
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <algorithm>
+
+namespace {
+
+const int MaxOccurrences = 1000; // 单个事件最多展开的次数，防止异常规则拖慢导入
+
+QString unescapeText(const QString &value)
+{
+    QString text;
+    text.reserve(value.size());
+    for (int i = 0; i < value.size(); ++i) {
+        const QChar ch = value.at(i);
+        if (ch == '\\' && i + 1 < value.size()) {
+            const QChar next = value.at(++i);
+            text += (next == 'n' || next == 'N') ? QChar('\n') : next;
+        } else {
+            text += ch;
+        }
+    }
+    return text;
+}
+
+int weekdayOf(const QString &code)
+{
+    static const QStringList codes = {"MO", "TU", "WE", "TH", "FR", "SA", "SU"};
+    return codes.indexOf(code.right(2).toUpper()) + 1; // 忽略 1MO 之类的序号前缀
+}
+
+// 只支持课程表里常见的 PnDTnHnMnS / PnW 形式
+qint64 durationSeconds(const QString &value)
+{
+    qint64 seconds = 0;
+    qint64 number = 0;
+    for (QChar ch : value) {
+        if (ch.isDigit()) {
+            number = number * 10 + ch.digitValue();
+            continue;
+        }
+        switch (ch.toUpper().unicode()) {
+        case 'W': seconds += number * 7 * 86400; break;
+        case 'D': seconds += number * 86400; break;
+        case 'H': seconds += number * 3600; break;
+        case 'M': seconds += number * 60; break;
+        case 'S': seconds += number; break;
+        default: break;
+        }
+        number = 0;
+    }
+    return value.startsWith('-') ? -seconds : seconds;
+}
+
+} // namespace
+
+IcsParser::IcsParser(const QTimeZone &targetZone)
+    : m_zone(targetZone)
+{
+}
+
+bool IcsParser::parseFile(const QString &filePath, const QDate &rangeEnd)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_warnings << QString("无法打开文件：%1").arg(file.errorString());
+        return false;
+    }
+    return parse(file.readAll(), rangeEnd);
+}
+
+bool IcsParser::parse(const QByteArray &data, const QDate &rangeEnd)
+{
+    m_events.clear();
+
+    // 先把折行还原成逻辑行：以空格或制表符开头的行接在上一行后面
+    QList<QByteArray> lines;
+    int start = 0;
+    while (start < data.size()) {
+        int end = data.indexOf('\n', start);
+        if (end < 0) end = data.size();
+        QByteArray line = data.mid(start, end - start);
+        if (line.endsWith('\r')) line.chop(1);
+        if (!line.isEmpty() && (line.at(0) == ' ' || line.at(0) == '\t') && !lines.isEmpty()) {
+            lines.last().append(line.constData() + 1, line.size() - 1);
+        } else if (!line.isEmpty()) {
+            lines.append(line);
+        }
+        start = end + 1;
+    }
+    if (lines.isEmpty() || !lines.first().startsWith("BEGIN:VCALENDAR")) {
+        m_warnings << "不是有效的 iCalendar 文件";
+        return false;
+    }
+
+    QList<RawEvent> raws;
+    RawEvent current;
+    bool inEvent = false;
+    bool canceled = false;
+    int nested = 0; // VEVENT 内的 VALARM 等子组件
+    QString durationValue;
+
+    for (const QByteArray &bytes : lines) {
+        const QString line = QString::fromUtf8(bytes);
+
+        // 属性名和参数在第一个不在引号内的冒号之前
+        int colon = -1;
+        bool quoted = false;
+        for (int i = 0; i < line.size(); ++i) {
+            if (line.at(i) == '"') quoted = !quoted;
+            else if (line.at(i) == ':' && !quoted) { colon = i; break; }
+        }
+        if (colon < 0) continue;
+
+        const QStringList head = line.left(colon).split(';');
+        const QString name = head.first().toUpper();
+        const QString value = line.mid(colon + 1);
+        QHash<QString, QString> params;
+        for (int i = 1; i < head.size(); ++i) {
+            const int eq = head.at(i).indexOf('=');
+            if (eq > 0) {
+                QString param = head.at(i).mid(eq + 1);
+                if (param.startsWith('"') && param.endsWith('"')) param = param.mid(1, param.size() - 2);
+                params.insert(head.at(i).left(eq).toUpper(), param);
+            }
+        }
+
+        if (name == "BEGIN") {
+            if (inEvent) {
+                ++nested;
+            } else if (value.toUpper() == "VEVENT") {
+                current = RawEvent();
+                inEvent = true;
+                canceled = false;
+                durationValue.clear();
+            }
+            continue;
+        }
+        if (name == "END") {
+            if (inEvent && nested > 0) {
+                --nested;
+            } else if (inEvent && value.toUpper() == "VEVENT") {
+                inEvent = false;
+                Event &event = current.event;
+                if (canceled) continue;
+                if (!event.start.isValid()) {
+                    m_warnings << QString("「%1」缺少开始时间，已跳过").arg(event.summary);
+                    continue;
+                }
+                if (!event.end.isValid()) {
+                    if (!durationValue.isEmpty()) event.end = event.start.addSecs(durationSeconds(durationValue));
+                    else event.end = event.allDay ? event.start.addDays(1) : event.start;
+                }
+                raws.append(current);
+            }
+            continue;
+        }
+        if (!inEvent || nested > 0) continue;
+
+        Event &event = current.event;
+        bool dateOnly = false;
+        if (name == "UID") {
+            event.uid = value;
+        } else if (name == "SUMMARY") {
+            event.summary = unescapeText(value).trimmed();
+        } else if (name == "LOCATION") {
+            event.location = unescapeText(value).trimmed();
+        } else if (name == "DESCRIPTION") {
+            event.description = unescapeText(value);
+        } else if (name == "CATEGORIES") {
+            for (const QString &category : value.split(',')) {
+                event.categories << unescapeText(category).trimmed();
+            }
+        } else if (name == "STATUS") {
+            canceled = value.toUpper() == "CANCELLED";
+        } else if (name == "DTSTART") {
+            event.start = parseDateTime(value, params.value("TZID"), &dateOnly);
+            event.allDay = dateOnly || params.value("VALUE").toUpper() == "DATE";
+        } else if (name == "DTEND") {
+            event.end = parseDateTime(value, params.value("TZID"), &dateOnly);
+        } else if (name == "DURATION") {
+            durationValue = value;
+        } else if (name == "RRULE") {
+            current.rule = value;
+        } else if (name == "EXDATE") {
+            for (const QString &item : value.split(',')) {
+                const QDateTime date = parseDateTime(item, params.value("TZID"), &dateOnly);
+                if (date.isValid()) current.exdates.append(date);
+            }
+        } else if (name == "RECURRENCE-ID") {
+            current.recurrenceId = parseDateTime(value, params.value("TZID"), &dateOnly);
+        }
+    }
+
+    // 单次修改过的日期由修改后的事件代表，原重复事件中去掉这些日期
+    QHash<QString, QSet<QDate>> overridden;
+    for (const RawEvent &raw : raws) {
+        if (raw.recurrenceId.isValid() && !raw.event.uid.isEmpty()) {
+            overridden[raw.event.uid].insert(raw.recurrenceId.date());
+        }
+    }
+
+    m_events.reserve(raws.size());
+    for (RawEvent &raw : raws) {
+        const QSet<QDate> none;
+        expand(raw, raw.recurrenceId.isValid() ? none : overridden.value(raw.event.uid), rangeEnd);
+        if (!raw.event.occurrences.isEmpty()) m_events.append(raw.event);
+    }
+    return true;
+}
+
+const QList<IcsParser::Event> &IcsParser::events() const
+{
+    return m_events;
+}
+
+const QStringList &IcsParser::warnings() const
+{
+    return m_warnings;
+}
+
+QDateTime IcsParser::parseDateTime(const QString &value, const QString &tzid, bool *dateOnly) const
+{
+    const QString text = value.trimmed();
+    const QDate date = QDate::fromString(text.left(8), "yyyyMMdd");
+    if (!date.isValid()) return QDateTime();
+
+    *dateOnly = text.size() == 8;
+    if (*dateOnly) return QDateTime(date, QTime(0, 0), m_zone);
+
+    const QTime time = QTime::fromString(text.mid(9, 6), "HHmmss");
+    if (!time.isValid()) return QDateTime();
+
+    if (text.endsWith('Z')) {
+        return QDateTime(date, time, QTimeZone::utc()).toTimeZone(m_zone);
+    }
+    if (!tzid.isEmpty()) {
+        const QTimeZone zone(tzid.toUtf8());
+        if (zone.isValid()) return QDateTime(date, time, zone).toTimeZone(m_zone);
+    }
+    return QDateTime(date, time, m_zone); // 浮动时间按目标时区理解
+}
+
+void IcsParser::expand(RawEvent &raw, const QSet<QDate> &overridden, const QDate &rangeEnd)
+{
+    Event &event = raw.event;
+    const QDate first = event.start.date();
+
+    QSet<QDate> excluded = overridden;
+    for (const QDateTime &date : raw.exdates) {
+        excluded.insert(date.date());
+    }
+
+    if (raw.rule.isEmpty()) {
+        if (!excluded.contains(first)) event.occurrences.append(first);
+        return;
+    }
+
+    QHash<QString, QString> rule;
+    for (const QString &part : raw.rule.split(';', Qt::SkipEmptyParts)) {
+        const int eq = part.indexOf('=');
+        if (eq > 0) rule.insert(part.left(eq).toUpper(), part.mid(eq + 1));
+    }
+
+    const QString freq = rule.value("FREQ").toUpper();
+    if (freq != "WEEKLY" && freq != "DAILY") {
+        m_warnings << QString("「%1」的重复规则 %2 不受支持，只导入第一次").arg(event.summary, freq);
+        if (!excluded.contains(first)) event.occurrences.append(first);
+        return;
+    }
+
+    const int interval = qMax(1, rule.value("INTERVAL", "1").toInt());
+    const int count = rule.contains("COUNT") ? rule.value("COUNT").toInt() : MaxOccurrences;
+    QDate limit = rangeEnd;
+    if (rule.contains("UNTIL")) {
+        bool dateOnly = false;
+        const QDateTime until = parseDateTime(rule.value("UNTIL"), QString(), &dateOnly);
+        if (until.isValid()) limit = until.date();
+    }
+
+    QVector<int> days;
+    for (const QString &code : rule.value("BYDAY").split(',', Qt::SkipEmptyParts)) {
+        const int day = weekdayOf(code);
+        if (day > 0 && !days.contains(day)) days.append(day);
+    }
+    if (days.isEmpty() || freq == "DAILY") days = {first.dayOfWeek()};
+    std::sort(days.begin(), days.end());
+
+    event.recurring = true;
+    int generated = 0;
+    if (freq == "DAILY") {
+        for (QDate date = first; date <= limit && generated < count && generated < MaxOccurrences;
+             date = date.addDays(interval)) {
+            ++generated;
+            if (!excluded.contains(date)) event.occurrences.append(date);
+        }
+        return;
+    }
+
+    // 每周规则：从 DTSTART 所在周的周一起，每隔 interval 周取 BYDAY 中的各天
+    const QDate weekStart = first.addDays(1 - first.dayOfWeek());
+    for (int week = 0; generated < count && generated < MaxOccurrences; ++week) {
+        const QDate base = weekStart.addDays(qint64(week) * 7 * interval);
+        if (base > limit) break;
+        for (int day : days) {
+            const QDate date = base.addDays(day - 1);
+            if (date < first) continue;
+            if (date > limit || generated >= count) break;
+            ++generated;
+            if (!excluded.contains(date)) event.occurrences.append(date);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef ICSPARSER_H
+#define ICSPARSER_H
+
+#include <QDate>
+#include <QDateTime>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimeZone>
+
+// iCalendar（RFC 5545）事件解析。
+// 只关心课程导入需要的部分：VEVENT 的标题、地点、说明、起止时间、RRULE、EXDATE 和 RECURRENCE-ID。
+// 所有时间统一换算到 targetZone；每周重复的事件在 occurrences 中展开成具体日期，
+// 被 EXDATE 排除或被单次修改（RECURRENCE-ID）替代的日期已经去掉。
+class IcsParser
+{
+public:
+    struct Event {
+        QString uid;
+        QString summary;
+        QString location;
+        QString description;
+        QStringList categories;
+        QDateTime start;            // 已换算到 targetZone
+        QDateTime end;
+        bool allDay = false;
+        bool recurring = false;
+        QList<QDate> occurrences;   // 按日期排序
+    };
+
+    explicit IcsParser(const QTimeZone &targetZone);
+
+    // rangeEnd 用于没有 UNTIL 和 COUNT 的无限重复规则
+    bool parseFile(const QString &filePath, const QDate &rangeEnd);
+    bool parse(const QByteArray &data, const QDate &rangeEnd);
+
+    const QList<Event> &events() const;
+    const QStringList &warnings() const;
+
+private:
+    struct RawEvent {
+        Event event;
+        QString rule;
+        QList<QDateTime> exdates;
+        QDateTime recurrenceId;
+    };
+
+    QDateTime parseDateTime(const QString &value, const QString &tzid, bool *dateOnly) const;
+    void expand(RawEvent &raw, const QSet<QDate> &overridden, const QDate &rangeEnd);
+
+    QTimeZone m_zone;
+    QList<Event> m_events;
+    QStringList m_warnings;
+};
+
+#endif // ICSPARSER_H
@@ -0,0 +1,931 @@
+#include "jsonlines.h"
+#include "backgroundio.h"
+#include "coursejournal.h"
+#include "coursemanager.h"
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtConcurrent>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int ProgressStep = 2000; // 每处理这么多行报告一次进度
+const char FormatName[] = "sourcemanager-courses";
+
+// ==================== 写出 ====================
+
+// JSON 字符串：只转义引号、反斜杠和控制字符，UTF-8 多字节字符原样写出
+void appendString(QByteArray &out, const QString &text)
+{
+    static const char hex[] = "0123456789abcdef";
+    const QByteArray utf8 = text.toUtf8();
+    const char *run = utf8.constData();
+    const char *end = run + utf8.size();
+
+    out.append('"');
+    for (const char *p = run; p < end; ++p) {
+        const uchar ch = uchar(*p);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+        out.append(run, p - run);
+        run = p + 1;
+        switch (ch) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default: {
+            const char escaped[] = {'\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xf]};
+            out.append(escaped, sizeof(escaped));
+        }
+        }
+    }
+    out.append(run, end - run);
+    out.append('"');
+}
+
+// 日期在数据库中已是 ISO 格式，空串写成 null
+void appendDate(QByteArray &out, const QString &text)
+{
+    if (text.isEmpty()) out.append("null");
+    else appendString(out, text);
+}
+
+// ==================== 读入 ====================
+
+// 单行 JSON 对象的原地解析器：直接在读入的字节上扫描，不构造 QJsonDocument。
+// 字段值只需要字符串、数字、布尔和 null；嵌套的对象和数组整体跳过，留给以后的格式版本使用
+class LineParser
+{
+public:
+    enum Kind { Null, Bool, Number, String, Nested };
+
+    struct Value {
+        Kind kind = Null;
+        bool boolean = false;
+        double number = 0;
+        QString text;
+    };
+
+    LineParser(const char *begin, const char *end)
+        : m_p(begin), m_end(end), m_first(true), m_closed(false)
+    {
+    }
+
+    bool begin()
+    {
+        skipSpace();
+        if (m_p >= m_end || *m_p != '{') return fail("不是 JSON 对象");
+        ++m_p;
+        return true;
+    }
+
+    // 读下一个键，对象结束或出错时返回 false，出错时 error() 非空
+    bool nextKey(QByteArrayView *key)
+    {
+        skipSpace();
+        if (m_p < m_end && *m_p == '}') {
+            ++m_p;
+            m_closed = true;
+            return false;
+        }
+        if (!m_first) {
+            if (m_p >= m_end || *m_p != ',') return fail("缺少逗号");
+            ++m_p;
+            skipSpace();
+        }
+        m_first = false;
+        if (!readString(m_key)) return false;
+        skipSpace();
+        if (m_p >= m_end || *m_p != ':') return fail("缺少冒号");
+        ++m_p;
+        *key = QByteArrayView(m_key);
+        return true;
+    }
+
+    bool readValue(Value *value)
+    {
+        skipSpace();
+        if (m_p >= m_end) return fail("缺少值");
+
+        switch (*m_p) {
+        case '"':
+            if (!readString(m_text)) return false;
+            value->kind = String;
+            value->text = QString::fromUtf8(m_text);
+            return true;
+        case 't':
+            value->kind = Bool;
+            value->boolean = true;
+            return literal("true");
+        case 'f':
+            value->kind = Bool;
+            value->boolean = false;
+            return literal("false");
+        case 'n':
+            value->kind = Null;
+            return literal("null");
+        case '{':
+        case '[':
+            value->kind = Nested;
+            return skipNested();
+        default:
+            value->kind = Number;
+            return readNumber(&value->number);
+        }
+    }
+
+    bool finish()
+    {
+        if (!m_error.isEmpty()) return false;
+        if (!m_closed) return fail("对象没有结束");
+        skipSpace();
+        if (m_p != m_end) return fail("对象之后还有多余内容");
+        return true;
+    }
+
+    const QString &error() const { return m_error; }
+
+private:
+    bool fail(const QString &message)
+    {
+        if (m_error.isEmpty()) m_error = message;
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n')) ++m_p;
+    }
+
+    bool literal(const char *word)
+    {
+        const int size = int(std::strlen(word));
+        if (m_end - m_p < size || std::memcmp(m_p, word, size) != 0) return fail("无法识别的值");
+        m_p += size;
+        return true;
+    }
+
+    bool readNumber(double *number)
+    {
+        const char *start = m_p;
+        while (m_p < m_end) {
+            const char ch = *m_p;
+            if ((ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E') ++m_p;
+            else break;
+        }
+        bool ok = false;
+        if (m_p > start) *number = QByteArray::fromRawData(start, int(m_p - start)).toDouble(&ok);
+        return ok || fail("无法识别的值");
+    }
+
+    // m_p 指向 'u'，读取其后的四位十六进制数，结束时 m_p 指向最后一位
+    bool readHex4(uint *code)
+    {
+        if (m_end - m_p <= 4) return false;
+        *code = 0;
+        for (int i = 1; i <= 4; ++i) {
+            const char ch = m_p[i];
+            uint digit;
+            if (ch >= '0' && ch <= '9') digit = ch - '0';
+            else if (ch >= 'a' && ch <= 'f') digit = ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F') digit = ch - 'A' + 10;
+            else return false;
+            *code = (*code << 4) | digit;
+        }
+        m_p += 4;
+        return true;
+    }
+
+    static void appendUtf8(QByteArray &out, uint code)
+    {
+        if (code < 0x80) {
+            out.append(char(code));
+        } else if (code < 0x800) {
+            out.append(char(0xC0 | (code >> 6)));
+            out.append(char(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out.append(char(0xE0 | (code >> 12)));
+            out.append(char(0x80 | ((code >> 6) & 0x3F)));
+            out.append(char(0x80 | (code & 0x3F)));
+        } else {
+            out.append(char(0xF0 | (code >> 18)));
+            out.append(char(0x80 | ((code >> 12) & 0x3F)));
+            out.append(char(0x80 | ((code >> 6) & 0x3F)));
+            out.append(char(0x80 | (code & 0x3F)));
+        }
+    }
+
+    // 解码后的 UTF-8 写入 out；没有转义时整段一次复制
+    bool readString(QByteArray &out)
+    {
+        if (m_p >= m_end || *m_p != '"') return fail("应为字符串");
+        ++m_p;
+        out.resize(0);
+
+        const char *run = m_p;
+        while (m_p < m_end) {
+            const char ch = *m_p;
+            if (ch == '"') {
+                out.append(run, m_p - run);
+                ++m_p;
+                return true;
+            }
+            if (uchar(ch) < 0x20) return fail("字符串中有未转义的控制字符");
+            if (ch != '\\') {
+                ++m_p;
+                continue;
+            }
+
+            out.append(run, m_p - run);
+            if (++m_p >= m_end) break;
+            switch (*m_p) {
+            case '"': out.append('"'); break;
+            case '\\': out.append('\\'); break;
+            case '/': out.append('/'); break;
+            case 'b': out.append('\b'); break;
+            case 'f': out.append('\f'); break;
+            case 'n': out.append('\n'); break;
+            case 'r': out.append('\r'); break;
+            case 't': out.append('\t'); break;
+            case 'u': {
+                uint code = 0;
+                if (!readHex4(&code)) return fail("\\u 转义无效");
+                if (code >= 0xD800 && code < 0xDC00) {
+                    // 代理对：后面必须紧跟低位的 \uDC00-\uDFFF
+                    uint low = 0;
+                    if (m_end - m_p < 3 || m_p[1] != '\\' || m_p[2] != 'u') return fail("\\u 转义无效");
+                    m_p += 2;
+                    if (!readHex4(&low) || low < 0xDC00 || low > 0xDFFF) return fail("\\u 转义无效");
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                } else if (code >= 0xDC00 && code < 0xE000) {
+                    return fail("\\u 转义无效");
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                return fail("未知的转义字符");
+            }
+            ++m_p;
+            run = m_p;
+        }
+        return fail("字符串没有结束");
+    }
+
+    bool skipNested()
+    {
+        int depth = 0;
+        while (m_p < m_end) {
+            const char ch = *m_p;
+            if (ch == '"') {
+                if (!readString(m_text)) return false;
+                continue;
+            }
+            if (ch == '{' || ch == '[') {
+                ++depth;
+            } else if (ch == '}' || ch == ']') {
+                if (--depth == 0) {
+                    ++m_p;
+                    return true;
+                }
+            }
+            ++m_p;
+        }
+        return fail("嵌套的值没有结束");
+    }
+
+    const char *m_p;
+    const char *m_end;
+    bool m_first;
+    bool m_closed;
+    QByteArray m_key;
+    QByteArray m_text;
+    QString m_error;
+};
+
+enum Field {
+    Type, Format, Schema, Name, Semester, DayOfWeek, StartSlot, EndSlot, Location,
+    StartDate, EndDate, Teacher, ExamDate, CourseType, Credits, WeekMask, Unknown
+};
+
+Field fieldFor(QByteArrayView key)
+{
+    static const struct { const char *name; Field field; } table[] = {
+        {"type", Type}, {"format", Format}, {"schema", Schema}, {"name", Name}, {"semester", Semester},
+        {"day_of_week", DayOfWeek}, {"start_slot", StartSlot}, {"end_slot", EndSlot}, {"location", Location},
+        {"start_date", StartDate}, {"end_date", EndDate}, {"teacher", Teacher}, {"exam_date", ExamDate},
+        {"course_type", CourseType}, {"credits", Credits}, {"week_mask", WeekMask},
+    };
+    for (const auto &entry : table) {
+        if (key == entry.name) return entry.field;
+    }
+    return Unknown;
+}
+
+// 一行记录中认识的字段；seen 的第 i 位表示出现过 Field i
+struct Record {
+    quint32 seen = 0;
+    QString type;
+    QString format;
+    QString strings[Unknown];
+    double numbers[Unknown] = {};
+
+    bool has(Field field) const { return seen & (1u << field); }
+};
+
+bool isStringField(Field field)
+{
+    switch (field) {
+    case Type: case Format: case Name: case Semester: case Location: case StartDate:
+    case EndDate: case Teacher: case ExamDate: case CourseType:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 解析一行；失败时返回原因
+QString parseRecord(const char *begin, const char *end, Record *record)
+{
+    LineParser parser(begin, end);
+    if (!parser.begin()) return parser.error();
+
+    QByteArrayView key;
+    LineParser::Value value;
+    while (parser.nextKey(&key)) {
+        if (!parser.readValue(&value)) break;
+
+        const Field field = fieldFor(key);
+        if (field == Unknown || value.kind == LineParser::Null) continue; // 未知字段和 null 都当作没有
+        if (isStringField(field)) {
+            if (value.kind != LineParser::String) {
+                return QString("字段 %1 应为字符串").arg(QString::fromUtf8(key.data(), key.size()));
+            }
+            record->strings[field] = value.text;
+        } else {
+            if (value.kind != LineParser::Number) {
+                return QString("字段 %1 应为数字").arg(QString::fromUtf8(key.data(), key.size()));
+            }
+            record->numbers[field] = value.number;
+        }
+        record->seen |= 1u << field;
+    }
+    if (!parser.finish()) return parser.error();
+
+    record->type = record->has(Type) ? record->strings[Type] : QString("course");
+    return QString();
+}
+
+bool integerField(const Record &record, Field field, qint64 *out)
+{
+    const double value = record.numbers[field];
+    if (!std::isfinite(value) || value != std::floor(value)) return false;
+    *out = qint64(value);
+    return true;
+}
+
+// 写修改日志时读回课程的列，semester 在最后
+const char JournalColumns[] = "id, name, day_of_week, start_slot, end_slot, location, start_date, end_date, "
+                              "teacher, exam_date, course_type, credits, week_mask, semester";
+
+CourseData journalCourse(const QSqlQuery &query)
+{
+    CourseData course;
+    course.id = query.value(0).toInt();
+    course.name = query.value(1).toString();
+    course.dayOfWeek = query.value(2).toInt();
+    course.startSlot = query.value(3).toInt();
+    course.endSlot = query.value(4).toInt();
+    course.location = query.value(5).toString();
+    course.startDate = QDate::fromString(query.value(6).toString(), Qt::ISODate);
+    course.endDate = QDate::fromString(query.value(7).toString(), Qt::ISODate);
+    course.teacher = query.value(8).toString();
+    course.examDate = QDate::fromString(query.value(9).toString(), Qt::ISODate);
+    course.courseType = query.value(10).toString();
+    course.credits = query.value(11).toDouble();
+    course.weekMask = query.value(12).isNull() ? CourseData::AllWeeks : quint32(query.value(12).toLongLong());
+    return course;
+}
+
+// 课程各列，攒够一批后整体绑定给 execBatch
+struct CourseBatch {
+    QVariantList names, days, starts, ends, locations, startDates, endDates;
+    QVariantList teachers, exams, types, credits, masks, rooms, semesters;
+
+    int size() const { return names.size(); }
+
+    void append(const CourseData &course, int roomId, const QString &semester)
+    {
+        names << course.name;
+        days << course.dayOfWeek;
+        starts << course.startSlot;
+        ends << course.endSlot;
+        locations << course.location;
+        startDates << course.startDate.toString(Qt::ISODate);
+        endDates << course.endDate.toString(Qt::ISODate);
+        teachers << course.teacher;
+        exams << (course.examDate.isValid() ? course.examDate.toString(Qt::ISODate) : QString(""));
+        types << course.courseType;
+        credits << course.credits;
+        masks << qint64(course.weekMask);
+        rooms << (roomId > 0 ? QVariant(roomId) : QVariant(QMetaType::fromType<int>()));
+        semesters << semester;
+    }
+
+    void clear()
+    {
+        for (QVariantList *column : {&names, &days, &starts, &ends, &locations, &startDates, &endDates,
+                                     &teachers, &exams, &types, &credits, &masks, &rooms, &semesters}) {
+            column->clear();
+        }
+    }
+};
+
+} // namespace
+
+JsonLines::JsonLines(QObject *parent)
+    : QObject(parent), m_canceled(false)
+{
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, [this]() {
+        emit finished(m_watcher.result());
+    });
+}
+
+JsonLines::~JsonLines()
+{
+    cancel();
+    m_watcher.waitForFinished();
+}
+
+void JsonLines::startExport(const QString &databasePath, const ExportOptions &options)
+{
+    run(databasePath, [this, options](const QSqlDatabase &db) {
+        return exportTo(db, options, [this](qint64 done, qint64 total) {
+            emit progressChanged(done, total);
+            return !m_canceled;
+        });
+    });
+}
+
+void JsonLines::startImport(const QString &databasePath, const ImportOptions &options)
+{
+    run(databasePath, [this, options](const QSqlDatabase &db) {
+        return importFrom(db, options, [this](qint64 done, qint64 total) {
+            emit progressChanged(done, total);
+            return !m_canceled;
+        });
+    });
+}
+
+void JsonLines::cancel()
+{
+    m_canceled = true;
+}
+
+bool JsonLines::isRunning() const
+{
+    return m_watcher.isRunning();
+}
+
+void JsonLines::run(const QString &databasePath, const Job &job)
+{
+    if (isRunning()) {
+        return;
+    }
+
+    m_canceled = false;
+    m_watcher.setFuture(QtConcurrent::run([databasePath, job]() {
+        Result result;
+        BackgroundIo::withConnection(databasePath, "jsonlines", [&](const QSqlDatabase &db) {
+            result = job(db);
+        }, &result.error);
+        return result;
+    }));
+}
+
+JsonLines::Result JsonLines::exportTo(const QSqlDatabase &db, const ExportOptions &options,
+                                      const ProgressCallback &progress)
+{
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+
+    int total = 0;
+    QSqlQuery count(db);
+    count.prepare("SELECT COUNT(*) FROM courses" + BackgroundIo::inFilter("semester", options.semesters));
+    for (const QString &semester : options.semesters) count.addBindValue(semester);
+    if (count.exec() && count.next()) total = count.value(0).toInt();
+
+    QSqlQuery semesters(db);
+    semesters.setForwardOnly(true);
+    semesters.prepare("SELECT name, start_date, end_date FROM semesters" + BackgroundIo::inFilter("name", options.semesters) +
+                      " ORDER BY start_date");
+    for (const QString &semester : options.semesters) semesters.addBindValue(semester);
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT id, name, day_of_week, start_slot, end_slot, location, start_date, end_date, "
+                  "teacher, exam_date, course_type, credits, week_mask, semester FROM courses" +
+                  BackgroundIo::inFilter("semester", options.semesters) + " ORDER BY semester, id");
+    for (const QString &semester : options.semesters) query.addBindValue(semester);
+
+    if (!semesters.exec() || !query.exec()) {
+        result.error = semesters.lastError().isValid() ? semesters.lastError().text() : query.lastError().text();
+        qDebug() << "Failed to query courses for export:" << result.error;
+        return result;
+    }
+
+    BackgroundIo::Writer file(options.filePath);
+    if (!file.open()) {
+        result.error = file.errorString();
+        return result;
+    }
+
+    QByteArray &buffer = file.buffer();
+
+    buffer.append("{\"type\":\"header\",\"format\":");
+    appendString(buffer, FormatName);
+    buffer.append(",\"schema\":").append(QByteArray::number(SchemaVersion));
+    buffer.append(",\"exported\":");
+    appendString(buffer, QDateTime::currentDateTime().toString(Qt::ISODate));
+    buffer.append("}\n");
+    ++result.lines;
+
+    while (semesters.next()) {
+        buffer.append("{\"type\":\"semester\",\"name\":");
+        appendString(buffer, semesters.value(0).toString());
+        buffer.append(",\"start_date\":");
+        appendDate(buffer, semesters.value(1).toString());
+        buffer.append(",\"end_date\":");
+        appendDate(buffer, semesters.value(2).toString());
+        buffer.append("}\n");
+        ++result.semesters;
+        ++result.lines;
+    }
+
+    bool ok = true;
+    while (ok && query.next()) {
+        buffer.append("{\"type\":\"course\",\"semester\":");
+        appendString(buffer, query.value(13).toString());
+        buffer.append(",\"id\":").append(QByteArray::number(query.value(0).toLongLong()));
+        buffer.append(",\"name\":");
+        appendString(buffer, query.value(1).toString());
+        buffer.append(",\"day_of_week\":").append(QByteArray::number(query.value(2).toInt()));
+        buffer.append(",\"start_slot\":").append(QByteArray::number(query.value(3).toInt()));
+        buffer.append(",\"end_slot\":").append(QByteArray::number(query.value(4).toInt()));
+        buffer.append(",\"location\":");
+        appendString(buffer, query.value(5).toString());
+        buffer.append(",\"start_date\":");
+        appendDate(buffer, query.value(6).toString());
+        buffer.append(",\"end_date\":");
+        appendDate(buffer, query.value(7).toString());
+        buffer.append(",\"teacher\":");
+        appendString(buffer, query.value(8).toString());
+        buffer.append(",\"exam_date\":");
+        appendDate(buffer, query.value(9).toString());
+        buffer.append(",\"course_type\":");
+        appendString(buffer, query.value(10).toString());
+        buffer.append(",\"credits\":").append(QByteArray::number(query.value(11).toDouble(), 'g', 15));
+        const qint64 mask = query.value(12).isNull() ? qint64(CourseData::AllWeeks) : query.value(12).toLongLong();
+        buffer.append(",\"week_mask\":").append(QByteArray::number(mask));
+        buffer.append("}\n");
+        ++result.courses;
+        ++result.lines;
+
+        ok = file.flushIfFull();
+        if (ok && progress && result.courses % ProgressStep == 0 && !progress(result.courses, total)) {
+            result.canceled = true;
+            ok = false;
+        }
+    }
+
+    if (ok && progress && !progress(result.courses, total)) {
+        result.canceled = true;
+        ok = false;
+    }
+
+    result.ok = file.finish(ok, result.canceled, &result.error);
+    result.bytes = file.bytes();
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+JsonLines::Result JsonLines::importFrom(const QSqlDatabase &db, const ImportOptions &options,
+                                        const ProgressCallback &progress)
+{
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(options.filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.error = file.errorString();
+        return result;
+    }
+    const qint64 total = file.size();
+
+    auto report = [&result](const QString &message) {
+        ++result.errorCount;
+        if (result.errors.size() < MaxReportedErrors) {
+            result.errors << QString("第 %1 行：%2").arg(result.lines).arg(message);
+        }
+    };
+
+    // 学期和教室都不多，先整体读入，导入过程中只在内存里查
+    QSet<QString> knownSemesters;
+    QHash<QString, int> rooms;
+    QSqlQuery query(db);
+    if (!query.exec("SELECT name FROM semesters")) {
+        result.error = query.lastError().text();
+        return result;
+    }
+    while (query.next()) knownSemesters.insert(query.value(0).toString());
+    if (query.exec("SELECT id, name FROM rooms")) {
+        while (query.next()) rooms.insert(query.value(1).toString(), query.value(0).toInt());
+    }
+
+    if (!query.exec("BEGIN")) {
+        result.error = query.lastError().text();
+        return result;
+    }
+
+    // 整个导入记为修改日志中的一个批次：替换掉的课程记为删除，导入的课程记为新增，可以整体撤回。
+    // 自增 id 只增不减，提交前按 id 读回本次插入的课程补记新增，不必逐条取 lastInsertId
+    CourseJournal journal(db.connectionName());
+    const QString summary = QString("导入 JSON Lines：%1").arg(QFileInfo(options.filePath).fileName());
+    if (!query.exec("SELECT IFNULL(MAX(id), 0) FROM courses") || !query.next()) {
+        result.error = query.lastError().text();
+        query.exec("ROLLBACK");
+        return result;
+    }
+    const qint64 lastId = query.value(0).toLongLong();
+
+    QSqlQuery insert(db);
+    insert.prepare("INSERT INTO courses (name, day_of_week, start_slot, end_slot, location, start_date, end_date, "
+                   "teacher, exam_date, course_type, credits, week_mask, room_id, semester) "
+                   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    QSqlQuery upsertSemester(db);
+    upsertSemester.prepare("INSERT INTO semesters (name, start_date, end_date) VALUES (?, ?, ?) "
+                           "ON CONFLICT(name) DO UPDATE SET start_date=excluded.start_date, end_date=excluded.end_date");
+    QSqlQuery registerRoom(db);
+    registerRoom.prepare("INSERT INTO rooms (name, building) VALUES (?, ?)");
+
+    CourseBatch batch;
+    auto flushBatch = [&]() {
+        if (batch.size() == 0) return true;
+        for (QVariantList *column : {&batch.names, &batch.days, &batch.starts, &batch.ends, &batch.locations,
+                                     &batch.startDates, &batch.endDates, &batch.teachers, &batch.exams,
+                                     &batch.types, &batch.credits, &batch.masks, &batch.rooms, &batch.semesters}) {
+            insert.addBindValue(*column);
+        }
+        const bool ok = insert.execBatch();
+        if (ok) result.courses += batch.size();
+        else result.error = insert.lastError().text();
+        batch.clear();
+        return ok;
+    };
+
+    // replaceSemesters：每个学期第一次出现时清空其原有课程，之后的行照常追加
+    QSet<QString> replacedSemesters;
+    auto replaceSemester = [&](const QString &semester) {
+        if (!options.replaceSemesters || replacedSemesters.contains(semester)) return true;
+        replacedSemesters.insert(semester);
+
+        // 被替换的课程连同选课学生记入日志，必须在删除之前读取
+        QHash<int, QVector<int>> students;
+        QSqlQuery old(db);
+        old.setForwardOnly(true);
+        old.prepare("SELECT course_id, student_id FROM enrollments "
+                    "WHERE course_id IN (SELECT id FROM courses WHERE semester=?)");
+        old.addBindValue(semester);
+        bool logged = old.exec();
+        while (logged && old.next()) students[old.value(0).toInt()].append(old.value(1).toInt());
+        if (logged) {
+            old.prepare(QString("SELECT %1 FROM courses WHERE semester=?").arg(JournalColumns));
+            old.addBindValue(semester);
+            logged = old.exec();
+        }
+        while (logged && old.next()) {
+            const CourseData course = journalCourse(old);
+            journal.recordDelete(semester, course, students.value(course.id));
+            if (journal.pendingCount() >= BatchSize) logged = journal.flushPart(summary);
+        }
+        if (!logged) {
+            result.error = old.lastError().isValid() ? old.lastError().text() : QString("无法写入修改日志");
+            return false;
+        }
+
+        QSqlQuery remove(db);
+        remove.prepare("DELETE FROM enrollments WHERE course_id IN (SELECT id FROM courses WHERE semester=?)");
+        remove.addBindValue(semester);
+        bool ok = remove.exec();
+        if (ok) {
+            remove.prepare("DELETE FROM courses WHERE semester=?");
+            remove.addBindValue(semester);
+            ok = remove.exec();
+            if (ok) result.replaced += remove.numRowsAffected();
+        }
+        if (!ok) result.error = remove.lastError().text();
+        return ok;
+    };
+
+    auto roomIdFor = [&](const QString &location) {
+        const QString name = location.trimmed();
+        if (name.isEmpty()) return -1;
+        auto it = rooms.constFind(name);
+        if (it != rooms.constEnd()) return it.value();
+
+        // 与手工录入一致，新出现的地点登记到教室库
+        const int space = name.indexOf(' ');
+        registerRoom.addBindValue(name);
+        registerRoom.addBindValue(space > 0 ? name.left(space) : QString());
+        const int id = registerRoom.exec() ? registerRoom.lastInsertId().toInt() : -1;
+        rooms.insert(name, id);
+        return id;
+    };
+
+    bool ok = true;
+    bool sawRecord = false;
+    QByteArray line;
+    while (ok && !file.atEnd()) {
+        line = file.readLine(MaxLineLength + 1);
+        ++result.lines;
+
+        if (progress && result.lines % ProgressStep == 0 && !progress(file.pos(), total)) {
+            result.canceled = true;
+            ok = false;
+            break;
+        }
+
+        if (line.size() > MaxLineLength && !line.endsWith('\n')) {
+            // 跳过这一行剩下的部分，内存占用不随行长增长
+            while (!file.atEnd() && !line.endsWith('\n')) line = file.readLine(BackgroundIo::BufferSize);
+            report(QString("超过 %1 KB，已跳过").arg(MaxLineLength / 1024));
+            continue;
+        }
+
+        const char *begin = line.constData();
+        const char *end = begin + line.size();
+        if (result.lines == 1 && line.startsWith("\xEF\xBB\xBF")) begin += 3;
+        while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+        while (end > begin && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) --end;
+        if (begin == end) continue;
+
+        Record record;
+        const QString problem = parseRecord(begin, end, &record);
+        if (!problem.isEmpty()) {
+            report(problem);
+            continue;
+        }
+        const bool first = !sawRecord;
+        sawRecord = true;
+
+        if (record.type == "header") {
+            if (!first) {
+                report("header 只能出现在第一行");
+                continue;
+            }
+            if (record.has(Format) && record.strings[Format] != FormatName) {
+                result.error = QString("不是课程数据文件（format 为 %1）").arg(record.strings[Format]);
+                ok = false;
+                break;
+            }
+            qint64 schema = 0;
+            if (!record.has(Schema) || !integerField(record, Schema, &schema) || schema < 1) {
+                result.error = "header 中的 schema 无效";
+                ok = false;
+                break;
+            }
+            if (schema > SchemaVersion) {
+                result.error = QString("文件格式版本 %1 高于支持的版本 %2，请先升级程序").arg(schema).arg(SchemaVersion);
+                ok = false;
+                break;
+            }
+            continue;
+        }
+
+        if (record.type == "semester") {
+            const QString name = record.strings[Name].trimmed();
+            const QDate start = QDate::fromString(record.strings[StartDate], Qt::ISODate);
+            const QDate end = QDate::fromString(record.strings[EndDate], Qt::ISODate);
+            if (name.isEmpty()) {
+                report("学期缺少 name");
+            } else if (!start.isValid() || !end.isValid() || start >= end) {
+                report(QString("学期「%1」的起止日期无效").arg(name));
+            } else {
+                upsertSemester.addBindValue(name);
+                upsertSemester.addBindValue(start.toString(Qt::ISODate));
+                upsertSemester.addBindValue(end.toString(Qt::ISODate));
+                ok = upsertSemester.exec() && replaceSemester(name);
+                if (!ok && result.error.isEmpty()) result.error = upsertSemester.lastError().text();
+                knownSemesters.insert(name);
+                ++result.semesters;
+            }
+            continue;
+        }
+
+        if (record.type != "course") {
+            report(QString("未知的记录类型 %1").arg(record.type));
+            continue;
+        }
+
+        // 课程：必填字段、取值范围都检查过才进入批次
+        CourseData course;
+        qint64 day = 0, startSlot = 0, endSlot = 0, weekMask = CourseData::AllWeeks;
+        const QString semester = record.has(Semester) ? record.strings[Semester].trimmed() : options.defaultSemester;
+        course.name = record.strings[Name].trimmed();
+        course.location = record.strings[Location].trimmed();
+        course.teacher = record.strings[Teacher].trimmed();
+        course.startDate = QDate::fromString(record.strings[StartDate], Qt::ISODate);
+        course.endDate = QDate::fromString(record.strings[EndDate], Qt::ISODate);
+        course.examDate = QDate::fromString(record.strings[ExamDate], Qt::ISODate);
+        if (record.has(CourseType) && !record.strings[CourseType].trimmed().isEmpty()) {
+            course.courseType = record.strings[CourseType].trimmed();
+        } else {
+            course.courseType = "必修";
+        }
+        course.credits = record.numbers[Credits];
+
+        QString invalid;
+        if (course.name.isEmpty()) {
+            invalid = "课程缺少 name";
+        } else if (!knownSemesters.contains(semester)) {
+            invalid = semester.isEmpty() ? "课程缺少 semester" : QString("学期「%1」不存在").arg(semester);
+        } else if (!record.has(DayOfWeek) || !integerField(record, DayOfWeek, &day) || day < 1 || day > 7) {
+            invalid = "day_of_week 应为 1-7";
+        } else if (!record.has(StartSlot) || !record.has(EndSlot) || !integerField(record, StartSlot, &startSlot)
+                   || !integerField(record, EndSlot, &endSlot) || startSlot < 1 || endSlot < startSlot
+                   || endSlot > OccupancyIndex::SlotsPerDay) {
+            invalid = QString("节次应在 1-%1 之间且 start_slot 不大于 end_slot").arg(OccupancyIndex::SlotsPerDay);
+        } else if (!course.startDate.isValid() || !course.endDate.isValid() || course.startDate > course.endDate) {
+            invalid = "start_date/end_date 无效";
+        } else if (record.has(ExamDate) && !record.strings[ExamDate].isEmpty() && !course.examDate.isValid()) {
+            invalid = "exam_date 无效";
+        } else if (!std::isfinite(course.credits) || course.credits < 0) {
+            invalid = "credits 不能为负数";
+        } else if (record.has(WeekMask) && (!integerField(record, WeekMask, &weekMask) || weekMask <= 0
+                                            || weekMask > qint64(CourseData::AllWeeks))) {
+            invalid = "week_mask 应为 1-4294967295";
+        }
+        if (!invalid.isEmpty()) {
+            report(QString("「%1」%2").arg(course.name, invalid));
+            continue;
+        }
+
+        course.dayOfWeek = int(day);
+        course.startSlot = int(startSlot);
+        course.endSlot = int(endSlot);
+        course.weekMask = quint32(weekMask);
+
+        if (!replaceSemester(semester)) {
+            ok = false;
+            break;
+        }
+        batch.append(course, roomIdFor(course.location), semester);
+        if (batch.size() >= BatchSize) ok = flushBatch();
+    }
+
+    if (ok) ok = flushBatch();
+    if (ok && progress && !progress(total, total)) {
+        result.canceled = true;
+        ok = false;
+    }
+
+    if (ok) {
+        QSqlQuery added(db);
+        added.setForwardOnly(true);
+        added.prepare(QString("SELECT %1 FROM courses WHERE id > ? ORDER BY id").arg(JournalColumns));
+        added.addBindValue(lastId);
+        ok = added.exec();
+        while (ok && added.next()) {
+            journal.recordInsert(added.value(13).toString(), journalCourse(added));
+            if (journal.pendingCount() >= BatchSize) ok = journal.flushPart(summary);
+        }
+        if (ok) ok = journal.flushPart(summary);
+        journal.endBatch();
+        if (!ok) result.error = added.lastError().isValid() ? added.lastError().text() : QString("无法写入修改日志");
+    }
+    if (ok && !query.exec("COMMIT")) {
+        result.error = query.lastError().text();
+        ok = false;
+    }
+    if (!ok) {
+        query.exec("ROLLBACK");
+        qDebug() << "JSON Lines import rolled back at line" << result.lines << ":" << result.error;
+    }
+
+    result.ok = ok;
+    result.bytes = total;
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
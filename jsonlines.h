@@ -0,0 +1,90 @@
+#ifndef JSONLINES_H
+#define JSONLINES_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+
+// 课程与学期的 JSON Lines 导入导出，供教务系统等外部流程对接。
+// 每行一个 JSON 对象，用 type 区分：
+//   {"type":"header","format":"sourcemanager-courses","schema":1,"exported":"2026-10-19T08:00:00"}
+//   {"type":"semester","name":"2025-2026-1","start_date":"2025-09-01","end_date":"2026-01-18"}
+//   {"type":"course","semester":"2025-2026-1","id":12,"name":"高等数学","day_of_week":1,"start_slot":1,
+//    "end_slot":2,"location":"厚德楼 B601","start_date":"2025-09-01","end_date":"2026-01-18","teacher":"张三",
+//    "exam_date":null,"course_type":"必修","credits":4,"week_mask":4294967295}
+// schema 只在不兼容的修改时加一；导入时遇到更高的版本整体拒绝，未知字段忽略，没有 header 按版本 1 处理。
+// 课程 id 只供对照，导入时由本地数据库重新分配；缺少 semester 的课程归入 ImportOptions::defaultSemester。
+//
+// 导出与 CsvExporter 相同：只进游标逐行读取，经 1 MB 缓冲区写入 QSaveFile。
+// 导入逐行读取、原地解析（不构造 QJsonDocument），课程攒够 BatchSize 条用 execBatch 写入，
+// 内存占用与文件大小无关。整个导入在一个事务中，出错的行跳过并记录行号和原因，其余照常导入；
+// 取消或数据库出错时全部回滚。整个导入在同一事务中记为修改日志的一个批次（替换掉的课程为删除，导入的课程为新增），可以整体撤回。
+class JsonLines : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int SchemaVersion = 1;
+    static constexpr int BatchSize = 500;
+    static constexpr int MaxLineLength = 1 << 20;   // 超过 1 MB 的行视为损坏
+    static constexpr int MaxReportedErrors = 200;   // 只保留前这么多条错误的详情
+
+    struct ExportOptions {
+        QString filePath;
+        QStringList semesters;   // 为空表示全部学期
+    };
+
+    struct ImportOptions {
+        QString filePath;
+        QString defaultSemester;
+        bool replaceSemesters = false; // 文件中出现的学期先清空原有课程，便于重复导入同一份数据
+    };
+
+    struct Result {
+        bool ok = false;
+        bool canceled = false;
+        int lines = 0;
+        int semesters = 0;
+        int courses = 0;
+        int replaced = 0;        // 因 replaceSemesters 删除的原有课程
+        int errorCount = 0;
+        QStringList errors;      // "第 n 行：原因"，最多 MaxReportedErrors 条
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+        QString error;           // 整体失败的原因
+    };
+
+    // 导出按课程数，导入按已读字节数报告进度；返回 false 表示取消
+    using ProgressCallback = std::function<bool(qint64 done, qint64 total)>;
+
+    explicit JsonLines(QObject *parent = nullptr);
+    ~JsonLines();
+
+    // 在线程池中使用独立连接导出/导入，完成后发出 finished
+    void startExport(const QString &databasePath, const ExportOptions &options);
+    void startImport(const QString &databasePath, const ImportOptions &options);
+    void cancel();
+    bool isRunning() const;
+
+    // 同步版本，使用调用线程上已打开的连接
+    static Result exportTo(const QSqlDatabase &db, const ExportOptions &options,
+                           const ProgressCallback &progress = ProgressCallback());
+    static Result importFrom(const QSqlDatabase &db, const ImportOptions &options,
+                             const ProgressCallback &progress = ProgressCallback());
+
+signals:
+    void progressChanged(qint64 done, qint64 total);
+    void finished(const JsonLines::Result &result);
+
+private:
+    using Job = std::function<Result(const QSqlDatabase &db)>;
+    void run(const QString &databasePath, const Job &job);
+
+    QFutureWatcher<Result> m_watcher;
+    std::atomic<bool> m_canceled;
+};
+
+#endif // JSONLINES_H
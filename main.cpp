@@ -1,5 +1,8 @@
 ﻿#include "mainwindow.h"
+#include "snapshotsource.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QMessageBox>
 
 int main(int argc, char *argv[])
 {
@@ -14,8 +17,22 @@ int main(int argc, char *argv[])
     QFont font("Microsoft YaHei", 10);
     app.setFont(font);
 
-    MainWindow window;
-    window.setWindowTitle("课程管理系统 v3.0 - 完整功能版");
+    // --viewer <快照文件>：只读浏览模式，供教室大屏、自助终端使用，不创建数据库
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption viewerOption("viewer", "以只读方式浏览学期快照", "snapshot");
+    parser.addOption(viewerOption);
+    parser.process(app);
+
+    SnapshotSource snapshot;
+    const bool viewer = parser.isSet(viewerOption);
+    if (viewer && !snapshot.open(parser.value(viewerOption))) {
+        QMessageBox::critical(nullptr, "打开快照失败", snapshot.errorString());
+        return 1;
+    }
+
+    MainWindow window(viewer ? &snapshot : nullptr);
+    window.setWindowTitle(viewer ? "课程管理系统 v3.0 - 只读浏览" : "课程管理系统 v3.0 - 完整功能版");
     window.resize(1200, 800);
     window.show();
 
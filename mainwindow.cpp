@@ -1,6 +1,13 @@
 ﻿
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "refreshscratch.h"
+#include "conflictaudit.h"
+#include "timetablesolver.h"
+#include "examscheduler.h"
+#include "csvexporter.h"
+#include "jsonlines.h"
+#include "backupchain.h"
 #include <QLabel>
 #include <QPushButton>
 #include <QTableWidget>
@@ -11,6 +18,7 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QDateEdit>
+#include <QDateTimeEdit>
 #include <QComboBox>
 #include <QLineEdit>
 #include <QDialog>
@@ -27,13 +35,29 @@
 #include <QProgressBar>
 #include <QFrame>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QSequentialAnimationGroup>
 #include <QPauseAnimation>
+#include <QApplication>
+#include <QCheckBox>
+#include <QShortcut>
+#include <QRegularExpression>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget *parent)
+    : MainWindow(nullptr, parent)
+{
+}
+
+MainWindow::MainWindow(CourseSource *readOnlySource, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , m_courseManager(new CourseManager(this))
+    , m_courseManager(readOnlySource ? nullptr : new CourseManager(this))
+    , m_source(readOnlySource ? readOnlySource : m_courseManager)
+    , m_backup(nullptr)
+    , m_analytics(m_courseManager ? new CourseAnalytics(m_courseManager, this) : nullptr)
     , m_clockTimer(new QTimer(this))
     , m_courseTable(nullptr)
     , m_weekLabel(nullptr)
@@ -42,6 +66,10 @@ MainWindow::MainWindow(QWidget *parent)
     , m_searchBtn(nullptr)
     , m_exportBtn(nullptr)
     , m_backupBtn(nullptr)
+    , m_undoBtn(nullptr)
+    , m_redoBtn(nullptr)
+    , m_summaryLabel(nullptr)
+    , m_scenarioLabel(nullptr)
     ,m_isDarkMode(false)
     ,m_canNavigateToNextWeek(true)
 {
@@ -56,6 +84,37 @@ MainWindow::MainWindow(QWidget *parent)
     updateWeekDisplay();
     populateCourseTable();
 
+    if (m_courseManager) {
+        // 状态栏显示学分汇总，课程变化时直接读取增量维护的结果
+        m_summaryLabel = new QLabel(this);
+        m_summaryLabel->setStyleSheet("color: #475569; padding: 0 8px;");
+        ui->statusbar->addPermanentWidget(m_summaryLabel, 1);
+        connect(m_courseManager, &CourseManager::dataChanged, this, &MainWindow::updateCreditSummary);
+        updateCreditSummary();
+
+        // 假设方案进行中时在状态栏醒目提示，避免误以为修改已经保存
+        m_scenarioLabel = new QLabel(this);
+        m_scenarioLabel->setStyleSheet("color: white; background: #f59e0b; border-radius: 8px; padding: 2px 10px; font-weight: 600;");
+        ui->statusbar->addWidget(m_scenarioLabel);
+        connect(m_courseManager, &CourseManager::dataChanged, this, &MainWindow::updateScenarioStatus);
+        updateScenarioStatus();
+
+        connect(m_courseManager, &CourseManager::dataChanged, this, &MainWindow::updateUndoButtons);
+        updateUndoButtons();
+        QShortcut *undoShortcut = new QShortcut(QKeySequence::Undo, this);
+        connect(undoShortcut, &QShortcut::activated, this, &MainWindow::onUndo);
+        QShortcut *redoShortcut = new QShortcut(QKeySequence::Redo, this);
+        connect(redoShortcut, &QShortcut::activated, this, &MainWindow::onRedo);
+
+        // 备份在后台线程进行，完成后才恢复按钮并提示结果
+        m_backup = new DatabaseBackup(this);
+        connect(m_backup, &DatabaseBackup::finished, this, &MainWindow::onBackupFinished);
+    } else {
+        QLabel *readOnlyLabel = new QLabel(QString("🔒 只读浏览：%1").arg(m_source->getCurrentSemester()), this);
+        readOnlyLabel->setStyleSheet("color: white; background: #0ea5e9; border-radius: 8px; padding: 2px 10px; font-weight: 600;");
+        ui->statusbar->addWidget(readOnlyLabel);
+    }
+
     // 连接时钟定时器
     connect(m_clockTimer, &QTimer::timeout, this, &MainWindow::updateClock);
     m_clockTimer->start(1000); // 每秒更新一次
@@ -203,11 +262,10 @@ void MainWindow::setupUI()
     m_courseTable->setHorizontalHeaderLabels(headers);
 
     // 设置时间列
-    QStringList timeSlots = {
-        "08:00-08:45", "08:55-09:40", "09:50-10:35", "10:45-11:30",
-        "14:00-14:45", "14:55-15:40", "15:50-16:35", "16:45-17:30",
-        "19:00-19:45", "19:55-20:40"
-    };
+    QStringList timeSlots;
+    for (int slot = 1; slot <= 10; ++slot) {
+        timeSlots << CourseManager::slotStartTime(slot).toString("HH:mm") + "-" + CourseManager::slotEndTime(slot).toString("HH:mm");
+    }
 
     for (int i = 0; i < timeSlots.size(); ++i) {
         QTableWidgetItem *timeItem = new QTableWidgetItem(timeSlots[i]);
@@ -271,6 +329,16 @@ void MainWindow::setupUI()
     addBtn->setStyleSheet(actionButtonStyle);
     connect(addBtn, &QPushButton::clicked, this, &MainWindow::onAddCourse);
 
+    m_undoBtn = new QPushButton("↩️ 撤销", this);
+    m_undoBtn->setObjectName("actionButton");
+    m_undoBtn->setStyleSheet(actionButtonStyle);
+    connect(m_undoBtn, &QPushButton::clicked, this, &MainWindow::onUndo);
+
+    m_redoBtn = new QPushButton("↪️ 重做", this);
+    m_redoBtn->setObjectName("actionButton");
+    m_redoBtn->setStyleSheet(actionButtonStyle);
+    connect(m_redoBtn, &QPushButton::clicked, this, &MainWindow::onRedo);
+
     // 添加设置学期按钮
     QPushButton *semesterBtn = new QPushButton("📅 设置学期", this);
     semesterBtn->setObjectName("actionButton");
@@ -292,17 +360,117 @@ void MainWindow::setupUI()
     m_exportBtn->setStyleSheet(actionButtonStyle);
     connect(m_exportBtn, &QPushButton::clicked, this, &MainWindow::onExport);
 
+    QPushButton *importIcsBtn = new QPushButton("📥 导入日历", this);
+    importIcsBtn->setObjectName("actionButton");
+    importIcsBtn->setStyleSheet(actionButtonStyle);
+    importIcsBtn->setToolTip("从 .ics 文件导入课程，重复事件合并为一门课");
+    connect(importIcsBtn, &QPushButton::clicked, this, &MainWindow::onImportIcs);
+
+    QPushButton *importJsonBtn = new QPushButton("🔗 导入 JSONL", this);
+    importJsonBtn->setObjectName("actionButton");
+    importJsonBtn->setStyleSheet(actionButtonStyle);
+    importJsonBtn->setToolTip("从 JSON Lines 文件批量导入学期和课程");
+    connect(importJsonBtn, &QPushButton::clicked, this, &MainWindow::onImportJsonLines);
+
+    QPushButton *importSnapshotBtn = new QPushButton("📦 导入快照", this);
+    importSnapshotBtn->setObjectName("actionButton");
+    importSnapshotBtn->setStyleSheet(actionButtonStyle);
+    connect(importSnapshotBtn, &QPushButton::clicked, this, &MainWindow::onImportSnapshot);
+
     m_backupBtn = new QPushButton("💾 备份数据", this);
     m_backupBtn->setObjectName("actionButton");
     m_backupBtn->setStyleSheet(actionButtonStyle);
     connect(m_backupBtn, &QPushButton::clicked, this, &MainWindow::onBackup);
 
+    QPushButton *restoreBtn = new QPushButton("♻️ 恢复备份", this);
+    restoreBtn->setObjectName("actionButton");
+    restoreBtn->setStyleSheet(actionButtonStyle);
+    connect(restoreBtn, &QPushButton::clicked, this, &MainWindow::onRestoreBackup);
+
+    QPushButton *historyBtn = new QPushButton("🕘 操作历史", this);
+    historyBtn->setObjectName("actionButton");
+    historyBtn->setStyleSheet(actionButtonStyle);
+    historyBtn->setToolTip("查看课程修改记录，撤销操作或恢复到某个时间点");
+    connect(historyBtn, &QPushButton::clicked, this, &MainWindow::onShowHistory);
+
+    QPushButton *diagnosticsBtn = new QPushButton("📊 内存诊断", this);
+    diagnosticsBtn->setObjectName("actionButton");
+    diagnosticsBtn->setStyleSheet(actionButtonStyle);
+    connect(diagnosticsBtn, &QPushButton::clicked, this, &MainWindow::onShowDiagnostics);
+
+    QPushButton *auditBtn = new QPushButton("🔍 冲突审计", this);
+    auditBtn->setObjectName("actionButton");
+    auditBtn->setStyleSheet(actionButtonStyle);
+    connect(auditBtn, &QPushButton::clicked, this, &MainWindow::onConflictAudit);
+
+    QPushButton *freeSlotBtn = new QPushButton("🕒 空闲时段", this);
+    freeSlotBtn->setObjectName("actionButton");
+    freeSlotBtn->setStyleSheet(actionButtonStyle);
+    connect(freeSlotBtn, &QPushButton::clicked, this, &MainWindow::onFindFreeSlots);
+
+    QPushButton *scheduleBtn = new QPushButton("🤖 自动排课", this);
+    scheduleBtn->setObjectName("actionButton");
+    scheduleBtn->setStyleSheet(actionButtonStyle);
+    connect(scheduleBtn, &QPushButton::clicked, this, &MainWindow::onAutoSchedule);
+
+    QPushButton *examBtn = new QPushButton("📝 考试安排", this);
+    examBtn->setObjectName("actionButton");
+    examBtn->setStyleSheet(actionButtonStyle);
+    connect(examBtn, &QPushButton::clicked, this, &MainWindow::onScheduleExams);
+
+    QPushButton *roomBtn = new QPushButton("🏫 教室管理", this);
+    roomBtn->setObjectName("actionButton");
+    roomBtn->setStyleSheet(actionButtonStyle);
+    connect(roomBtn, &QPushButton::clicked, this, &MainWindow::onManageRooms);
+
+    QPushButton *studentBtn = new QPushButton("👥 学生课表", this);
+    studentBtn->setObjectName("actionButton");
+    studentBtn->setStyleSheet(actionButtonStyle);
+    connect(studentBtn, &QPushButton::clicked, this, &MainWindow::onManageStudents);
+
+    QPushButton *analyticsBtn = new QPushButton("📊 统计报表", this);
+    analyticsBtn->setObjectName("actionButton");
+    analyticsBtn->setStyleSheet(actionButtonStyle);
+    connect(analyticsBtn, &QPushButton::clicked, this, &MainWindow::onShowAnalytics);
+
+    QPushButton *scenarioBtn = new QPushButton("🧪 假设方案", this);
+    scenarioBtn->setObjectName("actionButton");
+    scenarioBtn->setStyleSheet(actionButtonStyle);
+    connect(scenarioBtn, &QPushButton::clicked, this, &MainWindow::onScenario);
+
+    // 只读浏览模式只保留看课表需要的按钮
+    if (m_source->isReadOnly()) {
+        const QList<QPushButton *> editingButtons = {
+            addBtn, m_undoBtn, m_redoBtn, semesterBtn, m_exportBtn, importIcsBtn, importJsonBtn, importSnapshotBtn, m_backupBtn, restoreBtn, historyBtn, diagnosticsBtn,
+            auditBtn, freeSlotBtn, scheduleBtn, examBtn, roomBtn, studentBtn, analyticsBtn, scenarioBtn
+        };
+        for (QPushButton *button : editingButtons) {
+            button->hide();
+        }
+    }
+
     buttonLayout->addWidget(addBtn);
+    buttonLayout->addWidget(m_undoBtn);
+    buttonLayout->addWidget(m_redoBtn);
     buttonLayout->addWidget(semesterBtn);  // 添加设置学期按钮
     buttonLayout->addWidget(themeBtn);
     buttonLayout->addWidget(refreshBtn);
     buttonLayout->addWidget(m_exportBtn);
+    buttonLayout->addWidget(importIcsBtn);
+    buttonLayout->addWidget(importJsonBtn);
+    buttonLayout->addWidget(importSnapshotBtn);
     buttonLayout->addWidget(m_backupBtn);
+    buttonLayout->addWidget(restoreBtn);
+    buttonLayout->addWidget(historyBtn);
+    buttonLayout->addWidget(diagnosticsBtn);
+    buttonLayout->addWidget(auditBtn);
+    buttonLayout->addWidget(freeSlotBtn);
+    buttonLayout->addWidget(scheduleBtn);
+    buttonLayout->addWidget(examBtn);
+    buttonLayout->addWidget(roomBtn);
+    buttonLayout->addWidget(studentBtn);
+    buttonLayout->addWidget(analyticsBtn);
+    buttonLayout->addWidget(scenarioBtn);
     buttonLayout->addStretch();
 
     mainLayout->addLayout(buttonLayout);
@@ -467,9 +635,9 @@ void MainWindow::updateWeekDisplay()
     QDate weekEnd = m_currentWeekStart.addDays(6);
 
     // 计算当前是第几周
-    QDate semesterStart = m_courseManager->getSemesterStartDate();
+    QDate semesterStart = m_source->getSemesterStartDate();
     int weekNumber = (semesterStart.daysTo(m_currentWeekStart) / 7) + 1;
-    int totalWeeks = m_courseManager->getSemesterWeeks();
+    int totalWeeks = m_source->getSemesterWeeks();
 
     // 确保周数在合理范围内
     weekNumber = qMax(1, qMin(totalWeeks, weekNumber));
@@ -548,6 +716,63 @@ QColor MainWindow::getCourseColor(const QString &courseType)
         }
     }
 }
+void MainWindow::updateCreditSummary()
+{
+    if (!m_summaryLabel) return;
+
+    static const QStringList dayNames = {"周一", "周二", "周三", "周四", "周五", "周六", "周日"};
+    const CreditSummary &summary = m_courseManager->creditSummary();
+
+    QStringList types;
+    for (auto it = summary.byType.constBegin(); it != summary.byType.constEnd(); ++it) {
+        types << QString("%1 %2").arg(it.key().isEmpty() ? "未分类" : it.key()).arg(it.value().credits());
+    }
+    types.sort();
+
+    m_summaryLabel->setText(QString("📚 本学期 %1 门课程 · 共 %2 学分 · 每周 %3 节%4")
+                                .arg(summary.total.courseCount)
+                                .arg(summary.total.credits())
+                                .arg(summary.total.slotCount)
+                                .arg(types.isEmpty() ? QString() : "（" + types.join("，") + "）"));
+
+    QStringList lines;
+    QStringList days;
+    for (int day = 0; day < 7; ++day) {
+        const CreditSummary::Bucket &bucket = summary.byWeekday[day];
+        if (bucket.courseCount > 0) {
+            days << QString("%1 %2 节").arg(dayNames.at(day)).arg(bucket.slotCount);
+        }
+    }
+    if (!days.isEmpty()) lines << "按星期：" + days.join("，");
+
+    QStringList teachers;
+    for (auto it = summary.byTeacher.constBegin(); it != summary.byTeacher.constEnd(); ++it) {
+        teachers << QString("%1：%2 门 / %3 学分 / 每周 %4 节")
+                        .arg(it.key().isEmpty() ? "未填写教师" : it.key())
+                        .arg(it.value().courseCount)
+                        .arg(it.value().credits())
+                        .arg(it.value().slotCount);
+    }
+    teachers.sort();
+    if (!teachers.isEmpty()) lines << "按教师：\n" + teachers.join("\n");
+    m_summaryLabel->setToolTip(lines.join("\n"));
+}
+
+void MainWindow::updateScenarioStatus()
+{
+    if (!m_scenarioLabel) return;
+
+    if (!m_courseManager->isScenarioActive()) {
+        m_scenarioLabel->hide();
+        return;
+    }
+
+    m_scenarioLabel->setText(QString("🧪 假设方案「%1」· %2 处修改未保存")
+                                 .arg(m_courseManager->scenarioName())
+                                 .arg(m_courseManager->scenarioChangeCount()));
+    m_scenarioLabel->show();
+}
+
 void MainWindow::populateCourseTable()
 {
     if (!m_courseTable) return;
@@ -559,19 +784,16 @@ void MainWindow::populateCourseTable()
     // 清除现有课程内容
     for (int row = 0; row < m_courseTable->rowCount(); ++row) {
         for (int col = 1; col < m_courseTable->columnCount(); ++col) {
-            QTableWidgetItem *item = m_courseTable->item(row, col);
-            if (item) {
-                item->setText("");
-                item->setBackground(QBrush());
-                item->setToolTip("");
-                item->setData(Qt::UserRole, QVariant());
-            }
+            clearCourseCell(row, col);
         }
     }
 
+    // 本次刷新用到的临时文本，同一门课的各节共享
+    RefreshScratch scratch;
+
     try {
-        // 获取当前周的课程
-        QList<CourseData> courses = m_courseManager->getCoursesByWeek(m_currentWeekStart);
+        // 获取当前周的课程（已按周次范围/单双周过滤）
+        QList<CourseData> courses = m_source->getCoursesByWeek(m_currentWeekStart);
 
         for (const CourseData &course : courses) {
             int day = course.dayOfWeek - 1;
@@ -580,59 +802,141 @@ void MainWindow::populateCourseTable()
             // 为课程的每一节都创建独立的显示
             for (int slot = course.startSlot - 1; slot < course.endSlot; ++slot) {
                 if (slot < 0 || slot >= m_courseTable->rowCount()) continue;
+                paintCourseCell(slot, day + 1, course, scratch);
+            }
+        }
+    } catch (...) {
+        qDebug() << "Error populating course table";
+    }
 
-                QTableWidgetItem *item = m_courseTable->item(slot, day + 1);
-                if (!item) {
-                    item = new QTableWidgetItem();
-                    item->setFlags(item->flags() & ~Qt::ItemIsEditable);
-                    m_courseTable->setItem(slot, day + 1, item);
-                }
-
-                // 每节课都显示完整信息
-                QString courseText = QString("%1\n@%2").arg(course.name).arg(course.location);
-                item->setText(courseText);
-                item->setData(Qt::UserRole, course.id); // 每节课都有相同的course id
+    // 恢复信号和更新
+    m_courseTable->blockSignals(false);
+    m_courseTable->setUpdatesEnabled(true);
+    m_courseTable->viewport()->update();
+}
 
-                // 设置颜色和样式
-                QColor courseColor = getCourseColor(course.courseType);
-                item->setBackground(courseColor);
+void MainWindow::refreshCourseCells(const QList<CourseData> &touched)
+{
+    if (!m_courseTable) return;
 
-                // 字体颜色设置在这里：
-                item->setForeground(Qt::black); // 改为黑色字体
+    // 受影响的课程修改前后占用的格子，其余格子保持不动
+    const int columns = m_courseTable->columnCount();
+    QSet<int> cells;
+    for (const CourseData &course : touched) {
+        if (course.dayOfWeek < 1 || course.dayOfWeek > 7) continue;
+        for (int slot = course.startSlot - 1; slot < course.endSlot; ++slot) {
+            if (slot < 0 || slot >= m_courseTable->rowCount()) continue;
+            cells.insert(slot * columns + course.dayOfWeek);
+        }
+    }
+    if (cells.isEmpty()) return;
 
-                item->setTextAlignment(Qt::AlignCenter);
+    m_courseTable->setUpdatesEnabled(false);
+    m_courseTable->blockSignals(true);
 
-                // 设置工具提示
-                QString tooltip = QString("课程: %1\n地点: %2\n时间: 第%3-%4节\n教师: %5\n类型: %6\n学分: %7")
-                                      .arg(course.name)
-                                      .arg(course.location)
-                                      .arg(course.startSlot)
-                                      .arg(course.endSlot)
-                                      .arg(course.teacher.isEmpty() ? "未设置" : course.teacher)
-                                      .arg(course.courseType)
-                                      .arg(course.credits);
+    for (int cell : cells) {
+        clearCourseCell(cell / columns, cell % columns);
+    }
 
-                if (course.examDate.isValid()) {
-                    tooltip += QString("\n考试: %1").arg(course.examDate.toString("yyyy-MM-dd"));
-                }
-                item->setToolTip(tooltip);
+    // 本周课程来自学期缓存，只把落在这些格子里的重新画上
+    RefreshScratch scratch;
+    const QList<CourseData> courses = m_source->getCoursesByWeek(m_currentWeekStart);
+    for (const CourseData &course : courses) {
+        if (course.dayOfWeek < 1 || course.dayOfWeek > 7) continue;
+        for (int slot = course.startSlot - 1; slot < course.endSlot; ++slot) {
+            if (cells.contains(slot * columns + course.dayOfWeek)) {
+                paintCourseCell(slot, course.dayOfWeek, course, scratch);
             }
         }
-    } catch (...) {
-        qDebug() << "Error populating course table";
     }
 
-    // 恢复信号和更新
     m_courseTable->blockSignals(false);
     m_courseTable->setUpdatesEnabled(true);
     m_courseTable->viewport()->update();
 }
+
+void MainWindow::clearCourseCell(int row, int column)
+{
+    QTableWidgetItem *item = m_courseTable->item(row, column);
+    if (item) {
+        item->setText("");
+        item->setBackground(QBrush());
+        item->setToolTip("");
+        item->setData(Qt::UserRole, QVariant());
+    }
+}
+
+void MainWindow::paintCourseCell(int row, int column, const CourseData &course, RefreshScratch &scratch)
+{
+    QTableWidgetItem *item = m_courseTable->item(row, column);
+    if (!item) {
+        item = new QTableWidgetItem();
+        item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+        m_courseTable->setItem(row, column, item);
+    }
+
+    // 每节课都显示完整信息
+    item->setText(scratch.cellText(course));
+    item->setData(Qt::UserRole, course.id); // 每节课都有相同的course id
+
+    // 设置颜色和样式
+    QColor courseColor = getCourseColor(course.courseType);
+    item->setBackground(courseColor);
+
+    // 字体颜色设置在这里：
+    item->setForeground(Qt::black); // 改为黑色字体
+
+    item->setTextAlignment(Qt::AlignCenter);
+
+    // 设置工具提示
+    item->setToolTip(scratch.toolTip(course));
+}
 void MainWindow::onAddCourse()
 {
     animateButton(qobject_cast<QPushButton*>(sender()));
     showAddCourseDialog();
 }
 
+void MainWindow::onUndo()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    if (!m_courseManager || !m_courseManager->canUndo()) return;
+
+    const QString text = m_courseManager->undoText();
+    QList<CourseData> touched;
+    if (m_courseManager->undo(&touched)) {
+        refreshCourseCells(touched);
+        ui->statusbar->showMessage("已撤销：" + text, 3000);
+    } else {
+        QMessageBox::critical(this, "错误", "撤销失败：" + text);
+    }
+}
+
+void MainWindow::onRedo()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    if (!m_courseManager || !m_courseManager->canRedo()) return;
+
+    const QString text = m_courseManager->redoText();
+    QList<CourseData> touched;
+    if (m_courseManager->redo(&touched)) {
+        refreshCourseCells(touched);
+        ui->statusbar->showMessage("已重做：" + text, 3000);
+    } else {
+        QMessageBox::critical(this, "错误", "重做失败：" + text);
+    }
+}
+
+void MainWindow::updateUndoButtons()
+{
+    if (!m_undoBtn || !m_courseManager) return;
+
+    m_undoBtn->setEnabled(m_courseManager->canUndo());
+    m_redoBtn->setEnabled(m_courseManager->canRedo());
+    m_undoBtn->setToolTip(m_undoBtn->isEnabled() ? "撤销：" + m_courseManager->undoText() + "（Ctrl+Z）" : QString());
+    m_redoBtn->setToolTip(m_redoBtn->isEnabled() ? "重做：" + m_courseManager->redoText() + "（Ctrl+Y）" : QString());
+}
+
 
 
 void MainWindow::onRefresh()
@@ -675,7 +979,8 @@ void MainWindow::onSearch()
         return;
     }
 
-    QList<CourseData> courses = m_courseManager->searchCourses(keyword);
+    QList<CourseData> courses = m_source->searchCourses(keyword);
+    RefreshScratch scratch;
 
     // 清除表格
     for (int row = 0; row < m_courseTable->rowCount(); ++row) {
@@ -706,14 +1011,11 @@ void MainWindow::onSearch()
             }
 
             // 使用相同的显示逻辑
-            QString courseText;
             if (slot == course.startSlot - 1) {
-                courseText = QString("%1\n@%2").arg(course.name).arg(course.location);
+                item->setText(scratch.cellText(course));
             } else {
-                courseText = QString("↳ %1").arg(course.name);
+                item->setText(scratch.continuationText(course));
             }
-
-            item->setText(courseText);
             item->setData(Qt::UserRole, course.id);
 
             QColor courseColor = getCourseColor(course.courseType);
@@ -721,12 +1023,7 @@ void MainWindow::onSearch()
             item->setForeground(Qt::white);
             item->setTextAlignment(Qt::AlignCenter);
 
-            QString tooltip = QString("课程: %1\n地点: %2\n时间: 第%3-%4节\n教师: %5\n类型: %6\n学分: %7")
-                                  .arg(course.name).arg(course.location)
-                                  .arg(course.startSlot).arg(course.endSlot)
-                                  .arg(course.teacher.isEmpty() ? "未设置" : course.teacher)
-                                  .arg(course.courseType).arg(course.credits);
-            item->setToolTip(tooltip);
+            item->setToolTip(scratch.toolTip(course));
         }
     }
 }
@@ -734,105 +1031,742 @@ void MainWindow::onSearch()
 void MainWindow::onExport()
 {
     animateButton(qobject_cast<QPushButton*>(sender()));
+    showExportDialog();
+}
+
+void MainWindow::showExportDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("导出课程数据");
+    dialog.resize(520, 480);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    QGroupBox *semesterGroup = new QGroupBox("📅 导出学期");
+    QVBoxLayout *semesterLayout = new QVBoxLayout(semesterGroup);
+    QList<QCheckBox *> semesterChecks;
+    for (const QString &semester : m_courseManager->getSemesters()) {
+        QCheckBox *check = new QCheckBox(semester);
+        check->setChecked(semester == m_courseManager->getCurrentSemester());
+        semesterChecks << check;
+        semesterLayout->addWidget(check);
+    }
+    mainLayout->addWidget(semesterGroup);
+
+    QGroupBox *optionGroup = new QGroupBox("⚙️ 选项");
+    QVBoxLayout *optionLayout = new QVBoxLayout(optionGroup);
+    QCheckBox *bomCheck = new QCheckBox("写入 UTF-8 BOM（用 Excel 打开时中文不乱码）");
+    bomCheck->setChecked(true);
+    optionLayout->addWidget(bomCheck);
+    QCheckBox *compressCheck = new QCheckBox("压缩快照（文件更小，打开时需要先解压）");
+    optionLayout->addWidget(compressCheck);
+    if (m_courseManager->isScenarioActive()) {
+        QLabel *scenarioHint = new QLabel("⚠️ CSV 导出的是数据库中已保存的数据，不包含未提交的假设方案");
+        scenarioHint->setWordWrap(true);
+        scenarioHint->setStyleSheet("color: #b45309; font-size: 12px; font-weight: normal;");
+        optionLayout->addWidget(scenarioHint);
+    }
+    mainLayout->addWidget(optionGroup);
+
+    QLabel *statusLabel = new QLabel("选择学期后开始导出");
+    statusLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    QProgressBar *progressBar = new QProgressBar();
+    progressBar->setRange(0, 1);
+    progressBar->setValue(0);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addWidget(progressBar);
+    mainLayout->addStretch();
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *icsBtn = new QPushButton("📅 导出日历");
+    QPushButton *exportBtn = new QPushButton("📤 导出");
+    QPushButton *cancelBtn = new QPushButton("⏹️ 取消导出");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    exportBtn->setStyleSheet(getButtonStyle("#10b981"));
+    cancelBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    icsBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    icsBtn->setToolTip("导出当前学期为 .ics 文件，可导入手机或电脑日历");
+    QPushButton *snapshotBtn = new QPushButton("🗂️ 导出快照");
+    snapshotBtn->setStyleSheet(getButtonStyle("#0ea5e9"));
+    snapshotBtn->setToolTip("导出当前学期为二进制快照，可在另一台电脑上通过“导入快照”完整还原");
+    QPushButton *jsonBtn = new QPushButton("🧾 导出 JSONL");
+    jsonBtn->setStyleSheet(getButtonStyle("#14b8a6"));
+    jsonBtn->setToolTip("导出所选学期为 JSON Lines（每行一条记录），供教务系统等外部程序读取");
+    cancelBtn->setEnabled(false);
+    buttonLayout->addWidget(icsBtn);
+    buttonLayout->addWidget(snapshotBtn);
+    buttonLayout->addWidget(jsonBtn);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(exportBtn);
+    buttonLayout->addWidget(cancelBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    CsvExporter exporter;
+    JsonLines jsonExporter;
+    QString filePath;
+
+    connect(exportBtn, &QPushButton::clicked, &dialog, [&]() {
+        CsvExporter::Options options;
+        for (QCheckBox *check : semesterChecks) {
+            if (check->isChecked()) options.semesters << check->text();
+        }
+        if (options.semesters.isEmpty()) {
+            QMessageBox::warning(&dialog, "导出课程数据", "请至少选择一个学期！");
+            return;
+        }
+
+        const QString defaultName = options.semesters.size() == 1 ? options.semesters.first() + "课程表.csv" : "课程表.csv";
+        filePath = QFileDialog::getSaveFileName(&dialog, "导出课程数据",
+                                                QDir::homePath() + "/" + defaultName,
+                                                "CSV文件 (*.csv)");
+        if (filePath.isEmpty()) return;
+
+        options.filePath = filePath;
+        options.writeBom = bomCheck->isChecked();
+        exportBtn->setEnabled(false);
+        cancelBtn->setEnabled(true);
+        progressBar->setRange(0, 0);
+        statusLabel->setText("正在导出...");
+        exporter.start(m_courseManager->databasePath(), options);
+    });
 
-    QString filePath = QFileDialog::getSaveFileName(this, "导出课程数据",
-                                                    QDir::homePath() + "/课程表.csv",
-                                                    "CSV文件 (*.csv)");
-    if (!filePath.isEmpty()) {
-        if (m_courseManager->exportToCsv(filePath)) {
-            QMessageBox::information(this, "导出成功", "课程数据已成功导出到: " + filePath);
+    connect(&exporter, &CsvExporter::progressChanged, &dialog, [=](int done, int total) {
+        progressBar->setRange(0, qMax(1, total));
+        progressBar->setValue(done);
+        statusLabel->setText(QString("已导出 %1 / %2 门课程").arg(done).arg(total));
+    });
+
+    connect(&exporter, &CsvExporter::finished, &dialog, [&](const CsvExporter::Result &result) {
+        exportBtn->setEnabled(true);
+        cancelBtn->setEnabled(false);
+        progressBar->setRange(0, 1);
+        progressBar->setValue(result.ok ? 1 : 0);
+
+        if (result.canceled) {
+            statusLabel->setText("已取消导出，原文件未被修改");
+        } else if (result.ok) {
+            statusLabel->setText(QString("完成：%1 门课程，%2 KB，用时 %3 ms")
+                                     .arg(result.rows)
+                                     .arg((result.bytes + 1023) / 1024)
+                                     .arg(result.elapsedMs));
+            QMessageBox::information(&dialog, "导出成功", "课程数据已成功导出到: " + filePath);
         } else {
-            QMessageBox::warning(this, "导出失败", "导出课程数据失败");
+            statusLabel->setText("导出失败：" + result.error);
+            QMessageBox::warning(&dialog, "导出失败", "导出课程数据失败：" + result.error);
         }
-    }
+    });
+
+    connect(cancelBtn, &QPushButton::clicked, &exporter, &CsvExporter::cancel);
+    connect(cancelBtn, &QPushButton::clicked, &jsonExporter, &JsonLines::cancel);
+    connect(jsonBtn, &QPushButton::clicked, &dialog, [&]() {
+        JsonLines::ExportOptions options;
+        for (QCheckBox *check : semesterChecks) {
+            if (check->isChecked()) options.semesters << check->text();
+        }
+        if (options.semesters.isEmpty()) {
+            QMessageBox::warning(&dialog, "导出课程数据", "请至少选择一个学期！");
+            return;
+        }
+
+        const QString defaultName = options.semesters.size() == 1 ? options.semesters.first() + "课程表.jsonl" : "课程表.jsonl";
+        filePath = QFileDialog::getSaveFileName(&dialog, "导出 JSON Lines",
+                                                QDir::homePath() + "/" + defaultName,
+                                                "JSON Lines文件 (*.jsonl)");
+        if (filePath.isEmpty()) return;
+
+        options.filePath = filePath;
+        exportBtn->setEnabled(false);
+        jsonBtn->setEnabled(false);
+        cancelBtn->setEnabled(true);
+        progressBar->setRange(0, 0);
+        statusLabel->setText("正在导出...");
+        jsonExporter.startExport(m_courseManager->databasePath(), options);
+    });
+    connect(&jsonExporter, &JsonLines::progressChanged, &dialog, [=](qint64 done, qint64 total) {
+        progressBar->setRange(0, int(qMax<qint64>(1, total)));
+        progressBar->setValue(int(done));
+        statusLabel->setText(QString("已导出 %1 / %2 门课程").arg(done).arg(total));
+    });
+    connect(&jsonExporter, &JsonLines::finished, &dialog, [&](const JsonLines::Result &result) {
+        exportBtn->setEnabled(true);
+        jsonBtn->setEnabled(true);
+        cancelBtn->setEnabled(false);
+        progressBar->setRange(0, 1);
+        progressBar->setValue(result.ok ? 1 : 0);
+
+        if (result.canceled) {
+            statusLabel->setText("已取消导出，原文件未被修改");
+        } else if (result.ok) {
+            statusLabel->setText(QString("完成：%1 个学期，%2 门课程，%3 KB，用时 %4 ms")
+                                     .arg(result.semesters)
+                                     .arg(result.courses)
+                                     .arg((result.bytes + 1023) / 1024)
+                                     .arg(result.elapsedMs));
+            QMessageBox::information(&dialog, "导出成功", "课程数据已成功导出到: " + filePath);
+        } else {
+            statusLabel->setText("导出失败：" + result.error);
+            QMessageBox::warning(&dialog, "导出失败", "导出课程数据失败：" + result.error);
+        }
+    });
+    connect(icsBtn, &QPushButton::clicked, &dialog, [&]() {
+        const QString icsPath = QFileDialog::getSaveFileName(&dialog, "导出日历",
+                                                             QDir::homePath() + "/" + m_courseManager->getCurrentSemester() + "课程表.ics",
+                                                             "iCalendar文件 (*.ics)");
+        if (icsPath.isEmpty()) return;
+
+        if (m_courseManager->exportToIcs(icsPath)) {
+            QMessageBox::information(&dialog, "导出成功", "日历已成功导出到: " + icsPath);
+        } else {
+            QMessageBox::warning(&dialog, "导出失败", "导出日历失败");
+        }
+    });
+    connect(snapshotBtn, &QPushButton::clicked, &dialog, [&]() {
+        const QString snapshotPath = QFileDialog::getSaveFileName(&dialog, "导出快照",
+                                                                  QDir::homePath() + "/" + m_courseManager->getCurrentSemester() + ".smsnap",
+                                                                  "课程快照 (*.smsnap)");
+        if (snapshotPath.isEmpty()) return;
+
+        if (m_courseManager->exportSnapshot(snapshotPath, compressCheck->isChecked())) {
+            QMessageBox::information(&dialog, "导出成功", "快照已成功导出到: " + snapshotPath);
+        } else {
+            QMessageBox::warning(&dialog, "导出失败", "导出快照失败");
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    dialog.exec();
+
+    // 关闭对话框时结束仍在进行的导出，未完成的文件会被丢弃
+    exporter.cancel();
+    jsonExporter.cancel();
 }
 
-void MainWindow::onBackup()
+void MainWindow::onImportJsonLines()
 {
     animateButton(qobject_cast<QPushButton*>(sender()));
 
-    if (m_courseManager->createBackup()) {
-        QMessageBox::information(this, "备份成功", "数据库备份已创建");
-    } else {
-        QMessageBox::warning(this, "备份失败", "创建数据库备份失败");
+    if (m_courseManager->isScenarioActive()) {
+        QMessageBox::warning(this, "导入 JSON Lines", "请先提交或放弃当前的假设方案");
+        return;
     }
+    showJsonImportDialog();
 }
 
-void MainWindow::prevWeek()
+void MainWindow::showJsonImportDialog()
 {
-    animateButton(qobject_cast<QPushButton*>(sender()));
+    QDialog dialog(this);
+    dialog.setWindowTitle("导入 JSON Lines");
+    dialog.resize(600, 520);
+    dialog.setStyleSheet(getDialogStyle());
 
-    // 总是允许返回上一周
-    m_currentWeekStart = m_currentWeekStart.addDays(-7);
-    updateWeekDisplay();
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
 
-    // 如果从最后一周返回到非最后一周，重新启用下一周导航
-    if (m_canNavigateToNextWeek == false && !isLastWeek()) {
-        m_canNavigateToNextWeek = true;
+    QGroupBox *fileGroup = new QGroupBox("📄 数据文件");
+    QVBoxLayout *fileLayout = new QVBoxLayout(fileGroup);
+    QHBoxLayout *pathLayout = new QHBoxLayout();
+    QLineEdit *pathEdit = new QLineEdit();
+    pathEdit->setPlaceholderText("选择 .jsonl 文件");
+    pathEdit->setStyleSheet(getInputStyle());
+    QPushButton *browseBtn = new QPushButton("📂 浏览");
+    browseBtn->setStyleSheet(getButtonStyle("#64748b"));
+    pathLayout->addWidget(pathEdit, 1);
+    pathLayout->addWidget(browseBtn);
+    fileLayout->addLayout(pathLayout);
+    QCheckBox *replaceCheck = new QCheckBox("替换文件中出现的学期原有的课程（同一份数据可以重复导入）");
+    fileLayout->addWidget(replaceCheck);
+    QLabel *hintLabel = new QLabel(QString("没有注明学期的课程导入到当前学期 %1。出错的行会跳过，其余照常导入；"
+                                           "整个导入作为一次操作记入修改日志，可以在操作历史中撤回。").arg(m_courseManager->getCurrentSemester()));
+    hintLabel->setWordWrap(true);
+    hintLabel->setStyleSheet("color: #b45309; font-size: 12px; font-weight: normal;");
+    fileLayout->addWidget(hintLabel);
+    mainLayout->addWidget(fileGroup);
+
+    QLabel *statusLabel = new QLabel("选择文件后开始导入");
+    statusLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    QProgressBar *progressBar = new QProgressBar();
+    progressBar->setRange(0, 1);
+    progressBar->setValue(0);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addWidget(progressBar);
+
+    QGroupBox *errorGroup = new QGroupBox("⚠️ 出错的记录");
+    QVBoxLayout *errorLayout = new QVBoxLayout(errorGroup);
+    QTextEdit *errorText = new QTextEdit();
+    errorText->setReadOnly(true);
+    errorLayout->addWidget(errorText);
+    mainLayout->addWidget(errorGroup, 1);
 
-        // 重新启用下一周按钮
-        QPushButton* nextBtn = findChild<QPushButton*>("navButton");
-        if (nextBtn && nextBtn->text().contains("下一周")) {
-            nextBtn->setEnabled(true);
-            if (m_isDarkMode) {
-                nextBtn->setStyleSheet(
-                    "QPushButton {"
-                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #3498db, stop:1 #2980b9);"
-                    "    color: white;"
-                    "    border: none;"
-                    "    padding: 12px 20px;"
-                    "    border-radius: 20px;"
-                    "    font-weight: bold;"
-                    "    font-size: 14px;"
-                    "    min-width: 100px;"
-                    "}"
-                    "QPushButton:hover {"
-                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2980b9, stop:1 #2471a3);"
-                    "}"
-                    "QPushButton:pressed {"
-                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2471a3, stop:1 #1f618d);"
-                    "}"
-                    );
-            } else {
-                nextBtn->setStyleSheet(
-                    "QPushButton {"
-                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #3498db, stop:1 #2980b9);"
-                    "    color: white;"
-                    "    border: none;"
-                    "    padding: 12px 20px;"
-                    "    border-radius: 20px;"
-                    "    font-weight: bold;"
-                    "    font-size: 14px;"
-                    "    min-width: 100px;"
-                    "}"
-                    "QPushButton:hover {"
-                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2980b9, stop:1 #2471a3);"
-                    "}"
-                    "QPushButton:pressed {"
-                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2471a3, stop:1 #1f618d);"
-                    "}"
-                    );
-            }
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *importBtn = new QPushButton("📥 导入");
+    QPushButton *cancelBtn = new QPushButton("⏹️ 取消导入");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    importBtn->setStyleSheet(getButtonStyle("#10b981"));
+    cancelBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    cancelBtn->setEnabled(false);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(importBtn);
+    buttonLayout->addWidget(cancelBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    JsonLines importer;
+
+    connect(browseBtn, &QPushButton::clicked, &dialog, [&]() {
+        const QString path = QFileDialog::getOpenFileName(&dialog, "导入 JSON Lines", QDir::homePath(),
+                                                          "JSON Lines文件 (*.jsonl *.ndjson);;所有文件 (*)");
+        if (!path.isEmpty()) pathEdit->setText(path);
+    });
+
+    connect(importBtn, &QPushButton::clicked, &dialog, [&]() {
+        const QString path = pathEdit->text().trimmed();
+        if (path.isEmpty() || !QFileInfo::exists(path)) {
+            QMessageBox::warning(&dialog, "导入 JSON Lines", "请选择要导入的文件！");
+            return;
         }
-    }
+        if (replaceCheck->isChecked()) {
+            QMessageBox::StandardButton reply = QMessageBox::question(
+                &dialog, "导入 JSON Lines",
+                "文件中出现的学期，其原有课程及选课记录将被删除。\n\n确定要继续吗？",
+                QMessageBox::Yes | QMessageBox::No);
+            if (reply != QMessageBox::Yes) return;
+        }
+
+        JsonLines::ImportOptions options;
+        options.filePath = path;
+        options.defaultSemester = m_courseManager->getCurrentSemester();
+        options.replaceSemesters = replaceCheck->isChecked();
+        importBtn->setEnabled(false);
+        closeBtn->setEnabled(false);
+        cancelBtn->setEnabled(true);
+        errorText->clear();
+        progressBar->setRange(0, 0);
+        statusLabel->setText("正在导入...");
+        importer.startImport(m_courseManager->databasePath(), options);
+    });
+
+    connect(&importer, &JsonLines::progressChanged, &dialog, [=](qint64 done, qint64 total) {
+        // 按字节报告，换算成 KB 放进 int 范围
+        progressBar->setRange(0, int(qMax<qint64>(1, total / 1024)));
+        progressBar->setValue(int(done / 1024));
+        statusLabel->setText(QString("已读取 %1 / %2 KB").arg(done / 1024).arg(total / 1024));
+    });
+
+    connect(&importer, &JsonLines::finished, &dialog, [&](const JsonLines::Result &result) {
+        importBtn->setEnabled(true);
+        closeBtn->setEnabled(true);
+        cancelBtn->setEnabled(false);
+        progressBar->setRange(0, 1);
+        progressBar->setValue(result.ok ? 1 : 0);
+
+        QStringList errors = result.errors;
+        if (result.errorCount > errors.size()) {
+            errors << QString("…… 另有 %1 行出错未列出").arg(result.errorCount - errors.size());
+        }
+        errorText->setPlainText(errors.join('\n'));
+
+        if (result.canceled) {
+            statusLabel->setText("已取消导入，数据库未被修改");
+            return;
+        }
+        if (!result.ok) {
+            statusLabel->setText("导入失败：" + result.error);
+            QMessageBox::warning(&dialog, "导入失败", QString("第 %1 行导入失败，数据库未被修改：%2")
+                                                          .arg(result.lines).arg(result.error));
+            return;
+        }
+
+        // 导入走的是后台连接，界面这边的缓存全部作废
+        m_courseManager->reloadFromDatabase();
+        populateCourseTable();
+        QString message = QString("完成：%1 行，%2 个学期，%3 门课程，用时 %4 ms")
+                              .arg(result.lines).arg(result.semesters).arg(result.courses).arg(result.elapsedMs);
+        if (result.replaced > 0) message += QString("，替换了原有的 %1 门课程").arg(result.replaced);
+        if (result.errorCount > 0) message += QString("，%1 行出错已跳过").arg(result.errorCount);
+        statusLabel->setText(message);
+        QMessageBox::information(&dialog, "导入完成", message);
+    });
+
+    connect(cancelBtn, &QPushButton::clicked, &importer, &JsonLines::cancel);
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    dialog.exec();
+
+    // 导入进行中关闭对话框（如按 Esc）时取消并回滚
+    importer.cancel();
 }
 
-void MainWindow::nextWeek()
+void MainWindow::onImportIcs()
 {
-    // 检查是否允许导航到下一周
-    if (!m_canNavigateToNextWeek) {
-        // 显示提示信息
-        QMessageBox::information(this, "提示", "本学期已结束，无法查看后续周次！");
+    animateButton(qobject_cast<QPushButton*>(sender()));
+
+    const QString filePath = QFileDialog::getOpenFileName(this, "导入日历", QDir::homePath(),
+                                                          "iCalendar文件 (*.ics)");
+    if (filePath.isEmpty()) return;
+
+    IcsImportReport report;
+    if (!m_courseManager->importFromIcs(filePath, &report)) {
+        QString message = "导入日历失败";
+        if (!report.skipped.isEmpty()) message += "：" + report.skipped.first();
+        QMessageBox::warning(this, "导入失败", message);
         return;
     }
 
-    animateButton(qobject_cast<QPushButton*>(sender()));
+    populateCourseTable();
 
-    // 检查当前是否是最后一周
-    bool wasLastWeek = isLastWeek();
+    QString message = QString("共读取 %1 个事件，新增 %2 门课程，写入 %3 个考试日期。")
+                          .arg(report.events).arg(report.courses).arg(report.exams);
+    if (report.duplicates > 0) {
+        message += QString("\n%1 门课程已存在，未重复导入。").arg(report.duplicates);
+    }
+    if (!report.skipped.isEmpty()) {
+        // 跳过原因可能很多，只列出前几条
+        message += QString("\n\n以下 %1 项未导入：\n").arg(report.skipped.size());
+        message += report.skipped.mid(0, 10).join("\n");
+        if (report.skipped.size() > 10) message += "\n……";
+    }
+    QMessageBox::information(this, "导入完成", message);
+}
 
-    m_currentWeekStart = m_currentWeekStart.addDays(7);
-    updateWeekDisplay();
+void MainWindow::onImportSnapshot()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+
+    if (m_courseManager->isScenarioActive()) {
+        QMessageBox::warning(this, "导入快照", "请先提交或放弃当前的假设方案");
+        return;
+    }
+
+    const QString filePath = QFileDialog::getOpenFileName(this, "导入快照", QDir::homePath(),
+                                                          "课程快照 (*.smsnap)");
+    if (filePath.isEmpty()) return;
+
+    QMessageBox::StandardButton reply = QMessageBox::question(
+        this, "导入快照",
+        "导入会替换快照中学期的全部课程（同名学期原有课程及选课记录将被删除）。\n\n确定要继续吗？",
+        QMessageBox::Yes | QMessageBox::No);
+    if (reply != QMessageBox::Yes) return;
+
+    int imported = 0;
+    if (m_courseManager->importSnapshot(filePath, &imported)) {
+        // 定位到导入学期的第一周
+        const QDate start = m_courseManager->getSemesterStartDate();
+        m_currentWeekStart = start.addDays(1 - start.dayOfWeek());
+        m_canNavigateToNextWeek = true;
+        updateWeekDisplay();
+        populateCourseTable();
+        QMessageBox::information(this, "导入成功",
+                                 QString("已导入学期 %1 的 %2 门课程").arg(m_courseManager->getCurrentSemester()).arg(imported));
+    } else {
+        QMessageBox::warning(this, "导入失败", "导入快照失败，文件可能已损坏或版本不受支持");
+    }
+}
+
+void MainWindow::onBackup()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+
+    if (m_backup->isRunning()) return;
+
+    m_backupBtn->setEnabled(false);
+    ui->statusbar->showMessage("正在备份数据库…");
+    m_backup->startIncremental(m_courseManager->databasePath(), m_courseManager->backupChainDirectory());
+}
+
+void MainWindow::onBackupFinished(const DatabaseBackup::Result &result)
+{
+    m_backupBtn->setEnabled(true);
+    ui->statusbar->clearMessage();
+
+    if (result.ok) {
+        QString message = QString("备份 %1 已创建\n\n数据库 %2 KB，本次新增 %3 KB（未变化的数据与之前的备份共享），用时 %4 ms")
+                              .arg(result.filePath)
+                              .arg(result.bytes / 1024)
+                              .arg(result.storedBytes / 1024)
+                              .arg(result.elapsedMs);
+        if (result.pruned > 0) {
+            message += QString("\n已按保留策略清理 %1 份旧备份").arg(result.pruned);
+        }
+        QMessageBox::information(this, "备份成功", message);
+    } else {
+        QMessageBox::warning(this, "备份失败", "创建数据库备份失败: " + result.error);
+    }
+}
+
+void MainWindow::onRestoreBackup()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showRestoreDialog();
+}
+
+void MainWindow::showRestoreDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("恢复备份");
+    dialog.resize(620, 480);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    BackupChain chain(m_courseManager->backupChainDirectory());
+    const QList<BackupChain::Snapshot> snapshots = chain.snapshots();
+
+    QGroupBox *listGroup = new QGroupBox(QString("💾 备份列表（%1 份）").arg(snapshots.size()));
+    QVBoxLayout *listLayout = new QVBoxLayout(listGroup);
+    QTableWidget *table = new QTableWidget(snapshots.size(), 3);
+    table->setHorizontalHeaderLabels({"备份时间", "数据库大小", "本次新增"});
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    for (int row = 0; row < snapshots.size(); ++row) {
+        const BackupChain::Snapshot &snapshot = snapshots.at(row);
+        table->setItem(row, 0, new QTableWidgetItem(snapshot.created.toString("yyyy-MM-dd hh:mm:ss")));
+        table->setItem(row, 1, new QTableWidgetItem(QString("%1 KB").arg(snapshot.size / 1024)));
+        table->setItem(row, 2, new QTableWidgetItem(QString("%1 KB").arg(snapshot.storedBytes / 1024)));
+    }
+    if (!snapshots.isEmpty()) table->selectRow(0);
+    listLayout->addWidget(table);
+
+    QLabel *hintLabel = new QLabel("还原会用所选备份替换整个数据库，当前数据库另存为 coursemanager.db.before-restore。");
+    hintLabel->setWordWrap(true);
+    hintLabel->setStyleSheet("color: #b45309; font-size: 12px; font-weight: normal;");
+    listLayout->addWidget(hintLabel);
+    mainLayout->addWidget(listGroup);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *restoreBtn = new QPushButton("♻️ 还原");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    restoreBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    closeBtn->setStyleSheet(getButtonStyle("#64748b"));
+    restoreBtn->setEnabled(!snapshots.isEmpty());
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(restoreBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+    connect(restoreBtn, &QPushButton::clicked, &dialog, [&]() {
+        const int row = table->currentRow();
+        if (row < 0 || row >= snapshots.size()) return;
+        if (m_backup->isRunning()) {
+            QMessageBox::warning(&dialog, "恢复备份", "备份正在进行，请稍后再试");
+            return;
+        }
+
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            &dialog, "恢复备份",
+            QString("确定把数据库还原到 %1 吗？").arg(snapshots.at(row).created.toString("yyyy-MM-dd hh:mm:ss")));
+        if (answer != QMessageBox::Yes) return;
+
+        QString error;
+        if (m_courseManager->restoreBackup(snapshots.at(row).id, &error)) {
+            populateCourseTable();
+            QMessageBox::information(&dialog, "成功", "数据库已还原！");
+            dialog.accept();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "还原失败: " + error);
+        }
+    });
+
+    dialog.exec();
+}
+
+void MainWindow::onShowHistory()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showHistoryDialog();
+}
+
+void MainWindow::showHistoryDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("操作历史");
+    dialog.resize(680, 540);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    QGroupBox *listGroup = new QGroupBox();
+    QVBoxLayout *listLayout = new QVBoxLayout(listGroup);
+    QTableWidget *table = new QTableWidget(0, 3);
+    table->setHorizontalHeaderLabels({"时间", "操作", "涉及课程"});
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    table->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    listLayout->addWidget(table);
+    mainLayout->addWidget(listGroup);
+
+    QGroupBox *timeGroup = new QGroupBox("⏱️ 恢复到时间点");
+    QHBoxLayout *timeLayout = new QHBoxLayout(timeGroup);
+    QDateTimeEdit *timeEdit = new QDateTimeEdit(QDateTime::currentDateTime());
+    timeEdit->setDisplayFormat("yyyy-MM-dd hh:mm:ss");
+    timeEdit->setCalendarPopup(true);
+    timeEdit->setStyleSheet(getDateEditStyle().replace("QDateEdit", "QDateTimeEdit"));
+    QPushButton *timeBtn = new QPushButton("⏪ 恢复");
+    timeBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    timeLayout->addWidget(timeEdit, 1);
+    timeLayout->addWidget(timeBtn);
+    mainLayout->addWidget(timeGroup);
+
+    QList<CourseJournal::Operation> operations;
+    auto reload = [&]() {
+        operations = m_courseManager->journalOperations();
+        listGroup->setTitle(QString("🕘 最近的操作（%1 条）").arg(operations.size()));
+        table->setRowCount(operations.size());
+        for (int row = 0; row < operations.size(); ++row) {
+            const CourseJournal::Operation &operation = operations.at(row);
+            table->setItem(row, 0, new QTableWidgetItem(operation.time.toString("yyyy-MM-dd hh:mm:ss")));
+            table->setItem(row, 1, new QTableWidgetItem(operation.summary));
+            table->setItem(row, 2, new QTableWidgetItem(QString::number(operation.changes)));
+        }
+        if (!operations.isEmpty()) table->selectRow(0);
+        const QDateTime earliest = m_courseManager->journalEarliestTime();
+        if (earliest.isValid()) timeEdit->setMinimumDateTime(earliest.addSecs(-1));
+    };
+    reload();
+
+    QLabel *hintLabel = new QLabel("撤回会同时撤回所选操作之后的全部操作，撤回的记录从历史中移除。选课记录、教室和学生资料不在记录范围内。");
+    hintLabel->setWordWrap(true);
+    hintLabel->setStyleSheet("color: #b45309; font-size: 12px; font-weight: normal;");
+    listLayout->addWidget(hintLabel);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *undoBtn = new QPushButton("↩️ 撤销最近操作");
+    QPushButton *revertBtn = new QPushButton("⏮️ 撤回到所选操作之前");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    undoBtn->setStyleSheet(getButtonStyle("#3b82f6"));
+    revertBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    closeBtn->setStyleSheet(getButtonStyle("#64748b"));
+    buttonLayout->addWidget(undoBtn);
+    buttonLayout->addWidget(revertBtn);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    auto finish = [&](bool ok, const QString &message) {
+        if (ok) {
+            populateCourseTable();
+            reload();
+            QMessageBox::information(&dialog, "成功", message);
+        } else if (m_courseManager->isScenarioActive()) {
+            QMessageBox::warning(&dialog, "操作历史", "假设方案进行中，请先提交或放弃方案");
+        } else {
+            QMessageBox::critical(&dialog, "错误", "恢复失败！");
+        }
+    };
+
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+    connect(undoBtn, &QPushButton::clicked, &dialog, [&]() {
+        if (operations.isEmpty()) return;
+        QString summary;
+        const bool ok = m_courseManager->undoLastOperation(&summary);
+        finish(ok, QString("已撤销：%1").arg(summary));
+    });
+    connect(revertBtn, &QPushButton::clicked, &dialog, [&]() {
+        const int row = table->currentRow();
+        if (row < 0 || row >= operations.size()) return;
+        const CourseJournal::Operation operation = operations.at(row);
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            &dialog, "操作历史",
+            QString("将撤回「%1」及之后的 %2 次操作，确定吗？").arg(operation.summary).arg(row + 1));
+        if (answer != QMessageBox::Yes) return;
+        finish(m_courseManager->revertToOperation(operation.batch), QString("已撤回 %1 次操作").arg(row + 1));
+    });
+    connect(timeBtn, &QPushButton::clicked, &dialog, [&]() {
+        const QDateTime time = timeEdit->dateTime();
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            &dialog, "操作历史",
+            QString("将课程恢复到 %1 时的状态，确定吗？").arg(time.toString("yyyy-MM-dd hh:mm:ss")));
+        if (answer != QMessageBox::Yes) return;
+        finish(m_courseManager->restoreToTime(time), QString("课程已恢复到 %1").arg(time.toString("yyyy-MM-dd hh:mm:ss")));
+    });
+
+    dialog.exec();
+}
+
+void MainWindow::prevWeek()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+
+    // 总是允许返回上一周
+    m_currentWeekStart = m_currentWeekStart.addDays(-7);
+    updateWeekDisplay();
+
+    // 如果从最后一周返回到非最后一周，重新启用下一周导航
+    if (m_canNavigateToNextWeek == false && !isLastWeek()) {
+        m_canNavigateToNextWeek = true;
+
+        // 重新启用下一周按钮
+        QPushButton* nextBtn = findChild<QPushButton*>("navButton");
+        if (nextBtn && nextBtn->text().contains("下一周")) {
+            nextBtn->setEnabled(true);
+            if (m_isDarkMode) {
+                nextBtn->setStyleSheet(
+                    "QPushButton {"
+                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #3498db, stop:1 #2980b9);"
+                    "    color: white;"
+                    "    border: none;"
+                    "    padding: 12px 20px;"
+                    "    border-radius: 20px;"
+                    "    font-weight: bold;"
+                    "    font-size: 14px;"
+                    "    min-width: 100px;"
+                    "}"
+                    "QPushButton:hover {"
+                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2980b9, stop:1 #2471a3);"
+                    "}"
+                    "QPushButton:pressed {"
+                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2471a3, stop:1 #1f618d);"
+                    "}"
+                    );
+            } else {
+                nextBtn->setStyleSheet(
+                    "QPushButton {"
+                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #3498db, stop:1 #2980b9);"
+                    "    color: white;"
+                    "    border: none;"
+                    "    padding: 12px 20px;"
+                    "    border-radius: 20px;"
+                    "    font-weight: bold;"
+                    "    font-size: 14px;"
+                    "    min-width: 100px;"
+                    "}"
+                    "QPushButton:hover {"
+                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2980b9, stop:1 #2471a3);"
+                    "}"
+                    "QPushButton:pressed {"
+                    "    background: qlineargradient(x1:0, y1:0, x2:0, y2:1, stop:0 #2471a3, stop:1 #1f618d);"
+                    "}"
+                    );
+            }
+        }
+    }
+}
+
+void MainWindow::nextWeek()
+{
+    // 检查是否允许导航到下一周
+    if (!m_canNavigateToNextWeek) {
+        // 显示提示信息
+        QMessageBox::information(this, "提示", "本学期已结束，无法查看后续周次！");
+        return;
+    }
+
+    animateButton(qobject_cast<QPushButton*>(sender()));
+
+    // 检查当前是否是最后一周
+    bool wasLastWeek = isLastWeek();
+
+    m_currentWeekStart = m_currentWeekStart.addDays(7);
+    updateWeekDisplay();
 
     // 如果从非最后一周进入最后一周，显示动画并禁用后续导航
     if (!wasLastWeek && isLastWeek()) {
@@ -951,7 +1885,7 @@ void MainWindow::showCourseDetails(int row, int column)
     });
 
     int courseId = item->data(Qt::UserRole).toInt();
-    CourseData course = m_courseManager->getCourseById(courseId);
+    CourseData course = m_source->getCourseById(courseId);
 
     if (course.id == -1) return;
 
@@ -1181,6 +2115,8 @@ void MainWindow::showCourseDetails(int row, int column)
 
     connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::accept);
 
+    editBtn->setVisible(!m_source->isReadOnly());
+    deleteBtn->setVisible(!m_source->isReadOnly());
     buttonLayout->addWidget(editBtn);
     buttonLayout->addWidget(deleteBtn);
     buttonLayout->addWidget(closeBtn);
@@ -1415,6 +2351,31 @@ void MainWindow::showCourseDetails(int row, int column)
     timeLayout->addWidget(endSlotSpin);
     timeLayout->addStretch();
 
+    // 上课周次（周次范围 + 单双周）
+    int semesterWeeks = qBound(1, m_courseManager->getSemesterWeeks(), int(CourseData::MaxMaskWeeks));
+    QHBoxLayout *weekLayout = new QHBoxLayout();
+    QSpinBox *startWeekSpin = new QSpinBox();
+    startWeekSpin->setRange(1, CourseData::MaxMaskWeeks);
+    startWeekSpin->setValue(1);
+    startWeekSpin->setStyleSheet(getSpinBoxStyle());
+
+    QLabel *weekToLabel = new QLabel("至");
+    weekToLabel->setStyleSheet(toLabel->styleSheet());
+
+    QSpinBox *endWeekSpin = new QSpinBox();
+    endWeekSpin->setRange(1, CourseData::MaxMaskWeeks);
+    endWeekSpin->setValue(semesterWeeks);
+    endWeekSpin->setStyleSheet(getSpinBoxStyle());
+
+    QComboBox *parityCombo = new QComboBox();
+    parityCombo->addItems({"每周", "单周", "双周"});
+    parityCombo->setStyleSheet(getComboBoxStyle());
+
+    weekLayout->addWidget(startWeekSpin);
+    weekLayout->addWidget(weekToLabel);
+    weekLayout->addWidget(endWeekSpin);
+    weekLayout->addWidget(parityCombo);
+
     // 教室地点
     QLineEdit *locationEdit = new QLineEdit();
     locationEdit->setPlaceholderText("例如: A101教室");
@@ -1423,6 +2384,7 @@ void MainWindow::showCourseDetails(int row, int column)
     basicFormLayout->addRow("🎯 课程名称:", nameEdit);
     basicFormLayout->addRow("📅 上课星期:", dayCombo);
     basicFormLayout->addRow("⏰ 上课节次:", timeLayout);
+    basicFormLayout->addRow("🗓️ 上课周次:", weekLayout);
     basicFormLayout->addRow("📍 教室地点:", locationEdit);
 
     // 详细信息分组
@@ -1511,20 +2473,58 @@ void MainWindow::showCourseDetails(int row, int column)
     buttonLayout->addWidget(cancelBtn);
     buttonLayout->addWidget(saveBtn);
 
+    // 冲突提示：时间、教室、教师或周次变化时实时检测
+    QLabel *conflictLabel = new QLabel();
+    conflictLabel->setWordWrap(true);
+    mainLayout->addWidget(conflictLabel);
+
     mainLayout->addWidget(buttonWidget);
 
+    auto buildCourse = [=]() {
+        CourseData course;
+        course.name = nameEdit->text();
+        course.dayOfWeek = dayCombo->currentIndex() + 1;
+        course.startSlot = startSlotSpin->value();
+        course.endSlot = endSlotSpin->value();
+        course.location = locationEdit->text();
+        course.teacher = teacherEdit->text();
+        course.courseType = typeCombo->currentText().mid(2); // 移除表情符号
+        course.credits = creditSpin->value();
+        course.startDate = startDateEdit->date();
+        course.endDate = endDateEdit->date();
+        course.examDate = examDateEdit->date();
+        course.weekMask = weekMaskFor(startWeekSpin->value(), endWeekSpin->value(), parityCombo->currentIndex());
+        return course;
+    };
+    auto refreshConflicts = [this, conflictLabel, buildCourse]() {
+        updateConflictLabel(conflictLabel, buildCourse());
+    };
+    connect(dayCombo, &QComboBox::currentIndexChanged, conflictLabel, refreshConflicts);
+    connect(startSlotSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(endSlotSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(startWeekSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(endWeekSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(parityCombo, &QComboBox::currentIndexChanged, conflictLabel, refreshConflicts);
+    connect(locationEdit, &QLineEdit::textChanged, conflictLabel, refreshConflicts);
+    connect(teacherEdit, &QLineEdit::textChanged, conflictLabel, refreshConflicts);
+    connect(startDateEdit, &QDateEdit::dateChanged, conflictLabel, refreshConflicts);
+    connect(endDateEdit, &QDateEdit::dateChanged, conflictLabel, refreshConflicts);
+    refreshConflicts();
+
     // 连接信号
     connect(cancelBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
     // 在保存按钮的lambda表达式中添加验证
-    connect(saveBtn, &QPushButton::clicked, [&, nameEdit, dayCombo, startSlotSpin, endSlotSpin, locationEdit, teacherEdit, typeCombo, creditSpin, startDateEdit, endDateEdit, examDateEdit]() {
+    connect(saveBtn, &QPushButton::clicked, [&, nameEdit, startSlotSpin, endSlotSpin, startWeekSpin, endWeekSpin, locationEdit, buildCourse]() {
         if (nameEdit->text().isEmpty()) {
             QMessageBox::warning(&dialog, "输入错误", "请输入课程名称！");
             return;
         }
 
-        if (locationEdit->text().isEmpty()) {
-            QMessageBox::warning(&dialog, "输入错误", "请输入教室地点！");
-            return;
+        if (locationEdit->text().trimmed().isEmpty()) {
+            // 地点可以留空，稍后在教室管理中自动分配
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                &dialog, "未填写地点", "尚未填写教室地点，保存后可在“教室管理”中自动分配。继续保存吗？");
+            if (answer != QMessageBox::Yes) return;
         }
 
         if (startSlotSpin->value() > endSlotSpin->value()) {
@@ -1537,28 +2537,20 @@ void MainWindow::showCourseDetails(int row, int column)
             return;
         }
 
-        // 检查时间段冲突（简化版）
-        int dayOfWeek = dayCombo->currentIndex() + 1;
-        int startSlot = startSlotSpin->value();
-        int endSlot = endSlotSpin->value();
+        if (startWeekSpin->value() > endWeekSpin->value()) {
+            QMessageBox::warning(&dialog, "输入错误", "开始周次不能大于结束周次！");
+            return;
+        }
 
-        // 这里可以添加更复杂的时间冲突检测逻辑
-        if (endSlot - startSlot + 1 > 4) {
+        CourseData course = buildCourse();
+        if (course.endSlot - course.startSlot + 1 > 4) {
             QMessageBox::warning(&dialog, "输入提示", "课程连续节次较多，请确认时间安排是否合理。");
         }
 
-        CourseData course;
-        course.name = nameEdit->text();
-        course.dayOfWeek = dayOfWeek;
-        course.startSlot = startSlot;
-        course.endSlot = endSlot;
-        course.location = locationEdit->text();
-        course.teacher = teacherEdit->text();
-        course.courseType = typeCombo->currentText().mid(2); // 移除表情符号
-        course.credits = creditSpin->value();
-        course.startDate = startDateEdit->date();
-        course.endDate = endDateEdit->date();
-        course.examDate = examDateEdit->date();
+        // 教室或教师在同一时间已被占用
+        if (!confirmConflicts(&dialog, course)) {
+            return;
+        }
 
         if (m_courseManager->addCourse(course)) {
             QMessageBox::information(&dialog, "成功", "课程添加成功！");
@@ -1798,6 +2790,39 @@ void MainWindow::showCourseDetails(int row, int column)
     timeLayout->addWidget(endSlotSpin);
     timeLayout->addStretch();
 
+    // 上课周次（周次范围 + 单双周）
+    int semesterWeeks = qBound(1, m_courseManager->getSemesterWeeks(), int(CourseData::MaxMaskWeeks));
+    int startWeek = 1;
+    int endWeek = semesterWeeks;
+    CourseData::WeekParity parity = CourseData::EveryWeek;
+    if (course.weekMask != CourseData::AllWeeks) {
+        CourseData::decodeWeekMask(course.weekMask, &startWeek, &endWeek, &parity);
+    }
+
+    QHBoxLayout *weekLayout = new QHBoxLayout();
+    QSpinBox *startWeekSpin = new QSpinBox();
+    startWeekSpin->setRange(1, CourseData::MaxMaskWeeks);
+    startWeekSpin->setValue(startWeek);
+    startWeekSpin->setStyleSheet(getSpinBoxStyle());
+
+    QLabel *weekToLabel = new QLabel("至");
+    weekToLabel->setStyleSheet(toLabel->styleSheet());
+
+    QSpinBox *endWeekSpin = new QSpinBox();
+    endWeekSpin->setRange(1, CourseData::MaxMaskWeeks);
+    endWeekSpin->setValue(endWeek);
+    endWeekSpin->setStyleSheet(getSpinBoxStyle());
+
+    QComboBox *parityCombo = new QComboBox();
+    parityCombo->addItems({"每周", "单周", "双周"});
+    parityCombo->setStyleSheet(getComboBoxStyle());
+    parityCombo->setCurrentIndex(parity);
+
+    weekLayout->addWidget(startWeekSpin);
+    weekLayout->addWidget(weekToLabel);
+    weekLayout->addWidget(endWeekSpin);
+    weekLayout->addWidget(parityCombo);
+
     // 教室地点
     QLineEdit *locationEdit = new QLineEdit(course.location);
     locationEdit->setPlaceholderText("例如: A101教室");
@@ -1806,6 +2831,7 @@ void MainWindow::showCourseDetails(int row, int column)
     basicFormLayout->addRow("🎯 课程名称:", nameEdit);
     basicFormLayout->addRow("📅 上课星期:", dayCombo);
     basicFormLayout->addRow("⏰ 上课节次:", timeLayout);
+    basicFormLayout->addRow("🗓️ 上课周次:", weekLayout);
     basicFormLayout->addRow("📍 教室地点:", locationEdit);
 
     // 详细信息分组
@@ -1904,19 +2930,57 @@ void MainWindow::showCourseDetails(int row, int column)
     buttonLayout->addWidget(cancelBtn);
     buttonLayout->addWidget(saveBtn);
 
+    // 冲突提示：排除课程自身，只与其他课程比较
+    QLabel *conflictLabel = new QLabel();
+    conflictLabel->setWordWrap(true);
+    mainLayout->addWidget(conflictLabel);
+
     mainLayout->addWidget(buttonWidget);
 
+    auto buildCourse = [=]() {
+        CourseData edited = course;
+        edited.name = nameEdit->text();
+        edited.dayOfWeek = dayCombo->currentIndex() + 1;
+        edited.startSlot = startSlotSpin->value();
+        edited.endSlot = endSlotSpin->value();
+        edited.location = locationEdit->text();
+        edited.teacher = teacherEdit->text();
+        edited.courseType = typeCombo->currentText().mid(2); // 移除表情符号
+        edited.credits = creditSpin->value();
+        edited.startDate = startDateEdit->date();
+        edited.endDate = endDateEdit->date();
+        edited.examDate = examDateEdit->date();
+        edited.weekMask = weekMaskFor(startWeekSpin->value(), endWeekSpin->value(), parityCombo->currentIndex());
+        return edited;
+    };
+    auto refreshConflicts = [this, conflictLabel, buildCourse]() {
+        updateConflictLabel(conflictLabel, buildCourse());
+    };
+    connect(dayCombo, &QComboBox::currentIndexChanged, conflictLabel, refreshConflicts);
+    connect(startSlotSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(endSlotSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(startWeekSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(endWeekSpin, &QSpinBox::valueChanged, conflictLabel, refreshConflicts);
+    connect(parityCombo, &QComboBox::currentIndexChanged, conflictLabel, refreshConflicts);
+    connect(locationEdit, &QLineEdit::textChanged, conflictLabel, refreshConflicts);
+    connect(teacherEdit, &QLineEdit::textChanged, conflictLabel, refreshConflicts);
+    connect(startDateEdit, &QDateEdit::dateChanged, conflictLabel, refreshConflicts);
+    connect(endDateEdit, &QDateEdit::dateChanged, conflictLabel, refreshConflicts);
+    refreshConflicts();
+
     // 连接信号
     connect(cancelBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
-    connect(saveBtn, &QPushButton::clicked, [&, nameEdit, locationEdit, startSlotSpin, endSlotSpin, teacherEdit, typeCombo, creditSpin, startDateEdit, endDateEdit, examDateEdit]() {
+    connect(saveBtn, &QPushButton::clicked, [&, nameEdit, locationEdit, startSlotSpin, endSlotSpin, startWeekSpin, endWeekSpin, buildCourse]() {
         if (nameEdit->text().isEmpty()) {
             QMessageBox::warning(&dialog, "输入错误", "请输入课程名称！");
             return;
         }
 
-        if (locationEdit->text().isEmpty()) {
-            QMessageBox::warning(&dialog, "输入错误", "请输入教室地点！");
-            return;
+        if (locationEdit->text().trimmed().isEmpty()) {
+            // 地点可以留空，稍后在教室管理中自动分配
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                &dialog, "未填写地点", "尚未填写教室地点，保存后可在“教室管理”中自动分配。继续保存吗？");
+            if (answer != QMessageBox::Yes) return;
         }
 
         if (startSlotSpin->value() > endSlotSpin->value()) {
@@ -1924,18 +2988,17 @@ void MainWindow::showCourseDetails(int row, int column)
             return;
         }
 
-        course.name = nameEdit->text();
-        course.dayOfWeek = dayCombo->currentIndex() + 1;
-        course.startSlot = startSlotSpin->value();
-        course.endSlot = endSlotSpin->value();
-        course.location = locationEdit->text();
-        course.teacher = teacherEdit->text();
-        course.courseType = typeCombo->currentText().mid(2); // 移除表情符号
-        course.credits = creditSpin->value();
-        course.startDate = startDateEdit->date();
-        course.endDate = endDateEdit->date();
-        course.examDate = examDateEdit->date();
+        if (startWeekSpin->value() > endWeekSpin->value()) {
+            QMessageBox::warning(&dialog, "输入错误", "开始周次不能大于结束周次！");
+            return;
+        }
+
+        CourseData edited = buildCourse();
+        if (!confirmConflicts(&dialog, edited)) {
+            return;
+        }
 
+        course = edited;
         if (m_courseManager->updateCourse(course)) {
             QMessageBox::information(&dialog, "成功", "课程修改成功！");
             dialog.accept();
@@ -1955,7 +3018,7 @@ void MainWindow::showDeleteConfirmation(int courseId)
     QMessageBox msgBox(this);
     msgBox.setWindowTitle("删除课程");
     msgBox.setText(QString("确定要删除课程 \"%1\" 吗？").arg(course.name));
-    msgBox.setInformativeText("此操作不可撤销！");
+    msgBox.setInformativeText("删除后可按 Ctrl+Z 撤销，或在“操作历史”中恢复。");
     msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
     msgBox.setDefaultButton(QMessageBox::No);
     msgBox.setIcon(QMessageBox::Warning);
@@ -2633,6 +3696,72 @@ void MainWindow::applyLightStyles()
     // 使用你原来的亮色样式
     applyStyles();
 }
+// 由对话框中的周次范围和单双周选项生成周次位；覆盖整个学期的“每周”课程存为 AllWeeks
+quint32 MainWindow::weekMaskFor(int startWeek, int endWeek, int parityIndex) const
+{
+    CourseData::WeekParity parity = static_cast<CourseData::WeekParity>(parityIndex);
+    if (parity == CourseData::EveryWeek && startWeek <= 1
+        && endWeek >= qMin(int(CourseData::MaxMaskWeeks), m_courseManager->getSemesterWeeks())) {
+        return CourseData::AllWeeks;
+    }
+    return CourseData::makeWeekMask(startWeek, endWeek, parity);
+}
+
+// 在对话框底部显示候选课程与已有课程的教室/教师冲突
+void MainWindow::updateConflictLabel(QLabel *label, const CourseData &candidate)
+{
+    const QList<CourseConflict> conflicts = m_courseManager->findConflicts(candidate);
+    if (conflicts.isEmpty()) {
+        label->setText("✅ 未发现教室或教师冲突");
+        label->setStyleSheet(R"(
+            color: #047857;
+            font-size: 12px;
+            padding: 8px 12px;
+            margin: 0 8px;
+            background: #ecfdf5;
+            border-radius: 8px;
+            border: 1px solid #a7f3d0;
+        )");
+        return;
+    }
+
+    QStringList lines;
+    for (const CourseConflict &conflict : conflicts) {
+        lines << "⚠️ " + conflict.description();
+    }
+    label->setText(lines.join("\n"));
+    label->setStyleSheet(R"(
+        color: #b45309;
+        font-size: 12px;
+        padding: 8px 12px;
+        margin: 0 8px;
+        background: #fffbeb;
+        border-radius: 8px;
+        border: 1px solid #fde68a;
+    )");
+}
+
+// 保存前确认冲突；没有冲突或用户坚持保存时返回 true
+bool MainWindow::confirmConflicts(QWidget *parent, const CourseData &candidate)
+{
+    const QList<CourseConflict> conflicts = m_courseManager->findConflicts(candidate);
+    if (conflicts.isEmpty()) return true;
+
+    QStringList lines;
+    for (const CourseConflict &conflict : conflicts) {
+        lines << conflict.description();
+    }
+
+    QMessageBox msgBox(parent);
+    msgBox.setWindowTitle("时间冲突");
+    msgBox.setText(QString("发现 %1 处冲突，仍然保存吗？").arg(conflicts.size()));
+    msgBox.setInformativeText(lines.join("\n"));
+    msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    msgBox.setDefaultButton(QMessageBox::No);
+    msgBox.setIcon(QMessageBox::Warning);
+    return msgBox.exec() == QMessageBox::Yes;
+}
+
 void MainWindow::updateWeeksDisplay(QLabel* label, const QDate& startDate, const QDate& endDate)
 {
     int weeks = startDate.daysTo(endDate) / 7 + 1;
@@ -2673,7 +3802,7 @@ void MainWindow::updateWeeksDisplay(QLabel* label, const QDate& startDate, const
 }
 bool MainWindow::isLastWeek() const
 {
-    QDate semesterEnd = m_courseManager->getSemesterEndDate();
+    QDate semesterEnd = m_source->getSemesterEndDate();
     QDate lastWeekStart = semesterEnd.addDays(1 - semesterEnd.dayOfWeek()); // 最后一周的周一
     return m_currentWeekStart >= lastWeekStart;
 }
@@ -3094,17 +4223,18 @@ void MainWindow::displayAllCoursesInSearch(QTableWidget *table)
 {
     table->setRowCount(0);
 
-    QList<CourseData> allCourses = m_courseManager->getAllCourses();
+    QList<CourseData> allCourses = m_source->getAllCourses();
+    RefreshScratch scratch;
 
     for (const CourseData &course : allCourses) {
         int row = table->rowCount();
         table->insertRow(row);
 
         // 时间信息
-        QString timeInfo = QString("周%1 第%2-%3节").arg(course.dayOfWeek).arg(course.startSlot).arg(course.endSlot);
+        QString timeInfo = scratch.timeText(course);
 
         // 周数信息
-        QString weeksInfo = QString("%1周").arg(course.startDate.daysTo(course.endDate) / 7 + 1);
+        QString weeksInfo = scratch.spanText(course);
 
         {
             QTableWidgetItem *nameItem = new QTableWidgetItem(course.name);
@@ -3127,7 +4257,8 @@ void MainWindow::searchCoursesInDialog(const QString &keyword, QTableWidget *tab
 {
     table->setRowCount(0);
 
-    QList<CourseData> allCourses = m_courseManager->getAllCourses();
+    QList<CourseData> allCourses = m_source->getAllCourses();
+    RefreshScratch scratch;
     int foundCount = 0;
 
     for (const CourseData &course : allCourses) {
@@ -3140,10 +4271,10 @@ void MainWindow::searchCoursesInDialog(const QString &keyword, QTableWidget *tab
             table->insertRow(row);
 
             // 时间信息
-            QString timeInfo = QString("周%1 第%2-%3节").arg(course.dayOfWeek).arg(course.startSlot).arg(course.endSlot);
+            QString timeInfo = scratch.timeText(course);
 
             // 周数信息
-            QString weeksInfo = QString("%1周").arg(course.startDate.daysTo(course.endDate) / 7 + 1);
+            QString weeksInfo = scratch.spanText(course);
 
             {
                 QTableWidgetItem *nameItem = new QTableWidgetItem(course.name);
@@ -3171,37 +4302,13 @@ void MainWindow::searchCoursesInDialog(const QString &keyword, QTableWidget *tab
 
 void MainWindow::showCourseDetailInSearch(int courseId)
 {
-    CourseData course = m_courseManager->getCourseById(courseId);
+    CourseData course = m_source->getCourseById(courseId);
     if (course.id == -1) return;
 
     QDialog dialog(this);
     dialog.setWindowTitle("课程详情");
     dialog.setFixedSize(500, 450);
-    dialog.setStyleSheet(R"(
-        QDialog {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                stop:0 #f8fafc, stop:1 #e2e8f0);
-            font-family: 'Microsoft YaHei', 'Segoe UI';
-        }
-        QGroupBox {
-            background: white;
-            border: 1.5px solid #e2e8f0;
-            border-radius: 12px;
-            margin-top: 10px;
-            padding-top: 15px;
-            font-weight: 600;
-            color: #1e293b;
-            font-size: 14px;
-        }
-        QGroupBox::title {
-            subcontrol-origin: margin;
-            left: 12px;
-            padding: 0 8px 0 8px;
-            color: #475569;
-            font-weight: 600;
-            font-size: 13px;
-        }
-    )");
+    dialog.setStyleSheet(getDialogStyle());
 
     QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
 
@@ -3322,3 +4429,1527 @@ void MainWindow::showCourseDetailInSearch(int courseId)
     connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::accept);
     dialog.exec();
 }
+
+void MainWindow::onShowDiagnostics()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showDiagnosticsDialog();
+}
+
+// 估算课表单元格（QTableWidgetItem 及其文本、提示）占用的内存
+qint64 MainWindow::tableMemoryBytes(int *itemCount) const
+{
+    qint64 bytes = 0;
+    int count = 0;
+    if (m_courseTable) {
+        for (int row = 0; row < m_courseTable->rowCount(); ++row) {
+            for (int col = 0; col < m_courseTable->columnCount(); ++col) {
+                QTableWidgetItem *item = m_courseTable->item(row, col);
+                if (!item) continue;
+
+                ++count;
+                // 每个 item 内部还保存一组 QVariant 角色数据，这里按常见的 6 个角色估算
+                bytes += qint64(sizeof(QTableWidgetItem)) + 6 * qint64(sizeof(QVariant) + sizeof(int));
+                bytes += (item->text().capacity() + item->toolTip().capacity()) * qint64(sizeof(QChar));
+            }
+        }
+    }
+    if (itemCount) *itemCount = count;
+    return bytes;
+}
+
+void MainWindow::showDiagnosticsDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("内存诊断");
+    dialog.setFixedSize(520, 460);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    QGroupBox *usageGroup = new QGroupBox("📊 内存占用");
+    QVBoxLayout *usageLayout = new QVBoxLayout(usageGroup);
+    QTableWidget *usageTable = new QTableWidget(0, 3);
+    usageTable->setHorizontalHeaderLabels({"项目", "数量", "占用"});
+    usageTable->horizontalHeader()->setStretchLastSection(true);
+    usageTable->verticalHeader()->setVisible(false);
+    usageTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    usageTable->setColumnWidth(0, 200);
+    usageLayout->addWidget(usageTable);
+    mainLayout->addWidget(usageGroup);
+
+    QGroupBox *budgetGroup = new QGroupBox("⚙️ 缓存预算");
+    QFormLayout *budgetLayout = new QFormLayout(budgetGroup);
+    QSpinBox *budgetSpin = new QSpinBox();
+    budgetSpin->setRange(0, 4096);
+    budgetSpin->setSuffix(" MB");
+    budgetSpin->setSpecialValueText("不限制");
+    budgetSpin->setValue(int(m_courseManager->memoryBudget() / (1024 * 1024)));
+    budgetSpin->setStyleSheet(getSpinBoxStyle());
+    budgetLayout->addRow("内存预算:", budgetSpin);
+    mainLayout->addWidget(budgetGroup);
+
+    auto formatBytes = [](qint64 bytes) {
+        if (bytes >= 1024 * 1024) return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 2);
+        if (bytes >= 1024) return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+        return QString("%1 B").arg(bytes);
+    };
+
+    auto refreshUsage = [this, usageTable, formatBytes]() {
+        MemoryUsage usage = m_courseManager->memoryUsage();
+        int itemCount = 0;
+        qint64 tableBytes = tableMemoryBytes(&itemCount);
+
+        const QList<QStringList> rows = {
+            {"课程缓存", QString("%1 门 / %2 个学期").arg(usage.cachedCourses).arg(usage.cachedSemesters), formatBytes(usage.courseBytes)},
+            {"字符串池", QString("%1 个").arg(usage.pooledStrings), formatBytes(usage.stringBytes)},
+            {"占用位图与日期索引", "-", formatBytes(usage.indexBytes)},
+            {"课表单元格", QString("%1 个").arg(itemCount), formatBytes(tableBytes)},
+            {"合计", "-", formatBytes(usage.total() + tableBytes)}
+        };
+
+        usageTable->setRowCount(rows.size());
+        for (int row = 0; row < rows.size(); ++row) {
+            for (int col = 0; col < 3; ++col) {
+                usageTable->setItem(row, col, new QTableWidgetItem(rows[row][col]));
+            }
+        }
+    };
+    refreshUsage();
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *clearBtn = new QPushButton("🧹 释放缓存");
+    QPushButton *applyBtn = new QPushButton("💾 应用预算");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    clearBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    applyBtn->setStyleSheet(getButtonStyle("#10b981"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(clearBtn);
+    buttonLayout->addWidget(applyBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(clearBtn, &QPushButton::clicked, [this, refreshUsage]() {
+        m_courseManager->clearCaches();
+        refreshUsage();
+    });
+    connect(applyBtn, &QPushButton::clicked, [this, budgetSpin, refreshUsage]() {
+        m_courseManager->setMemoryBudget(qint64(budgetSpin->value()) * 1024 * 1024);
+        refreshUsage();
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::accept);
+
+    dialog.exec();
+}
+
+void MainWindow::onConflictAudit()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showConflictAuditDialog();
+}
+
+void MainWindow::showConflictAuditDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("冲突审计");
+    dialog.resize(860, 600);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    QLabel *summaryLabel = new QLabel("正在检查本学期的全部课程...");
+    summaryLabel->setStyleSheet("color: #475569; font-size: 13px; font-weight: 500; padding: 6px;");
+    QProgressBar *progressBar = new QProgressBar();
+    progressBar->setRange(0, 0);
+    mainLayout->addWidget(summaryLabel);
+    mainLayout->addWidget(progressBar);
+
+    QGroupBox *conflictGroup = new QGroupBox("⚠️ 冲突课程");
+    QVBoxLayout *conflictLayout = new QVBoxLayout(conflictGroup);
+    QTableWidget *conflictTable = new QTableWidget(0, 2);
+    conflictTable->setHorizontalHeaderLabels({"课程", "冲突说明"});
+    conflictTable->horizontalHeader()->setStretchLastSection(true);
+    conflictTable->verticalHeader()->setVisible(false);
+    conflictTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    conflictTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    conflictTable->setColumnWidth(0, 220);
+    conflictLayout->addWidget(conflictTable);
+    mainLayout->addWidget(conflictGroup, 3);
+
+    // 按教室、教师汇总冲突次数
+    QHBoxLayout *countsLayout = new QHBoxLayout();
+    auto makeCountTable = [](const QString &keyHeader) {
+        QTableWidget *table = new QTableWidget(0, 2);
+        table->setHorizontalHeaderLabels({keyHeader, "冲突数"});
+        table->horizontalHeader()->setStretchLastSection(true);
+        table->verticalHeader()->setVisible(false);
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setColumnWidth(0, 200);
+        return table;
+    };
+    QGroupBox *roomGroup = new QGroupBox("🏫 按教室");
+    QVBoxLayout *roomLayout = new QVBoxLayout(roomGroup);
+    QTableWidget *roomTable = makeCountTable("教室");
+    roomLayout->addWidget(roomTable);
+    QGroupBox *teacherGroup = new QGroupBox("👨‍🏫 按教师");
+    QVBoxLayout *teacherLayout = new QVBoxLayout(teacherGroup);
+    QTableWidget *teacherTable = makeCountTable("教师");
+    teacherLayout->addWidget(teacherTable);
+    countsLayout->addWidget(roomGroup);
+    countsLayout->addWidget(teacherGroup);
+    mainLayout->addLayout(countsLayout, 2);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *benchmarkBtn = new QPushButton("⏱️ 性能基准");
+    QPushButton *cancelBtn = new QPushButton("⏹️ 停止");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    benchmarkBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    cancelBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(benchmarkBtn);
+    buttonLayout->addWidget(cancelBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    // 课程快照：审计在后台线程中进行，界面只按 id 查找名称
+    QHash<int, CourseData> courses;
+    for (const CourseData &course : m_courseManager->getAllCourses()) {
+        courses.insert(course.id, course);
+    }
+    QHash<QString, int> roomCounts;
+    QHash<QString, int> teacherCounts;
+
+    auto fillCounts = [](QTableWidget *table, const QHash<QString, int> &counts) {
+        QList<QPair<int, QString>> sorted;
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            sorted.append(qMakePair(it.value(), it.key()));
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const QPair<int, QString> &a, const QPair<int, QString> &b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+
+        table->setRowCount(sorted.size());
+        for (int row = 0; row < sorted.size(); ++row) {
+            table->setItem(row, 0, new QTableWidgetItem(sorted.at(row).second));
+            QTableWidgetItem *countItem = new QTableWidgetItem();
+            countItem->setData(Qt::DisplayRole, sorted.at(row).first);
+            table->setItem(row, 1, countItem);
+        }
+    };
+
+    ConflictAudit audit;
+    connect(&audit, &ConflictAudit::conflictsFound, &dialog, [&](const QVector<ConflictAudit::Conflict> &batch) {
+        conflictTable->setUpdatesEnabled(false);
+        for (const ConflictAudit::Conflict &found : batch) {
+            const CourseData first = courses.value(found.firstId);
+            CourseConflict conflict;
+            conflict.other = courses.value(found.secondId);
+            conflict.sameRoom = found.sameRoom;
+            conflict.sameTeacher = found.sameTeacher;
+            conflict.slotMask = found.slotMask;
+            conflict.weeks = found.weeks;
+
+            const int row = conflictTable->rowCount();
+            conflictTable->insertRow(row);
+            conflictTable->setItem(row, 0, new QTableWidgetItem(first.name));
+            conflictTable->setItem(row, 1, new QTableWidgetItem(conflict.description()));
+
+            if (found.sameRoom) ++roomCounts[first.location.trimmed()];
+            if (found.sameTeacher) ++teacherCounts[first.teacher.trimmed()];
+        }
+        conflictTable->setUpdatesEnabled(true);
+        summaryLabel->setText(QString("已发现 %1 处冲突...").arg(conflictTable->rowCount()));
+    });
+    connect(&audit, &ConflictAudit::progressChanged, &dialog, [progressBar](int done, int total) {
+        progressBar->setRange(0, total);
+        progressBar->setValue(done);
+    });
+    connect(&audit, &ConflictAudit::finished, &dialog, [&](int conflictCount, qint64 elapsedMs, bool canceled) {
+        fillCounts(roomTable, roomCounts);
+        fillCounts(teacherTable, teacherCounts);
+        progressBar->setRange(0, 1);
+        progressBar->setValue(1);
+        cancelBtn->setEnabled(false);
+        summaryLabel->setText(QString("%1：%2 门课程，%3 处冲突，用时 %4 ms")
+                                  .arg(canceled ? "审计已停止" : "审计完成")
+                                  .arg(courses.size())
+                                  .arg(conflictCount)
+                                  .arg(elapsedMs));
+    });
+
+    connect(cancelBtn, &QPushButton::clicked, &audit, &ConflictAudit::cancel);
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::accept);
+
+    // 基准只使用自己生成的数据，放到线程池中运行，界面不被阻塞；关闭对话框时结果直接丢弃
+    QFutureWatcher<QStringList> benchmarkWatcher;
+    connect(&benchmarkWatcher, &QFutureWatcher<QStringList>::finished, &dialog, [&]() {
+        benchmarkBtn->setEnabled(true);
+        benchmarkBtn->setText("⏱️ 性能基准");
+        QMessageBox::information(&dialog, "冲突审计基准", benchmarkWatcher.result().join("\n"));
+    });
+    connect(benchmarkBtn, &QPushButton::clicked, &dialog, [&]() {
+        if (benchmarkWatcher.isRunning()) return;
+        benchmarkBtn->setEnabled(false);
+        benchmarkBtn->setText("⏱️ 基准运行中...");
+        benchmarkWatcher.setFuture(QtConcurrent::run([]() { return ConflictAudit::benchmark(); }));
+    });
+
+    // 周数与实时冲突检测使用的占用索引保持一致
+    audit.start(courses.values(), m_courseManager->getSemesterStartDate(),
+                m_courseManager->occupancyIndex().weekCount());
+    dialog.exec();
+}
+
+void MainWindow::onFindFreeSlots()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showFreeSlotDialog();
+}
+
+void MainWindow::showFreeSlotDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("空闲时段查询");
+    dialog.resize(640, 620);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    // 教室和教师候选项取自本学期已有课程，也可以直接输入
+    QStringList rooms;
+    QStringList teachers;
+    for (const CourseData &course : m_courseManager->getAllCourses()) {
+        const QString room = course.location.trimmed();
+        const QString teacher = course.teacher.trimmed();
+        if (!room.isEmpty() && !rooms.contains(room)) rooms << room;
+        if (!teacher.isEmpty() && !teachers.contains(teacher)) teachers << teacher;
+    }
+    rooms.sort();
+    teachers.sort();
+
+    QGroupBox *queryGroup = new QGroupBox("🔎 查询条件");
+    QFormLayout *queryLayout = new QFormLayout(queryGroup);
+    queryLayout->setVerticalSpacing(10);
+
+    QComboBox *roomCombo = new QComboBox();
+    roomCombo->setEditable(true);
+    roomCombo->addItem(QString());
+    roomCombo->addItems(rooms);
+    roomCombo->lineEdit()->setPlaceholderText("不限教室");
+    roomCombo->setStyleSheet(getComboBoxStyle());
+
+    QComboBox *teacherCombo = new QComboBox();
+    teacherCombo->setEditable(true);
+    teacherCombo->addItem(QString());
+    teacherCombo->addItems(teachers);
+    teacherCombo->lineEdit()->setPlaceholderText("不限教师");
+    teacherCombo->setStyleSheet(getComboBoxStyle());
+
+    QSpinBox *durationSpin = new QSpinBox();
+    durationSpin->setRange(1, OccupancyIndex::SlotsPerDay);
+    durationSpin->setValue(2);
+    durationSpin->setSuffix(" 节");
+    durationSpin->setStyleSheet(getSpinBoxStyle());
+
+    QComboBox *dayCombo = new QComboBox();
+    dayCombo->addItems({"任意", "周一", "周二", "周三", "周四", "周五", "周六", "周日"});
+    dayCombo->setStyleSheet(getComboBoxStyle());
+
+    QHBoxLayout *dateLayout = new QHBoxLayout();
+    QDateEdit *fromEdit = new QDateEdit(m_courseManager->getSemesterStartDate());
+    QDateEdit *toEdit = new QDateEdit(m_courseManager->getSemesterEndDate());
+    for (QDateEdit *edit : {fromEdit, toEdit}) {
+        edit->setCalendarPopup(true);
+        edit->setDisplayFormat("yyyy-MM-dd");
+        edit->setStyleSheet(getDateEditStyle());
+    }
+    dateLayout->addWidget(fromEdit);
+    dateLayout->addWidget(new QLabel("至"));
+    dateLayout->addWidget(toEdit);
+
+    queryLayout->addRow("🏫 教室:", roomCombo);
+    queryLayout->addRow("👨‍🏫 教师:", teacherCombo);
+    queryLayout->addRow("⏱️ 连续节数:", durationSpin);
+    queryLayout->addRow("📅 星期:", dayCombo);
+    queryLayout->addRow("🗓️ 日期范围:", dateLayout);
+    mainLayout->addWidget(queryGroup);
+
+    QGroupBox *resultGroup = new QGroupBox("✅ 推荐时段");
+    QVBoxLayout *resultLayout = new QVBoxLayout(resultGroup);
+    QLabel *summaryLabel = new QLabel();
+    summaryLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    QTableWidget *resultTable = new QTableWidget(0, 3);
+    resultTable->setHorizontalHeaderLabels({"时间", "空闲周数", "全校负载"});
+    resultTable->horizontalHeader()->setStretchLastSection(true);
+    resultTable->verticalHeader()->setVisible(false);
+    resultTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    resultTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    resultTable->setColumnWidth(0, 200);
+    resultTable->setColumnWidth(1, 160);
+    resultLayout->addWidget(summaryLabel);
+    resultLayout->addWidget(resultTable);
+    mainLayout->addWidget(resultGroup, 1);
+
+    static const QStringList dayNames = {"周一", "周二", "周三", "周四", "周五", "周六", "周日"};
+
+    // 查询直接读取占用位图，条件一变就重新计算
+    auto runQuery = [this, roomCombo, teacherCombo, durationSpin, dayCombo, fromEdit, toEdit, resultTable, summaryLabel]() {
+        FreeSlotQuery query;
+        query.room = roomCombo->currentText();
+        query.teacher = teacherCombo->currentText();
+        query.duration = durationSpin->value();
+        query.dayOfWeek = dayCombo->currentIndex();
+        query.from = fromEdit->date();
+        query.to = toEdit->date();
+
+        const QList<FreeSlot> candidates = m_courseManager->findFreeSlots(query);
+        resultTable->setRowCount(candidates.size());
+        for (int row = 0; row < candidates.size(); ++row) {
+            const FreeSlot &slot = candidates.at(row);
+            resultTable->setItem(row, 0, new QTableWidgetItem(QString("%1 第%2-%3节")
+                                                                  .arg(dayNames.value(slot.dayOfWeek - 1))
+                                                                  .arg(slot.startSlot)
+                                                                  .arg(slot.endSlot)));
+            QTableWidgetItem *weeksItem = new QTableWidgetItem(slot.isFullyFree()
+                                                                   ? QString("全部 %1 周").arg(slot.totalWeeks)
+                                                                   : QString("%1 / %2 周").arg(slot.freeWeeks).arg(slot.totalWeeks));
+            weeksItem->setForeground(slot.isFullyFree() ? QColor("#047857") : QColor("#b45309"));
+            resultTable->setItem(row, 1, weeksItem);
+            resultTable->setItem(row, 2, new QTableWidgetItem(QString::number(slot.load)));
+        }
+
+        if (query.room.trimmed().isEmpty() && query.teacher.trimmed().isEmpty()) {
+            summaryLabel->setText("未指定教室或教师，按全校负载推荐");
+        } else {
+            summaryLabel->setText(QString("共 %1 个候选时段，完全空闲的排在前面").arg(candidates.size()));
+        }
+    };
+
+    connect(roomCombo, &QComboBox::currentTextChanged, &dialog, runQuery);
+    connect(teacherCombo, &QComboBox::currentTextChanged, &dialog, runQuery);
+    connect(durationSpin, &QSpinBox::valueChanged, &dialog, runQuery);
+    connect(dayCombo, &QComboBox::currentIndexChanged, &dialog, runQuery);
+    connect(fromEdit, &QDateEdit::dateChanged, &dialog, runQuery);
+    connect(toEdit, &QDateEdit::dateChanged, &dialog, runQuery);
+    runQuery();
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::accept);
+
+    dialog.exec();
+}
+
+void MainWindow::onAutoSchedule()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showAutoScheduleDialog();
+}
+
+void MainWindow::showAutoScheduleDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("自动排课");
+    dialog.resize(820, 720);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+    static const QStringList dayNames = {"周一", "周二", "周三", "周四", "周五", "周六", "周日"};
+
+    const QList<CourseData> courses = m_courseManager->getAllCourses();
+    QStringList rooms;
+    QHash<QString, int> roomCapacity;
+    for (const RoomData &room : m_courseManager->getRooms()) {
+        rooms << room.name;
+        if (room.capacity > 0) roomCapacity.insert(room.name, room.capacity);
+    }
+    for (const CourseData &course : courses) {
+        const QString room = course.location.trimmed();
+        if (!room.isEmpty() && !rooms.contains(room)) rooms << room;
+    }
+
+    // 待排课程：默认勾选还没有填写地点的课程
+    QGroupBox *courseGroup = new QGroupBox("📋 待排课程（勾选的课程会被重新安排）");
+    QVBoxLayout *courseLayout = new QVBoxLayout(courseGroup);
+    QTableWidget *courseTable = new QTableWidget(courses.size(), 4);
+    courseTable->setHorizontalHeaderLabels({"课程", "当前时间", "地点", "教师"});
+    courseTable->horizontalHeader()->setStretchLastSection(true);
+    courseTable->verticalHeader()->setVisible(false);
+    courseTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    courseTable->setColumnWidth(0, 220);
+    courseTable->setColumnWidth(1, 160);
+    courseTable->setColumnWidth(2, 160);
+    for (int row = 0; row < courses.size(); ++row) {
+        const CourseData &course = courses.at(row);
+        QTableWidgetItem *nameItem = new QTableWidgetItem(course.name);
+        nameItem->setFlags(nameItem->flags() | Qt::ItemIsUserCheckable);
+        nameItem->setCheckState(course.location.trimmed().isEmpty() ? Qt::Checked : Qt::Unchecked);
+        courseTable->setItem(row, 0, nameItem);
+        courseTable->setItem(row, 1, new QTableWidgetItem(QString("%1 第%2-%3节")
+                                                              .arg(dayNames.value(course.dayOfWeek - 1))
+                                                              .arg(course.startSlot)
+                                                              .arg(course.endSlot)));
+        courseTable->setItem(row, 2, new QTableWidgetItem(course.location));
+        courseTable->setItem(row, 3, new QTableWidgetItem(course.teacher));
+    }
+    courseLayout->addWidget(courseTable);
+    mainLayout->addWidget(courseGroup, 2);
+
+    QGroupBox *constraintGroup = new QGroupBox("⚙️ 排课约束");
+    QFormLayout *constraintLayout = new QFormLayout(constraintGroup);
+
+    QHBoxLayout *dayLayout = new QHBoxLayout();
+    QList<QCheckBox *> dayChecks;
+    for (int day = 0; day < dayNames.size(); ++day) {
+        QCheckBox *check = new QCheckBox(dayNames.at(day));
+        check->setChecked(day < 5);
+        dayChecks << check;
+        dayLayout->addWidget(check);
+    }
+
+    QHBoxLayout *slotLayout = new QHBoxLayout();
+    QSpinBox *earliestSpin = new QSpinBox();
+    earliestSpin->setRange(1, OccupancyIndex::SlotsPerDay);
+    earliestSpin->setValue(1);
+    earliestSpin->setStyleSheet(getSpinBoxStyle());
+    QSpinBox *latestSpin = new QSpinBox();
+    latestSpin->setRange(1, OccupancyIndex::SlotsPerDay);
+    latestSpin->setValue(OccupancyIndex::SlotsPerDay);
+    latestSpin->setStyleSheet(getSpinBoxStyle());
+    slotLayout->addWidget(earliestSpin);
+    slotLayout->addWidget(new QLabel("至"));
+    slotLayout->addWidget(latestSpin);
+    slotLayout->addStretch();
+
+    QSpinBox *consecutiveSpin = new QSpinBox();
+    consecutiveSpin->setRange(0, OccupancyIndex::SlotsPerDay);
+    consecutiveSpin->setValue(4);
+    consecutiveSpin->setSpecialValueText("不限");
+    consecutiveSpin->setSuffix(" 节");
+    consecutiveSpin->setStyleSheet(getSpinBoxStyle());
+
+    QSpinBox *timeLimitSpin = new QSpinBox();
+    timeLimitSpin->setRange(1, 300);
+    timeLimitSpin->setValue(5);
+    timeLimitSpin->setSuffix(" 秒");
+    timeLimitSpin->setStyleSheet(getSpinBoxStyle());
+
+    QCheckBox *assignRoomsCheck = new QCheckBox(QString("从现有 %1 间教室中重新分配").arg(rooms.size()));
+    assignRoomsCheck->setChecked(!rooms.isEmpty());
+    assignRoomsCheck->setEnabled(!rooms.isEmpty());
+
+    constraintLayout->addRow("📅 偏好星期:", dayLayout);
+    constraintLayout->addRow("⏰ 可排节次:", slotLayout);
+    constraintLayout->addRow("👨‍🏫 教师连续上限:", consecutiveSpin);
+    constraintLayout->addRow("🏫 教室:", assignRoomsCheck);
+    constraintLayout->addRow("⏱️ 时间限制:", timeLimitSpin);
+    mainLayout->addWidget(constraintGroup);
+
+    QGroupBox *resultGroup = new QGroupBox("✅ 排课结果");
+    QVBoxLayout *resultLayout = new QVBoxLayout(resultGroup);
+    QLabel *statusLabel = new QLabel("勾选课程并设置约束后开始排课");
+    statusLabel->setWordWrap(true);
+    statusLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    QProgressBar *progressBar = new QProgressBar();
+    progressBar->setRange(0, 1);
+    progressBar->setValue(0);
+    QTableWidget *resultTable = new QTableWidget(0, 3);
+    resultTable->setHorizontalHeaderLabels({"课程", "新时间", "地点"});
+    resultTable->horizontalHeader()->setStretchLastSection(true);
+    resultTable->verticalHeader()->setVisible(false);
+    resultTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    resultTable->setColumnWidth(0, 220);
+    resultTable->setColumnWidth(1, 160);
+    resultLayout->addWidget(statusLabel);
+    resultLayout->addWidget(progressBar);
+    resultLayout->addWidget(resultTable);
+    mainLayout->addWidget(resultGroup, 2);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *runBtn = new QPushButton("🚀 开始排课");
+    QPushButton *stopBtn = new QPushButton("⏹️ 停止");
+    QPushButton *applyBtn = new QPushButton("💾 应用结果");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    runBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    stopBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    applyBtn->setStyleSheet(getButtonStyle("#10b981"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    stopBtn->setEnabled(false);
+    applyBtn->setEnabled(false);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(runBtn);
+    buttonLayout->addWidget(stopBtn);
+    buttonLayout->addWidget(applyBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    std::atomic<bool> canceled(false);
+    ScheduleResult lastResult;
+    QFutureWatcher<ScheduleResult> watcher;
+
+    connect(runBtn, &QPushButton::clicked, &dialog, [&]() {
+        ScheduleRequest request;
+        for (int row = 0; row < courses.size(); ++row) {
+            if (courseTable->item(row, 0)->checkState() == Qt::Checked) {
+                request.toPlace << courses.at(row);
+            } else {
+                request.fixed << courses.at(row);
+            }
+        }
+        if (request.toPlace.isEmpty()) {
+            QMessageBox::warning(&dialog, "自动排课", "请至少勾选一门课程！");
+            return;
+        }
+        if (earliestSpin->value() > latestSpin->value()) {
+            QMessageBox::warning(&dialog, "自动排课", "可排节次的开始不能晚于结束！");
+            return;
+        }
+
+        request.preferredDays = 0;
+        for (int day = 0; day < dayChecks.size(); ++day) {
+            if (dayChecks.at(day)->isChecked()) request.preferredDays |= quint8(1u << day);
+        }
+        request.earliestSlot = earliestSpin->value();
+        request.latestSlot = latestSpin->value();
+        request.maxConsecutive = consecutiveSpin->value();
+        request.timeLimitMs = timeLimitSpin->value() * 1000;
+        request.semesterStart = m_courseManager->getSemesterStartDate();
+        request.weekCount = m_courseManager->getSemesterWeeks();
+        if (assignRoomsCheck->isChecked()) {
+            request.rooms = rooms;
+            request.roomCapacity = roomCapacity;
+            request.courseSize = m_courseManager->enrollmentCounts();
+        }
+
+        canceled = false;
+        runBtn->setEnabled(false);
+        applyBtn->setEnabled(false);
+        stopBtn->setEnabled(true);
+        progressBar->setRange(0, 0);
+        statusLabel->setText(QString("正在为 %1 门课程排课...").arg(request.toPlace.size()));
+
+        watcher.setFuture(QtConcurrent::run([request, &canceled]() {
+            return TimetableSolver(request).solve(&canceled);
+        }));
+    });
+
+    connect(&watcher, &QFutureWatcherBase::finished, &dialog, [&]() {
+        lastResult = watcher.result();
+        progressBar->setRange(0, 1);
+        progressBar->setValue(1);
+        runBtn->setEnabled(true);
+        stopBtn->setEnabled(false);
+        applyBtn->setEnabled(!lastResult.placed.isEmpty());
+
+        resultTable->setRowCount(lastResult.placed.size());
+        for (int row = 0; row < lastResult.placed.size(); ++row) {
+            const CourseData &course = lastResult.placed.at(row);
+            resultTable->setItem(row, 0, new QTableWidgetItem(course.name));
+            resultTable->setItem(row, 1, new QTableWidgetItem(QString("%1 第%2-%3节")
+                                                                  .arg(dayNames.value(course.dayOfWeek - 1))
+                                                                  .arg(course.startSlot)
+                                                                  .arg(course.endSlot)));
+            resultTable->setItem(row, 2, new QTableWidgetItem(course.location));
+        }
+
+        QString status = QString("%1：%2 轮搜索，用时 %3 ms，软约束惩罚 %4")
+                             .arg(lastResult.canceled ? "已停止" : "完成")
+                             .arg(lastResult.restarts)
+                             .arg(lastResult.elapsedMs)
+                             .arg(lastResult.softPenalty);
+        if (!lastResult.unresolved.isEmpty()) {
+            status += "\n⚠️ " + lastResult.unresolved.join("\n⚠️ ");
+        }
+        statusLabel->setText(status);
+    });
+
+    connect(stopBtn, &QPushButton::clicked, &dialog, [&canceled]() {
+        canceled = true;
+    });
+
+    connect(applyBtn, &QPushButton::clicked, &dialog, [&]() {
+        if (!lastResult.unresolved.isEmpty()) {
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                &dialog, "自动排课", "部分课程仍有冲突或未能安排，仍然应用结果吗？");
+            if (answer != QMessageBox::Yes) return;
+        }
+
+        if (m_courseManager->updateCourses(lastResult.placed)) {
+            QMessageBox::information(&dialog, "成功", QString("已更新 %1 门课程的安排！").arg(lastResult.placed.size()));
+            populateCourseTable();
+            dialog.accept();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "保存排课结果失败，数据未做任何修改！");
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    dialog.exec();
+
+    // 关闭对话框时结束仍在进行的搜索
+    canceled = true;
+    watcher.waitForFinished();
+}
+
+void MainWindow::onScheduleExams()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showExamScheduleDialog();
+}
+
+void MainWindow::showExamScheduleDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("考试安排");
+    dialog.resize(820, 680);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+    static const QStringList sessionNames = {"上午", "下午", "晚上"};
+
+    const QList<CourseData> courses = m_courseManager->getAllCourses();
+    ExamScheduler scheduler;
+    scheduler.setCourses(courses);
+    for (const QVector<int> &group : m_courseManager->sharedStudentGroups()) {
+        scheduler.addConflictGroup(group);
+    }
+    const QHash<int, int> examSize = m_courseManager->enrollmentCounts();
+
+    QGroupBox *optionGroup = new QGroupBox("⚙️ 考试周设置");
+    QFormLayout *optionLayout = new QFormLayout(optionGroup);
+
+    QHBoxLayout *dateLayout = new QHBoxLayout();
+    const QDate semesterEnd = m_courseManager->getSemesterEndDate();
+    QDateEdit *firstDayEdit = new QDateEdit(semesterEnd.addDays(-13));
+    QDateEdit *lastDayEdit = new QDateEdit(semesterEnd);
+    for (QDateEdit *edit : {firstDayEdit, lastDayEdit}) {
+        edit->setCalendarPopup(true);
+        edit->setDisplayFormat("yyyy-MM-dd");
+        edit->setStyleSheet(getDateEditStyle());
+    }
+    dateLayout->addWidget(firstDayEdit);
+    dateLayout->addWidget(new QLabel("至"));
+    dateLayout->addWidget(lastDayEdit);
+
+    QSpinBox *sessionSpin = new QSpinBox();
+    sessionSpin->setRange(1, sessionNames.size());
+    sessionSpin->setValue(2);
+    sessionSpin->setSuffix(" 场/天");
+    sessionSpin->setStyleSheet(getSpinBoxStyle());
+
+    QCheckBox *weekendCheck = new QCheckBox("周末不安排考试");
+    weekendCheck->setChecked(true);
+
+    optionLayout->addRow("🗓️ 考试日期:", dateLayout);
+    optionLayout->addRow("⏰ 每天场次:", sessionSpin);
+    optionLayout->addRow("📅 周末:", weekendCheck);
+    mainLayout->addWidget(optionGroup);
+
+    QGroupBox *resultGroup = new QGroupBox("📝 考试安排（同一教师的考试不会同场）");
+    QVBoxLayout *resultLayout = new QVBoxLayout(resultGroup);
+    QTableWidget *examTable = new QTableWidget(courses.size(), 4);
+    examTable->setHorizontalHeaderLabels({"课程", "教师", "考试场次", "考场"});
+    examTable->horizontalHeader()->setStretchLastSection(true);
+    examTable->verticalHeader()->setVisible(false);
+    examTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    examTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    examTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    examTable->setColumnWidth(0, 220);
+    examTable->setColumnWidth(1, 120);
+    examTable->setColumnWidth(2, 200);
+    resultLayout->addWidget(examTable);
+
+    QHBoxLayout *moveLayout = new QHBoxLayout();
+    QComboBox *slotCombo = new QComboBox();
+    slotCombo->setStyleSheet(getComboBoxStyle());
+    QPushButton *moveBtn = new QPushButton("↔️ 移动所选考试");
+    moveBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    moveLayout->addWidget(new QLabel("调整到:"));
+    moveLayout->addWidget(slotCombo, 1);
+    moveLayout->addWidget(moveBtn);
+    resultLayout->addLayout(moveLayout);
+
+    QLabel *problemLabel = new QLabel();
+    problemLabel->setWordWrap(true);
+    problemLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    resultLayout->addWidget(problemLabel);
+    mainLayout->addWidget(resultGroup, 1);
+
+    auto slotText = [&scheduler](int slot) {
+        if (slot < 0) return QString("未安排");
+        return QString("%1 %2").arg(scheduler.dateOfSlot(slot).toString("yyyy-MM-dd ddd"),
+                                    sessionNames.value(scheduler.sessionOfSlot(slot)));
+    };
+
+    auto refreshTable = [&]() {
+        for (int row = 0; row < courses.size(); ++row) {
+            const CourseData &course = courses.at(row);
+            examTable->setItem(row, 0, new QTableWidgetItem(course.name));
+            examTable->setItem(row, 1, new QTableWidgetItem(course.teacher));
+            examTable->setItem(row, 2, new QTableWidgetItem(slotText(scheduler.slotOf(course.id))));
+            examTable->setItem(row, 3, new QTableWidgetItem(scheduler.roomOf(course.id)));
+        }
+
+        const QStringList problems = scheduler.problems();
+        problemLabel->setText(problems.isEmpty()
+                                  ? QString("✅ %1 门考试已安排到 %2 个场次，没有冲突").arg(courses.size()).arg(scheduler.slotCount())
+                                  : "⚠️ " + problems.join("\n⚠️ "));
+    };
+
+    auto runSchedule = [&]() {
+        ExamScheduler::Options options;
+        options.firstDay = firstDayEdit->date();
+        options.lastDay = lastDayEdit->date();
+        options.sessionsPerDay = sessionSpin->value();
+        options.skipWeekends = weekendCheck->isChecked();
+        options.examSize = examSize;
+        for (const RoomData &room : m_courseManager->getRooms()) {
+            if (room.capacity > 0) options.roomCapacity.insert(room.name, room.capacity);
+        }
+        scheduler.schedule(options);
+
+        slotCombo->clear();
+        for (int slot = 0; slot < scheduler.slotCount(); ++slot) {
+            slotCombo->addItem(slotText(slot), slot);
+        }
+        refreshTable();
+    };
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *runBtn = new QPushButton("🚀 重新安排");
+    QPushButton *applyBtn = new QPushButton("💾 保存考试日期");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    runBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    applyBtn->setStyleSheet(getButtonStyle("#10b981"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(runBtn);
+    buttonLayout->addWidget(applyBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(runBtn, &QPushButton::clicked, &dialog, runSchedule);
+    connect(moveBtn, &QPushButton::clicked, &dialog, [&]() {
+        const int row = examTable->currentRow();
+        if (row < 0 || row >= courses.size() || slotCombo->currentIndex() < 0) {
+            QMessageBox::warning(&dialog, "考试安排", "请先选择一门考试和目标场次！");
+            return;
+        }
+        // 只重新安排与它同场冲突的考试，其余保持不变
+        scheduler.moveExam(courses.at(row).id, slotCombo->currentData().toInt());
+        refreshTable();
+        examTable->selectRow(row);
+    });
+    connect(applyBtn, &QPushButton::clicked, &dialog, [&]() {
+        const QHash<int, QDate> dates = scheduler.examDates();
+        QList<CourseData> changed;
+        for (CourseData course : courses) {
+            const QDate date = dates.value(course.id);
+            if (date.isValid() && date != course.examDate) {
+                course.examDate = date;
+                changed << course;
+            }
+        }
+
+        if (m_courseManager->updateCourses(changed)) {
+            QMessageBox::information(&dialog, "成功", QString("已更新 %1 门课程的考试日期！").arg(changed.size()));
+            populateCourseTable();
+            dialog.accept();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "保存考试日期失败，数据未做任何修改！");
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    runSchedule();
+    dialog.exec();
+}
+
+void MainWindow::onManageRooms()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showRoomDialog();
+}
+
+void MainWindow::showRoomDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("教室管理");
+    dialog.resize(760, 640);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    // 教室列表：直接在表格中编辑，第一列保存教室 id
+    QGroupBox *roomGroup = new QGroupBox("🏫 教室列表（双击单元格编辑，设备用逗号分隔）");
+    QVBoxLayout *roomLayout = new QVBoxLayout(roomGroup);
+    QTableWidget *roomTable = new QTableWidget(0, 4);
+    roomTable->setHorizontalHeaderLabels({"名称", "楼栋", "容量", "设备"});
+    roomTable->horizontalHeader()->setStretchLastSection(true);
+    roomTable->verticalHeader()->setVisible(false);
+    roomTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    roomTable->setColumnWidth(0, 200);
+    roomTable->setColumnWidth(1, 140);
+    roomTable->setColumnWidth(2, 80);
+    roomLayout->addWidget(roomTable);
+    mainLayout->addWidget(roomGroup, 3);
+
+    auto loadRooms = [this, roomTable]() {
+        const QList<RoomData> rooms = m_courseManager->getRooms();
+        roomTable->setRowCount(rooms.size());
+        for (int row = 0; row < rooms.size(); ++row) {
+            const RoomData &room = rooms.at(row);
+            QTableWidgetItem *nameItem = new QTableWidgetItem(room.name);
+            nameItem->setData(Qt::UserRole, room.id);
+            roomTable->setItem(row, 0, nameItem);
+            roomTable->setItem(row, 1, new QTableWidgetItem(room.building));
+            roomTable->setItem(row, 2, new QTableWidgetItem(QString::number(room.capacity)));
+            roomTable->setItem(row, 3, new QTableWidgetItem(room.features.join(",")));
+        }
+    };
+    loadRooms();
+
+    QGroupBox *assignGroup = new QGroupBox("🧭 自动分配教室");
+    QVBoxLayout *assignLayout = new QVBoxLayout(assignGroup);
+    QLabel *assignLabel = new QLabel("为本学期未填写地点的课程分配容量足够、设备齐全且整学期空闲的最小教室。\n"
+                                     "课程人数默认取选课人数，与所需设备一样可在下方修改，留空表示不限。");
+    assignLabel->setWordWrap(true);
+    assignLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+
+    const QList<CourseData> courses = m_courseManager->getAllCourses();
+    QList<CourseData> unplaced;
+    for (const CourseData &course : courses) {
+        if (course.location.trimmed().isEmpty()) unplaced << course;
+    }
+    const QHash<int, int> enrolled = m_courseManager->enrollmentCounts();
+    QTableWidget *courseTable = new QTableWidget(unplaced.size(), 3);
+    courseTable->setHorizontalHeaderLabels({"课程", "人数", "所需设备"});
+    courseTable->horizontalHeader()->setStretchLastSection(true);
+    courseTable->verticalHeader()->setVisible(false);
+    courseTable->setColumnWidth(0, 220);
+    courseTable->setColumnWidth(1, 80);
+    for (int row = 0; row < unplaced.size(); ++row) {
+        QTableWidgetItem *nameItem = new QTableWidgetItem(unplaced.at(row).name);
+        nameItem->setFlags(nameItem->flags() & ~Qt::ItemIsEditable);
+        courseTable->setItem(row, 0, nameItem);
+        const int size = enrolled.value(unplaced.at(row).id, 0);
+        courseTable->setItem(row, 1, new QTableWidgetItem(size > 0 ? QString::number(size) : QString()));
+        courseTable->setItem(row, 2, new QTableWidgetItem(QString()));
+    }
+    assignLayout->addWidget(assignLabel);
+    assignLayout->addWidget(courseTable);
+    mainLayout->addWidget(assignGroup, 2);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *addBtn = new QPushButton("➕ 添加教室");
+    QPushButton *deleteBtn = new QPushButton("🗑️ 删除教室");
+    QPushButton *saveBtn = new QPushButton("💾 保存修改");
+    QPushButton *assignBtn = new QPushButton("🧭 自动分配教室");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    addBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    deleteBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    saveBtn->setStyleSheet(getButtonStyle("#10b981"));
+    assignBtn->setStyleSheet(getButtonStyle("#0ea5e9"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    assignBtn->setEnabled(!unplaced.isEmpty());
+    buttonLayout->addWidget(addBtn);
+    buttonLayout->addWidget(deleteBtn);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(saveBtn);
+    buttonLayout->addWidget(assignBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(addBtn, &QPushButton::clicked, &dialog, [roomTable]() {
+        const int row = roomTable->rowCount();
+        roomTable->insertRow(row);
+        QTableWidgetItem *nameItem = new QTableWidgetItem(QString());
+        nameItem->setData(Qt::UserRole, -1);
+        roomTable->setItem(row, 0, nameItem);
+        roomTable->setItem(row, 1, new QTableWidgetItem(QString()));
+        roomTable->setItem(row, 2, new QTableWidgetItem("0"));
+        roomTable->setItem(row, 3, new QTableWidgetItem(QString()));
+        roomTable->editItem(nameItem);
+    });
+
+    connect(deleteBtn, &QPushButton::clicked, &dialog, [&, roomTable]() {
+        const int row = roomTable->currentRow();
+        if (row < 0) return;
+
+        const int id = roomTable->item(row, 0)->data(Qt::UserRole).toInt();
+        if (id >= 0) {
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                &dialog, "删除教室", QString("确定删除教室“%1”吗？使用该教室的课程会保留地点文本。")
+                                         .arg(roomTable->item(row, 0)->text()));
+            if (answer != QMessageBox::Yes) return;
+            if (!m_courseManager->deleteRoom(id)) {
+                QMessageBox::critical(&dialog, "错误", "删除教室失败！");
+                return;
+            }
+        }
+        roomTable->removeRow(row);
+    });
+
+    connect(saveBtn, &QPushButton::clicked, &dialog, [&, roomTable]() {
+        int saved = 0;
+        QStringList failed;
+        for (int row = 0; row < roomTable->rowCount(); ++row) {
+            RoomData room;
+            room.id = roomTable->item(row, 0)->data(Qt::UserRole).toInt();
+            room.name = roomTable->item(row, 0)->text().trimmed();
+            room.building = roomTable->item(row, 1)->text().trimmed();
+            room.capacity = qMax(0, roomTable->item(row, 2)->text().toInt());
+            room.features = roomTable->item(row, 3)->text().split(QRegularExpression("[,，]"), Qt::SkipEmptyParts);
+            for (QString &feature : room.features) {
+                feature = feature.trimmed();
+            }
+            if (room.name.isEmpty()) continue;
+
+            if (m_courseManager->saveRoom(room)) {
+                ++saved;
+            } else {
+                failed << room.name;
+            }
+        }
+
+        loadRooms();
+        populateCourseTable();
+        if (failed.isEmpty()) {
+            QMessageBox::information(&dialog, "成功", QString("已保存 %1 间教室！").arg(saved));
+        } else {
+            QMessageBox::warning(&dialog, "部分失败", "以下教室保存失败（名称可能重复）：\n" + failed.join("\n"));
+        }
+    });
+
+    connect(assignBtn, &QPushButton::clicked, &dialog, [&, courseTable]() {
+        QHash<int, int> courseSize;
+        QHash<int, QStringList> requiredFeatures;
+        for (int row = 0; row < unplaced.size(); ++row) {
+            const int id = unplaced.at(row).id;
+            const int size = courseTable->item(row, 1)->text().toInt();
+            if (size > 0) courseSize.insert(id, size);
+
+            QStringList features = courseTable->item(row, 2)->text().split(QRegularExpression("[,，]"), Qt::SkipEmptyParts);
+            for (QString &feature : features) {
+                feature = feature.trimmed();
+            }
+            if (!features.isEmpty()) requiredFeatures.insert(id, features);
+        }
+
+        QStringList unassigned;
+        const QList<CourseData> assigned = m_courseManager->assignRooms(unplaced, courseSize, requiredFeatures, &unassigned);
+        if (assigned.isEmpty()) {
+            QMessageBox::warning(&dialog, "自动分配教室", "没有找到可以分配的空闲教室！");
+            return;
+        }
+
+        QStringList lines;
+        for (const CourseData &course : assigned) {
+            lines << QString("%1 → %2").arg(course.name, course.location);
+        }
+        QString message = lines.join("\n");
+        if (!unassigned.isEmpty()) {
+            message += "\n\n⚠️ 以下课程没有合适的教室：\n" + unassigned.join("\n");
+        }
+        message += "\n\n确定保存以上分配吗？";
+
+        QMessageBox::StandardButton answer = QMessageBox::question(&dialog, "自动分配教室", message);
+        if (answer != QMessageBox::Yes) return;
+
+        if (m_courseManager->updateCourses(assigned)) {
+            QMessageBox::information(&dialog, "成功", QString("已为 %1 门课程分配教室！").arg(assigned.size()));
+            populateCourseTable();
+            dialog.accept();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "保存教室分配失败，数据未做任何修改！");
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    dialog.exec();
+}
+
+void MainWindow::onManageStudents()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showStudentDialog();
+}
+
+void MainWindow::showStudentDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("学生课表");
+    dialog.resize(860, 720);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+    static const QStringList dayNames = {"周一", "周二", "周三", "周四", "周五", "周六", "周日"};
+    const int maxRows = 500; // 学生很多时只列出前若干条，通过搜索定位
+
+    QGroupBox *studentGroup = new QGroupBox("👥 学生");
+    QVBoxLayout *studentLayout = new QVBoxLayout(studentGroup);
+    QHBoxLayout *searchLayout = new QHBoxLayout();
+    QLineEdit *searchEdit = new QLineEdit();
+    searchEdit->setPlaceholderText("按学号、姓名或班级搜索");
+    searchEdit->setStyleSheet(getInputStyle());
+    QLabel *countLabel = new QLabel();
+    countLabel->setStyleSheet("color: #64748b; font-size: 12px;");
+    searchLayout->addWidget(searchEdit);
+    searchLayout->addWidget(countLabel);
+
+    QTableWidget *studentTable = new QTableWidget(0, 3);
+    studentTable->setHorizontalHeaderLabels({"学号", "姓名", "班级"});
+    studentTable->horizontalHeader()->setStretchLastSection(true);
+    studentTable->verticalHeader()->setVisible(false);
+    studentTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    studentTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    studentTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    studentTable->setColumnWidth(0, 160);
+    studentTable->setColumnWidth(1, 160);
+    studentLayout->addLayout(searchLayout);
+    studentLayout->addWidget(studentTable);
+    mainLayout->addWidget(studentGroup, 2);
+
+    // 所选学生的周课表，切换周次只在内存中过滤
+    QGroupBox *timetableGroup = new QGroupBox("📅 周课表");
+    QVBoxLayout *timetableLayout = new QVBoxLayout(timetableGroup);
+    QHBoxLayout *weekLayout = new QHBoxLayout();
+    QPushButton *prevBtn = new QPushButton("◀ 上一周");
+    QPushButton *nextBtn = new QPushButton("下一周 ▶");
+    prevBtn->setStyleSheet(getButtonStyle("#64748b"));
+    nextBtn->setStyleSheet(getButtonStyle("#64748b"));
+    QLabel *weekLabel = new QLabel();
+    weekLabel->setAlignment(Qt::AlignCenter);
+    weekLabel->setStyleSheet("color: #1e293b; font-weight: 600;");
+    weekLayout->addWidget(prevBtn);
+    weekLayout->addWidget(weekLabel, 1);
+    weekLayout->addWidget(nextBtn);
+
+    QTableWidget *weekTable = new QTableWidget(0, 5);
+    weekTable->setHorizontalHeaderLabels({"星期", "节次", "课程", "地点", "教师"});
+    weekTable->horizontalHeader()->setStretchLastSection(true);
+    weekTable->verticalHeader()->setVisible(false);
+    weekTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    weekTable->setColumnWidth(2, 220);
+    weekTable->setColumnWidth(3, 160);
+    QLabel *clashLabel = new QLabel();
+    clashLabel->setWordWrap(true);
+    clashLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    timetableLayout->addLayout(weekLayout);
+    timetableLayout->addWidget(weekTable);
+    timetableLayout->addWidget(clashLabel);
+    mainLayout->addWidget(timetableGroup, 3);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *addBtn = new QPushButton("➕ 添加学生");
+    QPushButton *deleteBtn = new QPushButton("🗑️ 删除学生");
+    QPushButton *enrollBtn = new QPushButton("📋 编辑选课");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    addBtn->setStyleSheet(getButtonStyle("#6366f1"));
+    deleteBtn->setStyleSheet(getButtonStyle("#f59e0b"));
+    enrollBtn->setStyleSheet(getButtonStyle("#10b981"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    buttonLayout->addWidget(addBtn);
+    buttonLayout->addWidget(deleteBtn);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(enrollBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    QDate weekStart = m_currentWeekStart;
+
+    auto currentStudentId = [studentTable]() {
+        const int row = studentTable->currentRow();
+        return row < 0 ? -1 : studentTable->item(row, 0)->data(Qt::UserRole).toInt();
+    };
+
+    auto loadStudents = [&, studentTable, searchEdit, countLabel]() {
+        const QList<StudentData> students = m_courseManager->getStudents(searchEdit->text());
+        const int shown = qMin(students.size(), maxRows);
+        studentTable->setRowCount(shown);
+        for (int row = 0; row < shown; ++row) {
+            const StudentData &student = students.at(row);
+            QTableWidgetItem *noItem = new QTableWidgetItem(student.studentNo);
+            noItem->setData(Qt::UserRole, student.id);
+            studentTable->setItem(row, 0, noItem);
+            studentTable->setItem(row, 1, new QTableWidgetItem(student.name));
+            studentTable->setItem(row, 2, new QTableWidgetItem(student.className));
+        }
+        countLabel->setText(students.size() > shown
+                                ? QString("共 %1 人，显示前 %2 人").arg(students.size()).arg(shown)
+                                : QString("共 %1 人").arg(students.size()));
+    };
+
+    auto refreshTimetable = [&, weekTable, weekLabel, clashLabel]() {
+        const int week = m_courseManager->getWeekNumber(weekStart);
+        weekLabel->setText(QString("第 %1 周（%2 - %3）")
+                               .arg(week)
+                               .arg(weekStart.toString("MM/dd"), weekStart.addDays(6).toString("MM/dd")));
+
+        const int studentId = currentStudentId();
+        if (studentId < 0) {
+            weekTable->setRowCount(0);
+            clashLabel->setText("请选择一名学生");
+            return;
+        }
+
+        const QList<CourseData> courses = m_courseManager->getStudentCoursesByWeek(studentId, weekStart);
+        weekTable->setRowCount(courses.size());
+        for (int row = 0; row < courses.size(); ++row) {
+            const CourseData &course = courses.at(row);
+            weekTable->setItem(row, 0, new QTableWidgetItem(dayNames.value(course.dayOfWeek - 1)));
+            weekTable->setItem(row, 1, new QTableWidgetItem(QString("第%1-%2节").arg(course.startSlot).arg(course.endSlot)));
+            weekTable->setItem(row, 2, new QTableWidgetItem(course.name));
+            weekTable->setItem(row, 3, new QTableWidgetItem(course.location));
+            weekTable->setItem(row, 4, new QTableWidgetItem(course.teacher));
+        }
+
+        QStringList lines;
+        for (const StudentClash &clash : m_courseManager->findStudentClashes(studentId)) {
+            int weekCount = 0;
+            for (quint64 rest = clash.weeks; rest; rest &= rest - 1) ++weekCount;
+            lines << QString("「%1」与「%2」在%3时间重叠，共 %4 周")
+                         .arg(clash.first.name, clash.second.name, dayNames.value(clash.first.dayOfWeek - 1))
+                         .arg(weekCount);
+        }
+        clashLabel->setText(lines.isEmpty() ? QString("✅ 所选课程没有时间冲突") : "⚠️ " + lines.join("\n⚠️ "));
+    };
+
+    connect(searchEdit, &QLineEdit::textChanged, &dialog, [&]() {
+        loadStudents();
+        refreshTimetable();
+    });
+    connect(studentTable, &QTableWidget::itemSelectionChanged, &dialog, [&]() {
+        refreshTimetable();
+    });
+    connect(prevBtn, &QPushButton::clicked, &dialog, [&]() {
+        weekStart = weekStart.addDays(-7);
+        refreshTimetable();
+    });
+    connect(nextBtn, &QPushButton::clicked, &dialog, [&]() {
+        weekStart = weekStart.addDays(7);
+        refreshTimetable();
+    });
+
+    connect(addBtn, &QPushButton::clicked, &dialog, [&]() {
+        QDialog input(&dialog);
+        input.setWindowTitle("添加学生");
+        QFormLayout *form = new QFormLayout(&input);
+        QLineEdit *noEdit = new QLineEdit();
+        QLineEdit *nameEdit = new QLineEdit();
+        QLineEdit *classEdit = new QLineEdit();
+        noEdit->setStyleSheet(getInputStyle());
+        nameEdit->setStyleSheet(getInputStyle());
+        classEdit->setStyleSheet(getInputStyle());
+        form->addRow("学号:", noEdit);
+        form->addRow("姓名:", nameEdit);
+        form->addRow("班级:", classEdit);
+        QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        form->addRow(buttons);
+        connect(buttons, &QDialogButtonBox::accepted, &input, &QDialog::accept);
+        connect(buttons, &QDialogButtonBox::rejected, &input, &QDialog::reject);
+        if (input.exec() != QDialog::Accepted) return;
+
+        StudentData student;
+        student.studentNo = noEdit->text();
+        student.name = nameEdit->text();
+        student.className = classEdit->text();
+        if (!m_courseManager->saveStudent(student)) {
+            QMessageBox::warning(&dialog, "添加学生", "保存失败，请检查学号和姓名是否填写、学号是否重复！");
+            return;
+        }
+        searchEdit->setText(student.studentNo);
+    });
+
+    connect(deleteBtn, &QPushButton::clicked, &dialog, [&]() {
+        const int studentId = currentStudentId();
+        if (studentId < 0) return;
+
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            &dialog, "删除学生", QString("确定删除学生“%1”及其全部选课记录吗？")
+                                     .arg(studentTable->item(studentTable->currentRow(), 1)->text()));
+        if (answer != QMessageBox::Yes) return;
+
+        if (m_courseManager->deleteStudent(studentId)) {
+            loadStudents();
+            refreshTimetable();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "删除学生失败！");
+        }
+    });
+
+    connect(enrollBtn, &QPushButton::clicked, &dialog, [&]() {
+        const int studentId = currentStudentId();
+        if (studentId < 0) {
+            QMessageBox::warning(&dialog, "编辑选课", "请先选择一名学生！");
+            return;
+        }
+
+        const QList<CourseData> courses = m_courseManager->getAllCourses();
+        const QVector<int> enrolled = m_courseManager->enrolledCourseIds(studentId);
+
+        QDialog picker(&dialog);
+        picker.setWindowTitle("编辑选课");
+        picker.resize(560, 480);
+        QVBoxLayout *pickerLayout = new QVBoxLayout(&picker);
+        QTableWidget *courseTable = new QTableWidget(courses.size(), 3);
+        courseTable->setHorizontalHeaderLabels({"课程", "时间", "教师"});
+        courseTable->horizontalHeader()->setStretchLastSection(true);
+        courseTable->verticalHeader()->setVisible(false);
+        courseTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        courseTable->setColumnWidth(0, 220);
+        courseTable->setColumnWidth(1, 140);
+        for (int row = 0; row < courses.size(); ++row) {
+            const CourseData &course = courses.at(row);
+            QTableWidgetItem *nameItem = new QTableWidgetItem(course.name);
+            nameItem->setFlags(nameItem->flags() | Qt::ItemIsUserCheckable);
+            nameItem->setCheckState(enrolled.contains(course.id) ? Qt::Checked : Qt::Unchecked);
+            courseTable->setItem(row, 0, nameItem);
+            courseTable->setItem(row, 1, new QTableWidgetItem(QString("%1 第%2-%3节")
+                                                                  .arg(dayNames.value(course.dayOfWeek - 1))
+                                                                  .arg(course.startSlot)
+                                                                  .arg(course.endSlot)));
+            courseTable->setItem(row, 2, new QTableWidgetItem(course.teacher));
+        }
+        QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+        pickerLayout->addWidget(courseTable);
+        pickerLayout->addWidget(buttons);
+        connect(buttons, &QDialogButtonBox::accepted, &picker, &QDialog::accept);
+        connect(buttons, &QDialogButtonBox::rejected, &picker, &QDialog::reject);
+        if (picker.exec() != QDialog::Accepted) return;
+
+        // 只替换本学期的选课，其它学期的记录原样保留
+        QVector<int> selected;
+        QSet<int> semesterIds;
+        for (int row = 0; row < courses.size(); ++row) {
+            semesterIds.insert(courses.at(row).id);
+            if (courseTable->item(row, 0)->checkState() == Qt::Checked) selected.append(courses.at(row).id);
+        }
+        for (int id : enrolled) {
+            if (!semesterIds.contains(id)) selected.append(id);
+        }
+
+        if (m_courseManager->setEnrollments(studentId, selected)) {
+            refreshTimetable();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "保存选课失败，数据未做任何修改！");
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    loadStudents();
+    refreshTimetable();
+    dialog.exec();
+}
+
+void MainWindow::onShowAnalytics()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showAnalyticsDialog();
+}
+
+void MainWindow::showAnalyticsDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("统计报表");
+    dialog.resize(860, 720);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+
+    const bool cached = m_analytics->isValid();
+    const QList<CourseAnalytics::TeacherWorkload> &teachers = m_analytics->teacherWorkloads();
+    const QList<CourseAnalytics::RoomUtilisation> &rooms = m_analytics->roomUtilisation();
+
+    QLabel *summaryLabel = new QLabel(QString("学期 %1，共 %2 周；%3（用时 %4 ms）")
+                                          .arg(m_courseManager->getCurrentSemester())
+                                          .arg(m_analytics->weekCount())
+                                          .arg(cached ? "使用缓存结果" : "重新计算")
+                                          .arg(m_analytics->lastComputeMs()));
+    summaryLabel->setStyleSheet("color: #475569; font-size: 12px; padding: 4px;");
+    mainLayout->addWidget(summaryLabel);
+
+    QGroupBox *teacherGroup = new QGroupBox("👨‍🏫 教师工作量");
+    QVBoxLayout *teacherLayout = new QVBoxLayout(teacherGroup);
+    QTableWidget *teacherTable = new QTableWidget(teachers.size(), 7);
+    teacherTable->setHorizontalHeaderLabels({"教师", "课程数", "学分", "总节数", "周均节数", "最忙一周", "授课周数"});
+    teacherTable->horizontalHeader()->setStretchLastSection(true);
+    teacherTable->verticalHeader()->setVisible(false);
+    teacherTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    for (int row = 0; row < teachers.size(); ++row) {
+        const CourseAnalytics::TeacherWorkload &load = teachers.at(row);
+        teacherTable->setItem(row, 0, new QTableWidgetItem(load.teacher));
+        teacherTable->setItem(row, 1, new QTableWidgetItem(QString::number(load.courseCount)));
+        teacherTable->setItem(row, 2, new QTableWidgetItem(QString::number(load.credits)));
+        teacherTable->setItem(row, 3, new QTableWidgetItem(QString::number(load.totalSlots)));
+        teacherTable->setItem(row, 4, new QTableWidgetItem(QString::number(load.averageWeeklySlots(), 'f', 1)));
+        teacherTable->setItem(row, 5, new QTableWidgetItem(QString::number(load.peakWeekSlots)));
+        teacherTable->setItem(row, 6, new QTableWidgetItem(QString::number(load.teachingWeeks)));
+    }
+    teacherLayout->addWidget(teacherTable);
+    mainLayout->addWidget(teacherGroup, 1);
+
+    QGroupBox *roomGroup = new QGroupBox(QString("🏫 教室利用率（按每周 %1 个工作日计算）").arg(CourseAnalytics::TeachingDays));
+    QVBoxLayout *roomLayout = new QVBoxLayout(roomGroup);
+    QTableWidget *roomTable = new QTableWidget(rooms.size(), 5);
+    roomTable->setHorizontalHeaderLabels({"教室", "容量", "占用节数", "利用率", "重复占用"});
+    roomTable->horizontalHeader()->setStretchLastSection(true);
+    roomTable->verticalHeader()->setVisible(false);
+    roomTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    roomTable->setColumnWidth(0, 200);
+    roomTable->setColumnWidth(3, 220);
+    for (int row = 0; row < rooms.size(); ++row) {
+        const CourseAnalytics::RoomUtilisation &usage = rooms.at(row);
+        roomTable->setItem(row, 0, new QTableWidgetItem(usage.room));
+        roomTable->setItem(row, 1, new QTableWidgetItem(usage.capacity > 0 ? QString::number(usage.capacity) : "未登记"));
+        roomTable->setItem(row, 2, new QTableWidgetItem(QString("%1 / %2").arg(usage.usedSlots).arg(usage.availableSlots)));
+
+        QProgressBar *bar = new QProgressBar();
+        bar->setRange(0, 1000);
+        bar->setValue(qMin(1000, int(usage.percent() * 10)));
+        bar->setFormat(QString::number(usage.percent(), 'f', 1) + "%");
+        roomTable->setCellWidget(row, 3, bar);
+
+        QTableWidgetItem *overlapItem = new QTableWidgetItem(QString::number(usage.doubleBooked));
+        if (usage.doubleBooked > 0) overlapItem->setForeground(QColor("#ef4444"));
+        roomTable->setItem(row, 4, overlapItem);
+    }
+    roomLayout->addWidget(roomTable);
+    mainLayout->addWidget(roomGroup, 1);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *exportBtn = new QPushButton("📤 导出 CSV");
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    exportBtn->setStyleSheet(getButtonStyle("#10b981"));
+    closeBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(exportBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(exportBtn, &QPushButton::clicked, &dialog, [&]() {
+        QString filePath = QFileDialog::getSaveFileName(&dialog, "导出统计报表",
+                                                        QDir::homePath() + "/统计报表.csv",
+                                                        "CSV文件 (*.csv)");
+        if (filePath.isEmpty()) return;
+
+        if (m_analytics->exportToCsv(filePath)) {
+            QMessageBox::information(&dialog, "导出成功", "统计报表已成功导出到: " + filePath);
+        } else {
+            QMessageBox::warning(&dialog, "导出失败", "导出统计报表失败");
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    dialog.exec();
+}
+
+void MainWindow::onScenario()
+{
+    animateButton(qobject_cast<QPushButton*>(sender()));
+    showScenarioDialog();
+}
+
+void MainWindow::showScenarioDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("假设方案");
+    dialog.resize(640, 520);
+    dialog.setStyleSheet(getDialogStyle());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(&dialog);
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *closeBtn = new QPushButton("❌ 关闭");
+    closeBtn->setStyleSheet(getButtonStyle("#64748b"));
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
+
+    if (!m_courseManager->isScenarioActive()) {
+        QGroupBox *startGroup = new QGroupBox("🧪 新建方案");
+        QFormLayout *startLayout = new QFormLayout(startGroup);
+        QLabel *hintLabel = new QLabel(QString("方案建立在学期 %1 的当前数据之上。开始后对课程的添加、修改和删除只保存在方案中，"
+                                               "周课表、冲突检测和各项统计都会按方案显示；确认无误后再一次性提交，"
+                                               "或直接放弃，数据库不受任何影响。")
+                                           .arg(m_courseManager->getCurrentSemester()));
+        hintLabel->setWordWrap(true);
+        hintLabel->setStyleSheet("color: #475569; font-size: 12px; font-weight: normal;");
+        QLineEdit *nameEdit = new QLineEdit();
+        nameEdit->setPlaceholderText("例如：周三下午课程整体前移");
+        nameEdit->setStyleSheet(getInputStyle());
+        startLayout->addRow(hintLabel);
+        startLayout->addRow("方案名称:", nameEdit);
+        mainLayout->addWidget(startGroup);
+        mainLayout->addStretch();
+
+        QPushButton *startBtn = new QPushButton("🚀 开始方案");
+        startBtn->setStyleSheet(getButtonStyle("#6366f1"));
+        buttonLayout->addStretch();
+        buttonLayout->addWidget(startBtn);
+        buttonLayout->addWidget(closeBtn);
+        mainLayout->addLayout(buttonLayout);
+
+        connect(startBtn, &QPushButton::clicked, &dialog, [&, nameEdit]() {
+            if (m_courseManager->beginScenario(nameEdit->text())) {
+                populateCourseTable();
+                dialog.accept();
+            }
+        });
+
+        dialog.exec();
+        return;
+    }
+
+    const QStringList changes = m_courseManager->scenarioChanges();
+    QGroupBox *changeGroup = new QGroupBox(QString("📋 方案「%1」的修改（%2 处）")
+                                               .arg(m_courseManager->scenarioName())
+                                               .arg(changes.size()));
+    QVBoxLayout *changeLayout = new QVBoxLayout(changeGroup);
+    QTextEdit *changeText = new QTextEdit();
+    changeText->setReadOnly(true);
+    changeText->setPlainText(changes.isEmpty() ? QString("尚未做任何修改") : changes.join("\n"));
+    changeLayout->addWidget(changeText);
+    mainLayout->addWidget(changeGroup);
+
+    QPushButton *commitBtn = new QPushButton("💾 提交方案");
+    QPushButton *discardBtn = new QPushButton("🗑️ 放弃方案");
+    commitBtn->setStyleSheet(getButtonStyle("#10b981"));
+    discardBtn->setStyleSheet(getButtonStyle("#ef4444"));
+    commitBtn->setEnabled(!changes.isEmpty());
+    closeBtn->setText("✏️ 继续编辑");
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(commitBtn);
+    buttonLayout->addWidget(discardBtn);
+    buttonLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(commitBtn, &QPushButton::clicked, &dialog, [&]() {
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            &dialog, "提交方案", QString("确定把 %1 处修改写入数据库吗？").arg(changes.size()));
+        if (answer != QMessageBox::Yes) return;
+
+        if (m_courseManager->commitScenario()) {
+            QMessageBox::information(&dialog, "成功", "方案已提交！");
+            populateCourseTable();
+            dialog.accept();
+        } else {
+            QMessageBox::critical(&dialog, "错误", "提交方案失败，数据库未做任何修改，方案仍然保留。");
+        }
+    });
+
+    connect(discardBtn, &QPushButton::clicked, &dialog, [&]() {
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            &dialog, "放弃方案", "确定放弃该方案中的全部修改吗？");
+        if (answer != QMessageBox::Yes) return;
+
+        m_courseManager->discardScenario();
+        populateCourseTable();
+        dialog.accept();
+    });
+
+    dialog.exec();
+}
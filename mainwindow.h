@@ -8,6 +8,8 @@
 #include <QParallelAnimationGroup>
 #include <QGraphicsOpacityEffect>
 #include "coursemanager.h"
+#include "courseanalytics.h"
+#include "databasebackup.h"
 #include "qlabel.h"
 #include "qpushbutton.h"
 #include "qtablewidget.h"
@@ -18,12 +20,16 @@ class MainWindow;
 }
 QT_END_NAMESPACE
 
+class RefreshScratch;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
     MainWindow(QWidget *parent = nullptr);
+    // 只读浏览模式：课程表从 readOnlySource 读取，不创建 CourseManager，也不打开数据库
+    explicit MainWindow(CourseSource *readOnlySource, QWidget *parent = nullptr);
     ~MainWindow();
 
     QLabel *createFormLabel(const QString &text);
@@ -31,10 +37,19 @@ public:
     void updateWeeksLabel(QLabel *label, const QDate &startDate, const QDate &endDate);
 private slots:
     void onAddCourse();
+    void onUndo();
+    void onRedo();
+    void updateUndoButtons();
     void onRefresh();
     void onSearch();
     void onExport();
+    void onImportIcs();
+    void onImportSnapshot();
+    void onImportJsonLines();
     void onBackup();
+    void onBackupFinished(const DatabaseBackup::Result &result);
+    void onRestoreBackup();
+    void onShowHistory();
     void updateClock();
     void prevWeek();
     void nextWeek();
@@ -42,12 +57,24 @@ private slots:
     void onToggleTheme();
     void onSetSemester();
     void showCourseSearchDialog();
+    void onShowDiagnostics();
+    void onConflictAudit();
+    void onFindFreeSlots();
+    void onAutoSchedule();
+    void onScheduleExams();
+    void onManageRooms();
+    void onManageStudents();
+    void onShowAnalytics();
+    void onScenario();
 
 private:
     void updateWeeksDisplay(QLabel* label, const QDate& startDate, const QDate& endDate);
     void showSemesterDialog();
     Ui::MainWindow *ui;
-    CourseManager *m_courseManager;
+    CourseManager *m_courseManager;  // 只读浏览模式下为空
+    CourseSource *m_source;          // 课程表、搜索和详情读取的数据来源
+    DatabaseBackup *m_backup;
+    CourseAnalytics *m_analytics;
     QTimer *m_clockTimer;
     QDate m_currentWeekStart;
     //
@@ -55,6 +82,20 @@ private:
     void displayAllCoursesInSearch(QTableWidget* table);
     void searchCoursesInDialog(const QString& keyword, QTableWidget* table);
     void showCourseDetailInSearch(int courseId);
+    void showDiagnosticsDialog();
+    qint64 tableMemoryBytes(int *itemCount) const;
+    void showConflictAuditDialog();
+    void showFreeSlotDialog();
+    void showAutoScheduleDialog();
+    void showExamScheduleDialog();
+    void showRoomDialog();
+    void showRestoreDialog();
+    void showHistoryDialog();
+    void showStudentDialog();
+    void showAnalyticsDialog();
+    void showScenarioDialog();
+    void showExportDialog();
+    void showJsonImportDialog();
     // UI组件指针
     QTableWidget *m_courseTable;
     QLabel *m_weekLabel;
@@ -63,10 +104,19 @@ private:
     QPushButton *m_searchBtn;
     QPushButton *m_exportBtn;
     QPushButton *m_backupBtn;
+    QPushButton *m_undoBtn;
+    QPushButton *m_redoBtn;
+    QLabel *m_summaryLabel;
+    QLabel *m_scenarioLabel;
 
     void setupUI();
     void updateWeekDisplay();
     void populateCourseTable();
+    void refreshCourseCells(const QList<CourseData> &touched); // 只重画这些课程占用的格子
+    void clearCourseCell(int row, int column);
+    void paintCourseCell(int row, int column, const CourseData &course, RefreshScratch &scratch);
+    void updateCreditSummary();
+    void updateScenarioStatus();
     void applyStyles();
     void showAddCourseDialog();
     void showEditCourseDialog(int courseId);
@@ -84,6 +134,9 @@ private:
 
     // 工具函数
     QColor getCourseColor(const QString &courseType);
+    quint32 weekMaskFor(int startWeek, int endWeek, int parityIndex) const;
+    void updateConflictLabel(QLabel *label, const CourseData &candidate);
+    bool confirmConflicts(QWidget *parent, const CourseData &candidate);
     void applyDarkStyles();
     void applyLightStyles();
 private:
@@ -91,6 +144,34 @@ private:
     void showSemesterEndAnimation();
     bool isLastWeek() const;
     bool m_isDarkMode;
+    QString getDialogStyle() {
+        return R"(
+        QDialog {
+            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
+                stop:0 #f8fafc, stop:1 #e2e8f0);
+            font-family: 'Microsoft YaHei', 'Segoe UI';
+        }
+        QGroupBox {
+            background: white;
+            border: 1.5px solid #e2e8f0;
+            border-radius: 12px;
+            margin-top: 10px;
+            padding-top: 15px;
+            font-weight: 600;
+            color: #1e293b;
+            font-size: 14px;
+        }
+        QGroupBox::title {
+            subcontrol-origin: margin;
+            left: 12px;
+            padding: 0 8px 0 8px;
+            color: #475569;
+            font-weight: 600;
+            font-size: 13px;
+        }
+    )";
+    }
+
     QString getInputStyle() {
         return R"(
         QLineEdit {
@@ -0,0 +1,230 @@
+#include "occupancyindex.h"
+#include "coursemanager.h"
+
+OccupancyIndex::OccupancyIndex()
+    : m_weekCount(0)
+{
+}
+
+void OccupancyIndex::reset(const QDate &semesterStart, int weekCount)
+{
+    clear();
+    m_firstMonday = semesterStart.addDays(1 - semesterStart.dayOfWeek());
+    m_weekCount = qBound(0, weekCount, int(MaxWeeks));
+    m_all.counts.fill(0, m_weekCount * DaysPerWeek * SlotsPerDay);
+    m_all.masks.fill(0, m_weekCount * DaysPerWeek);
+}
+
+void OccupancyIndex::clear()
+{
+    m_firstMonday = QDate();
+    m_weekCount = 0;
+    m_all = Layer();
+    m_rooms.clear();
+    m_teachers.clear();
+    m_footprints.clear();
+}
+
+void OccupancyIndex::addCourse(const CourseData &course)
+{
+    if (course.id < 0) return;
+
+    removeCourse(course.id);
+
+    // 即使不占用任何格子也记录下来，便于后续更新时找到所属学期
+    Footprint footprint = footprintOf(course);
+    apply(m_all, footprint, 1);
+    if (!footprint.room.isEmpty()) {
+        apply(m_rooms[footprint.room], footprint, 1);
+    }
+    if (!footprint.teacher.isEmpty()) {
+        apply(m_teachers[footprint.teacher], footprint, 1);
+    }
+
+    m_footprints.insert(course.id, footprint);
+}
+
+bool OccupancyIndex::removeCourse(int courseId)
+{
+    auto it = m_footprints.find(courseId);
+    if (it == m_footprints.end()) return false;
+
+    const Footprint footprint = it.value();
+    m_footprints.erase(it);
+
+    apply(m_all, footprint, -1);
+    if (!footprint.room.isEmpty()) {
+        apply(m_rooms[footprint.room], footprint, -1);
+    }
+    if (!footprint.teacher.isEmpty()) {
+        apply(m_teachers[footprint.teacher], footprint, -1);
+    }
+    return true;
+}
+
+bool OccupancyIndex::contains(int courseId) const
+{
+    return m_footprints.contains(courseId);
+}
+
+int OccupancyIndex::courseCount() const
+{
+    return m_footprints.size();
+}
+
+qint64 OccupancyIndex::memoryBytes() const
+{
+    auto layerBytes = [](const Layer &layer) {
+        return qint64(layer.counts.capacity() + layer.masks.capacity()) * qint64(sizeof(quint16));
+    };
+
+    qint64 bytes = layerBytes(m_all);
+    for (auto it = m_rooms.constBegin(); it != m_rooms.constEnd(); ++it) {
+        bytes += layerBytes(it.value()) + it.key().capacity() * qint64(sizeof(QChar));
+    }
+    for (auto it = m_teachers.constBegin(); it != m_teachers.constEnd(); ++it) {
+        bytes += layerBytes(it.value()) + it.key().capacity() * qint64(sizeof(QChar));
+    }
+    // 教室/教师名与课程缓存中的字符串隐式共享，这里只计节点本身
+    bytes += qint64(m_footprints.size()) * qint64(sizeof(int) + sizeof(Footprint) + sizeof(void *));
+    return bytes;
+}
+
+int OccupancyIndex::weekCount() const
+{
+    return m_weekCount;
+}
+
+QDate OccupancyIndex::firstMonday() const
+{
+    return m_firstMonday;
+}
+
+int OccupancyIndex::weekIndexOf(const QDate &date) const
+{
+    if (!m_firstMonday.isValid() || !date.isValid()) return -1;
+
+    qint64 days = m_firstMonday.daysTo(date);
+    if (days < 0) return -1;
+
+    int week = int(days / 7);
+    return week < m_weekCount ? week : -1;
+}
+
+quint16 OccupancyIndex::busyMask(int week, int day) const
+{
+    return layerMask(m_all, week, day);
+}
+
+quint16 OccupancyIndex::roomBusyMask(const QString &room, int week, int day) const
+{
+    auto it = m_rooms.constFind(room.trimmed());
+    return it == m_rooms.constEnd() ? 0 : layerMask(it.value(), week, day);
+}
+
+quint16 OccupancyIndex::teacherBusyMask(const QString &teacher, int week, int day) const
+{
+    auto it = m_teachers.constFind(teacher.trimmed());
+    return it == m_teachers.constEnd() ? 0 : layerMask(it.value(), week, day);
+}
+
+bool OccupancyIndex::isSlotFree(int week, int day, int slot) const
+{
+    if (slot < 1 || slot > SlotsPerDay) return false;
+    return !(busyMask(week, day) & (1u << (slot - 1)));
+}
+
+quint64 OccupancyIndex::activeWeeks(const CourseData &course) const
+{
+    Footprint footprint = footprintOf(course);
+    return footprint.slotMask ? footprint.weeks : 0;
+}
+
+quint64 OccupancyIndex::activeWeeks(int courseId) const
+{
+    auto it = m_footprints.constFind(courseId);
+    return it == m_footprints.constEnd() || !it->slotMask ? 0 : it->weeks;
+}
+
+int OccupancyIndex::slotLoad(int week, int day, int slot) const
+{
+    if (week < 0 || week >= m_weekCount || day < 1 || day > DaysPerWeek
+        || slot < 1 || slot > SlotsPerDay) {
+        return 0;
+    }
+    return m_all.counts.at(((week * DaysPerWeek) + day - 1) * SlotsPerDay + slot - 1);
+}
+
+quint16 OccupancyIndex::slotRangeMask(int startSlot, int endSlot)
+{
+    startSlot = qMax(1, startSlot);
+    endSlot = qMin(int(SlotsPerDay), endSlot);
+    if (startSlot > endSlot) return 0;
+
+    // 第 startSlot..endSlot 节对应第 startSlot-1..endSlot-1 位
+    return quint16(((1u << endSlot) - 1) & ~((1u << (startSlot - 1)) - 1));
+}
+
+OccupancyIndex::Footprint OccupancyIndex::footprintOf(const CourseData &course) const
+{
+    Footprint footprint;
+    footprint.day = qBound(0, course.dayOfWeek - 1, DaysPerWeek - 1);
+    footprint.slotMask = 0;
+    footprint.weeks = 0;
+    footprint.room = course.location.trimmed();
+    footprint.teacher = course.teacher.trimmed();
+
+    if (course.dayOfWeek < 1 || course.dayOfWeek > DaysPerWeek) {
+        return footprint;
+    }
+    footprint.slotMask = slotRangeMask(course.startSlot, course.endSlot);
+
+    // 以当天的实际上课日期判断该周是否在课程起止日期内
+    const qint64 first = m_firstMonday.toJulianDay() + footprint.day;
+    const qint64 start = course.startDate.isValid() ? course.startDate.toJulianDay() : first;
+    const qint64 end = course.endDate.isValid() ? course.endDate.toJulianDay()
+                                                 : first + qint64(m_weekCount) * 7;
+    for (int week = 0; week < m_weekCount; ++week) {
+        const qint64 day = first + qint64(week) * 7;
+        if (day >= start && day <= end && course.occursInWeek(week + 1)) {
+            footprint.weeks |= quint64(1) << week;
+        }
+    }
+    return footprint;
+}
+
+void OccupancyIndex::apply(Layer &layer, const Footprint &footprint, int delta)
+{
+    if (footprint.slotMask == 0 || footprint.weeks == 0) return;
+
+    if (layer.masks.isEmpty()) {
+        layer.counts.fill(0, m_weekCount * DaysPerWeek * SlotsPerDay);
+        layer.masks.fill(0, m_weekCount * DaysPerWeek);
+    }
+
+    for (int week = 0; week < m_weekCount; ++week) {
+        if (!(footprint.weeks & (quint64(1) << week))) continue;
+
+        const int cell = week * DaysPerWeek + footprint.day;
+        quint16 &mask = layer.masks[cell];
+        for (int slot = 0; slot < SlotsPerDay; ++slot) {
+            const quint16 bit = quint16(1u << slot);
+            if (!(footprint.slotMask & bit)) continue;
+
+            quint16 &count = layer.counts[cell * SlotsPerDay + slot];
+            if (delta > 0) {
+                ++count;
+                mask |= bit;
+            } else if (count > 0 && --count == 0) {
+                mask &= quint16(~bit);
+            }
+        }
+    }
+}
+
+quint16 OccupancyIndex::layerMask(const Layer &layer, int week, int day) const
+{
+    if (week < 0 || week >= m_weekCount || day < 1 || day > DaysPerWeek) return 0;
+    if (layer.masks.isEmpty()) return 0;
+    return layer.masks.at(week * DaysPerWeek + day - 1);
+}
@@ -0,0 +1,73 @@
+#ifndef OCCUPANCYINDEX_H
+#define OCCUPANCYINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class CourseData;
+
+// 学期占用位图：周 × 7 天 × 10 节。
+// 每个 (周, 天) 用一个 quint16 的低 10 位表示各节是否被占用，
+// 另外按教室、教师各维护一层，增删课程时只改动受影响的格子。
+class OccupancyIndex
+{
+public:
+    static constexpr int DaysPerWeek = 7;
+    static constexpr int SlotsPerDay = 10;
+    static constexpr int MaxWeeks = 64;
+
+    OccupancyIndex();
+
+    void reset(const QDate &semesterStart, int weekCount);
+    void clear();
+
+    void addCourse(const CourseData &course);
+    bool removeCourse(int courseId);
+    bool contains(int courseId) const;
+    int courseCount() const;
+    qint64 memoryBytes() const; // 估算占用的堆内存
+
+    int weekCount() const;
+    QDate firstMonday() const;
+    int weekIndexOf(const QDate &date) const; // 从 0 开始，不在学期内返回 -1
+
+    // day 取 1-7，slot 取 1-10，与 CourseData 保持一致
+    quint16 busyMask(int week, int day) const;
+    quint16 roomBusyMask(const QString &room, int week, int day) const;
+    quint16 teacherBusyMask(const QString &teacher, int week, int day) const;
+    bool isSlotFree(int week, int day, int slot) const;
+    quint64 activeWeeks(const CourseData &course) const; // 第 i 位表示第 i+1 周上课
+    quint64 activeWeeks(int courseId) const;
+    int slotLoad(int week, int day, int slot) const; // 该节被多少门课占用，供热力图使用
+
+    static quint16 slotRangeMask(int startSlot, int endSlot);
+
+private:
+    struct Footprint {
+        int day;        // 0-6
+        quint16 slotMask;  // 节次位
+        quint64 weeks;     // 周次位
+        QString room;
+        QString teacher;
+    };
+
+    struct Layer {
+        QVector<quint16> counts; // 每节的占用计数
+        QVector<quint16> masks;  // 每个 (周, 天) 的占用位
+    };
+
+    Footprint footprintOf(const CourseData &course) const;
+    void apply(Layer &layer, const Footprint &footprint, int delta);
+    quint16 layerMask(const Layer &layer, int week, int day) const;
+
+    QDate m_firstMonday;
+    int m_weekCount;
+    Layer m_all;
+    QHash<QString, Layer> m_rooms;
+    QHash<QString, Layer> m_teachers;
+    QHash<int, Footprint> m_footprints;
+};
+
+#endif // OCCUPANCYINDEX_H
@@ -0,0 +1,97 @@
+#include "refreshscratch.h"
+#include "coursemanager.h"
+#include <QStringBuilder>
+#include <QVector>
+
+namespace {
+// 节次、星期、周数这类小整数预先转换好，拼接时不再为数字单独分配；
+// 超出范围的值（如跨度超过 99 周的异常数据）退回 QString::number
+QString smallNumber(int value)
+{
+    static const QVector<QString> numbers = [] {
+        QVector<QString> list;
+        for (int i = 0; i < 100; ++i) {
+            list.append(QString::number(i));
+        }
+        return list;
+    }();
+    return value >= 0 && value < numbers.size() ? numbers.at(value) : QString::number(value);
+}
+}
+
+RefreshScratch::RefreshScratch()
+{
+}
+
+const QString &RefreshScratch::cellText(const CourseData &course)
+{
+    Entry &entry = entryFor(course);
+    if (entry.cellText.isNull()) {
+        entry.cellText = course.name % QStringLiteral("\n@") % course.location;
+    }
+    return entry.cellText;
+}
+
+const QString &RefreshScratch::continuationText(const CourseData &course)
+{
+    Entry &entry = entryFor(course);
+    if (entry.continuationText.isNull()) {
+        entry.continuationText = QStringLiteral("↳ ") % course.name;
+    }
+    return entry.continuationText;
+}
+
+const QString &RefreshScratch::toolTip(const CourseData &course)
+{
+    Entry &entry = entryFor(course);
+    if (!entry.toolTip.isNull()) {
+        return entry.toolTip;
+    }
+
+    const QString credits = QString::number(course.credits);
+    const QString weeks = course.weekPatternText();
+
+    const QString &teacher = course.teacher.isEmpty() ? QStringLiteral("未设置") : course.teacher;
+    if (course.examDate.isValid()) {
+        const QString exam = course.examDate.toString("yyyy-MM-dd");
+        entry.toolTip = QStringLiteral("课程: ") % course.name
+                        % QStringLiteral("\n地点: ") % course.location
+                        % QStringLiteral("\n时间: 第") % smallNumber(course.startSlot)
+                        % QLatin1Char('-') % smallNumber(course.endSlot)
+                        % QStringLiteral("节\n教师: ") % teacher
+                        % QStringLiteral("\n类型: ") % course.courseType
+                        % QStringLiteral("\n学分: ") % credits
+                        % QStringLiteral("\n周次: ") % weeks
+                        % QStringLiteral("\n考试: ") % exam;
+    } else {
+        entry.toolTip = QStringLiteral("课程: ") % course.name
+                        % QStringLiteral("\n地点: ") % course.location
+                        % QStringLiteral("\n时间: 第") % smallNumber(course.startSlot)
+                        % QLatin1Char('-') % smallNumber(course.endSlot)
+                        % QStringLiteral("节\n教师: ") % teacher
+                        % QStringLiteral("\n类型: ") % course.courseType
+                        % QStringLiteral("\n学分: ") % credits
+                        % QStringLiteral("\n周次: ") % weeks;
+    }
+    return entry.toolTip;
+}
+
+QString RefreshScratch::timeText(const CourseData &course)
+{
+    return QStringLiteral("周") % smallNumber(course.dayOfWeek)
+           % QStringLiteral(" 第") % smallNumber(course.startSlot)
+           % QLatin1Char('-') % smallNumber(course.endSlot) % QStringLiteral("节");
+}
+
+QString RefreshScratch::spanText(const CourseData &course)
+{
+    if (course.weekMask != CourseData::AllWeeks) {
+        return course.weekPatternText();
+    }
+    return smallNumber(int(course.startDate.daysTo(course.endDate) / 7) + 1) % QStringLiteral("周");
+}
+
+RefreshScratch::Entry &RefreshScratch::entryFor(const CourseData &course)
+{
+    return m_entries[course.id];
+}
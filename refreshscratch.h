@@ -0,0 +1,35 @@
+#ifndef REFRESHSCRATCH_H
+#define REFRESHSCRATCH_H
+
+#include <QHash>
+#include <QString>
+
+class CourseData;
+
+// 单次刷新期间使用的临时文本区。
+// 每门课的单元格文本和提示文本只拼接一次（QStringBuilder 一次分配），
+// 同一门课的多个节次共享同一份隐式共享的字符串；刷新结束后随对象一起释放。
+class RefreshScratch
+{
+public:
+    RefreshScratch();
+
+    const QString &cellText(const CourseData &course);         // "课程名\n@地点"
+    const QString &continuationText(const CourseData &course); // "↳ 课程名"
+    const QString &toolTip(const CourseData &course);
+    QString timeText(const CourseData &course);                // "周1 第1-2节"
+    QString spanText(const CourseData &course);                // 搜索结果中的周数列
+
+private:
+    struct Entry {
+        QString cellText;
+        QString continuationText;
+        QString toolTip;
+    };
+
+    Entry &entryFor(const CourseData &course);
+
+    QHash<int, Entry> m_entries;
+};
+
+#endif // REFRESHSCRATCH_H
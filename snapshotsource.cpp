@@ -0,0 +1,108 @@
+#include "snapshotsource.h"
+#include <algorithm>
+
+SnapshotSource::SnapshotSource()
+{
+}
+
+bool SnapshotSource::open(const QString &filePath)
+{
+    if (!m_snapshot.open(filePath)) {
+        return false;
+    }
+    m_semester = m_snapshot.semesterName();
+    m_start = m_snapshot.semesterStart();
+    m_end = m_snapshot.semesterEnd();
+    return true;
+}
+
+QString SnapshotSource::errorString() const
+{
+    return m_snapshot.errorString();
+}
+
+bool SnapshotSource::isMapped() const
+{
+    return m_snapshot.isMapped();
+}
+
+QString SnapshotSource::getCurrentSemester() const
+{
+    return m_semester;
+}
+
+QDate SnapshotSource::getSemesterStartDate() const
+{
+    return m_start;
+}
+
+QDate SnapshotSource::getSemesterEndDate() const
+{
+    return m_end;
+}
+
+int SnapshotSource::getSemesterWeeks() const
+{
+    if (!m_start.isValid() || !m_end.isValid() || m_start >= m_end) {
+        return 0;
+    }
+    return m_start.daysTo(m_end) / 7 + 1;
+}
+
+int SnapshotSource::getWeekNumber(const QDate &date) const
+{
+    QDate firstMonday = m_start.addDays(1 - m_start.dayOfWeek());
+    qint64 days = firstMonday.daysTo(date);
+    return days < 0 ? 0 : int(days / 7) + 1;
+}
+
+QList<CourseData> SnapshotSource::getCoursesByWeek(const QDate &date)
+{
+    // 与 CourseManager 一致：起止日期包含 date，且该周在周次位中
+    const qint64 day = date.toJulianDay();
+    const int week = getWeekNumber(date);
+    const bool inMask = week >= 1 && week <= CourseData::MaxMaskWeeks;
+    const quint32 bit = inMask ? 1u << (week - 1) : 0;
+
+    QList<CourseData> courses;
+    for (int i = 0; i < m_snapshot.courseCount(); ++i) {
+        const CourseSnapshot::Record &record = m_snapshot.record(i);
+        if (!record.startDate || record.startDate > day || record.endDate < day) continue;
+        if (inMask ? !(record.weekMask & bit) : record.weekMask != CourseData::AllWeeks) continue;
+        courses.append(m_snapshot.course(i));
+    }
+    return sorted(courses);
+}
+
+QList<CourseData> SnapshotSource::getAllCourses()
+{
+    return sorted(m_snapshot.courses());
+}
+
+QList<CourseData> SnapshotSource::searchCourses(const QString &keyword)
+{
+    QList<CourseData> courses = m_snapshot.courses();
+    courses.erase(std::remove_if(courses.begin(), courses.end(), [&keyword](const CourseData &course) {
+        return !course.name.contains(keyword, Qt::CaseInsensitive)
+            && !course.teacher.contains(keyword, Qt::CaseInsensitive)
+            && !course.location.contains(keyword, Qt::CaseInsensitive);
+    }), courses.end());
+    return sorted(courses);
+}
+
+CourseData SnapshotSource::getCourseById(int id)
+{
+    for (int i = 0; i < m_snapshot.courseCount(); ++i) {
+        if (m_snapshot.record(i).id == id) return m_snapshot.course(i);
+    }
+    return CourseData();
+}
+
+QList<CourseData> SnapshotSource::sorted(QList<CourseData> courses) const
+{
+    std::sort(courses.begin(), courses.end(), [](const CourseData &a, const CourseData &b) {
+        if (a.dayOfWeek != b.dayOfWeek) return a.dayOfWeek < b.dayOfWeek;
+        return a.startSlot < b.startSlot;
+    });
+    return courses;
+}
@@ -0,0 +1,39 @@
+#ifndef SNAPSHOTSOURCE_H
+#define SNAPSHOTSOURCE_H
+
+#include "coursemanager.h"
+#include "coursesnapshot.h"
+
+// 只读浏览模式的数据来源：直接读取内存映射的学期快照，不打开 SQLite。
+// 启动时只校验快照文件头；按周查询时在定长记录上比较儒略日和周次位，
+// 只有命中的课程才解码字符串，因此几万门课程的快照也能立即显示。
+class SnapshotSource : public CourseSource
+{
+public:
+    SnapshotSource();
+
+    bool open(const QString &filePath);
+    QString errorString() const;
+    bool isMapped() const;
+
+    bool isReadOnly() const override { return true; }
+    QString getCurrentSemester() const override;
+    QDate getSemesterStartDate() const override;
+    QDate getSemesterEndDate() const override;
+    int getSemesterWeeks() const override;
+    int getWeekNumber(const QDate &date) const override;
+    QList<CourseData> getCoursesByWeek(const QDate &date) override;
+    QList<CourseData> getAllCourses() override;
+    QList<CourseData> searchCourses(const QString &keyword) override;
+    CourseData getCourseById(int id) override;
+
+private:
+    QList<CourseData> sorted(QList<CourseData> courses) const;
+
+    CourseSnapshot m_snapshot;
+    QString m_semester;
+    QDate m_start;
+    QDate m_end;
+};
+
+#endif // SNAPSHOTSOURCE_H
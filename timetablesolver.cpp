@@ -0,0 +1,577 @@
+#include "timetablesolver.h"
+#include "occupancyindex.h"
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace {
+const int kDays = OccupancyIndex::DaysPerWeek;
+const int kSlots = OccupancyIndex::SlotsPerDay;
+
+const int kHardWeight = 1000;        // 一次硬冲突相当于多少软惩罚
+const int kDayPenalty = 10;          // 排在非偏好星期
+const int kConsecutivePenalty = 50;  // 教师连续上课每超出一节
+const int kRandomWalkPercent = 5;    // 局部搜索中随机换位的概率，帮助跳出局部最优
+const int kStaleRestarts = 4;        // 已无硬冲突时，连续这么多轮重启没有改进就提前结束
+
+int longestRun(quint16 mask)
+{
+    int best = 0;
+    int run = 0;
+    for (int slot = 0; slot < kSlots; ++slot) {
+        run = (mask & (1u << slot)) ? run + 1 : 0;
+        best = qMax(best, run);
+    }
+    return best;
+}
+
+// 一类资源（教室或教师）在 (资源, 周, 星期) 上的逐节占用计数和位图
+struct Grid
+{
+    int weekCount = 0;
+    QVector<quint16> counts;
+    QVector<quint16> masks;
+
+    void init(int resources, int weeks)
+    {
+        weekCount = weeks;
+        counts.fill(0, resources * weeks * kDays * kSlots);
+        masks.fill(0, resources * weeks * kDays);
+    }
+
+    int cell(int resource, int week, int day) const
+    {
+        return (resource * weekCount + week) * kDays + day;
+    }
+
+    quint16 mask(int resource, int week, int day) const
+    {
+        return masks.at(cell(resource, week, day));
+    }
+
+    void apply(int resource, int day, quint16 range, quint64 weeks, int delta)
+    {
+        if (resource < 0) return;
+        for (int week = 0; week < weekCount; ++week) {
+            if (!(weeks & (quint64(1) << week))) continue;
+
+            const int c = cell(resource, week, day);
+            quint16 &bits = masks[c];
+            for (int slot = 0; slot < kSlots; ++slot) {
+                const quint16 bit = quint16(1u << slot);
+                if (!(range & bit)) continue;
+
+                quint16 &count = counts[c * kSlots + slot];
+                if (delta > 0) {
+                    ++count;
+                    bits |= bit;
+                } else if (count > 0 && --count == 0) {
+                    bits &= quint16(~bit);
+                }
+            }
+        }
+    }
+
+    // 课程尚未放入时，与已有占用重叠的 (周, 节) 数
+    int overlap(int resource, int day, quint16 range, quint64 weeks) const
+    {
+        if (resource < 0) return 0;
+        int total = 0;
+        for (int week = 0; week < weekCount; ++week) {
+            if (weeks & (quint64(1) << week)) {
+                total += qPopulationCount(quint16(mask(resource, week, day) & range));
+            }
+        }
+        return total;
+    }
+
+    // 课程已经放入时，与其他课程重叠的 (周, 节) 数
+    int overlapWithOthers(int resource, int day, quint16 range, quint64 weeks) const
+    {
+        if (resource < 0) return 0;
+        int total = 0;
+        for (int week = 0; week < weekCount; ++week) {
+            if (!(weeks & (quint64(1) << week))) continue;
+
+            const int base = cell(resource, week, day) * kSlots;
+            for (int slot = 0; slot < kSlots; ++slot) {
+                if ((range & (1u << slot)) && counts.at(base + slot) > 1) ++total;
+            }
+        }
+        return total;
+    }
+};
+
+struct Job
+{
+    int duration = 1;
+    int teacher = -1;            // -1 表示未填写教师
+    QVector<int> rooms;          // 容量足够的教室；不分配教室时只有课程原来的教室
+    quint64 weeks[kDays] = {};   // 排在周一..周日时实际上课的周次
+};
+
+struct Placement
+{
+    int day = -1;                // 0..6，-1 表示没有可行位置
+    int start = 0;
+    int room = -1;
+
+    bool operator==(const Placement &other) const
+    {
+        return day == other.day && start == other.start && room == other.room;
+    }
+};
+
+struct Problem
+{
+    int earliest = 1;
+    int latest = kSlots;
+    quint8 preferredDays = 0x1F;
+    int maxConsecutive = 0;
+    bool assignRooms = false;
+    QVector<Job> jobs;
+    QVector<quint16> unavailable; // 教师 * 7 + 星期
+    Grid rooms;
+    Grid teachers;
+    QStringList roomNames;
+};
+
+// 一次重启的搜索状态，只在单个工作线程内使用
+class Search
+{
+public:
+    Search(const Problem &problem, quint32 seed)
+        : m_problem(problem), m_rooms(problem.rooms), m_teachers(problem.teachers),
+        m_random(seed), m_placements(problem.jobs.size())
+    {
+    }
+
+    void greedy()
+    {
+        QVector<int> order(m_problem.jobs.size());
+        for (int i = 0; i < order.size(); ++i) order[i] = i;
+
+        // 先随机打乱，再把节数多、可选教室少的课程排在前面，同类课程的先后由种子决定
+        std::shuffle(order.begin(), order.end(), m_random);
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            const Job &left = m_problem.jobs.at(a);
+            const Job &right = m_problem.jobs.at(b);
+            if (left.duration != right.duration) return left.duration > right.duration;
+            return left.rooms.size() < right.rooms.size();
+        });
+
+        for (int job : order) {
+            place(job, bestPlacement(job, Placement()), 1);
+        }
+        remember();
+    }
+
+    void improve(int maxMoves, const std::function<bool()> &shouldStop)
+    {
+        QVector<int> pending;
+        bool softPhase = false;
+
+        for (int moves = 0; moves < maxMoves; ) {
+            if (pending.isEmpty()) {
+                if ((moves & 63) == 0 && shouldStop()) break;
+                remember();
+                pending = collect(&softPhase);
+                if (pending.isEmpty()) break;
+            }
+            if ((moves & 255) == 0 && shouldStop()) break;
+
+            const int pick = m_random.bounded(pending.size());
+            const int job = pending.at(pick);
+            pending[pick] = pending.last();
+            pending.removeLast();
+
+            const bool stale = softPhase ? jobSoft(job) == 0 : jobHard(job) == 0;
+            if (stale) continue;
+
+            const Placement current = m_placements.at(job);
+            place(job, current, -1);
+
+            Placement next;
+            if (!softPhase && m_random.bounded(100) < kRandomWalkPercent) {
+                next = randomPlacement(job);
+            } else {
+                // 消解硬冲突时不允许原地不动，否则容易在同一个局部最优里打转
+                next = bestPlacement(job, softPhase ? Placement() : current);
+            }
+            place(job, next.day < 0 ? current : next, 1);
+            ++moves;
+        }
+        remember();
+    }
+
+    // 直接放入给定的位置，用于检查最终结果
+    void load(const QVector<Placement> &placements)
+    {
+        for (int i = 0; i < placements.size() && i < m_placements.size(); ++i) {
+            place(i, placements.at(i), 1);
+        }
+    }
+
+    bool hasHardConflict(int index) const { return jobHard(index) > 0; }
+
+    int bestHard() const { return m_bestHard; }
+    int bestSoft() const { return m_bestSoft; }
+    const QVector<Placement> &bestPlacements() const { return m_best; }
+
+private:
+    quint16 rangeOf(const Job &job, int start) const
+    {
+        return OccupancyIndex::slotRangeMask(start, start + job.duration - 1);
+    }
+
+    void place(int index, const Placement &placement, int delta)
+    {
+        if (placement.day < 0) return;
+
+        const Job &job = m_problem.jobs.at(index);
+        const quint16 range = rangeOf(job, placement.start);
+        const quint64 weeks = job.weeks[placement.day];
+        m_rooms.apply(placement.room, placement.day, range, weeks, delta);
+        m_teachers.apply(job.teacher, placement.day, range, weeks, delta);
+        if (delta > 0) m_placements[index] = placement;
+    }
+
+    int unavailableOverlap(const Job &job, int day, quint16 range) const
+    {
+        if (job.teacher < 0) return 0;
+        return qPopulationCount(quint16(m_problem.unavailable.at(job.teacher * kDays + day) & range));
+    }
+
+    // 教师的软惩罚：非偏好星期 + 单日连续节数超限（教师位图中需已包含本课程）
+    int softCost(const Job &job, int day, quint16 range, bool placed) const
+    {
+        int cost = (m_problem.preferredDays & (1u << day)) ? 0 : kDayPenalty;
+        if (m_problem.maxConsecutive <= 0 || job.teacher < 0) return cost;
+
+        int excess = 0;
+        const quint64 weeks = job.weeks[day];
+        for (int week = 0; week < m_teachers.weekCount; ++week) {
+            if (!(weeks & (quint64(1) << week))) continue;
+            quint16 mask = m_teachers.mask(job.teacher, week, day);
+            if (!placed) mask |= range;
+            excess = qMax(excess, longestRun(mask) - m_problem.maxConsecutive);
+        }
+        return cost + kConsecutivePenalty * excess;
+    }
+
+    int jobHard(int index) const
+    {
+        const Placement &placement = m_placements.at(index);
+        if (placement.day < 0) return 0;
+
+        const Job &job = m_problem.jobs.at(index);
+        const quint16 range = rangeOf(job, placement.start);
+        const quint64 weeks = job.weeks[placement.day];
+        return m_rooms.overlapWithOthers(placement.room, placement.day, range, weeks)
+               + m_teachers.overlapWithOthers(job.teacher, placement.day, range, weeks)
+               + unavailableOverlap(job, placement.day, range);
+    }
+
+    int jobSoft(int index) const
+    {
+        const Placement &placement = m_placements.at(index);
+        if (placement.day < 0) return 0;
+
+        const Job &job = m_problem.jobs.at(index);
+        return softCost(job, placement.day, rangeOf(job, placement.start), true);
+    }
+
+    // 在所有 (星期, 开始节次, 教室) 中取代价最小者，代价相同的随机取一个
+    Placement bestPlacement(int index, const Placement &avoid)
+    {
+        const Job &job = m_problem.jobs.at(index);
+        Placement best;
+        int bestCost = std::numeric_limits<int>::max();
+        int ties = 0;
+
+        auto consider = [&](const Placement &candidate, int cost) {
+            if (candidate == avoid) return;
+            if (cost < bestCost) {
+                best = candidate;
+                bestCost = cost;
+                ties = 1;
+            } else if (cost == bestCost && m_random.bounded(++ties) == 0) {
+                best = candidate;
+            }
+        };
+
+        for (int day = 0; day < kDays; ++day) {
+            const quint64 weeks = job.weeks[day];
+            for (int start = m_problem.earliest; start + job.duration - 1 <= m_problem.latest; ++start) {
+                const quint16 range = rangeOf(job, start);
+                const int teacherHard = m_teachers.overlap(job.teacher, day, range, weeks)
+                                        + unavailableOverlap(job, day, range);
+                const int base = teacherHard * kHardWeight + softCost(job, day, range, false);
+                if (base > bestCost) continue;
+
+                Placement candidate;
+                candidate.day = day;
+                candidate.start = start;
+                if (job.rooms.isEmpty()) {
+                    consider(candidate, base);
+                    continue;
+                }
+                for (int room : job.rooms) {
+                    candidate.room = room;
+                    consider(candidate, base + m_rooms.overlap(room, day, range, weeks) * kHardWeight);
+                }
+            }
+        }
+        return best;
+    }
+
+    Placement randomPlacement(int index)
+    {
+        const Job &job = m_problem.jobs.at(index);
+        const int starts = m_problem.latest - m_problem.earliest - job.duration + 2;
+        if (starts <= 0 || (m_problem.assignRooms && job.rooms.isEmpty())) return Placement();
+
+        Placement placement;
+        placement.day = m_random.bounded(kDays);
+        placement.start = m_problem.earliest + m_random.bounded(starts);
+        if (!job.rooms.isEmpty()) {
+            placement.room = job.rooms.at(m_random.bounded(job.rooms.size()));
+        }
+        return placement;
+    }
+
+    // 收集待处理课程：先处理有硬冲突的，全部消解后再处理有软惩罚的
+    QVector<int> collect(bool *softPhase) const
+    {
+        QVector<int> hard;
+        QVector<int> soft;
+        for (int i = 0; i < m_placements.size(); ++i) {
+            if (jobHard(i) > 0) hard.append(i);
+            else if (hard.isEmpty() && jobSoft(i) > 0) soft.append(i);
+        }
+        *softPhase = hard.isEmpty();
+        return hard.isEmpty() ? soft : hard;
+    }
+
+    void remember()
+    {
+        int hard = 0;
+        int soft = 0;
+        for (int i = 0; i < m_placements.size(); ++i) {
+            hard += jobHard(i) > 0 ? 1 : 0;
+            soft += jobSoft(i);
+        }
+        if (hard < m_bestHard || (hard == m_bestHard && soft < m_bestSoft)) {
+            m_bestHard = hard;
+            m_bestSoft = soft;
+            m_best = m_placements;
+        }
+    }
+
+    const Problem &m_problem;
+    Grid m_rooms;
+    Grid m_teachers;
+    QRandomGenerator m_random;
+    QVector<Placement> m_placements;
+    QVector<Placement> m_best;
+    int m_bestHard = std::numeric_limits<int>::max();
+    int m_bestSoft = std::numeric_limits<int>::max();
+};
+
+Problem buildProblem(const ScheduleRequest &request, QStringList *notes)
+{
+    Problem problem;
+    problem.earliest = qBound(1, request.earliestSlot, kSlots);
+    problem.latest = qBound(problem.earliest, request.latestSlot, kSlots);
+    problem.preferredDays = request.preferredDays;
+    problem.maxConsecutive = request.maxConsecutive;
+
+    // 借用占用索引计算课程在每个星期实际上课的周次，规则与冲突检测一致
+    OccupancyIndex weeksOf;
+    weeksOf.reset(request.semesterStart, request.weekCount);
+    const int weekCount = weeksOf.weekCount();
+
+    QHash<QString, int> roomIndex;
+    auto addRoom = [&roomIndex, &problem](const QString &name) {
+        const QString room = name.trimmed();
+        if (!room.isEmpty() && !roomIndex.contains(room)) {
+            roomIndex.insert(room, problem.roomNames.size());
+            problem.roomNames.append(room);
+        }
+    };
+    for (const QString &name : request.rooms) addRoom(name);
+    problem.assignRooms = !problem.roomNames.isEmpty();
+
+    // 不分配教室时仍要检查教室冲突：按已有课程和待排课程原来的地点建立教室位图，
+    // 每门待排课程固定在自己的教室
+    if (!problem.assignRooms) {
+        for (const CourseData &course : request.fixed) addRoom(course.location);
+        for (const CourseData &course : request.toPlace) addRoom(course.location);
+    }
+
+    QHash<QString, int> teacherIndex;
+    auto teacherOf = [&teacherIndex](const QString &name) {
+        const QString teacher = name.trimmed();
+        if (teacher.isEmpty()) return -1;
+        auto it = teacherIndex.constFind(teacher);
+        if (it != teacherIndex.constEnd()) return it.value();
+        const int index = teacherIndex.size();
+        teacherIndex.insert(teacher, index);
+        return index;
+    };
+    for (const CourseData &course : request.fixed) teacherOf(course.teacher);
+    for (const CourseData &course : request.toPlace) teacherOf(course.teacher);
+
+    problem.rooms.init(problem.roomNames.size(), weekCount);
+    problem.teachers.init(teacherIndex.size(), weekCount);
+    problem.unavailable.fill(0, teacherIndex.size() * kDays);
+
+    for (const CourseData &course : request.fixed) {
+        if (course.dayOfWeek < 1 || course.dayOfWeek > kDays) continue;
+        const quint16 range = OccupancyIndex::slotRangeMask(course.startSlot, course.endSlot);
+        const quint64 weeks = weeksOf.activeWeeks(course);
+        problem.rooms.apply(roomIndex.value(course.location.trimmed(), -1), course.dayOfWeek - 1, range, weeks, 1);
+        problem.teachers.apply(teacherOf(course.teacher), course.dayOfWeek - 1, range, weeks, 1);
+    }
+
+    for (auto it = request.teacherUnavailable.constBegin(); it != request.teacherUnavailable.constEnd(); ++it) {
+        const int teacher = teacherIndex.value(it.key().trimmed(), -1);
+        if (teacher < 0) continue;
+        for (int day = 0; day < kDays && day < it.value().size(); ++day) {
+            problem.unavailable[teacher * kDays + day] = it.value().at(day);
+        }
+    }
+
+    const int window = problem.latest - problem.earliest + 1;
+    for (const CourseData &course : request.toPlace) {
+        Job job;
+        job.duration = qBound(1, course.endSlot - course.startSlot + 1, kSlots);
+        job.teacher = teacherOf(course.teacher);
+
+        CourseData probe = course;
+        probe.startSlot = 1;
+        probe.endSlot = 1;
+        for (int day = 0; day < kDays; ++day) {
+            probe.dayOfWeek = day + 1;
+            job.weeks[day] = weeksOf.activeWeeks(probe);
+        }
+
+        const int size = request.courseSize.value(course.id, 0);
+        if (problem.assignRooms) {
+            for (int room = 0; room < problem.roomNames.size(); ++room) {
+                const int capacity = request.roomCapacity.value(problem.roomNames.at(room), 0);
+                if (size <= 0 || capacity <= 0 || capacity >= size) {
+                    job.rooms.append(room);
+                }
+            }
+        } else {
+            const int ownRoom = roomIndex.value(course.location.trimmed(), -1);
+            if (ownRoom >= 0) job.rooms.append(ownRoom);
+        }
+
+        if (job.duration > window) {
+            notes->append(QString("%1：%2 节超出可排节次范围").arg(course.name).arg(job.duration));
+        } else if (problem.assignRooms && job.rooms.isEmpty()) {
+            notes->append(QString("%1：没有容量不少于 %2 人的教室").arg(course.name).arg(size));
+        }
+        problem.jobs.append(job);
+    }
+    return problem;
+}
+}
+
+TimetableSolver::TimetableSolver(const ScheduleRequest &request)
+    : m_request(request)
+{
+}
+
+ScheduleResult TimetableSolver::solve(const std::atomic<bool> *cancel) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    ScheduleResult result;
+    QStringList notes;
+    const Problem problem = buildProblem(m_request, &notes);
+
+    QDeadlineTimer deadline(m_request.timeLimitMs);
+    std::atomic<bool> stop(false);
+    auto shouldStop = [&]() {
+        return stop.load() || (cancel && cancel->load()) || deadline.hasExpired();
+    };
+
+    QMutex mutex;
+    QVector<Placement> best;
+    int bestHard = std::numeric_limits<int>::max();
+    int bestSoft = std::numeric_limits<int>::max();
+    int staleRestarts = 0;
+    QAtomicInt nextSeed(0);
+
+    const int threads = m_request.threadCount > 0 ? m_request.threadCount : QThread::idealThreadCount();
+    const int movesPerRestart = qMax(2000, int(problem.jobs.size()) * 50);
+
+    if (!problem.jobs.isEmpty()) {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        for (int i = 0; i < threads; ++i) {
+            pool.start([&]() {
+                while (!shouldStop()) {
+                    // 每轮重启领取一个新种子；线程之间不做同步，快的线程自然多跑几轮
+                    const quint32 seed = quint32(nextSeed.fetchAndAddRelaxed(1)) * 2654435761u + 17u;
+                    Search search(problem, seed);
+                    search.greedy();
+                    search.improve(movesPerRestart, shouldStop);
+
+                    QMutexLocker locker(&mutex);
+                    ++result.restarts;
+                    if (search.bestHard() < bestHard
+                        || (search.bestHard() == bestHard && search.bestSoft() < bestSoft)) {
+                        bestHard = search.bestHard();
+                        bestSoft = search.bestSoft();
+                        best = search.bestPlacements();
+                        staleRestarts = 0;
+                    } else if (bestHard == 0) {
+                        ++staleRestarts;
+                    }
+                    if (bestHard == 0 && (bestSoft == 0 || staleRestarts >= kStaleRestarts * threads)) {
+                        stop = true;
+                    }
+                }
+            });
+        }
+        pool.waitForDone();
+    }
+
+    // 组装结果；没有可行位置的课程保留原来的时间和地点
+    Search replay(problem, 0);
+    replay.load(best);
+    result.unresolved = notes;
+    for (int i = 0; i < m_request.toPlace.size(); ++i) {
+        CourseData course = m_request.toPlace.at(i);
+        const Placement placement = i < best.size() ? best.at(i) : Placement();
+        if (placement.day >= 0) {
+            course.dayOfWeek = placement.day + 1;
+            course.startSlot = placement.start;
+            course.endSlot = placement.start + problem.jobs.at(i).duration - 1;
+            if (problem.assignRooms && placement.room >= 0) {
+                course.location = problem.roomNames.at(placement.room);
+            }
+            if (replay.hasHardConflict(i)) {
+                result.unresolved.append(QString("%1：教室、教师或可用时间仍有冲突").arg(course.name));
+            }
+        }
+        result.placed.append(course);
+    }
+
+    result.softPenalty = bestSoft == std::numeric_limits<int>::max() ? 0 : bestSoft;
+    result.canceled = cancel && cancel->load();
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef TIMETABLESOLVER_H
+#define TIMETABLESOLVER_H
+
+#include <QDate>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "coursemanager.h"
+
+// 自动排课的输入
+struct ScheduleRequest
+{
+    QList<CourseData> fixed;     // 位置不变的课程，只占用教室和教师
+    QList<CourseData> toPlace;   // 待排课程：节数取 endSlot-startSlot+1，教师、周次、日期不变
+    QStringList rooms;           // 可选教室；为空时保留课程原有地点，只排时间
+    QHash<QString, int> roomCapacity;                     // 教室 -> 容量，未列出视为不限
+    QHash<int, int> courseSize;                           // 课程 id -> 人数，未列出视为不限
+    QHash<QString, QVector<quint16>> teacherUnavailable;  // 教师 -> 周一..周日不可用的节次位
+    quint8 preferredDays = 0x1F; // 第 i 位 = 周 i+1，默认周一到周五
+    int maxConsecutive = 4;      // 教师单日最多连续上课节数，0 表示不限
+    int earliestSlot = 1;
+    int latestSlot = 10;
+    QDate semesterStart;
+    int weekCount = 0;
+    int timeLimitMs = 5000;
+    int threadCount = 0;         // 0 表示按 CPU 核数
+};
+
+struct ScheduleResult
+{
+    QList<CourseData> placed;    // 与 toPlace 一一对应，已填好星期、节次和地点
+    QStringList unresolved;      // 仍未满足硬约束的课程及原因
+    int softPenalty = 0;
+    int restarts = 0;
+    qint64 elapsedMs = 0;
+    bool canceled = false;
+};
+
+// 自动排课求解器。
+// 每门待排课程在 (星期, 开始节次, 教室) 上取值；教室/教师不冲突、教师可用时间和教室容量是硬约束，
+// 偏好星期和教师单日连续节数是软约束。搜索为“贪心初解 + 最小冲突局部搜索”的多次重启，
+// 多个工作线程从共享计数器领取重启任务，先完成的线程自动多领，最后取所有线程中的最优解。
+class TimetableSolver
+{
+public:
+    explicit TimetableSolver(const ScheduleRequest &request);
+
+    // 阻塞直到找到无冲突且无惩罚的解、超时或 cancel 被置位
+    ScheduleResult solve(const std::atomic<bool> *cancel = nullptr) const;
+
+private:
+    ScheduleRequest m_request;
+};
+
+#endif // TIMETABLESOLVER_H